@@ -0,0 +1,64 @@
+#include "artifact_writer.h"
+#include "thread_pool.h"
+#include "fast_png.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Encoding is CPU bound, a few workers are enough to keep up without starving the tests:
+enum { ArtifactMaxThreads = 4, ArtifactMaxQueued = 16 };
+
+struct ArtifactJob {
+    char path[1024];
+    uint32_t width, height, comps;
+    uint8_t pixels[1]; // width * height * comps, packed
+};
+
+static ThreadPool *s_pArtifactPool;
+
+static void
+WriteArtifactJob(void *pArg)
+{
+    ArtifactJob *const job = static_cast<ArtifactJob *>(pArg);
+    int const rowBytes = int(job->width * job->comps);
+    if (!FastPngWrite(job->path, int(job->width), int(job->height), int(job->comps), job->pixels, rowBytes)) {
+        printf("ERROR: failed to write %s\n", job->path);
+    }
+    free(job);
+}
+
+void
+ArtifactWritePng(const char *path, uint32_t width, uint32_t height, uint32_t comps, const void *pPixels, size_t rowPitch)
+{
+    if (!s_pArtifactPool) {
+        unsigned const n = ThreadPoolDefaultThreadCount();
+        s_pArtifactPool = ThreadPoolCreate(n < ArtifactMaxThreads ? n : unsigned(ArtifactMaxThreads), ArtifactMaxQueued);
+    }
+    size_t const rowBytes = size_t(width) * comps;
+    ArtifactJob *const job = static_cast<ArtifactJob *>(malloc(offsetof(ArtifactJob, pixels) + rowBytes * height));
+    if (!job) {
+        // No room for a copy, so encode straight from the caller's pixels before returning:
+        if (!FastPngWrite(path, int(width), int(height), int(comps), pPixels, int(rowPitch))) {
+            printf("ERROR: failed to write %s\n", path);
+        }
+        return;
+    }
+    snprintf(job->path, sizeof job->path, "%s", path);
+    job->width = width;
+    job->height = height;
+    job->comps = comps;
+    for (uint32_t y = 0; y < height; ++y) {
+        memcpy(job->pixels + y * rowBytes, static_cast<const uint8_t *>(pPixels) + y * rowPitch, rowBytes);
+    }
+    ThreadPoolSubmit(s_pArtifactPool, WriteArtifactJob, job);
+}
+
+void
+ArtifactFlush()
+{
+    if (s_pArtifactPool) {
+        ThreadPoolDestroy(s_pArtifactPool);
+        s_pArtifactPool = nullptr;
+    }
+}
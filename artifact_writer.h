@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Saves test output images (failing results, debug dumps) on worker threads so the test
+ * doesn't block on PNG compression. The pixels are copied before returning, so the caller
+ * may reuse or unmap them right away. Once too many writes are pending, ArtifactWritePng
+ * blocks until a worker catches up. If the copy can't be allocated, it writes synchronously.
+ *
+ * Write failures are reported from the worker threads.
+ */
+
+// Encoded with FastPngWrite. Same arguments as stbi_write_png: comps is 1-4 channels of 8 bits, rowPitch in bytes.
+void
+ArtifactWritePng(const char *path, uint32_t width, uint32_t height, uint32_t comps, const void *pPixels, size_t rowPitch);
+
+// Waits for all pending writes. main calls this before exiting.
+void
+ArtifactFlush();
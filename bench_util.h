@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+
+// Monotonic wall clock for CPU side timings in benchmarks.
+inline uint64_t
+BenchNowNs()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
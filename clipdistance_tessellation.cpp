@@ -7,7 +7,12 @@
 #include <string.h>
 #include <assert.h>
 
-#include "stb/stb_image_write.h"
+#include "artifact_writer.h"
+#include "result_archive.h"
+#include "shader_cache.h"
+#include "pipeline_batch.h"
+#include "pipeline_library.h"
+#include "spirv_patch.h"
 
 
 struct D3D11_QUERY_DATA_PIPELINE_STATISTICS {
@@ -24,6 +29,20 @@ struct D3D11_QUERY_DATA_PIPELINE_STATISTICS {
   uint64_t CSInvocations;
 };
 
+// 11 bits, matches full D3D11_QUERY_DATA_PIPELINE_STATISTICS:
+static const VkQueryPipelineStatisticFlags D3D11PipelineStatistics =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_GEOMETRY_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_GEOMETRY_SHADER_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_CONTROL_SHADER_PATCHES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
 static void
 #ifdef __GNUC__
 __attribute__((noreturn))
@@ -35,56 +54,13 @@ VerifyVkResultFaild(VkResult r, const char *expr, int line)
 }
 #define VERIFY_VK(e) do { if (VkResult _r = e) VerifyVkResultFaild(_r, #e, __LINE__); } while(0)
 
-static VkShaderModule
-CreateShaderModule(VkDevice device, uint32_t nBytes, const void *spirv)
-{
-    VkShaderModule module = nullptr;
-    VkShaderModuleCreateInfo info = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-    info.codeSize = nBytes;
-    info.pCode = static_cast<const uint32_t *>(spirv);
-    VERIFY_VK(vkCreateShaderModule(device, &info, ALLOC_CBS, &module));
-    return module;
-}
-
-
-static VkShaderModule
-CreateShaderModuleFromFile(VkDevice device, const char *path)
-{
-    if (FILE *const fp = fopen(path, "rb")) {
-        long err = 0;
-        err |= fseek(fp, 0, SEEK_END);
-        long const size = ftell(fp);
-        err |= size;
-        err |= fseek(fp, 0, SEEK_SET);
-        if (err < 0) {
-            perror("fseek/ftell/fseek");
-            exit(int(err));
-        }
-        if (size > 0x7fffffff || size < 20 || (size & 3u)) {
-            printf("bad size = %ld\n", size);
-            exit(42);
-        }
-        void *const data = malloc(size);
-        if (fread(data, 1, size, fp) != size_t(size)) {
-            perror("fread");
-            exit(43);
-        }
-        VkShaderModule sm = CreateShaderModule(device, uint32_t(size), data);
-        free(data);
-        fclose(fp);
-        return sm;
-    } else {
-        perror("fopen");
-        fprintf(stderr, "(path)=(%s)\n", path);
-        exit(1);
-    }
-}
 
+// libraryParts: 0 for a complete pipeline, else the PipelineLibrary* parts to make a library of.
 static void
 CreateGraphicsPipeline(VkDevice device,
                        VkShaderModule vs, VkShaderModule tesc, VkShaderModule tese, VkShaderModule fs,
                        VkRenderPass renderpass, VkPipelineLayout pipelineLayout,
-                       VkPipeline *pPipline)
+                       VkPipeline *pPipline, uint32_t libraryParts)
 {
     VkGraphicsPipelineCreateInfo info = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
 
@@ -173,11 +149,194 @@ CreateGraphicsPipeline(VkDevice device,
     info.stageCount = numStages;
     info.pStages = stages;
 
-    VERIFY_VK(vkCreateGraphicsPipelines(device, VkPipelineCache(), 1, &info, ALLOC_CBS, pPipline));
+    if (libraryParts) {
+        VERIFY_VK(PipelineLibraryCreatePart(info, libraryParts, pPipline));
+    } else {
+        VERIFY_VK(ShaderCacheCreateGraphicsPipeline(info, pPipline));
+    }
 }
 
+struct GraphicsPipelineArgs {
+    VkDevice device;
+    VkShaderModule vs, tesc, tese, fs;
+    VkRenderPass renderpass;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline *pPipeline;
+    uint32_t libraryParts;
+};
 
-bool TestClipDistanceIo(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex, const VkPhysicalDeviceMemoryProperties& memProps)
+static void
+BuildGraphicsPipelineJob(void *pArgs)
+{
+    GraphicsPipelineArgs const *const a = static_cast<const GraphicsPipelineArgs *>(pArgs);
+    CreateGraphicsPipeline(a->device, a->vs, a->tesc, a->tese, a->fs, a->renderpass, a->pipelineLayout, a->pPipeline,
+                           a->libraryParts);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Expected pipeline statistics
+
+/*
+ * Domain points, so the fewest DS invocations, of a triangle patch with every level = f and equal
+ * spacing: rings of 3 * (f - 2k) points inward from the edges, and a center point if f is even.
+ */
+static uint32_t
+TriangleDomainPoints(uint32_t f)
+{
+    uint32_t n = (f & 1) ? 0 : 1;
+    for (uint32_t k = 0; 2*k < f; ++k) {
+        n += 3 * (f - 2*k);
+    }
+    return n;
+}
+
+// Triangles the same patch is split into: a strip between each pair of rings, and the innermost one if f is odd.
+static uint32_t
+TriangleDomainTriangles(uint32_t f)
+{
+    uint32_t n = f & 1;
+    for (uint32_t k = 0; f - 2*k >= 2; ++k) {
+        n += 3 * (f - 2*k) + 3 * (f - 2*k - 2);
+    }
+    return n;
+}
+
+struct ClipIoDraw {
+    uint32_t vertexCount;
+    bool bTessellated; // a 3 control point patch list through the HS and DS, else a triangle list
+    uint32_t tessLevel; // every level the HS writes, 0 if only known to be in [1, maxTessellationGenerationLevel]
+};
+
+// Each pass of TestClipDistanceIo, the way the clip distances get to the HS doesn't change the draws:
+static const ClipIoDraw ClipIoDraws[] = {
+    { 4*2*3, false, 0 },
+    { 4*2*3, true,  0 }, // the levels are up to the HS in shaders/
+};
+
+// The bounds of each counter of a query, a counter below min means work was skipped, above max wasted work:
+struct PipelineStatsModel {
+    D3D11_QUERY_DATA_PIPELINE_STATISTICS min, max;
+};
+
+// How a counter of the ClipDistance pass compares to the same counter of the generic pass:
+enum PipelineStatPasses {
+    StatSameInBothPasses, // before clipping and tessellation, so any difference is work one pass wasted
+    StatTessDependent, // the passes use different HS modules, which may be tessellated differently
+    StatAfterClipping, // only the ClipDistance pass clips
+};
+
+static const struct PipelineStatCounter {
+    const char *name;
+    uint64_t D3D11_QUERY_DATA_PIPELINE_STATISTICS::*pCounter;
+    PipelineStatPasses passes;
+    bool bMaxIsSpec; // the spec bounds it above too, so above max is an error rather than a performance bug
+} PipelineStatCounters[] = {
+    { "IAVertices",    &D3D11_QUERY_DATA_PIPELINE_STATISTICS::IAVertices,    StatSameInBothPasses, true  },
+    { "IAPrimitives",  &D3D11_QUERY_DATA_PIPELINE_STATISTICS::IAPrimitives,  StatSameInBothPasses, true  },
+    { "VSInvocations", &D3D11_QUERY_DATA_PIPELINE_STATISTICS::VSInvocations, StatSameInBothPasses, false },
+    { "GSInvocations", &D3D11_QUERY_DATA_PIPELINE_STATISTICS::GSInvocations, StatSameInBothPasses, false },
+    { "GSPrimitives",  &D3D11_QUERY_DATA_PIPELINE_STATISTICS::GSPrimitives,  StatSameInBothPasses, false },
+    { "CInvocations",  &D3D11_QUERY_DATA_PIPELINE_STATISTICS::CInvocations,  StatTessDependent,    false },
+    { "CPrimitives",   &D3D11_QUERY_DATA_PIPELINE_STATISTICS::CPrimitives,   StatAfterClipping,    false },
+    { "PSInvocations", &D3D11_QUERY_DATA_PIPELINE_STATISTICS::PSInvocations, StatAfterClipping,    false },
+    { "HSInvocations", &D3D11_QUERY_DATA_PIPELINE_STATISTICS::HSInvocations, StatSameInBothPasses, true  },
+    { "DSInvocations", &D3D11_QUERY_DATA_PIPELINE_STATISTICS::DSInvocations, StatTessDependent,    false },
+    { "CSInvocations", &D3D11_QUERY_DATA_PIPELINE_STATISTICS::CSInvocations, StatSameInBothPasses, false },
+};
+
+/*
+ * Non-indexed draws have no vertex reuse, so the VS runs once per vertex, the HS once per patch and
+ * clipping once per triangle out of the VS or DS. DS invocations and tessellated triangles are
+ * bounded by the levels, and the levels are only known to be up to maxTessLevel, so those maxima are
+ * already loose. Only the IA and HS counts are exact per the spec; the VS and DS may legally run more
+ * than once per vertex or domain point, but doing so for these draws is wasted work.
+ * CPrimitives is left open since a clipped triangle may come out as several, and PSInvocations since
+ * helper invocations and the sub-triangles of a patch share quads. Each pass covers at least as many
+ * PS invocations as pixels, and TestClipDistanceIo compares PSInvocations across the passes instead.
+ */
+static void
+ModelPipelineStats(const ClipIoDraw *pDraws, uint32_t numDraws, uint32_t maxTessLevel,
+                   uint64_t coveredPixels, PipelineStatsModel *pModel)
+{
+    D3D11_QUERY_DATA_PIPELINE_STATISTICS& lo = pModel->min;
+    D3D11_QUERY_DATA_PIPELINE_STATISTICS& hi = pModel->max;
+    lo = { };
+    hi = { };
+    for (uint32_t i = 0; i < numDraws; ++i) {
+        const ClipIoDraw& d = pDraws[i];
+        uint64_t const prims = d.vertexCount / 3;
+        lo.IAVertices += d.vertexCount;
+        lo.IAPrimitives += prims;
+        lo.VSInvocations += d.vertexCount;
+        if (d.bTessellated) {
+            uint32_t const minLevel = d.tessLevel ? d.tessLevel : 1;
+            uint32_t const maxLevel = d.tessLevel ? d.tessLevel : maxTessLevel;
+            lo.HSInvocations += prims;
+            hi.HSInvocations += prims;
+            lo.DSInvocations += prims * TriangleDomainPoints(minLevel);
+            hi.DSInvocations += prims * TriangleDomainPoints(maxLevel);
+            lo.CInvocations += prims * TriangleDomainTriangles(minLevel);
+            hi.CInvocations += prims * TriangleDomainTriangles(maxLevel);
+        } else {
+            lo.CInvocations += prims;
+            hi.CInvocations += prims;
+        }
+    }
+    hi.IAVertices = lo.IAVertices;
+    hi.IAPrimitives = lo.IAPrimitives;
+    hi.VSInvocations = lo.VSInvocations;
+    hi.CPrimitives = UINT64_MAX;
+    lo.PSInvocations = coveredPixels;
+    hi.PSInvocations = UINT64_MAX;
+}
+
+// Counts the pixels of a packed RGBA8 image that aren't the clear color.
+static uint64_t
+CountCoverage(const uint32_t *pPixels, uint32_t width, uint32_t height, uint32_t clearColor)
+{
+    uint64_t covered = 0;
+    for (uint32_t i = 0; i < width * height; ++i) {
+        uint32_t const c = pPixels[i];
+        // Allow 1 off per channel for how the clear value is rounded:
+        bool bClear = true;
+        for (int shift = 0; shift < 32; shift += 8) {
+            int const delta = int((c >> shift) & 0xffu) - int((clearColor >> shift) & 0xffu);
+            bClear &= delta >= -1 && delta <= 1;
+        }
+        covered += !bClear;
+    }
+    return covered;
+}
+
+/*
+ * Counters below the model's min, or above it when the spec bounds them, are printed as errors.
+ * Other counters above the model's max are printed as performance bugs. Adds how many of each.
+ */
+static void
+CheckPipelineStats(const char *passName, const D3D11_QUERY_DATA_PIPELINE_STATISTICS& got, const PipelineStatsModel& model,
+                   uint32_t *pNumErrors, uint32_t *pNumPerfBugs)
+{
+    for (const PipelineStatCounter& c : PipelineStatCounters) {
+        uint64_t const v = got.*c.pCounter, lo = model.min.*c.pCounter, hi = model.max.*c.pCounter;
+        if (v < lo) {
+            printf("ERROR: %s: %s = %llu, the draws need at least %llu.\n", passName, c.name,
+                   (unsigned long long)v, (unsigned long long)lo);
+            ++*pNumErrors;
+        } else if (v > hi && c.bMaxIsSpec) {
+            printf("ERROR: %s: %s = %llu, the draws need exactly %llu.\n", passName, c.name,
+                   (unsigned long long)v, (unsigned long long)hi);
+            ++*pNumErrors;
+        } else if (v > hi) {
+            printf("PERFORMANCE BUG: %s: %s = %llu, %llu more than the draws need.\n", passName, c.name,
+                   (unsigned long long)v, (unsigned long long)(v - hi));
+            ++*pNumPerfBugs;
+        }
+    }
+}
+
+bool TestClipDistanceIo(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex, const VkPhysicalDeviceMemoryProperties& memProps,
+                        const VkPhysicalDeviceLimits& limits)
 {
     const VkExtent3D ImageSize = { 256, 256, 1 };
     const VkFormat Format = VK_FORMAT_R8G8B8A8_UNORM;
@@ -190,18 +349,7 @@ bool TestClipDistanceIo(VkDevice device, VkQueue queue, uint32_t graphicsFamilyI
             0x0, // flags
             VK_QUERY_TYPE_PIPELINE_STATISTICS,
             2, // count
-            /* 11 bits, matches full D3D11_QUERY_DATA_PIPELINE_STATISTICS: */
-            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_GEOMETRY_SHADER_INVOCATIONS_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_GEOMETRY_SHADER_PRIMITIVES_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_CONTROL_SHADER_PATCHES_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT |
-            VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT
+            D3D11PipelineStatistics
         };
         VERIFY_VK(vkCreateQueryPool(device, &info, ALLOC_CBS, &pipelineStatsQueryPool));
     }
@@ -310,30 +458,101 @@ bool TestClipDistanceIo(VkDevice device, VkQueue queue, uint32_t graphicsFamilyI
          * ls -l shaders
          *      # shaders -> ../vktest/shaders
          */
-        VkShaderModule vs_clipdist = CreateShaderModuleFromFile(device, "shaders/clipdist_vs.spv");
-        VkShaderModule hs_clipdist = CreateShaderModuleFromFile(device, "shaders/clipdist_hs.spv");
+        VkShaderModule vs_clipdist, hs_clipdist, vs_generic, hs_generic, ps, ds;
+        VERIFY_VK(ShaderCacheAcquireFile("shaders/clipdist_vs.spv", &vs_clipdist));
+        VERIFY_VK(ShaderCacheAcquireFile("shaders/clipdist_hs.spv", &hs_clipdist));
 
-        VkShaderModule vs_generic = CreateShaderModuleFromFile(device, "shaders/generic_vs.spv");
-        VkShaderModule hs_generic = CreateShaderModuleFromFile(device, "shaders/generic_hs.spv");
+        VERIFY_VK(ShaderCacheAcquireFile("shaders/generic_vs.spv", &vs_generic));
+        VERIFY_VK(ShaderCacheAcquireFile("shaders/generic_hs.spv", &hs_generic));
 
-        VkShaderModule ps = CreateShaderModuleFromFile(device, "shaders/clipdist_ps.spv");
-        VkShaderModule ds = CreateShaderModuleFromFile(device, "shaders/clipdist_ds.spv");
+        VERIFY_VK(ShaderCacheAcquireFile("shaders/clipdist_ps.spv", &ps));
+        VERIFY_VK(ShaderCacheAcquireFile("shaders/clipdist_ds.spv", &ds));
 
-        CreateGraphicsPipeline(device, vs_clipdist, VK_NULL_HANDLE, VK_NULL_HANDLE, ps, renderpass, pipelineLayout, &pipelines[0]);
-        CreateGraphicsPipeline(device, vs_clipdist, hs_clipdist, ds, ps, renderpass, pipelineLayout, &pipelines[1]);
+        GraphicsPipelineArgs psoArgs[4] = {
+            { device, vs_clipdist, VK_NULL_HANDLE, VK_NULL_HANDLE, ps, renderpass, pipelineLayout, &pipelines[0] },
+            { device, vs_clipdist, hs_clipdist, ds, ps, renderpass, pipelineLayout, &pipelines[1] },
 
-        CreateGraphicsPipeline(device, vs_generic, VK_NULL_HANDLE, VK_NULL_HANDLE, ps, renderpass, pipelineLayout, &pipelines[2]);
-        CreateGraphicsPipeline(device, vs_generic, hs_generic, ds, ps, renderpass, pipelineLayout, &pipelines[3]);
+            { device, vs_generic, VK_NULL_HANDLE, VK_NULL_HANDLE, ps, renderpass, pipelineLayout, &pipelines[2] },
+            { device, vs_generic, hs_generic, ds, ps, renderpass, pipelineLayout, &pipelines[3] },
+        };
+        static const char *const PsoNames[4] = { "clipdist_vs", "clipdist_vs_hs_ds", "generic_vs", "generic_vs_hs_ds" };
+        PipelineBatch batch;
+        PipelineBatchInit(&batch, "clipdistance_io");
+        for (int i = 0; i < 4; ++i) {
+            PipelineBatchAdd(&batch, PsoNames[i], BuildGraphicsPipelineJob, &psoArgs[i]);
+        }
+        PipelineBatchBuild(&batch);
 
+        if (PipelineLibraryEnabled()) {
+            /*
+             * Only the pre-rasterization part differs between all four, the fragment shader and
+             * output parts are shared and vertex input only depends on whether there is tessellation:
+             */
+            enum { ViTriangles, ViPatches, PreRaster0, Fragment = PreRaster0 + 4, Output, NumParts };
+            VkPipeline parts[NumParts];
+            GraphicsPipelineArgs partArgs[NumParts];
+            partArgs[ViTriangles] = psoArgs[0];
+            partArgs[ViTriangles].libraryParts = PipelineLibraryVertexInput;
+            partArgs[ViPatches] = psoArgs[1];
+            partArgs[ViPatches].libraryParts = PipelineLibraryVertexInput;
+            for (int i = 0; i < 4; ++i) {
+                partArgs[PreRaster0 + i] = psoArgs[i];
+                partArgs[PreRaster0 + i].libraryParts = PipelineLibraryPreRaster;
+            }
+            partArgs[Fragment] = psoArgs[0];
+            partArgs[Fragment].libraryParts = PipelineLibraryFragmentShader;
+            partArgs[Output] = psoArgs[0];
+            partArgs[Output].libraryParts = PipelineLibraryFragmentOutput;
+            static const char *const PartNames[NumParts] = {
+                "vi_triangles", "vi_patches",
+                "pre_raster_clipdist_vs", "pre_raster_clipdist_vs_hs_ds", "pre_raster_generic_vs", "pre_raster_generic_vs_hs_ds",
+                "fragment", "output"
+            };
+            PipelineBatch partBatch;
+            PipelineBatchInit(&partBatch, "clipdistance_io libraries");
+            for (int i = 0; i < NumParts; ++i) {
+                partArgs[i].pPipeline = &parts[i];
+                PipelineBatchAdd(&partBatch, PartNames[i], BuildGraphicsPipelineJob, &partArgs[i]);
+            }
+            PipelineBatchBuild(&partBatch);
+
+            VkPipeline linkParts[4][4];
+            for (int i = 0; i < 4; ++i) {
+                linkParts[i][0] = parts[(i & 1) ? ViPatches : ViTriangles];
+                linkParts[i][1] = parts[PreRaster0 + i];
+                linkParts[i][2] = parts[Fragment];
+                linkParts[i][3] = parts[Output];
+            }
+            VkPipeline linked[2][4]; // [bOptimize]
+            PipelineLibraryLinkArgs linkArgs[2][4];
+            PipelineBatch linkBatches[2]; // [bOptimize]
+            for (int bOptimize = 0; bOptimize < 2; ++bOptimize) {
+                PipelineBatchInit(&linkBatches[bOptimize], bOptimize ? "clipdistance_io optimized links" : "clipdistance_io links");
+                for (int i = 0; i < 4; ++i) {
+                    linkArgs[bOptimize][i] = { linkParts[i], 4, pipelineLayout, bOptimize != 0, &linked[bOptimize][i] };
+                    PipelineBatchAdd(&linkBatches[bOptimize], PsoNames[i], PipelineLibraryLinkJob, &linkArgs[bOptimize][i]);
+                }
+                PipelineBatchBuild(&linkBatches[bOptimize]);
+            }
+            PipelineLibraryReport("clipdistance_io", batch, partBatch, linkBatches[0], linkBatches[1]);
 
-        vkDestroyShaderModule(device, vs_clipdist, ALLOC_CBS);
-        vkDestroyShaderModule(device, hs_clipdist, ALLOC_CBS);
+            // Draw with the optimized links, the rest was only built to be timed:
+            for (int i = 0; i < 4; ++i) {
+                vkDestroyPipeline(device, pipelines[i], ALLOC_CBS);
+                vkDestroyPipeline(device, linked[0][i], ALLOC_CBS);
+                pipelines[i] = linked[1][i];
+            }
+            for (VkPipeline part : parts) vkDestroyPipeline(device, part, ALLOC_CBS);
+        }
 
-        vkDestroyShaderModule(device, vs_generic, ALLOC_CBS);
-        vkDestroyShaderModule(device, hs_generic, ALLOC_CBS);
+        ShaderCacheRelease(vs_clipdist);
+        ShaderCacheRelease(hs_clipdist);
 
-        vkDestroyShaderModule(device, ps, ALLOC_CBS);
-        vkDestroyShaderModule(device, ds, ALLOC_CBS);
+        ShaderCacheRelease(vs_generic);
+        ShaderCacheRelease(hs_generic);
+
+        ShaderCacheRelease(ps);
+        ShaderCacheRelease(ds);
     }
 
     const VkRect2D RenderArea = {
@@ -354,9 +573,12 @@ bool TestClipDistanceIo(VkDevice device, VkQueue queue, uint32_t graphicsFamilyI
         vkCmdResetQueryPool(cmdbuf, pipelineStatsQueryPool, 0, 2); // first, count
     }
 
+    bool const bUseDebugUtils = (vkCmdBeginDebugUtilsLabelEXT != nullptr);
     for (int i = 0; i < 2; ++i) {
-        vkuCmdLabel(vkCmdBeginDebugUtilsLabelEXT, cmdbuf,
-                    i == 0 ? "vs->hs via ClipDistance" : "vs->hs via generic", 0xff000000u | 0xffu << (i*8));
+        if (bUseDebugUtils) {
+            vkuCmdLabel(vkCmdBeginDebugUtilsLabelEXT, cmdbuf,
+                        i == 0 ? "vs->hs via ClipDistance" : "vs->hs via generic", 0xff000000u | 0xffu << (i*8));
+        }
         VkImageMemoryBarrier imageBarrier = {
             VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr,
             0, // srcAccessMask
@@ -391,10 +613,12 @@ bool TestClipDistanceIo(VkDevice device, VkQueue queue, uint32_t graphicsFamilyI
                 VkClearRect clearRect = { RenderArea, 0, 1 }; // layer range
                 vkCmdClearAttachments(cmdbuf, 1, &attClear, 1, &clearRect);
 
-                vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[i*2 + 0]);
-                vkCmdDraw(cmdbuf, 4*2*3, 1,     0, 0);
-                vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[i*2 + 1]);
-                vkCmdDraw(cmdbuf, 4*2*3, 1, 4*2*3, 0);
+                uint32_t firstVertex = 0;
+                for (int d = 0; d < 2; ++d) {
+                    vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[i*2 + d]);
+                    vkCmdDraw(cmdbuf, ClipIoDraws[d].vertexCount, 1, firstVertex, 0);
+                    firstVertex += ClipIoDraws[d].vertexCount;
+                }
             }
             vkCmdEndRenderPass(cmdbuf);
         }
@@ -413,7 +637,9 @@ bool TestClipDistanceIo(VkDevice device, VkQueue queue, uint32_t graphicsFamilyI
         bufImgCopy.bufferRowLength = ImageSize.width;
         bufImgCopy.bufferImageHeight = ImageSize.height;
         vkCmdCopyImageToBuffer(cmdbuf, resources[i].image, VK_IMAGE_LAYOUT_GENERAL, stage.buffer, 1, &bufImgCopy);
-        vkCmdEndDebugUtilsLabelEXT(cmdbuf);
+        if (bUseDebugUtils) {
+            vkCmdEndDebugUtilsLabelEXT(cmdbuf);
+        }
     }
 
     // end cmdbuf:
@@ -429,6 +655,7 @@ bool TestClipDistanceIo(VkDevice device, VkQueue queue, uint32_t graphicsFamilyI
 
     // submit:
     void *pMap = nullptr;
+    D3D11_QUERY_DATA_PIPELINE_STATISTICS queryData[2] = { };
     {
         const VkDeviceSize offset = 0, size = StageByteCapacity;
         VERIFY_VK(vkMapMemory(device, stage.memory, offset, size, 0, &pMap));
@@ -442,33 +669,93 @@ bool TestClipDistanceIo(VkDevice device, VkQueue queue, uint32_t graphicsFamilyI
         VERIFY_VK(vkQueueWaitIdle(queue));
         vkInvalidateMappedMemoryRanges(device, 1, &range);
 
-        D3D11_QUERY_DATA_PIPELINE_STATISTICS queryData[2] = { };
         vkGetQueryPoolResults(device, pipelineStatsQueryPool, 0, 2, // first, count
                               sizeof queryData, queryData, sizeof(queryData[0]),
                               VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    }
+
+    uint32_t numErrors = 0, numPerfBugs = 0;
+    {
+        static const char *const QueryNames[2] = { "via ClipDistance", "via generic" };
+        // The clear color above as RGBA8:
+        const uint32_t ClearColor = 0xff2080ffu;
+        PipelineStatsModel models[2];
+        uint64_t coveredPixels[2];
+        for (int i = 0; i < 2; ++i) {
+            coveredPixels[i] = CountCoverage((const uint32_t *)((const unsigned char *)pMap + i*PackedImageByteSize),
+                                             ImageSize.width, ImageSize.height, ClearColor);
+            ModelPipelineStats(ClipIoDraws, lengthof(ClipIoDraws), limits.maxTessellationGenerationLevel,
+                               coveredPixels[i], &models[i]);
+        }
+
+        printf("  %-14s %20s %20s   %s\n", "", QueryNames[0], QueryNames[1], "expected");
+        for (const PipelineStatCounter& c : PipelineStatCounters) {
+            char expected[2][48];
+            for (int i = 0; i < 2; ++i) {
+                uint64_t const lo = models[i].min.*c.pCounter, hi = models[i].max.*c.pCounter;
+                if (lo == hi) {
+                    snprintf(expected[i], sizeof expected[i], "%llu", (unsigned long long)lo);
+                } else if (hi == UINT64_MAX) {
+                    snprintf(expected[i], sizeof expected[i], ">= %llu", (unsigned long long)lo);
+                } else {
+                    snprintf(expected[i], sizeof expected[i], "%llu..%llu", (unsigned long long)lo, (unsigned long long)hi);
+                }
+            }
+            printf("  %-14s %20llu %20llu   %s", c.name,
+                   (unsigned long long)(queryData[0].*c.pCounter), (unsigned long long)(queryData[1].*c.pCounter), expected[0]);
+            if (strcmp(expected[0], expected[1]) != 0) printf(", %s", expected[1]);
+            putchar('\n');
+        }
+
         for (int i = 0; i < 2; ++i) {
-            const D3D11_QUERY_DATA_PIPELINE_STATISTICS& r = queryData[i];
-            printf("Relevant QueryResult[%d] = {\n", i);
-            printf("   IAVertices    = %llu\n", r.IAVertices);
-            printf("   IAPrimitives  = %llu\n", r.IAPrimitives);
-            printf("   VSInvocations = %llu\n", r.VSInvocations);
-            printf("   CInvocations  = %llu\n", r.CInvocations);
-            printf("   CPrimitives   = %llu\n", r.CPrimitives);
-            printf("   PSInvocations = %llu\n", r.PSInvocations);
-            printf("   HSInvocations = %llu\n", r.HSInvocations);
-            printf("   DSInvocations = %llu\n", r.DSInvocations);
-            puts("}");
+            CheckPipelineStats(QueryNames[i], queryData[i], models[i], &numErrors, &numPerfBugs);
+        }
+        for (const PipelineStatCounter& c : PipelineStatCounters) {
+            uint64_t const v0 = queryData[0].*c.pCounter, v1 = queryData[1].*c.pCounter;
+            // Exact counters were already checked against the model:
+            if (c.passes == StatAfterClipping || c.bMaxIsSpec || v0 == v1) continue;
+            if (c.passes == StatSameInBothPasses) {
+                printf("PERFORMANCE BUG: %s = %llu %s but %llu %s, the draws are the same before clipping.\n", c.name,
+                       (unsigned long long)v0, QueryNames[0], (unsigned long long)v1, QueryNames[1]);
+                ++numPerfBugs;
+            } else {
+                printf("NOTE: %s = %llu %s but %llu %s, %+lld.\n", c.name,
+                       (unsigned long long)v0, QueryNames[0], (unsigned long long)v1, QueryNames[1], (long long)(v1 - v0));
+            }
+        }
+        // The VS draw only clips in the first pass, so it covers less, and the fragments it clipped shouldn't be shaded:
+        if (coveredPixels[0] >= coveredPixels[1]) {
+            printf("ERROR: %s covers %llu pixels, not fewer than the %llu %s, so nothing was clipped.\n",
+                   QueryNames[0], (unsigned long long)coveredPixels[0], (unsigned long long)coveredPixels[1], QueryNames[1]);
+            ++numErrors;
+        } else if (queryData[0].PSInvocations >= queryData[1].PSInvocations) {
+            printf("PERFORMANCE BUG: PSInvocations = %llu %s, not fewer than the %llu %s, so clipped fragments were shaded.\n",
+                   (unsigned long long)queryData[0].PSInvocations, QueryNames[0],
+                   (unsigned long long)queryData[1].PSInvocations, QueryNames[1]);
+            ++numPerfBugs;
+        }
+        if (numErrors || numPerfBugs) {
+            printf("%u errors, %u performance bugs in the pipeline statistics.\n", numErrors, numPerfBugs);
         }
     }
 
-    bool bTestPassed = false;
-    {
-        stbi_write_png("pass_via_clipdist.png", ImageSize.width, ImageSize.height, 4,
-                       (const unsigned char *)pMap + 0*PackedImageByteSize, ImageSize.width*sizeof(uint32_t));
+    bool bTestPassed = numErrors == 0 && numPerfBugs == 0;
+    if (ResultArchiveIsOpen()) {
+        static const char *const PassNames[2] = { "pass_via_clipdist", "pass_via_generic" };
+        for (unsigned k = 0; k < 2; ++k) {
+            const ResultArchiveAddDesc archiveDesc = {
+                "clipdistance_tessellation", PassNames[k], Format, ImageSize.width, ImageSize.height, 1,
+                sizeof(uint32_t), (const unsigned char *)pMap + k*PackedImageByteSize, ImageSize.width*sizeof(uint32_t), false
+            };
+            ResultArchiveAdd(archiveDesc);
+        }
+    } else {
+        ArtifactWritePng("pass_via_clipdist.png", ImageSize.width, ImageSize.height, 4,
+                         (const unsigned char *)pMap + 0*PackedImageByteSize, ImageSize.width*sizeof(uint32_t));
 
 
-        stbi_write_png("pass_via_generic.png", ImageSize.width, ImageSize.height, 4,
-                       (const unsigned char *)pMap + 1*PackedImageByteSize, ImageSize.width*sizeof(uint32_t));
+        ArtifactWritePng("pass_via_generic.png", ImageSize.width, ImageSize.height, 4,
+                         (const unsigned char *)pMap + 1*PackedImageByteSize, ImageSize.width*sizeof(uint32_t));
     }
 
     vkDestroyQueryPool(device, pipelineStatsQueryPool, ALLOC_CBS);
@@ -488,3 +775,396 @@ bool TestClipDistanceIo(VkDevice device, VkQueue queue, uint32_t graphicsFamilyI
 // Welp, the bug from dx11-d2d-tessellation-tir doesnt repro like this.
 // Also note that the DS uvw colorIds are different than NV.
 // Might be missing Flat interp modifier or something about tess provoking vertex.
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// tess_clip_bench
+
+/*
+ * spirv-as --target-env vulkan1.1 on tess_clip_{vs,hs,ds,ps}.spvasm, which say what each stage does.
+ * The VS, HS and DS size their ClipDistance arrays and loop to the same %uint_clip constant, so a
+ * variant with another clip distance count only changes that constant's value.
+ */
+static const uint32_t TessClipVsSpirv[] =
+{
+0x7230203,0x10300,0x70000,0x46,0,0x20011,1,0x20011,32,0x6000B,1,0x4C534C47,0x6474732E,0x3035342E,0,0x3000E,0,1,
+0x8000F,0,2,0x6E69616D,0,3,4,5,0x40047,3,11,42,0x40047,4,11,0,0x40047,5,11,3,0x20013,6,0x30021,7,6,0x20014,8,
+0x40015,9,32,1,0x40015,10,32,0,0x30016,11,32,0x40017,12,11,4,0x4002B,10,13,8,0x4002B,10,14,0,0x4002B,10,15,1,
+0x4002B,10,16,2,0x4002B,10,17,3,0x4002B,10,18,6,0x4002B,10,19,16,0x4002B,11,20,0,0x4002B,11,21,0x3F800000,0x4002B,
+11,22,0x3E000000,0x4002B,11,23,0x3F490FDB,0x4002B,11,24,0x3F400000,0x4001C,25,11,13,0x40020,26,1,9,0x40020,27,3,12,
+0x40020,28,3,25,0x40020,29,3,11,0x40020,30,7,10,0x4003B,26,3,1,0x4003B,27,4,3,0x4003B,28,5,3,0x50036,6,2,0,7,
+0x200F8,31,0x4003B,30,32,7,0x4003D,9,33,3,0x4007C,10,34,33,0x50086,10,35,34,18,0x50089,10,36,34,18,0x500AE,8,37,36,
+17,0x50082,10,38,36,16,0x600A9,10,39,37,38,36,0x500C7,10,40,39,15,0x500C2,10,41,39,15,0x50089,10,42,35,19,0x50086,
+10,43,35,19,0x50080,10,44,42,40,0x50080,10,45,43,41,0x40070,11,46,44,0x40070,11,47,45,0x50085,11,48,46,22,0x50085,
+11,49,47,22,0x50083,11,50,48,21,0x50083,11,51,49,21,0x70050,12,52,50,51,20,21,0x3003E,4,52,0x3003E,32,14,0x200F9,53,
+0x200F8,53,0x400F6,54,55,0,0x200F9,56,0x200F8,56,0x4003D,10,57,32,0x500B0,8,58,57,13,0x400FA,58,59,54,0x200F8,59,
+0x40070,11,60,57,0x50085,11,61,60,23,0x6000C,11,62,1,14,61,0x6000C,11,63,1,13,61,0x50085,11,0x40,50,62,0x50085,11,
+0x41,51,63,0x50081,11,0x42,0x40,0x41,0x50083,11,0x43,24,0x42,0x50041,29,0x44,5,57,0x3003E,0x44,0x43,0x200F9,55,
+0x200F8,55,0x50080,10,0x45,57,15,0x3003E,32,0x45,0x200F9,53,0x200F8,54,0x100FD,0x10038
+};
+
+static const uint32_t TessClipHsSpirv[] =
+{
+0x7230203,0x10300,0x70000,56,0,0x20011,1,0x20011,3,0x20011,32,0x3000E,0,1,0xC000F,1,1,0x6E69616D,0,2,3,4,5,6,7,8,
+0x40010,1,26,3,0x40047,2,11,8,0x40047,3,11,0,0x40047,4,11,3,0x40047,5,11,0,0x40047,6,11,3,0x40047,7,11,11,0x30047,7,
+15,0x40047,8,11,12,0x30047,8,15,0x30047,9,2,0x50048,9,0,35,0,0x20013,10,0x30021,11,10,0x40015,12,32,1,0x40015,13,32,
+0,0x30016,14,32,0x40017,15,14,4,0x4002B,13,16,8,0x4002B,13,17,0,0x4002B,13,18,1,0x4002B,13,19,2,0x4002B,13,20,3,
+0x4002B,13,21,4,0x4001C,22,14,16,0x4001C,23,22,20,0x4001C,24,15,20,0x4001C,25,14,21,0x4001C,26,14,19,0x3001E,9,14,
+0x40020,27,1,12,0x40020,28,1,24,0x40020,29,1,23,0x40020,30,3,24,0x40020,31,3,23,0x40020,32,3,25,0x40020,33,3,26,
+0x40020,34,9,9,0x40020,35,9,14,0x40020,36,1,15,0x40020,37,3,15,0x40020,38,1,22,0x40020,39,3,22,0x40020,40,3,14,
+0x4003B,27,2,1,0x4003B,28,3,1,0x4003B,29,4,1,0x4003B,30,5,3,0x4003B,31,6,3,0x4003B,32,7,3,0x4003B,33,8,3,0x4003B,34,
+41,9,0x50036,10,1,0,11,0x200F8,42,0x4003D,12,43,2,0x50041,36,44,3,43,0x4003D,15,45,44,0x50041,37,46,5,43,0x3003E,46,
+45,0x50041,38,47,4,43,0x4003D,22,48,47,0x50041,39,49,6,43,0x3003E,49,48,0x50041,35,50,41,17,0x4003D,14,51,50,
+0x50041,40,52,7,17,0x3003E,52,51,0x50041,40,53,7,18,0x3003E,53,51,0x50041,40,54,7,19,0x3003E,54,51,0x50041,40,55,8,
+17,0x3003E,55,51,0x100FD,0x10038
+};
+
+static const uint32_t TessClipDsSpirv[] =
+{
+0x7230203,0x10300,0x70000,0x44,0,0x20011,1,0x20011,3,0x20011,32,0x3000E,0,1,0xA000F,2,1,0x6E69616D,0,2,3,4,5,6,
+0x30010,1,22,0x30010,1,1,0x30010,1,4,0x40047,2,11,13,0x40047,3,11,0,0x40047,4,11,3,0x40047,5,11,0,0x40047,6,11,3,
+0x20013,7,0x30021,8,7,0x20014,9,0x40015,10,32,0,0x30016,11,32,0x40017,12,11,3,0x40017,13,11,4,0x4002B,10,14,8,
+0x4002B,10,15,0,0x4002B,10,16,1,0x4002B,10,17,2,0x4002B,10,18,3,0x4001C,19,11,14,0x4001C,20,19,18,0x4001C,21,13,18,
+0x40020,22,1,12,0x40020,23,1,21,0x40020,24,1,20,0x40020,25,3,13,0x40020,26,3,19,0x40020,27,1,13,0x40020,28,1,11,
+0x40020,29,3,11,0x40020,30,7,10,0x4003B,22,2,1,0x4003B,23,3,1,0x4003B,24,4,1,0x4003B,25,5,3,0x4003B,26,6,3,0x50036,
+7,1,0,8,0x200F8,31,0x4003B,30,32,7,0x4003D,12,33,2,0x50051,11,34,33,0,0x50051,11,35,33,1,0x50051,11,36,33,2,0x50041,
+27,37,3,15,0x4003D,13,38,37,0x50041,27,39,3,16,0x4003D,13,40,39,0x50041,27,41,3,17,0x4003D,13,42,41,0x5008E,13,43,
+38,34,0x5008E,13,44,40,35,0x5008E,13,45,42,36,0x50081,13,46,43,44,0x50081,13,47,46,45,0x3003E,5,47,0x3003E,32,15,
+0x200F9,48,0x200F8,48,0x400F6,49,50,0,0x200F9,51,0x200F8,51,0x4003D,10,52,32,0x500B0,9,53,52,14,0x400FA,53,54,49,
+0x200F8,54,0x60041,28,55,4,15,52,0x4003D,11,56,55,0x60041,28,57,4,16,52,0x4003D,11,58,57,0x60041,28,59,4,17,52,
+0x4003D,11,60,59,0x50085,11,61,56,34,0x50085,11,62,58,35,0x50085,11,63,60,36,0x50081,11,0x40,61,62,0x50081,11,0x41,
+0x40,63,0x50041,29,0x42,6,52,0x3003E,0x42,0x41,0x200F9,50,0x200F8,50,0x50080,10,0x43,52,16,0x3003E,32,0x43,0x200F9,
+48,0x200F8,49,0x100FD,0x10038
+};
+
+static const uint32_t TessClipPsSpirv[] =
+{
+0x7230203,0x10300,0x70000,13,0,0x20011,1,0x3000E,0,1,0x6000F,4,1,0x6E69616D,0,2,0x30010,1,7,0x40047,2,30,0,0x20013,
+3,0x30021,4,3,0x30016,5,32,0x40017,6,5,4,0x40020,7,3,6,0x4002B,5,8,0x3F800000,0x4002B,5,9,0x3F000000,0x4002B,5,10,
+0x3E800000,0x7002C,6,11,10,9,8,8,0x4003B,7,2,3,0x50036,3,1,0,4,0x200F8,12,0x3003E,2,11,0x100FD,0x10038
+};
+
+// Sets the length of the ClipDistance arrays, which the shader also loops to, through the OpConstant it comes from.
+static bool
+SetClipDistanceCount(SpirvModule *m, uint32_t numClipDistances)
+{
+    uint32_t const decoration = SpirvFindBuiltInDecoration(*m, SpirvBuiltInClipDistance);
+    uint32_t const var = decoration ? SpirvFindResult(*m, m->pWords[decoration + 1]) : 0;
+    if (!var || SpirvOpcode(*m, var) != SpirvOpVariable) return false;
+    uint32_t const ptr = SpirvFindResult(*m, m->pWords[var + 1]);
+    if (!ptr || SpirvOpcode(*m, ptr) != SpirvOpTypePointer) return false;
+    uint32_t array = SpirvFindResult(*m, m->pWords[ptr + 3]);
+    if (!array || SpirvOpcode(*m, array) != SpirvOpTypeArray) return false;
+    // Per-vertex inputs and outputs of the tessellation stages are an array of control points of it:
+    uint32_t const element = SpirvFindResult(*m, m->pWords[array + 2]);
+    if (element && SpirvOpcode(*m, element) == SpirvOpTypeArray) array = element;
+    uint32_t const length = SpirvFindResult(*m, m->pWords[array + 3]);
+    if (!length || SpirvOpcode(*m, length) != SpirvOpConstant) return false;
+    m->pWords[length + 3] = numClipDistances;
+    return true;
+}
+
+// Passes the clip distances as plain varyings at location 1 instead, so nothing is clipped.
+static void
+MakeClipDistanceGeneric(SpirvModule *m)
+{
+    for (uint32_t at = SpirvFindBuiltInDecoration(*m, SpirvBuiltInClipDistance); at; at = SpirvFindBuiltInDecoration(*m, SpirvBuiltInClipDistance)) {
+        m->pWords[at + 2] = SpirvDecorationLocation;
+        m->pWords[at + 3] = 1;
+    }
+}
+
+/*
+ * Draws a grid of triangle patches through VS, HS and DS with every tessellation level at each power
+ * of two from 1 to maxTessellationGenerationLevel (and the limit itself), writing 1, 2, 4 or 8 clip
+ * distances in the VS that the HS passes through and the DS interpolates, or 8 floats through the
+ * same stages as generic varyings for a baseline that never clips. For every point it prints the
+ * HS and DS invocations, the primitives in and out of clipping and the GPU time of the draw, which
+ * is serialized with the others. The clip distances cut the corners off the grid, so clipping
+ * has work at every factor.
+ */
+bool TestTessClipBench(const VulkanObjetcs& vk)
+{
+    VkDevice const device = vk.device;
+    VkQueue const queue = vk.universalQueue;
+    const VkPhysicalDeviceLimits& limits = vk.props2.properties.limits;
+    const VkPhysicalDeviceFeatures& features = vk.features2.features;
+    if (!features.tessellationShader || !features.shaderClipDistance || !features.pipelineStatisticsQuery) {
+        puts("ERROR: tessellationShader, shaderClipDistance and pipelineStatisticsQuery are all needed.");
+        return false;
+    }
+    if (!limits.timestampComputeAndGraphics) {
+        puts("ERROR: timestamps are not supported.");
+        return false;
+    }
+    double const nsPerTick = limits.timestampPeriod;
+
+    enum { MaxClipConfigs = 5, MaxFactors = 16, NumPatches = 16 * 16 * 2 }; // the VS's grid
+    const VkExtent2D ImageSize = { 256, 256 };
+    const VkFormat Format = VK_FORMAT_R8G8B8A8_UNORM;
+
+    // Clip distance counts, 0 for the generic baseline:
+    static const uint32_t ClipCounts[MaxClipConfigs] = { 0, 1, 2, 4, 8 };
+    uint32_t clipCounts[MaxClipConfigs];
+    uint32_t numClipConfigs = 0;
+    for (uint32_t n : ClipCounts) {
+        if (n <= limits.maxClipDistances) clipCounts[numClipConfigs++] = n;
+    }
+    uint32_t factors[MaxFactors];
+    uint32_t numFactors = 0;
+    for (uint32_t f = 1; f <= limits.maxTessellationGenerationLevel && numFactors < MaxFactors; f *= 2) {
+        factors[numFactors++] = f;
+    }
+    if (factors[numFactors - 1] != limits.maxTessellationGenerationLevel && numFactors < MaxFactors) {
+        factors[numFactors++] = limits.maxTessellationGenerationLevel;
+    }
+    uint32_t const numPoints = numClipConfigs * numFactors;
+
+    VkQueryPool statsPool = VK_NULL_HANDLE, timestampPool = VK_NULL_HANDLE;
+    {
+        VkQueryPoolCreateInfo info = {
+            VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            nullptr,
+            0x0, // flags
+            VK_QUERY_TYPE_PIPELINE_STATISTICS,
+            numPoints,
+            D3D11PipelineStatistics
+        };
+        VERIFY_VK(vkCreateQueryPool(device, &info, ALLOC_CBS, &statsPool));
+        info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        info.queryCount = numPoints * 2;
+        info.pipelineStatistics = 0;
+        VERIFY_VK(vkCreateQueryPool(device, &info, ALLOC_CBS, &timestampPool));
+    }
+
+    VkCommandPool cmdpool = VK_NULL_HANDLE;
+    VkCommandBuffer cmdbuf = VK_NULL_HANDLE;
+    {
+        const VkCommandPoolCreateInfo cmdPoolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr,
+            0, // flags
+            vk.universalFamilyIndex
+        };
+        VERIFY_VK(vkCreateCommandPool(device, &cmdPoolInfo, ALLOC_CBS, &cmdpool));
+
+        const VkCommandBufferAllocateInfo cmdBufAllocInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr, cmdpool,
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            1 // commandBufferCount
+        };
+        VERIFY_VK(vkAllocateCommandBuffers(device, &cmdBufAllocInfo, &cmdbuf));
+    }
+
+    VkuImageAndMemory resource;
+    {
+        VkImageCreateInfo imageInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = Format;
+        imageInfo.extent = { ImageSize.width, ImageSize.height, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        VERIFY_VK(vkuDedicatedImage(device, imageInfo, &resource, vk.memProps, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+    }
+
+    VkRenderPass renderpass;
+    {
+        VkAttachmentDescription attDesc = { };
+        attDesc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attDesc.format = Format;
+        attDesc.samples = VK_SAMPLE_COUNT_1_BIT;
+        attDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attDesc.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        VkAttachmentReference attRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        VkSubpassDescription subpassDesc = { };
+        subpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpassDesc.colorAttachmentCount = 1;
+        subpassDesc.pColorAttachments = &attRef;
+        VkRenderPassCreateInfo renderpassInfo = {
+            VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO, nullptr, 0,
+            1, &attDesc, 1, &subpassDesc,
+        };
+        VERIFY_VK(vkCreateRenderPass(device, &renderpassInfo, ALLOC_CBS, &renderpass));
+    }
+
+    VkImageView view;
+    {
+        VkImageViewCreateInfo viewCreateInfo = {
+            VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            nullptr,
+            0, // VkImageViewCreateFlags
+            resource.image,
+            VK_IMAGE_VIEW_TYPE_2D,
+            Format,
+            VkComponentMapping(), // identity
+            { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 } // single mip, single layer
+        };
+        VERIFY_VK(vkCreateImageView(device, &viewCreateInfo, ALLOC_CBS, &view));
+    }
+
+    VkFramebuffer framebuffer;
+    {
+        VkFramebufferCreateInfo framebufferInfo = {
+            VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO, nullptr, 0,
+            renderpass,
+            1, &view,
+            ImageSize.width, ImageSize.height, 1
+        };
+        VERIFY_VK(vkCreateFramebuffer(device, &framebufferInfo, ALLOC_CBS, &framebuffer));
+    }
+
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    {
+        // The tessellation level, as a float:
+        const VkPushConstantRange pcRange = { VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT, 0, sizeof(float) };
+        VkPipelineLayoutCreateInfo info = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        info.pushConstantRangeCount = 1;
+        info.pPushConstantRanges = &pcRange;
+        VERIFY_VK(vkCreatePipelineLayout(device, &info, ALLOC_CBS, &pipelineLayout));
+    }
+
+    VkPipeline pipelines[MaxClipConfigs] = { };
+    char configNames[MaxClipConfigs][16];
+    {
+        static const uint32_t *const SrcCode[3] = { TessClipVsSpirv, TessClipHsSpirv, TessClipDsSpirv };
+        static const size_t SrcBytes[3] = { sizeof TessClipVsSpirv, sizeof TessClipHsSpirv, sizeof TessClipDsSpirv };
+        VkShaderModule modules[MaxClipConfigs][3]; // vs, hs, ds
+        VkShaderModule ps;
+        VERIFY_VK(ShaderCacheAcquire(TessClipPsSpirv, &ps));
+        GraphicsPipelineArgs psoArgs[MaxClipConfigs];
+        PipelineBatch batch;
+        PipelineBatchInit(&batch, "tess_clip_bench");
+        for (uint32_t c = 0; c < numClipConfigs; ++c) {
+            for (int stage = 0; stage < 3; ++stage) {
+                uint32_t tmp[lengthof(TessClipDsSpirv)]; // the biggest
+                SpirvModule m;
+                bool bOk = SpirvInit(&m, tmp, lengthof(tmp), SrcCode[stage], SrcBytes[stage]);
+                if (bOk && clipCounts[c] == 0) {
+                    MakeClipDistanceGeneric(&m);
+                } else if (bOk) {
+                    bOk = SetClipDistanceCount(&m, clipCounts[c]);
+                }
+                if (!bOk) {
+                    puts("ERROR: couldn't patch the clip distance count of the tess_clip shaders.");
+                    abort();
+                }
+                VERIFY_VK(ShaderCacheAcquire(tmp, SpirvByteSize(m), &modules[c][stage]));
+            }
+            if (clipCounts[c] == 0) {
+                snprintf(configNames[c], sizeof configNames[c], "generic");
+            } else {
+                snprintf(configNames[c], sizeof configNames[c], "clip=%u", clipCounts[c]);
+            }
+            psoArgs[c] = { device, modules[c][0], modules[c][1], modules[c][2], ps, renderpass, pipelineLayout, &pipelines[c] };
+            PipelineBatchAdd(&batch, configNames[c], BuildGraphicsPipelineJob, &psoArgs[c]);
+        }
+        PipelineBatchBuild(&batch);
+        for (uint32_t c = 0; c < numClipConfigs; ++c) {
+            for (VkShaderModule module : modules[c]) ShaderCacheRelease(module);
+        }
+        ShaderCacheRelease(ps);
+    }
+
+    {
+        const VkCommandBufferBeginInfo cmdBufbeginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr
+        };
+        VERIFY_VK(vkBeginCommandBuffer(cmdbuf, &cmdBufbeginInfo));
+        vkCmdResetQueryPool(cmdbuf, statsPool, 0, numPoints);
+        vkCmdResetQueryPool(cmdbuf, timestampPool, 0, numPoints * 2);
+
+        const VkRect2D RenderArea = {
+            { 0, 0 }, ImageSize
+        };
+        VkViewport vp;
+        vkuUpwardsViewportFromRect(RenderArea, 0, 1, &vp);
+        VkClearValue clearValue = { };
+        const VkRenderPassBeginInfo rpBeginInfo = {
+            VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO, nullptr,
+            renderpass, framebuffer, RenderArea,
+            1, &clearValue
+        };
+        // Serialize the draws so each sample is its own execution time, not how well it overlaps the previous one.
+        // Only waiting on color output would still let the next draw's VS/HS/DS work start early, so wait on everything:
+        VkMemoryBarrier memBarrier = {
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT
+        };
+        for (uint32_t c = 0; c < numClipConfigs; ++c) {
+            for (uint32_t f = 0; f < numFactors; ++f) {
+                uint32_t const q = c * numFactors + f;
+                float const level = float(factors[f]);
+                if (q != 0) {
+                    vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0x0,
+                                         1, &memBarrier, 0, nullptr, 0 , nullptr);
+                }
+                vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, q * 2);
+                vkCmdBeginQuery(cmdbuf, statsPool, q, 0x0);
+                vkCmdBeginRenderPass(cmdbuf, &rpBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+                vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[c]);
+                vkCmdSetViewport(cmdbuf, 0, 1, &vp);
+                vkCmdSetScissor(cmdbuf, 0, 1, &RenderArea);
+                vkCmdPushConstants(cmdbuf, pipelineLayout, VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT, 0, sizeof level, &level);
+                vkCmdDraw(cmdbuf, NumPatches * 3, 1, 0, 0);
+                vkCmdEndRenderPass(cmdbuf);
+                vkCmdEndQuery(cmdbuf, statsPool, q);
+                vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, q * 2 + 1);
+            }
+        }
+        VERIFY_VK(vkEndCommandBuffer(cmdbuf));
+    }
+
+    {
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmdbuf;
+        VERIFY_VK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+        VERIFY_VK(vkQueueWaitIdle(queue));
+    }
+
+    D3D11_QUERY_DATA_PIPELINE_STATISTICS stats[MaxClipConfigs * MaxFactors];
+    uint64_t ticks[MaxClipConfigs * MaxFactors * 2];
+    VERIFY_VK(vkGetQueryPoolResults(device, statsPool, 0, numPoints, sizeof stats, stats, sizeof stats[0],
+                                    VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+    VERIFY_VK(vkGetQueryPoolResults(device, timestampPool, 0, numPoints * 2, sizeof ticks, ticks, sizeof(uint64_t),
+                                    VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    printf("%u triangle patches per draw into %ux%u, maxTessellationGenerationLevel = %u:\n",
+           NumPatches, ImageSize.width, ImageSize.height, limits.maxTessellationGenerationLevel);
+    printf("  %-8s %6s %8s %10s %9s %9s %10s %10s %10s\n",
+           "clip", "factor", "HS", "DS", "DS/patch", "min", "C invocs", "C prims", "GPU us");
+    bool bCountsOk = true;
+    for (uint32_t c = 0; c < numClipConfigs; ++c) {
+        for (uint32_t f = 0; f < numFactors; ++f) {
+            uint32_t const q = c * numFactors + f;
+            const D3D11_QUERY_DATA_PIPELINE_STATISTICS& r = stats[q];
+            uint32_t const minPoints = TriangleDomainPoints(factors[f]);
+            printf("  %-8s %6u %8llu %10llu %9.1f %9u %10llu %10llu %10.1f\n", configNames[c], factors[f],
+                   (unsigned long long)r.HSInvocations, (unsigned long long)r.DSInvocations,
+                   double(r.DSInvocations) / NumPatches, minPoints,
+                   (unsigned long long)r.CInvocations, (unsigned long long)r.CPrimitives,
+                   double(ticks[q * 2 + 1] - ticks[q * 2]) * nsPerTick * 1e-3);
+            bCountsOk &= r.HSInvocations == NumPatches && r.DSInvocations >= uint64_t(minPoints) * NumPatches;
+        }
+    }
+    if (!bCountsOk) {
+        puts("ERROR: some HS counts aren't one per patch or DS counts are below the domain points.");
+    }
+
+    vkDestroyQueryPool(device, statsPool, ALLOC_CBS);
+    vkDestroyQueryPool(device, timestampPool, ALLOC_CBS);
+    for (uint32_t c = 0; c < numClipConfigs; ++c) vkDestroyPipeline(device, pipelines[c], ALLOC_CBS);
+    vkDestroyPipelineLayout(device, pipelineLayout, ALLOC_CBS);
+    vkFreeCommandBuffers(device, cmdpool, 1, &cmdbuf);
+    vkDestroyCommandPool(device, cmdpool, ALLOC_CBS);
+    vkDestroyFramebuffer(device, framebuffer, ALLOC_CBS);
+    vkDestroyImageView(device, view, ALLOC_CBS);
+    vkDestroyRenderPass(device, renderpass, ALLOC_CBS);
+    vkuDestroyImageAndFreeMemory(device, resource);
+
+    return bCountsOk;
+}
@@ -0,0 +1,335 @@
+#include "descriptor_binder.h"
+#include "vk_simple_init.h"
+#include "bench_util.h"
+#include "volk/volk.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+static void
+#ifdef __GNUC__
+__attribute__((noreturn))
+#endif
+VerifyVkResultFaild(VkResult r, const char *expr, int line)
+{
+   fprintf(stderr, "%s:%d (%s) returned non-VK_SUCCESS: %d\n", __FILE__, line, expr, r);
+   exit(r);
+}
+#define VERIFY_VK(e) do { if (VkResult _r = e) VerifyVkResultFaild(_r, #e, __LINE__); } while(0)
+
+static bool
+IsImageDescriptor(VkDescriptorType type)
+{
+    return type == VK_DESCRIPTOR_TYPE_SAMPLER ||
+           type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+           type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+           type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+           type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+}
+
+static bool
+IsTexelBufferDescriptor(VkDescriptorType type)
+{
+    return type == VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER || type == VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+}
+
+// Image and buffer infos can be written straight from a DescriptorData array:
+static_assert(sizeof(DescriptorData) == sizeof(VkDescriptorImageInfo) && sizeof(DescriptorData) == sizeof(VkDescriptorBufferInfo),
+              "DescriptorData arrays must have the stride of the info arrays");
+
+static VkWriteDescriptorSet
+DescriptorWrite(VkDescriptorSet set, uint32_t binding, uint32_t first, uint32_t count, VkDescriptorType type, const DescriptorData *pData)
+{
+    assert(count == 1 || !IsTexelBufferDescriptor(type));
+    const VkWriteDescriptorSet write = {
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, set, binding, first, count, type,
+        IsImageDescriptor(type) ? &pData->image : nullptr,
+        !IsImageDescriptor(type) && !IsTexelBufferDescriptor(type) ? &pData->buffer : nullptr,
+        IsTexelBufferDescriptor(type) ? &pData->texelBufferView : nullptr
+    };
+    return write;
+}
+
+VkResult
+DescriptorBinderInit(DescriptorBinder *b, const VulkanObjetcs& vk, DescriptorBindMode mode, VkPipelineBindPoint bindPoint,
+                     VkShaderStageFlags stages, const VkDescriptorType *pTypes, uint32_t numBindings, uint32_t maxSets)
+{
+    assert(numBindings <= DescriptorBinderMaxBindings);
+    *b = { };
+    b->device = vk.device;
+    b->bindPoint = bindPoint;
+    b->numBindings = numBindings;
+
+    bool const bPushSupported = numBindings <= vk.pushDescriptorProperties.maxPushDescriptors; // 0 without the extension
+    if (mode == DescriptorBindMode::Auto || (mode == DescriptorBindMode::Push && !bPushSupported)) {
+        mode = bPushSupported ? DescriptorBindMode::Push : DescriptorBindMode::Template;
+    }
+    b->mode = mode;
+
+    VkDescriptorSetLayoutBinding bindings[DescriptorBinderMaxBindings];
+    for (uint32_t i = 0; i < numBindings; ++i) {
+        b->types[i] = pTypes[i];
+        bindings[i] = { i, pTypes[i], 1, stages, nullptr };
+    }
+    const VkDescriptorSetLayoutCreateInfo setInfo = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr,
+        mode == DescriptorBindMode::Push ? VkDescriptorSetLayoutCreateFlags(VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR) : 0u,
+        numBindings, bindings
+    };
+    VkResult r = vkCreateDescriptorSetLayout(b->device, &setInfo, ALLOC_CBS, &b->setLayout);
+    if (r != VK_SUCCESS || mode == DescriptorBindMode::Push) return r;
+
+    // One pool size per distinct type:
+    VkDescriptorPoolSize poolSizes[DescriptorBinderMaxBindings];
+    uint32_t numPoolSizes = 0;
+    for (uint32_t i = 0; i < numBindings; ++i) {
+        uint32_t s = 0;
+        while (s < numPoolSizes && poolSizes[s].type != pTypes[i]) ++s;
+        if (s == numPoolSizes) poolSizes[numPoolSizes++] = { pTypes[i], 0 };
+        poolSizes[s].descriptorCount += maxSets;
+    }
+    const VkDescriptorPoolCreateInfo poolInfo = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr, 0,
+        maxSets,
+        numPoolSizes, poolSizes
+    };
+    return vkCreateDescriptorPool(b->device, &poolInfo, ALLOC_CBS, &b->pool);
+}
+
+VkResult
+DescriptorBinderSetPipelineLayout(DescriptorBinder *b, VkPipelineLayout layout)
+{
+    b->pipelineLayout = layout;
+    if (b->mode == DescriptorBindMode::Pool) return VK_SUCCESS;
+
+    VkDescriptorUpdateTemplateEntry entries[DescriptorBinderMaxBindings];
+    for (uint32_t i = 0; i < b->numBindings; ++i) {
+        entries[i] = { i, 0, 1, b->types[i], i * sizeof(DescriptorData), sizeof(DescriptorData) };
+    }
+    bool const bPush = (b->mode == DescriptorBindMode::Push);
+    const VkDescriptorUpdateTemplateCreateInfo info = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO, nullptr, 0,
+        b->numBindings, entries,
+        bPush ? VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR : VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET,
+        b->setLayout,
+        b->bindPoint, layout,
+        0 // set
+    };
+    return vkCreateDescriptorUpdateTemplate(b->device, &info, ALLOC_CBS, &b->updateTemplate);
+}
+
+void
+DescriptorBinderBind(DescriptorBinder *b, VkCommandBuffer cmdbuf, const DescriptorData *pData)
+{
+    uint64_t const startNs = BenchNowNs();
+    if (b->mode == DescriptorBindMode::Push) {
+        vkCmdPushDescriptorSetWithTemplateKHR(cmdbuf, b->updateTemplate, b->pipelineLayout, 0, pData);
+    } else {
+        VkDescriptorSet set;
+        const VkDescriptorSetAllocateInfo allocInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
+            b->pool, 1, &b->setLayout
+        };
+        VERIFY_VK(vkAllocateDescriptorSets(b->device, &allocInfo, &set));
+        if (b->mode == DescriptorBindMode::Template) {
+            vkUpdateDescriptorSetWithTemplate(b->device, set, b->updateTemplate, pData);
+        } else {
+            VkWriteDescriptorSet writes[DescriptorBinderMaxBindings];
+            for (uint32_t i = 0; i < b->numBindings; ++i) {
+                writes[i] = DescriptorWrite(set, i, 0, 1, b->types[i], &pData[i]);
+            }
+            vkUpdateDescriptorSets(b->device, b->numBindings, writes, 0, nullptr);
+        }
+        vkCmdBindDescriptorSets(cmdbuf, b->bindPoint, b->pipelineLayout, 0, 1, &set, 0, nullptr);
+    }
+    b->bindNs += BenchNowNs() - startNs;
+    b->numBinds++;
+}
+
+void
+DescriptorBinderDestroy(DescriptorBinder *b)
+{
+    vkDestroyDescriptorUpdateTemplate(b->device, b->updateTemplate, ALLOC_CBS);
+    vkDestroyDescriptorPool(b->device, b->pool, ALLOC_CBS);
+    vkDestroyDescriptorSetLayout(b->device, b->setLayout, ALLOC_CBS);
+    b->updateTemplate = VK_NULL_HANDLE;
+    b->pool = VK_NULL_HANDLE;
+    b->setLayout = VK_NULL_HANDLE;
+}
+
+const char *
+DescriptorBindModeName(DescriptorBindMode mode)
+{
+    switch (mode) {
+    case DescriptorBindMode::Auto: return "auto";
+    case DescriptorBindMode::Pool: return "pool";
+    case DescriptorBindMode::Template: return "template";
+    case DescriptorBindMode::Push: return "push";
+    }
+    return "?";
+}
+
+void
+DescriptorBinderReport(const DescriptorBinder& b, const char *name)
+{
+    printf("%s descriptors (%s): %llu binds, %.2f us each\n", name, DescriptorBindModeName(b.mode),
+           (unsigned long long)b.numBinds, b.numBinds ? b.bindNs * 1e-3 / b.numBinds : 0.0);
+}
+
+// The update-after-bind limits of one type, false if a table of it can't be indexed dynamically.
+static bool
+GetUpdateAfterBindLimits(const VulkanObjetcs& vk, VkDescriptorType type, uint32_t *pPerStage, uint32_t *pPerSet)
+{
+    const VkPhysicalDeviceDescriptorIndexingFeaturesEXT& f = vk.descriptorIndexingFeatures;
+    const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& p = vk.descriptorIndexingProperties;
+    const VkPhysicalDeviceFeatures& core = vk.features2.features;
+    switch (type) {
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+        *pPerStage = p.maxPerStageDescriptorUpdateAfterBindSampledImages;
+        *pPerSet = p.maxDescriptorSetUpdateAfterBindSampledImages;
+        return f.descriptorBindingSampledImageUpdateAfterBind && core.shaderSampledImageArrayDynamicIndexing;
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+        *pPerStage = p.maxPerStageDescriptorUpdateAfterBindStorageImages;
+        *pPerSet = p.maxDescriptorSetUpdateAfterBindStorageImages;
+        return f.descriptorBindingStorageImageUpdateAfterBind && core.shaderStorageImageArrayDynamicIndexing;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+        *pPerStage = p.maxPerStageDescriptorUpdateAfterBindUniformBuffers;
+        *pPerSet = p.maxDescriptorSetUpdateAfterBindUniformBuffers;
+        return f.descriptorBindingUniformBufferUpdateAfterBind && core.shaderUniformBufferArrayDynamicIndexing;
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+        *pPerStage = p.maxPerStageDescriptorUpdateAfterBindStorageBuffers;
+        *pPerSet = p.maxDescriptorSetUpdateAfterBindStorageBuffers;
+        return f.descriptorBindingStorageBufferUpdateAfterBind && core.shaderStorageBufferArrayDynamicIndexing;
+    default:
+        *pPerStage = *pPerSet = 0;
+        return false;
+    }
+}
+
+uint32_t
+DescriptorTableMaxCapacity(const VulkanObjetcs& vk, VkDescriptorType tableType, const VkDescriptorType *pTypes, uint32_t numOtherBindings)
+{
+    const VkPhysicalDeviceDescriptorIndexingPropertiesEXT& p = vk.descriptorIndexingProperties;
+    uint32_t perStage, perSet;
+    if (!vk.EXT_descriptor_indexing || !GetUpdateAfterBindLimits(vk, tableType, &perStage, &perSet)) return 0;
+    uint32_t n = perStage < perSet ? perStage : perSet;
+    uint32_t resources = p.maxPerStageUpdateAfterBindResources < p.maxUpdateAfterBindDescriptorsInAllPools ?
+                         p.maxPerStageUpdateAfterBindResources : p.maxUpdateAfterBindDescriptorsInAllPools;
+
+    // The set is created UPDATE_AFTER_BIND_POOL, so the other bindings count against the same limits:
+    if (numOtherBindings >= resources) return 0;
+    resources -= numOtherBindings;
+    uint32_t numOfTableType = 0;
+    for (uint32_t i = 0; i < numOtherBindings; ++i) {
+        uint32_t numOfType = 0;
+        for (uint32_t j = 0; j < numOtherBindings; ++j) numOfType += pTypes[j] == pTypes[i];
+        if (pTypes[i] == tableType) {
+            numOfTableType = numOfType;
+        } else {
+            uint32_t otherPerStage, otherPerSet;
+            GetUpdateAfterBindLimits(vk, pTypes[i], &otherPerStage, &otherPerSet); // single descriptors, no feature needed
+            if (numOfType > otherPerStage || numOfType > otherPerSet) return 0;
+        }
+    }
+    n = n > numOfTableType ? n - numOfTableType : 0;
+    return n < resources ? n : resources;
+}
+
+VkResult
+DescriptorTableInit(DescriptorTable *t, const VulkanObjetcs& vk, VkShaderStageFlags stages, VkDescriptorType tableType, uint32_t capacity,
+                    const VkDescriptorType *pTypes, uint32_t numOtherBindings)
+{
+    assert(numOtherBindings < DescriptorBinderMaxBindings && !IsTexelBufferDescriptor(tableType));
+    *t = { };
+    t->device = vk.device;
+    t->tableType = tableType;
+    t->capacity = capacity;
+    t->numBindings = 1 + numOtherBindings;
+
+    VkDescriptorSetLayoutBinding bindings[DescriptorBinderMaxBindings];
+    VkDescriptorBindingFlagsEXT bindingFlags[DescriptorBinderMaxBindings] = { };
+    bindings[0] = { 0, tableType, capacity, stages, nullptr };
+    bindingFlags[0] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT;
+    t->types[0] = tableType;
+    for (uint32_t i = 1; i < t->numBindings; ++i) {
+        t->types[i] = pTypes[i - 1];
+        bindings[i] = { i, pTypes[i - 1], 1, stages, nullptr };
+    }
+    const VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT, nullptr,
+        t->numBindings, bindingFlags
+    };
+    const VkDescriptorSetLayoutCreateInfo setInfo = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, &flagsInfo,
+        VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+        t->numBindings, bindings
+    };
+    VkResult r = vkCreateDescriptorSetLayout(t->device, &setInfo, ALLOC_CBS, &t->setLayout);
+    if (r != VK_SUCCESS) return r;
+
+    VkDescriptorPoolSize poolSizes[DescriptorBinderMaxBindings];
+    uint32_t numPoolSizes = 0;
+    for (uint32_t i = 0; i < t->numBindings; ++i) {
+        uint32_t s = 0;
+        while (s < numPoolSizes && poolSizes[s].type != t->types[i]) ++s;
+        if (s == numPoolSizes) poolSizes[numPoolSizes++] = { t->types[i], 0 };
+        poolSizes[s].descriptorCount += bindings[i].descriptorCount;
+    }
+    const VkDescriptorPoolCreateInfo poolInfo = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr,
+        VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT,
+        1, // maxSets
+        numPoolSizes, poolSizes
+    };
+    r = vkCreateDescriptorPool(t->device, &poolInfo, ALLOC_CBS, &t->pool);
+    if (r != VK_SUCCESS) return r;
+
+    const VkDescriptorSetAllocateInfo allocInfo = {
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
+        t->pool, 1, &t->setLayout
+    };
+    return vkAllocateDescriptorSets(t->device, &allocInfo, &t->set);
+}
+
+void
+DescriptorTableWrite(DescriptorTable *t, uint32_t first, uint32_t count, const DescriptorData *pData)
+{
+    assert(first <= t->capacity && count <= t->capacity - first);
+    uint64_t const startNs = BenchNowNs();
+    VkWriteDescriptorSet const write = DescriptorWrite(t->set, 0, first, count, t->tableType, pData);
+    vkUpdateDescriptorSets(t->device, 1, &write, 0, nullptr);
+    t->writeNs += BenchNowNs() - startNs;
+    t->numWrites += count;
+}
+
+void
+DescriptorTableWriteBinding(DescriptorTable *t, uint32_t binding, const DescriptorData& data)
+{
+    assert(binding >= 1 && binding < t->numBindings);
+    VkWriteDescriptorSet const write = DescriptorWrite(t->set, binding, 0, 1, t->types[binding], &data);
+    vkUpdateDescriptorSets(t->device, 1, &write, 0, nullptr);
+}
+
+void
+DescriptorTableBind(const DescriptorTable& t, VkCommandBuffer cmdbuf, VkPipelineBindPoint bindPoint, VkPipelineLayout layout)
+{
+    vkCmdBindDescriptorSets(cmdbuf, bindPoint, layout, 0, 1, &t.set, 0, nullptr);
+}
+
+void
+DescriptorTableDestroy(DescriptorTable *t)
+{
+    vkDestroyDescriptorPool(t->device, t->pool, ALLOC_CBS);
+    vkDestroyDescriptorSetLayout(t->device, t->setLayout, ALLOC_CBS);
+    t->pool = VK_NULL_HANDLE;
+    t->setLayout = VK_NULL_HANDLE;
+    t->set = VK_NULL_HANDLE;
+}
+
+void
+DescriptorTableReport(const DescriptorTable& t, const char *name)
+{
+    printf("%s descriptors (table): %llu written, %.3f us each\n", name,
+           (unsigned long long)t.numWrites, t.numWrites ? t.writeNs * 1e-3 / t.numWrites : 0.0);
+}
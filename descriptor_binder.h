@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+struct VulkanObjetcs;
+
+/*
+ * Writes and binds one descriptor set (set 0) per draw or dispatch, in whichever of these ways
+ * is cheapest on the device:
+ *  - Push:     vkCmdPushDescriptorSetWithTemplateKHR, no sets or pool at all (VK_KHR_push_descriptor)
+ *  - Template: a set from the binder's pool, written with vkUpdateDescriptorSetWithTemplate
+ *  - Pool:     a set from the binder's pool, written with vkUpdateDescriptorSets
+ * Every mode still writes every descriptor on every bind: a template only saves building the
+ * VkWriteDescriptorSet array, and push records the writes into the command buffer instead of a set.
+ * The caller passes one DescriptorData per binding, in the order of the types given at init,
+ * and every binding is a single descriptor. The templates read that array directly, so a test
+ * fills it the same way for every mode.
+ *
+ * Pooled sets are never recycled, size maxSets for every bind over the binder's lifetime.
+ *
+ * The CPU time of every bind is accumulated for DescriptorBinderReport, since a sweep of
+ * thousands of tiny dispatches can spend more time on descriptors than on the work.
+ */
+
+enum class DescriptorBindMode : uint8_t { Auto, Pool, Template, Push };
+
+// From --descriptors=, Auto picks Push if supported, else Template:
+extern DescriptorBindMode g_descriptorBindMode;
+
+enum { DescriptorBinderMaxBindings = 8 };
+
+union DescriptorData {
+    VkDescriptorImageInfo image;   // images and samplers
+    VkDescriptorBufferInfo buffer; // uniform and storage buffers
+    VkBufferView texelBufferView;
+};
+
+struct DescriptorBinder {
+    VkDevice device;
+    DescriptorBindMode mode; // never Auto after init
+    VkPipelineBindPoint bindPoint;
+    uint32_t numBindings;
+    VkDescriptorType types[DescriptorBinderMaxBindings];
+    VkDescriptorSetLayout setLayout;
+    VkPipelineLayout pipelineLayout; // the caller's
+    VkDescriptorUpdateTemplate updateTemplate;
+    VkDescriptorPool pool;
+    uint64_t numBinds;
+    uint64_t bindNs;
+};
+
+/*
+ * Creates the set layout, binding i of type pTypes[i]. mode is usually g_descriptorBindMode; Auto, or
+ * Push where push descriptors can't be used, becomes Push or Template, check b->mode for which.
+ * maxSets: binds the binder can do, unused with Push.
+ */
+VkResult
+DescriptorBinderInit(DescriptorBinder *b, const VulkanObjetcs& vk, DescriptorBindMode mode, VkPipelineBindPoint bindPoint,
+                     VkShaderStageFlags stages, const VkDescriptorType *pTypes, uint32_t numBindings, uint32_t maxSets);
+
+// Finishes the setup once the caller has made a pipeline layout with b->setLayout as set 0.
+VkResult
+DescriptorBinderSetPipelineLayout(DescriptorBinder *b, VkPipelineLayout layout);
+
+void
+DescriptorBinderBind(DescriptorBinder *b, VkCommandBuffer cmdbuf, const DescriptorData *pData);
+
+// Leaves the pipeline layout to the caller.
+void
+DescriptorBinderDestroy(DescriptorBinder *b);
+
+const char *
+DescriptorBindModeName(DescriptorBindMode mode);
+
+// e.g. "srv descriptors (push): 4 binds, 0.41 us each"
+void
+DescriptorBinderReport(const DescriptorBinder& b, const char *name);
+
+/*
+ * The bindless alternative: one set holding an array of 'capacity' descriptors at binding 0
+ * (the table) and single descriptors at bindings 1.., allocated and bound once. Kernels pick
+ * their table entry with a push constant, so a sweep over thousands of inputs changes no
+ * descriptors between dispatches. The table binding is UPDATE_AFTER_BIND, entries may be
+ * written after the set is bound as long as the command buffer has not been submitted yet;
+ * the other bindings have to be written before binding.
+ *
+ * Needs VK_EXT_descriptor_indexing with update-after-bind for the table's type, see
+ * DescriptorTableMaxCapacity. Texel buffer tables are not supported.
+ */
+struct DescriptorTable {
+    VkDevice device;
+    VkDescriptorType tableType;
+    uint32_t capacity;
+    uint32_t numBindings; // including the table
+    VkDescriptorType types[DescriptorBinderMaxBindings]; // [0] = tableType
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+    uint64_t numWrites; // descriptors written
+    uint64_t writeNs;
+};
+
+/*
+ * Largest table of this type the device can bind to one stage next to the other bindings, as
+ * DescriptorTableInit takes them, within the update-after-bind limits of VK_EXT_descriptor_indexing.
+ * 0 if the table can't be updated after binding or the other bindings don't fit.
+ */
+uint32_t
+DescriptorTableMaxCapacity(const VulkanObjetcs& vk, VkDescriptorType tableType, const VkDescriptorType *pTypes, uint32_t numOtherBindings);
+
+// pTypes: the types of bindings 1 to numOtherBindings.
+VkResult
+DescriptorTableInit(DescriptorTable *t, const VulkanObjetcs& vk, VkShaderStageFlags stages, VkDescriptorType tableType, uint32_t capacity,
+                    const VkDescriptorType *pTypes, uint32_t numOtherBindings);
+
+// Writes table entries [first, first + count), one DescriptorData each.
+void
+DescriptorTableWrite(DescriptorTable *t, uint32_t first, uint32_t count, const DescriptorData *pData);
+
+// Writes binding >= 1.
+void
+DescriptorTableWriteBinding(DescriptorTable *t, uint32_t binding, const DescriptorData& data);
+
+void
+DescriptorTableBind(const DescriptorTable& t, VkCommandBuffer cmdbuf, VkPipelineBindPoint bindPoint, VkPipelineLayout layout);
+
+void
+DescriptorTableDestroy(DescriptorTable *t);
+
+// e.g. "table descriptors: 4096 written, 0.05 us each"
+void
+DescriptorTableReport(const DescriptorTable& t, const char *name);
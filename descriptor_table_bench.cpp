@@ -0,0 +1,448 @@
+#include "vk_simple_init.h"
+#include "vk_util.h"
+#include "spirv_patch.h"
+#include "shader_cache.h"
+#include "descriptor_binder.h"
+#include "gpu_verify.h"
+#include "bench_util.h"
+#include "volk/volk.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The ld_typed_2darray_oob kernel over thousands of input views, once per binding model: a set
+ * per dispatch from a pool, written with an update template, or pushed (DescriptorBinder), and
+ * one UPDATE_AFTER_BIND table indexed by a push constant (DescriptorTable). Every view covers a
+ * different layer span of one of four input arrays, so the out of bounds layers move around;
+ * all outputs are compared on the device against the expectation computed from the shader.
+ *
+ * Reports per backend the CPU time of the descriptor writes, the CPU time to record the timed
+ * dispatches and their GPU time, per dispatch.
+ */
+
+static void
+#ifdef __GNUC__
+__attribute__((noreturn))
+#endif
+VerifyVkResultFaild(VkResult r, const char *expr, int line)
+{
+   fprintf(stderr, "%s:%d (%s) returned non-VK_SUCCESS: %d\n", __FILE__, line, expr, r);
+   exit(r);
+}
+#define VERIFY_VK(e) do { if (VkResult _r = e) VerifyVkResultFaild(_r, #e, __LINE__); } while(0)
+
+// see ld_srv_typed_2darray.comp:
+static const uint32_t CsSpirvWords[] =
+#include "ld_srv_typed_2darray.comp.h"
+;
+
+/*
+ * Makes binding 0 of the SRV kernel an array of tableSize images and loads element pc.v.z:
+ * the input variable's type becomes a pointer to OpTypeArray, and its OpLoad becomes an
+ * OpAccessChain to v.z in the push constants, a load of that, an OpAccessChain to the element
+ * and the original load from it. The index is dynamically uniform, so no NonUniform needed.
+ */
+static bool
+MakeTableKernel(SpirvModule *m, uint32_t tableSize)
+{
+    uint32_t input = 0, pushConsts = 0, uintType = 0, load = 0;
+    for (uint32_t at = SpirvFindOp(*m, SpirvOpDecorate); at; at = SpirvFindOp(*m, SpirvOpDecorate, at + SpirvWordCount(*m, at))) {
+        if (SpirvWordCount(*m, at) >= 4 && m->pWords[at + 2] == SpirvDecorationBinding && m->pWords[at + 3] == 0) input = m->pWords[at + 1];
+    }
+    for (uint32_t at = SpirvFindOp(*m, SpirvOpVariable); at; at = SpirvFindOp(*m, SpirvOpVariable, at + SpirvWordCount(*m, at))) {
+        if (m->pWords[at + 3] == SpirvStorageClassPushConstant) pushConsts = m->pWords[at + 2];
+    }
+    for (uint32_t at = SpirvFindOp(*m, SpirvOpTypeInt); at; at = SpirvFindOp(*m, SpirvOpTypeInt, at + SpirvWordCount(*m, at))) {
+        if (m->pWords[at + 2] == 32 && m->pWords[at + 3] == 0) uintType = m->pWords[at + 1];
+    }
+    for (uint32_t at = SpirvFindOp(*m, SpirvOpLoad); at && input; at = SpirvFindOp(*m, SpirvOpLoad, at + SpirvWordCount(*m, at))) {
+        if (m->pWords[at + 3] == input) load = at;
+    }
+    uint32_t const var = input ? SpirvFindResult(*m, input) : 0;
+    if (!var || !pushConsts || !uintType || !load || SpirvOpcode(*m, var) != SpirvOpVariable) return false;
+    uint32_t const ptrType = m->pWords[var + 1];
+    uint32_t const ptr = SpirvFindResult(*m, ptrType);
+    if (!ptr || SpirvOpcode(*m, ptr) != SpirvOpTypePointer) return false;
+    uint32_t const imageType = m->pWords[ptr + 3];
+    uint32_t const loaded = m->pWords[load + 2];
+
+    uint32_t const sizeConst = SpirvNewId(m), zeroConst = SpirvNewId(m), twoConst = SpirvNewId(m);
+    uint32_t const arrayType = SpirvNewId(m), arrayPtrType = SpirvNewId(m), pcUintPtrType = SpirvNewId(m);
+    uint32_t const indexPtr = SpirvNewId(m), index = SpirvNewId(m), elementPtr = SpirvNewId(m);
+
+    // The load comes after the variable, edit it first so var stays valid:
+    const uint32_t loadWords[] = {
+        (6u << 16) | SpirvOpAccessChain, pcUintPtrType, indexPtr, pushConsts, zeroConst, twoConst,
+        (4u << 16) | SpirvOpLoad, uintType, index, indexPtr,
+        (5u << 16) | SpirvOpAccessChain, ptrType, elementPtr, input, index,
+        (4u << 16) | SpirvOpLoad, imageType, loaded, elementPtr,
+    };
+    if (!SpirvSplice(m, load, SpirvWordCount(*m, load), loadWords, lengthof(loadWords))) return false;
+
+    const uint32_t typeWords[] = {
+        (4u << 16) | SpirvOpConstant, uintType, sizeConst, tableSize,
+        (4u << 16) | SpirvOpConstant, uintType, zeroConst, 0,
+        (4u << 16) | SpirvOpConstant, uintType, twoConst, 2,
+        (4u << 16) | SpirvOpTypeArray, arrayType, imageType, sizeConst,
+        (4u << 16) | SpirvOpTypePointer, arrayPtrType, SpirvStorageClassUniformConstant, arrayType,
+        (4u << 16) | SpirvOpTypePointer, pcUintPtrType, SpirvStorageClassPushConstant, uintType,
+    };
+    m->pWords[var + 1] = arrayPtrType;
+    return SpirvSplice(m, var, 0, typeWords, lengthof(typeWords));
+}
+
+bool TestDescriptorTableBench(const VulkanObjetcs& vk)
+{
+    VkDevice const device = vk.device;
+    VkQueue const queue = vk.universalQueue;
+    const VkPhysicalDeviceMemoryProperties& memProps = vk.memProps;
+
+    {
+        uint32_t numFamilies = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(vk.physicalDevice, &numFamilies, nullptr);
+        VkQueueFamilyProperties families[16];
+        numFamilies = numFamilies < 16 ? numFamilies : 16;
+        vkGetPhysicalDeviceQueueFamilyProperties(vk.physicalDevice, &numFamilies, families);
+        if (vk.universalFamilyIndex >= numFamilies || families[vk.universalFamilyIndex].timestampValidBits == 0) {
+            puts("ERROR: the queue does not support timestamps.");
+            return false;
+        }
+    }
+    double const nsPerTick = vk.props2.properties.limits.timestampPeriod;
+
+    static constexpr uint32_t ImageWidth = 8, ImageHeight = 8, NumViews = 4096;
+    static constexpr uint32_t ValuesPerView = ImageWidth * ImageHeight;
+    static const uint8_t ImageLayerCounts[4] = { 1, 3, 4, 5 };
+    static const uint32_t ColorOfLayer[5] = { 0xff0000ffu, 0xff00ff00u, 0xffff0000u, 0xff00ffffu, 0xffff00ffu };
+
+    static const struct Backend {
+        const char *name;
+        DescriptorBindMode mode; // for DescriptorBinder
+        bool bTable;
+    } Backends[] = {
+        { "pool",     DescriptorBindMode::Pool,     false },
+        { "template", DescriptorBindMode::Template, false },
+        { "push",     DescriptorBindMode::Push,     false },
+        { "table",    DescriptorBindMode::Auto,     true },
+    };
+
+    // The output is the table set's only other binding, see DescriptorTableInit below:
+    const VkDescriptorType inputTypes[2] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE };
+    uint32_t const tableCapacity = DescriptorTableMaxCapacity(vk, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, &inputTypes[1], 1);
+    uint32_t tableCode[lengthof(CsSpirvWords) + 64];
+    SpirvModule tableKernel = { };
+    if (tableCapacity >= NumViews) {
+        if (!SpirvInit(&tableKernel, tableCode, lengthof(tableCode), CsSpirvWords, sizeof CsSpirvWords) ||
+            !MakeTableKernel(&tableKernel, NumViews)) {
+            puts("ERROR: failed to patch ld_srv_typed_2darray.comp.h into the table variant");
+            abort();
+        }
+    } else {
+        printf("NOTE: update-after-bind tables of %u sampled images are not supported (max %u), skipping the table backend.\n",
+               NumViews, tableCapacity);
+    }
+
+    VkuImageAndMemory images[5]; // [4] is the output
+    VkImageView outputView;
+    {
+        VkImageCreateInfo imageInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = VK_FORMAT_R32_UINT;
+        imageInfo.extent = { ImageWidth, ImageHeight, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        for (int i = 0; i < 5; ++i) {
+            imageInfo.arrayLayers = i < 4 ? ImageLayerCounts[i] : 1;
+            imageInfo.usage = i < 4 ? (VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT) :
+                                      (VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+            VERIFY_VK(vkuDedicatedImage(device, imageInfo, &images[i], memProps));
+        }
+        const VkImageViewCreateInfo viewInfo = {
+            VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, nullptr, 0,
+            images[4].image,
+            VK_IMAGE_VIEW_TYPE_2D,
+            VK_FORMAT_R32_UINT,
+            { }, // VkComponentMapping all zeroes is identity
+            { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+        };
+        VERIFY_VK(vkCreateImageView(device, &viewInfo, ALLOC_CBS, &outputView));
+    }
+
+    // View v reads layers [base, base + n) of input v % 4, each view gets a different span over the sweep:
+    struct ViewSpan { uint8_t base, n; };
+    ViewSpan *const spans = static_cast<ViewSpan *>(malloc(NumViews * sizeof(ViewSpan)));
+    VkImageView *const views = static_cast<VkImageView *>(malloc(NumViews * sizeof(VkImageView)));
+    DescriptorData *const tableData = static_cast<DescriptorData *>(malloc(NumViews * sizeof(DescriptorData)));
+    for (uint32_t v = 0; v < NumViews; ++v) {
+        uint32_t const layers = ImageLayerCounts[v % 4];
+        uint32_t const base = (v / 4) % layers;
+        spans[v] = { uint8_t(base), uint8_t(1 + (v / 16) % (layers - base)) };
+        const VkImageViewCreateInfo viewInfo = {
+            VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, nullptr, 0,
+            images[v % 4].image,
+            VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+            VK_FORMAT_R32_UINT,
+            { },
+            { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, spans[v].base, spans[v].n }
+        };
+        VERIFY_VK(vkCreateImageView(device, &viewInfo, ALLOC_CBS, &views[v]));
+        tableData[v].image = { VkSampler(), views[v], VK_IMAGE_LAYOUT_GENERAL };
+    }
+
+    // Outputs are copied to 'got' one after another and compared with 'expected' on the device:
+    static constexpr VkDeviceSize ResultBytes = VkDeviceSize(NumViews) * ValuesPerView * sizeof(uint32_t);
+    VkuBufferAndMemory got;
+    VERIFY_VK(vkuDedicatedBuffer(device, ResultBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                 &got, memProps, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+    VkuStagingBuffer expected;
+    VERIFY_VK(vkuStagingBuffer(device, ResultBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &expected, memProps));
+    {
+        uint32_t *const pExpected = static_cast<uint32_t *>(expected.pHost);
+        for (uint32_t v = 0; v < NumViews; ++v) {
+            for (uint32_t y = 0; y < ImageHeight; ++y) {
+                for (uint32_t x = 0; x < ImageWidth; ++x) {
+                    // same coordinates as the shader:
+                    uint32_t const cx = x + 1, cz = y < 7u ? y : uint32_t(-1);
+                    pExpected[(v * ImageHeight + y) * ImageWidth + x] =
+                            (cx >= ImageWidth || cz >= spans[v].n) ? 0 : ColorOfLayer[spans[v].base + cz];
+                }
+            }
+        }
+        vkuFlushStagingBuffer(device, expected);
+    }
+
+    GpuVerifier verifier;
+    VERIFY_VK(GpuVerifierInit(vk, &verifier));
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    {
+        VkQueryPoolCreateInfo info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        info.queryCount = 2;
+        VERIFY_VK(vkCreateQueryPool(device, &info, ALLOC_CBS, &queryPool));
+    }
+
+    VkCommandPool cmdpool = VK_NULL_HANDLE;
+    VkCommandBuffer cmdbuf = VK_NULL_HANDLE;
+    {
+        const VkCommandPoolCreateInfo cmdPoolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr,
+            0, // flags
+            vk.universalFamilyIndex
+        };
+        VERIFY_VK(vkCreateCommandPool(device, &cmdPoolInfo, ALLOC_CBS, &cmdpool));
+
+        const VkCommandBufferAllocateInfo cmdBufAllocInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr, cmdpool,
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            1 // commandBufferCount
+        };
+        VERIFY_VK(vkAllocateCommandBuffers(device, &cmdBufAllocInfo, &cmdbuf));
+    }
+
+    const VkCommandBufferBeginInfo cmdBufbeginInfo = {
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr
+    };
+    auto SubmitAndWait = [&]() {
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmdbuf;
+        VERIFY_VK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+        VERIFY_VK(vkQueueWaitIdle(queue));
+    };
+
+    // Clear the inputs once, every backend reads the same data:
+    {
+        VERIFY_VK(vkBeginCommandBuffer(cmdbuf, &cmdBufbeginInfo));
+        VkImageMemoryBarrier ib[5] = { };
+        for (int i = 0; i < 5; ++i) {
+            ib[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            ib[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            ib[i].image = images[i].image;
+            ib[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            ib[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            ib[i].dstAccessMask = i < 4 ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_WRITE_BIT;
+            ib[i].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, -1u, 0, -1u };
+        }
+        vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0x0,
+                             0, nullptr, 0, nullptr, 5, ib);
+        for (int i = 0; i < 4; ++i) {
+            for (uint32_t layer = 0; layer < ImageLayerCounts[i]; ++layer) {
+                VkClearColorValue clearVal; for (uint32_t &r : clearVal.uint32) r = ColorOfLayer[layer];
+                const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, layer, 1 };
+                vkCmdClearColorImage(cmdbuf, images[i].image, VK_IMAGE_LAYOUT_GENERAL, &clearVal, 1, &range);
+            }
+        }
+        VERIFY_VK(vkEndCommandBuffer(cmdbuf));
+        SubmitAndWait();
+    }
+
+    printf("%u views, %ux%u output per dispatch, per dispatch:\n", NumViews, ImageWidth, ImageHeight);
+    printf("  %-10s %16s %16s %12s %12s\n", "backend", "descriptors us", "record us", "gpu us", "mismatches");
+    bool bPassed = true;
+    for (const Backend& backend : Backends) {
+        if (backend.bTable && !tableKernel.pWords) continue;
+
+        DescriptorBinder binder = { };
+        DescriptorTable table = { };
+        VkDescriptorSetLayout setLayout;
+        if (backend.bTable) {
+            VERIFY_VK(DescriptorTableInit(&table, vk, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, NumViews,
+                                          &inputTypes[1], 1));
+            setLayout = table.setLayout;
+        } else {
+            // Two binds per view, the timed dispatches and the checked ones:
+            VERIFY_VK(DescriptorBinderInit(&binder, vk, backend.mode, VK_PIPELINE_BIND_POINT_COMPUTE, VK_SHADER_STAGE_COMPUTE_BIT,
+                                           inputTypes, 2, NumViews * 2));
+            if (binder.mode != backend.mode) {
+                printf("  %-10s not supported\n", backend.name);
+                DescriptorBinderDestroy(&binder);
+                continue;
+            }
+            setLayout = binder.setLayout;
+        }
+
+        VkPipelineLayout psoLayout = VK_NULL_HANDLE;
+        {
+            const VkPushConstantRange pcRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, 16 };
+            const VkPipelineLayoutCreateInfo layoutInfo = {
+                VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, nullptr, 0,
+                1, &setLayout,
+                1, &pcRange
+            };
+            VERIFY_VK(vkCreatePipelineLayout(device, &layoutInfo, ALLOC_CBS, &psoLayout));
+        }
+        if (!backend.bTable) VERIFY_VK(DescriptorBinderSetPipelineLayout(&binder, psoLayout));
+
+        VkPipeline pso = VK_NULL_HANDLE;
+        {
+            VkShaderModule shaderModule;
+            if (backend.bTable) {
+                VERIFY_VK(ShaderCacheAcquire(tableKernel.pWords, SpirvByteSize(tableKernel), &shaderModule));
+            } else {
+                VERIFY_VK(ShaderCacheAcquire(CsSpirvWords, &shaderModule));
+            }
+            const VkComputePipelineCreateInfo pipelineInfo = {
+                VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                nullptr, // pNext
+                0, // VkPipelineCreateFlags
+                {
+                    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    nullptr,
+                    0, // VkPipelineShaderStageCreateFlags
+                    VK_SHADER_STAGE_COMPUTE_BIT,
+                    shaderModule,
+                    "main",
+                    nullptr },
+                psoLayout,
+                VK_NULL_HANDLE, // basePipelineHandle
+                0 // basePipelineIndex
+            };
+            VERIFY_VK(ShaderCacheCreateComputePipeline(pipelineInfo, &pso));
+            ShaderCacheRelease(shaderModule);
+        }
+
+        DescriptorData outputData;
+        outputData.image = { VkSampler(), outputView, VK_IMAGE_LAYOUT_GENERAL };
+        // Not update-after-bind, so before the set is bound:
+        if (backend.bTable) DescriptorTableWriteBinding(&table, 1, outputData);
+
+        auto CmdBindView = [&](uint32_t v) {
+            if (backend.bTable) {
+                vkCmdPushConstants(cmdbuf, psoLayout, VK_SHADER_STAGE_COMPUTE_BIT, 8, sizeof v, &v); // pc.v.z
+            } else {
+                DescriptorData const data[2] = { tableData[v], outputData };
+                DescriptorBinderBind(&binder, cmdbuf, data);
+            }
+        };
+
+        vkResetCommandPool(device, cmdpool, 0x0);
+        VERIFY_VK(vkBeginCommandBuffer(cmdbuf, &cmdBufbeginInfo));
+        vkCmdResetQueryPool(cmdbuf, queryPool, 0, 2);
+        vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, pso);
+        const uint32_t pcData[4] = { uint32_t(-1), 0, 0, 0 };
+        vkCmdPushConstants(cmdbuf, psoLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, 16, pcData);
+        if (backend.bTable) DescriptorTableBind(table, cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, psoLayout);
+
+        // Timed, the dispatches are serialized so the GPU time is their sum rather than how well they overlap:
+        VkMemoryBarrier memBarrier = {
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+            VK_ACCESS_SHADER_WRITE_BIT,
+            VK_ACCESS_SHADER_WRITE_BIT,
+        };
+        uint64_t const recordStartNs = BenchNowNs();
+        vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+        for (uint32_t v = 0; v < NumViews; ++v) {
+            CmdBindView(v);
+            vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0x0,
+                                 1, &memBarrier, 0, nullptr, 0 , nullptr);
+            vkCmdDispatch(cmdbuf, 1, 1, 1);
+        }
+        vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+        uint64_t const recordNs = BenchNowNs() - recordStartNs;
+
+        // Checked, each output is copied out before the next dispatch overwrites it:
+        for (uint32_t v = 0; v < NumViews; ++v) {
+            CmdBindView(v);
+            memBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            memBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0x0,
+                                 1, &memBarrier, 0, nullptr, 0 , nullptr);
+            vkCmdDispatch(cmdbuf, 1, 1, 1);
+            memBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0x0,
+                                 1, &memBarrier, 0, nullptr, 0 , nullptr);
+            VkBufferImageCopy bufImgCopy = { };
+            bufImgCopy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 }; // mip, layer{begin, count}
+            bufImgCopy.imageExtent = { ImageWidth, ImageHeight, 1 };
+            bufImgCopy.bufferOffset = VkDeviceSize(v) * ValuesPerView * sizeof(uint32_t);
+            vkCmdCopyImageToBuffer(cmdbuf, images[4].image, VK_IMAGE_LAYOUT_GENERAL, got.buffer, 1, &bufImgCopy);
+        }
+        GpuVerifierCmdCompareBuffers(&verifier, cmdbuf, got.buffer, expected.buffer, NumViews * ValuesPerView);
+        VERIFY_VK(vkEndCommandBuffer(cmdbuf));
+
+        // The table is update-after-bind, so filling it after recording is fine as long as it is before the submit:
+        if (backend.bTable) DescriptorTableWrite(&table, 0, NumViews, tableData);
+
+        SubmitAndWait();
+
+        uint64_t ticks[2];
+        VERIFY_VK(vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof ticks, ticks, sizeof(uint64_t),
+                                        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        const GpuVerifySummary& summary = GpuVerifierReadSummary(verifier);
+
+        double const descriptorUs = backend.bTable ? table.writeNs * 1e-3 / table.numWrites : binder.bindNs * 1e-3 / binder.numBinds;
+        printf("  %-10s %16.3f %16.3f %12.3f %12u\n", backend.name, descriptorUs, recordNs * 1e-3 / NumViews,
+               double(ticks[1] - ticks[0]) * nsPerTick / 1e3 / NumViews, summary.numMismatches);
+        if (summary.numMismatches) {
+            PrintGpuVerifySummary(backend.name, summary);
+            bPassed = false;
+        }
+
+        vkDestroyPipeline(device, pso, ALLOC_CBS);
+        vkDestroyPipelineLayout(device, psoLayout, ALLOC_CBS);
+        if (backend.bTable) {
+            DescriptorTableDestroy(&table);
+        } else {
+            DescriptorBinderDestroy(&binder);
+        }
+    }
+
+    vkDestroyCommandPool(device, cmdpool, ALLOC_CBS);
+    vkDestroyQueryPool(device, queryPool, ALLOC_CBS);
+    GpuVerifierDestroy(verifier);
+    vkuDestroyStagingBuffer(device, expected);
+    vkuDestroyBufferAndFreeMemory(device, got);
+    for (uint32_t v = 0; v < NumViews; ++v) vkDestroyImageView(device, views[v], ALLOC_CBS);
+    vkDestroyImageView(device, outputView, ALLOC_CBS);
+    for (const VkuImageAndMemory& r : images) vkuDestroyImageAndFreeMemory(device, r);
+    free(tableData);
+    free(views);
+    free(spans);
+    return bPassed;
+}
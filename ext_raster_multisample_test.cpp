@@ -1,13 +1,21 @@
 #include "vk_simple_init.h"
 #include "volk/volk.h"
+#include "vk_util.h"
+#include "image_compare.h"
+#include "raster_reference.h"
+#include "golden_hash.h"
+#include "result_archive.h"
+#include "shader_cache.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <math.h>
 
-#include "stb/stb_image_write.h"
-#include "stb/stb_image.h"
+#include "artifact_writer.h"
+
+extern bool g_bHostImportStaging;
 
 struct vec2f { float x, y; };
 
@@ -25,6 +33,41 @@ inline bool operator!=(PackedR8G8B8 c0, PackedR8G8B8 c1)
     return !(c0 == c1);
 }
 
+static const PackedR8G8B8 ColorFromCoverageMask2[1 << 2] = {
+    { 0x00, 0x00, 0x00 },
+    { 0xff, 0x00, 0x00 },
+    { 0x00, 0xff, 0x00 },
+    { 0x00, 0x00, 0xff },
+};
+
+// 2x keeps the colors of reference_2x.png, higher counts are grey by the fraction of samples covered.
+static PackedR8G8B8
+ColorFromCoverageMask(uint16_t mask, uint32_t numSamples)
+{
+    if (mask >> numSamples) {
+        return PackedR8G8B8{ 0xff, 0x00, 0xff }; // outside the raster sample pattern
+    }
+    if (numSamples == 2) {
+        return ColorFromCoverageMask2[mask];
+    }
+    uint32_t numCovered = 0;
+    for (uint32_t m = mask; m; m &= m - 1) ++numCovered;
+    uint8_t const v = uint8_t(numCovered * 255 / numSamples);
+    return PackedR8G8B8{ v, v, v };
+}
+
+// pRgb is width*height pixels of scratch, ArtifactWritePng copies it so the caller can reuse it for the next image.
+static void
+WriteCoveragePng(const char *path, const uint16_t *pMasks, uint32_t width, uint32_t height, uint32_t numSamples,
+                 PackedR8G8B8 *pRgb)
+{
+    uint32_t const nPixelsTotal = width * height;
+    for (uint32_t i = 0; i < nPixelsTotal; ++i) {
+        pRgb[i] = ColorFromCoverageMask(pMasks[i], numSamples);
+    }
+    ArtifactWritePng(path, width, height, 3, pRgb, width * sizeof(PackedR8G8B8));
+}
+
 
 // glslc -O --target-env=vulkan1.1 xy01_attrib_passthru.vert -mfmt=c -o -
 static const uint32_t VsSpirv[] =
@@ -113,23 +156,6 @@ VerifyVkResultFaild(VkResult r, const char *expr, int line)
 }
 #define VERIFY_VK(e) do { if (VkResult _r = e) VerifyVkResultFaild(_r, #e, __LINE__); } while(0)
 
-static VkShaderModule
-CreateShaderModule(VkDevice device, uint32_t nBytes, const void *spirv)
-{
-    VkShaderModule module = nullptr;
-    VkShaderModuleCreateInfo info = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-    info.codeSize = nBytes;
-    info.pCode = static_cast<const uint32_t *>(spirv);
-    VERIFY_VK(vkCreateShaderModule(device, &info, ALLOC_CBS, &module));
-    return module;
-}
-
-template<uint32_t N> static VkShaderModule
-CreateShaderModule(VkDevice device, const uint32_t (&a)[N])
-{
-    return CreateShaderModule(device, N * sizeof (uint32_t), a);
-}
-
 typedef struct BufferAndMemory {
     VkBuffer buffer;
     VkDeviceMemory memory;
@@ -325,14 +351,46 @@ CreateExtRasterMultisamplePipeline(VkDevice device, VkShaderModule vs, VkShaderM
     info.stageCount = lengthof(stages);
     info.pStages = stages;
 
-    VERIFY_VK(vkCreateGraphicsPipelines(device, VkPipelineCache(), 1, &info, ALLOC_CBS, pPipline));
+    VERIFY_VK(ShaderCacheCreateGraphicsPipeline(info, pPipline));
 }
 
 
-bool TestExtRasterMultisample(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex, const VkPhysicalDeviceMemoryProperties& memProps)
+/*
+ * Draws two overlapping triangles with a XOR logic op and a fragment shader that writes its input
+ * SampleMask, at each raster sample count in {2, 4, 8, 16} the device can rasterize without
+ * attachments, standing in for the proposal's forcedSamples. The masks are compared against the
+ * CPU rasterizer in raster_reference, at the standard sample locations.
+ */
+bool TestExtRasterMultisample(const VulkanObjetcs& vk)
 {
+    VkDevice const device = vk.device;
+    VkQueue const queue = vk.universalQueue;
+    uint32_t const graphicsFamilyIndex = vk.universalFamilyIndex;
+    const VkPhysicalDeviceMemoryProperties& memProps = vk.memProps;
+    const VkPhysicalDeviceLimits& limits = vk.props2.properties.limits;
+
     const VkExtent3D ImageSize = { 64, 64, 1 };
-    const VkFormat Format = VK_FORMAT_R16_UINT;
+    const VkFormat Format = VK_FORMAT_R16_UINT; // holds a mask of up to 16 samples
+
+    static const VkSampleCountFlagBits SweepSampleCounts[] = {
+        VK_SAMPLE_COUNT_2_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_16_BIT
+    };
+    VkSampleCountFlagBits sampleCounts[lengthof(SweepSampleCounts)];
+    uint32_t numSampleCounts = 0;
+    for (VkSampleCountFlagBits n : SweepSampleCounts) {
+        if (limits.framebufferNoAttachmentsSampleCounts & n) {
+            sampleCounts[numSampleCounts++] = n;
+        } else {
+            printf("NOTE: %ux rasterization is not supported, skipping it.\n", uint32_t(n));
+        }
+    }
+    if (numSampleCounts == 0) {
+        puts("ERROR: none of 2x, 4x, 8x or 16x rasterization is supported.");
+        return false;
+    }
+    if (!limits.standardSampleLocations) {
+        puts("NOTE: the device doesn't use the standard sample locations, the CPU reference will likely not match.");
+    }
 
     VkCommandPool cmdpool = VK_NULL_HANDLE;
     VkCommandBuffer cmdbuf = VK_NULL_HANDLE;
@@ -352,12 +410,21 @@ bool TestExtRasterMultisample(VkDevice device, VkQueue queue, uint32_t graphicsF
         VERIFY_VK(vkAllocateCommandBuffers(device, &cmdBufAllocInfo, &cmdbuf));
     }
 
-    BufferAndMemory stage;
+    // One image's worth of masks per sample count:
+    VkuStagingBuffer stage;
     const uint32_t PackedImageByteSize = ImageSize.width * ImageSize.height * sizeof(uint16_t);
-    CreateBufferAndMemory(device, memProps,
-                          VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                          PackedImageByteSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &stage);
+    VERIFY_VK(vkuStagingBuffer(device, numSampleCounts * PackedImageByteSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                               &stage, memProps, HostImportAlignment(vk, g_bHostImportStaging)));
 
+    static const vec2f Positions[6] = {
+        {  0,    1 },
+        {  1,    0 },
+        { -0.5, -1 },
+
+        { -0.75,  1 },
+        {  1, -1 },
+        { -1, -0.75 },
+    };
     BufferAndMemory attribs;
     {
 
@@ -366,16 +433,6 @@ bool TestExtRasterMultisample(VkDevice device, VkQueue queue, uint32_t graphicsF
                               4096, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &attribs);
         void *pAttribData;
         VERIFY_VK(vkMapMemory(device, attribs.memory, 0, VK_WHOLE_SIZE, 0, &pAttribData));
-
-        static const vec2f Positions[6] = {
-            {  0,    1 },
-            {  1,    0 },
-            { -0.5, -1 },
-
-            { -0.75,  1 },
-            {  1, -1 },
-            { -1, -0.75 },
-        };
         memcpy(pAttribData, Positions, sizeof Positions);
     }
 
@@ -449,13 +506,23 @@ bool TestExtRasterMultisample(VkDevice device, VkQueue queue, uint32_t graphicsF
         VERIFY_VK(vkCreatePipelineLayout(device, &info, ALLOC_CBS, &pipelineLayout));
     }
 
-    VkPipeline pipeline = VK_NULL_HANDLE;
+    // The CPU reference uses the same viewport:
+    const VkRect2D RenderArea = {
+        { 0, 0 }, { ImageSize.width, ImageSize.height}
+    };
+    VkViewport Viewport;
+    vkuUpwardsViewportFromRect(RenderArea, 0, 1, &Viewport);
+
+    VkPipeline pipelines[lengthof(SweepSampleCounts)] = { };
     {
-        VkShaderModule vs = CreateShaderModule(device, VsSpirv);
-        VkShaderModule fs = CreateShaderModule(device, FsSpirv);
-        CreateExtRasterMultisamplePipeline(device, vs, fs, renderpass, pipelineLayout, VK_SAMPLE_COUNT_2_BIT, &pipeline);
-        vkDestroyShaderModule(device, vs, ALLOC_CBS);
-        vkDestroyShaderModule(device, fs, ALLOC_CBS);
+        VkShaderModule vs, fs;
+        VERIFY_VK(ShaderCacheAcquire(VsSpirv, &vs));
+        VERIFY_VK(ShaderCacheAcquire(FsSpirv, &fs));
+        for (uint32_t i = 0; i < numSampleCounts; ++i) {
+            CreateExtRasterMultisamplePipeline(device, vs, fs, renderpass, pipelineLayout, sampleCounts[i], &pipelines[i]);
+        }
+        ShaderCacheRelease(vs);
+        ShaderCacheRelease(fs);
     }
 
     {
@@ -478,10 +545,15 @@ bool TestExtRasterMultisample(VkDevice device, VkQueue queue, uint32_t graphicsF
         };
         vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0x0,
                              0, nullptr, 0, nullptr, 1, &imageBarrier);
-        {
-            const VkRect2D RenderArea = {
-                { 0, 0 }, { ImageSize.width, ImageSize.height}
-            };
+        VkMemoryBarrier memBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        // Each count reuses the image after the previous one's copy is done reading it:
+        for (uint32_t i = 0; i < numSampleCounts; ++i) {
+            if (i != 0) {
+                memBarrier.srcAccessMask = 0;
+                memBarrier.dstAccessMask = 0;
+                vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0x0,
+                                     1, &memBarrier, 0, nullptr, 0 , nullptr);
+            }
             const VkRenderPassBeginInfo rpBeginInfo = {
                 VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO, nullptr,
                 renderpass, framebuffer, RenderArea
@@ -495,35 +567,27 @@ bool TestExtRasterMultisample(VkDevice device, VkQueue queue, uint32_t graphicsF
                 VkClearRect clearRect = { RenderArea, 0, 1 }; // layer range
                 vkCmdClearAttachments(cmdbuf, 1, &attClear, 1, &clearRect);
 
-                vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-                VkViewport vp = { };
-                vp.x = 0;
-                vp.y = 0 + int32_t(RenderArea.extent.height);
-                vp.width = RenderArea.extent.width;
-                vp.height = -int32_t(RenderArea.extent.height);
-                vp.minDepth = 0;
-                vp.maxDepth = 1;
-                vkCmdSetViewport(cmdbuf, 0, 1, &vp);
+                vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[i]);
+                vkCmdSetViewport(cmdbuf, 0, 1, &Viewport);
                 vkCmdSetScissor(cmdbuf, 0, 1, &RenderArea);
                 VkDeviceSize offsets[1] = { };
                 vkCmdBindVertexBuffers(cmdbuf, 0, 1, &attribs.buffer, offsets);
                 vkCmdDraw(cmdbuf, 6, 1, 0, 0);
             }
             vkCmdEndRenderPass(cmdbuf);
+
+            memBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            memBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0x0,
+                                 1, &memBarrier, 0, nullptr, 0 , nullptr);
+            VkBufferImageCopy bufImgCopy = { };
+            bufImgCopy.bufferOffset = i * PackedImageByteSize;
+            bufImgCopy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 }; // mip, layer{begin, count}
+            bufImgCopy.imageExtent = ImageSize;
+            bufImgCopy.bufferRowLength = ImageSize.width;
+            bufImgCopy.bufferImageHeight = ImageSize.height;
+            vkCmdCopyImageToBuffer(cmdbuf, resource.image, VK_IMAGE_LAYOUT_GENERAL, stage.buffer, 1, &bufImgCopy);
         }
-        VkMemoryBarrier memBarrier = {
-            VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
-            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-            VK_ACCESS_TRANSFER_READ_BIT
-        };
-        vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0x0,
-                             1, &memBarrier, 0, nullptr, 0 , nullptr);
-        VkBufferImageCopy bufImgCopy = { };
-        bufImgCopy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 }; // mip, layer{begin, count}
-        bufImgCopy.imageExtent = ImageSize;
-        bufImgCopy.bufferRowLength = ImageSize.width;
-        bufImgCopy.bufferImageHeight = ImageSize.height;
-        vkCmdCopyImageToBuffer(cmdbuf, resource.image, VK_IMAGE_LAYOUT_GENERAL, stage.buffer, 1, &bufImgCopy);
         memBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
         memBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
         vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0x0,
@@ -540,79 +604,88 @@ bool TestExtRasterMultisample(VkDevice device, VkQueue queue, uint32_t graphicsF
         VERIFY_VK(vkQueueWaitIdle(queue));
     }
 
-    void *pMap = nullptr;
-    {
-        const VkDeviceSize offset = 0, size = PackedImageByteSize;
-        VERIFY_VK(vkMapMemory(device, stage.memory, offset, size, 0, &pMap));
-        VkMappedMemoryRange range = { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, stage.memory, 0x0, VK_WHOLE_SIZE };
-        vkInvalidateMappedMemoryRanges(device, 1, &range);
-    }
+    vkuInvalidateStagingBuffer(device, stage);
 
-    bool bTestPassed = false;
+    bool bTestPassed = true;
     {
-        static const PackedR8G8B8 ColorFromCoverageMask2[1 << 2] = {
-            { 0x00, 0x00, 0x00 },
-            { 0xff, 0x00, 0x00 },
-            { 0x00, 0xff, 0x00 },
-            { 0x00, 0x00, 0xff },
-        };
-
         const uint32_t nPixelsTotal = ImageSize.width * ImageSize.height;
-            PackedR8G8B8 *pRgb = (PackedR8G8B8 *)malloc(nPixelsTotal * sizeof(PackedR8G8B8));
-
-        const bool bGenRef = false;
-        if (bGenRef) {
-            bool bGotBadVaue = false;
-
-            for (uint32_t i = 0; i < nPixelsTotal; ++i) {
-                uint16_t genVal = reinterpret_cast<const uint16_t *>(pMap)[i];
-                PackedR8G8B8 color;
-                if (genVal >= 4) {
-                    bGotBadVaue = true;
-                    color = { 0xff, 0xff, 0xff };
-                } else {
-                    color = ColorFromCoverageMask2[genVal];
-                }
-                pRgb[i] = color;
+        uint16_t *const pExpected = (uint16_t *)malloc(PackedImageByteSize);
+        PackedR8G8B8 *pRgb = nullptr; // only needed, and then shared, by failing sample counts
+
+        for (uint32_t i = 0; i < numSampleCounts; ++i) {
+            uint32_t const numSamples = sampleCounts[i];
+            const uint16_t *const pMasks = reinterpret_cast<const uint16_t *>(static_cast<const uint8_t *>(stage.pHost) + i * PackedImageByteSize);
+
+            // 2x keeps the name it had before the sweep, so existing golden manifests still apply:
+            char params[32] = "64x64_r16";
+            if (numSamples != 2) snprintf(params, sizeof params, "64x64_r16_%ux", numSamples);
+            GoldenResult const golden = GoldenCheck("ext_raster_multisample", params, pMasks, PackedImageByteSize);
+            ResultArchiveAddDesc archiveDesc = {
+                "ext_raster_multisample", params, Format, ImageSize.width, ImageSize.height, 1,
+                sizeof(uint16_t), pMasks, ImageSize.width * sizeof(uint16_t), false
+            };
+            if (golden == GoldenResult::Match) {
+                ResultArchiveAdd(archiveDesc); // nothing else to look at
+                continue;
             }
-            if (bGotBadVaue) {
-                puts("Got value outside of raster sample pattern!");
+
+            const RasterRefDesc refDesc = {
+                &Positions[0].x, lengthof(Positions) / 3, Viewport, ImageSize.width, ImageSize.height,
+                numSamples, nullptr, limits.subPixelPrecisionBits
+            };
+            if (!RasterRefCoverageXor(refDesc, pExpected)) {
+                bTestPassed = false;
+                archiveDesc.bFailed = true;
+                ResultArchiveAdd(archiveDesc);
+                continue;
             }
-            bTestPassed = !bGotBadVaue;
-            stbi_write_png("reference_2x.png", ImageSize.width, ImageSize.height, 3, pRgb, ImageSize.width * sizeof(PackedR8G8B8));
-        } else {
-            int w, h, ncomps;
-            void *const pRefData = stbi_load("reference_2x.png", &w, &h, &ncomps, 3);
-            if (pRefData && uint32_t(w) == ImageSize.width && uint32_t(h) == ImageSize.height && ncomps == 3) {
+
+            ImageCompareDesc compareDesc = { };
+            compareDesc.pGot = pMasks;
+            compareDesc.pExpected = pExpected;
+            compareDesc.width = ImageSize.width;
+            compareDesc.height = ImageSize.height;
+            compareDesc.bytesPerPixel = sizeof(uint16_t);
+            ImageCompareResult compareResult;
+            CompareImagesExact(compareDesc, &compareResult);
+            char what[64];
+            snprintf(what, sizeof what, "generated_%ux vs CPU reference", numSamples);
+            PrintImageCompareResult(what, compareResult);
+            bool const bPassed = (compareResult.numMismatches == 0); // the reference only holds masks in the pattern
+            printf("%2ux: %d pixels matching the CPU reference\n", numSamples, int(nPixelsTotal - compareResult.numMismatches));
+
+            archiveDesc.bFailed = !bPassed;
+            ResultArchiveAdd(archiveDesc);
+            if (bPassed) {
+                GoldenRecord("ext_raster_multisample", params, pMasks, PackedImageByteSize);
+            } else {
+                bTestPassed = false;
                 bool bGotBadVaue = false;
-                uint32_t nPixelsMatching = 0;
-                for (uint32_t i = 0; i < nPixelsTotal; ++i) {
-                    uint16_t genVal = reinterpret_cast<const uint16_t *>(pMap)[i];
-                    PackedR8G8B8 const refColor = reinterpret_cast<const PackedR8G8B8 *>(pRefData)[i];
-                    PackedR8G8B8 color;
-                    if (genVal >= 4) {
-                        bGotBadVaue = true;
-                        color = { 0xff, 0xff, 0xff };
-                    } else {
-                        color = ColorFromCoverageMask2[genVal];
-                    }
-                    pRgb[i] = color;
-                    nPixelsMatching += (refColor == color);
+                for (uint32_t p = 0; p < nPixelsTotal; ++p) {
+                    bGotBadVaue |= (pMasks[p] >> numSamples) != 0;
                 }
                 if (bGotBadVaue) {
                     puts("Got value outside of raster sample pattern!");
                 }
-                bTestPassed = !bGotBadVaue && (nPixelsMatching == nPixelsTotal);
-                printf("Num pixels matching ref image: %d\n", nPixelsMatching);
-                stbi_write_png("generated_2x.png", ImageSize.width, ImageSize.height, 3, pRgb, ImageSize.width * sizeof(PackedR8G8B8));
-            } else {
-                puts("Failed to load reference_2x.png from cwd.");
+                if (ResultArchiveIsOpen()) {
+                    printf("Result is archived as ext_raster_multisample/%s, not writing generated_%ux.png\n", params, numSamples);
+                } else {
+                    if (!pRgb) pRgb = (PackedR8G8B8 *)malloc(nPixelsTotal * sizeof(PackedR8G8B8));
+                    char path[64];
+                    snprintf(path, sizeof path, "generated_%ux.png", numSamples);
+                    WriteCoveragePng(path, pMasks, ImageSize.width, ImageSize.height, numSamples, pRgb);
+                    snprintf(path, sizeof path, "expected_%ux.png", numSamples);
+                    WriteCoveragePng(path, pExpected, ImageSize.width, ImageSize.height, numSamples, pRgb);
+                }
             }
         }
         free(pRgb);
+        free(pExpected);
     }
 
-    vkDestroyPipeline(device, pipeline, ALLOC_CBS);
+    for (uint32_t i = 0; i < numSampleCounts; ++i) {
+        vkDestroyPipeline(device, pipelines[i], ALLOC_CBS);
+    }
     vkDestroyPipelineLayout(device, pipelineLayout, ALLOC_CBS);
 
     vkFreeCommandBuffers(device, cmdpool, 1, &cmdbuf);
@@ -621,9 +694,631 @@ bool TestExtRasterMultisample(VkDevice device, VkQueue queue, uint32_t graphicsF
     vkDestroyFramebuffer(device, framebuffer, ALLOC_CBS);
     vkDestroyRenderPass(device, renderpass, ALLOC_CBS);
     DestroyImageAndFreeMemory(device, resource);
-    DestroyBufferAndFreeMemory(device, stage);
+    vkuDestroyStagingBuffer(device, stage);
     DestroyBufferAndFreeMemory(device, attribs);
 
     return bTestPassed;
 }
 
+
+// ---------------------------------------------------------------------------------------------------------------------
+// path_fill_bench
+
+/*
+// dxc -spirv -fspv-target-env=vulkan1.1 -T ps_6_0 fs.hlsl, same as the one in xfb_pingpong_bug.cpp
+void main(out float4 rtv0 : SV_Target)
+{
+    rtv0 = float4(1.0f, 0.5f, 0.25f, 1.0f);
+}
+*/
+static const uint32_t FsConstantColorSpirv[] =
+{
+0x7230203,0x10300,0xE0000,13,0,0x20011,1,0x3000E,0,1,0x6000F,4,1,0x6E69616D,0,2,0x30010,1,7,0x30003,5,0x258,
+0x70005,2,0x2E74756F,0x2E726176,0x545F5653,0x65677261,0x74,0x40005,1,0x6E69616D,0,0x40047,2,30,0,0x30016,3,32,
+0x4002B,3,4,0x3F800000,0x4002B,3,5,0x3F000000,0x4002B,3,6,0x3E800000,0x40017,7,3,4,0x7002C,7,8,4,5,6,4,0x40020,
+9,3,7,0x20013,10,0x30021,11,10,0x4003B,9,2,3,0x50036,10,1,0,11,0x200F8,12,0x3003E,2,8,0x100FD,0x10038
+};
+
+enum PathFillMode { PathFillForcedSamples, PathFillMsaa, PathFillMixedSamples, NumPathFillModes };
+static const char *const PathFillModeNames[NumPathFillModes] = { "forced", "msaa", "mixed" };
+
+enum PathFillPass { PathFillStencil, PathFillCover };
+
+/*
+ * Stencil-then-cover with the even-odd rule: the stencil pass inverts bit 0 for every sample a fan
+ * triangle covers without writing color, and the cover pass draws the path's bounding quad where
+ * bit 0 is set, zeroing it again for the next path. bCoverageModulation scales the color by the
+ * fraction of samples that pass, for a single sample color attachment with VK_NV_framebuffer_mixed_samples.
+ */
+static void
+CreatePathFillPipeline(VkDevice device, VkShaderModule vs, VkShaderModule fs, VkRenderPass renderpass,
+                       VkPipelineLayout pipelineLayout, VkSampleCountFlagBits rasterSamples, PathFillPass pass,
+                       bool bCoverageModulation, VkPipeline *pPipline)
+{
+    VkGraphicsPipelineCreateInfo info = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+
+    const VkPipelineShaderStageCreateInfo stages[] = {
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_VERTEX_BIT, vs, "main" },
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_FRAGMENT_BIT, fs, "main" },
+    };
+
+    static const VkDynamicState DynamicStateList[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+    static const VkPipelineDynamicStateCreateInfo DynamicStateInfo = {
+        VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        nullptr, 0,
+        lengthof(DynamicStateList), DynamicStateList
+    };
+
+    VkPipelineColorBlendAttachmentState attBlend = { };
+    attBlend.colorWriteMask = pass == PathFillCover ? 0xf : 0x0;
+    VkPipelineColorBlendStateCreateInfo blendState = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+    blendState.attachmentCount = 1;
+    blendState.pAttachments = &attBlend;
+
+    VkStencilOpState stencilOp = { };
+    stencilOp.compareMask = 1;
+    stencilOp.writeMask = 1;
+    stencilOp.reference = 0;
+    if (pass == PathFillStencil) {
+        stencilOp.compareOp = VK_COMPARE_OP_ALWAYS;
+        stencilOp.passOp = VK_STENCIL_OP_INVERT;
+    } else {
+        stencilOp.compareOp = VK_COMPARE_OP_NOT_EQUAL;
+        stencilOp.passOp = VK_STENCIL_OP_ZERO;
+    }
+    stencilOp.failOp = VK_STENCIL_OP_KEEP;
+    stencilOp.depthFailOp = VK_STENCIL_OP_KEEP;
+    VkPipelineDepthStencilStateCreateInfo depthStencil = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+    depthStencil.stencilTestEnable = VK_TRUE;
+    depthStencil.front = stencilOp;
+    depthStencil.back = stencilOp;
+
+    // Without a table, each component is multiplied by the fraction of raster samples covered:
+    const VkPipelineCoverageModulationStateCreateInfoNV coverageModulation = {
+        VK_STRUCTURE_TYPE_PIPELINE_COVERAGE_MODULATION_STATE_CREATE_INFO_NV, nullptr, 0,
+        VK_COVERAGE_MODULATION_MODE_RGBA_NV,
+        VK_FALSE, 0, nullptr
+    };
+    const VkPipelineMultisampleStateCreateInfo msaaInfo = {
+        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        bCoverageModulation ? &coverageModulation : nullptr,
+        0,
+        rasterSamples,
+        false, // sampleShadingEnable
+        0.0f,
+        nullptr
+    };
+
+    static const VkPipelineViewportStateCreateInfo SingleViewportInfo = {
+        VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        nullptr, 0,
+        1, nullptr,
+        1, nullptr
+    };
+
+    static const VkPipelineInputAssemblyStateCreateInfo TriangleListNoRestart = {
+        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        nullptr, 0,
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST
+    };
+
+    static const VkVertexInputAttributeDescription Attribs[] = {
+        // location, binding, format, offsetof in struct:
+        { 0, 0, VK_FORMAT_R32G32_SFLOAT, 0 },
+    };
+    static const VkVertexInputBindingDescription InputSlot0Info= {
+        // binding, stride, rate:
+        0, sizeof(float)*2, VK_VERTEX_INPUT_RATE_VERTEX
+    };
+    static const VkPipelineVertexInputStateCreateInfo VertexInputInfo = {
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        nullptr, 0,
+        1, &InputSlot0Info,
+        lengthof(Attribs), Attribs
+    };
+
+    VkPipelineRasterizationStateCreateInfo rast = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+    rast.polygonMode = VK_POLYGON_MODE_FILL;
+    rast.cullMode = VK_CULL_MODE_NONE;
+    rast.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rast.lineWidth = 1.0f;
+
+    info.basePipelineHandle = VK_NULL_HANDLE;
+    info.basePipelineIndex = -1;
+    info.layout = pipelineLayout;
+    info.renderPass = renderpass;
+    info.subpass = 0;
+
+    info.pTessellationState = nullptr;
+    info.pDynamicState = &DynamicStateInfo;
+    info.pViewportState = &SingleViewportInfo;
+    info.pColorBlendState = &blendState;
+    info.pDepthStencilState = &depthStencil;
+    info.pMultisampleState = &msaaInfo;
+    info.pInputAssemblyState = &TriangleListNoRestart;
+    info.pVertexInputState = &VertexInputInfo;
+    info.pRasterizationState = &rast;
+
+    info.stageCount = lengthof(stages);
+    info.pStages = stages;
+
+    VERIFY_VK(ShaderCacheCreateGraphicsPipeline(info, pPipline));
+}
+
+// First of S8, D24S8 and D32S8 usable as an optimal tiling stencil attachment, or VK_FORMAT_UNDEFINED.
+static VkFormat
+FindStencilFormat(VkPhysicalDevice physdev)
+{
+    static const VkFormat Candidates[] = {
+        VK_FORMAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D32_SFLOAT_S8_UINT
+    };
+    for (VkFormat format : Candidates) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physdev, format, &props);
+        if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            return format;
+        }
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+enum {
+    PathFillSize = 1024,        // width and height of the target
+    PathFillGrid = 32,          // paths per row and column, one per cell so that they don't overlap
+    PathFillStarPoints = 17,    // each path is a {17/7} star polygon
+    PathFillStarStep = 7,
+    PathFillFanTriangles = PathFillStarPoints - 2,
+    PathFillFanVerts = PathFillGrid * PathFillGrid * PathFillFanTriangles * 3,
+    PathFillCoverVerts = PathFillGrid * PathFillGrid * 6,
+    PathFillFrames = 16         // render passes per timing
+};
+
+/*
+ * Writes the fan triangles of every path, then the bounding quads, as NDC xy for the xy01 vertex shader.
+ * The fan of a polygon covers each point as many times as the polygon winds around it, so the
+ * parity of the triangles over a sample is the even-odd fill, the same in each mode.
+ */
+static void
+WritePathFillVertices(vec2f *pVerts)
+{
+    const float CellNdc = 2.0f / PathFillGrid;
+    const float RadiusNdc = CellNdc * 0.45f;
+    vec2f *pFan = pVerts;
+    vec2f *pCover = pVerts + PathFillFanVerts;
+    for (uint32_t cy = 0; cy < PathFillGrid; ++cy) {
+        for (uint32_t cx = 0; cx < PathFillGrid; ++cx) {
+            const vec2f c = { -1.0f + (cx + 0.5f) * CellNdc, -1.0f + (cy + 0.5f) * CellNdc };
+            // A different rotation per path, so that edges don't line up with the same samples in every cell:
+            float const rotation = float(cy * PathFillGrid + cx) * 0.37f;
+            vec2f star[PathFillStarPoints];
+            for (uint32_t i = 0; i < PathFillStarPoints; ++i) {
+                float const a = rotation + 6.2831853f * float(i * PathFillStarStep % PathFillStarPoints) / PathFillStarPoints;
+                star[i] = vec2f{ c.x + RadiusNdc * cosf(a), c.y + RadiusNdc * sinf(a) };
+            }
+            for (uint32_t i = 1; i + 1 < PathFillStarPoints; ++i) {
+                *pFan++ = star[0];
+                *pFan++ = star[i];
+                *pFan++ = star[i + 1];
+            }
+            const vec2f lo = { c.x - RadiusNdc, c.y - RadiusNdc };
+            const vec2f hi = { c.x + RadiusNdc, c.y + RadiusNdc };
+            const vec2f quad[6] = { lo, { hi.x, lo.y }, hi, lo, hi, { lo.x, hi.y } };
+            memcpy(pCover, quad, sizeof quad);
+            pCover += 6;
+        }
+    }
+}
+
+struct PathFillTargets {
+    ImageAndMemory images[3];
+    uint32_t numImages;
+    VkImageView views[3];
+    VkImage readbackImage; // single sample result: the mask, the resolve or the mixed sample color
+    VkRenderPass renderpass;
+    VkFramebuffer framebuffer;
+    VkDeviceSize attachmentBytes;
+};
+
+static void
+AddPathFillAttachment(VkDevice device, const VkPhysicalDeviceMemoryProperties& memProps, PathFillTargets *t,
+                      VkFormat format, VkSampleCountFlagBits samples, VkImageUsageFlags usage, VkImageAspectFlags aspect)
+{
+    VkImageCreateInfo imageInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = { PathFillSize, PathFillSize, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = samples;
+    imageInfo.usage = usage;
+    ImageAndMemory& image = t->images[t->numImages];
+    CreateImageAndMemory(device, memProps, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, imageInfo, &image);
+    VkMemoryRequirements reqs;
+    vkGetImageMemoryRequirements(device, image.image, &reqs);
+    t->attachmentBytes += reqs.size;
+
+    VkImageViewCreateInfo viewCreateInfo = {
+        VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        nullptr,
+        0, // VkImageViewCreateFlags
+        image.image,
+        VK_IMAGE_VIEW_TYPE_2D,
+        format,
+        VkComponentMapping(), // identity
+        { aspect, 0, 1, 0, 1 } // single mip, single layer
+    };
+    VERIFY_VK(vkCreateImageView(device, &viewCreateInfo, ALLOC_CBS, &t->views[t->numImages]));
+    if (samples == VK_SAMPLE_COUNT_1_BIT) {
+        t->readbackImage = image.image;
+    }
+    t->numImages++;
+}
+
+/*
+ * Attachments, in order:
+ *   forced: the R16_UINT mask, single sampled.
+ *   msaa:   RGBA8 color and stencil at the sample count, and the single sample RGBA8 resolve.
+ *   mixed:  single sample RGBA8 color and stencil at the sample count.
+ * Only the single sample image is stored, the rest only live for the render pass.
+ */
+static void
+CreatePathFillTargets(VkDevice device, const VkPhysicalDeviceMemoryProperties& memProps, PathFillMode mode,
+                      VkSampleCountFlagBits samples, VkFormat stencilFormat, PathFillTargets *t)
+{
+    *t = { };
+    VkImageUsageFlags const ResultUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    VkImageAspectFlags const stencilAspect = stencilFormat == VK_FORMAT_S8_UINT ? VK_IMAGE_ASPECT_STENCIL_BIT :
+                                             VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+
+    VkAttachmentDescription attDescs[3] = { };
+    VkAttachmentReference colorRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    VkAttachmentReference stencilRef = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+    VkAttachmentReference resolveRef = { 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    VkSubpassDescription subpassDesc = { };
+    subpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpassDesc.colorAttachmentCount = 1;
+    subpassDesc.pColorAttachments = &colorRef;
+
+    VkFormat const colorFormat = mode == PathFillForcedSamples ? VK_FORMAT_R16_UINT : VK_FORMAT_R8G8B8A8_UNORM;
+    VkSampleCountFlagBits const colorSamples = mode == PathFillMsaa ? samples : VK_SAMPLE_COUNT_1_BIT;
+    AddPathFillAttachment(device, memProps, t, colorFormat, colorSamples,
+                          colorSamples == VK_SAMPLE_COUNT_1_BIT ? ResultUsage : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+                          VK_IMAGE_ASPECT_COLOR_BIT);
+    if (mode != PathFillForcedSamples) {
+        AddPathFillAttachment(device, memProps, t, stencilFormat, samples, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, stencilAspect);
+        subpassDesc.pDepthStencilAttachment = &stencilRef;
+    }
+    if (mode == PathFillMsaa) {
+        AddPathFillAttachment(device, memProps, t, VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, ResultUsage, VK_IMAGE_ASPECT_COLOR_BIT);
+        subpassDesc.pResolveAttachments = &resolveRef;
+    }
+
+    for (uint32_t i = 0; i < t->numImages; ++i) {
+        VkAttachmentDescription& d = attDescs[i];
+        bool const bStored = (i == 0 && colorSamples == VK_SAMPLE_COUNT_1_BIT) || i == 2;
+        d.format = i == 0 ? colorFormat : i == 1 ? stencilFormat : VK_FORMAT_R8G8B8A8_UNORM;
+        d.samples = i == 0 ? colorSamples : i == 1 ? samples : VK_SAMPLE_COUNT_1_BIT;
+        d.loadOp = i == 0 ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        d.storeOp = bStored ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        d.stencilLoadOp = i == 1 ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        d.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        d.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        d.finalLayout = bStored ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL :
+                        i == 1 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+    // The layouts start UNDEFINED each pass, so the transitions themselves must wait on the previous frame's
+    // attachment writes and the readback copy, and the last pass's stored image must be visible to the copy:
+    VkPipelineStageFlags const AttachmentStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                                  VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    VkAccessFlags const AttachmentWrites = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    const VkSubpassDependency dependencies[2] = {
+        {
+            VK_SUBPASS_EXTERNAL, 0,
+            AttachmentStages | VK_PIPELINE_STAGE_TRANSFER_BIT, AttachmentStages,
+            AttachmentWrites,
+            AttachmentWrites | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+            0x0
+        },
+        {
+            0, VK_SUBPASS_EXTERNAL,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            0x0
+        },
+    };
+    VkRenderPassCreateInfo renderpassInfo = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO, nullptr, 0,
+        t->numImages, attDescs, 1, &subpassDesc,
+        lengthof(dependencies), dependencies
+    };
+    VERIFY_VK(vkCreateRenderPass(device, &renderpassInfo, ALLOC_CBS, &t->renderpass));
+
+    VkFramebufferCreateInfo framebufferInfo = {
+        VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO, nullptr, 0,
+        t->renderpass,
+        t->numImages, t->views,
+        PathFillSize, PathFillSize, 1
+    };
+    VERIFY_VK(vkCreateFramebuffer(device, &framebufferInfo, ALLOC_CBS, &t->framebuffer));
+}
+
+static void
+DestroyPathFillTargets(VkDevice device, const PathFillTargets& t)
+{
+    vkDestroyFramebuffer(device, t.framebuffer, ALLOC_CBS);
+    vkDestroyRenderPass(device, t.renderpass, ALLOC_CBS);
+    for (uint32_t i = 0; i < t.numImages; ++i) {
+        vkDestroyImageView(device, t.views[i], ALLOC_CBS);
+        DestroyImageAndFreeMemory(device, t.images[i]);
+    }
+}
+
+/*
+ * The RGBA8 result of msaa or mixed can't be compared exactly, how partly covered pixels resolve or
+ * modulate is up to the implementation, but pixels the reference leaves uncovered must stay clear
+ * and fully covered ones must have the whole color's red and alpha.
+ */
+static uint32_t
+CountPathFillColorMismatches(const uint8_t *pRgba, const uint16_t *pMasks, uint32_t numSamples)
+{
+    uint16_t const fullMask = uint16_t((1u << numSamples) - 1);
+    uint32_t numMismatches = 0;
+    for (uint32_t i = 0; i < PathFillSize * PathFillSize; ++i) {
+        const uint8_t *const p = pRgba + 4*i;
+        if (pMasks[i] == 0) {
+            numMismatches += (p[0] | p[1] | p[2] | p[3]) != 0;
+        } else if (pMasks[i] == fullMask) {
+            numMismatches += p[0] != 0xff || p[3] != 0xff;
+        }
+    }
+    return numMismatches;
+}
+
+/*
+ * Fill rate of anti-aliased paths drawn three ways, at each sample count in {2, 4, 8, 16} a way supports:
+ *   forced: the proposed VK_EXT_raster_multisample, rasterizing at the sample count into a single
+ *           sample target with the XOR of SampleMask, so one pass leaves each pixel's even-odd mask.
+ *           This is only the coverage step, a TIR renderer would then cover each path reading the mask.
+ *   msaa:   stencil-then-cover into a multisampled color and stencil, resolved to a single sample.
+ *   mixed:  stencil-then-cover with VK_NV_framebuffer_mixed_samples, a multisampled stencil and a
+ *           single sample color modulated by the fraction of samples covered.
+ * Each timing is PathFillFrames render passes of PathFillGrid^2 non-overlapping star polygons
+ * drawn as fans, and pixels per second counts the whole target once per frame. Attachment bytes are
+ * the memory requirements of every attachment a way needs. The forced masks are compared against the
+ * CPU rasterizer, the msaa and mixed colors are checked where the reference is fully in or out.
+ */
+bool TestPathFillBench(const VulkanObjetcs& vk)
+{
+    VkDevice const device = vk.device;
+    VkQueue const queue = vk.universalQueue;
+    const VkPhysicalDeviceMemoryProperties& memProps = vk.memProps;
+    const VkPhysicalDeviceLimits& limits = vk.props2.properties.limits;
+    if (!limits.timestampComputeAndGraphics) {
+        puts("ERROR: timestamps are not supported.");
+        return false;
+    }
+    double const nsPerTick = limits.timestampPeriod;
+
+    VkFormat const stencilFormat = FindStencilFormat(vk.physicalDevice);
+    if (stencilFormat == VK_FORMAT_UNDEFINED) {
+        puts("NOTE: no stencil attachment format, skipping msaa and mixed.");
+    }
+    if (!vk.NV_framebuffer_mixed_samples) {
+        puts("NOTE: VK_NV_framebuffer_mixed_samples is not supported, skipping mixed.");
+    }
+    if (!limits.standardSampleLocations) {
+        puts("NOTE: the device doesn't use the standard sample locations, the CPU reference will likely not match.");
+    }
+
+    VkCommandPool cmdpool = VK_NULL_HANDLE;
+    VkCommandBuffer cmdbuf = VK_NULL_HANDLE;
+    {
+        const VkCommandPoolCreateInfo cmdPoolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr,
+            0, // flags
+            vk.universalFamilyIndex
+        };
+        VERIFY_VK(vkCreateCommandPool(device, &cmdPoolInfo, ALLOC_CBS, &cmdpool));
+
+        const VkCommandBufferAllocateInfo cmdBufAllocInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr, cmdpool,
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            1 // commandBufferCount
+        };
+        VERIFY_VK(vkAllocateCommandBuffers(device, &cmdBufAllocInfo, &cmdbuf));
+    }
+
+    const uint32_t VertexBytes = (PathFillFanVerts + PathFillCoverVerts) * sizeof(vec2f);
+    vec2f *const pVerts = (vec2f *)malloc(VertexBytes);
+    WritePathFillVertices(pVerts);
+    BufferAndMemory attribs;
+    {
+        CreateBufferAndMemory(device, memProps,
+                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                              VertexBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &attribs);
+        void *pAttribData;
+        VERIFY_VK(vkMapMemory(device, attribs.memory, 0, VK_WHOLE_SIZE, 0, &pAttribData));
+        memcpy(pAttribData, pVerts, VertexBytes);
+    }
+
+    const uint32_t nPixelsTotal = PathFillSize * PathFillSize;
+    VkuStagingBuffer stage;
+    VERIFY_VK(vkuStagingBuffer(device, nPixelsTotal * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               &stage, memProps, HostImportAlignment(vk, g_bHostImportStaging)));
+
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    {
+        // no descriptors or push constants:
+        VkPipelineLayoutCreateInfo info = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        VERIFY_VK(vkCreatePipelineLayout(device, &info, ALLOC_CBS, &pipelineLayout));
+    }
+    VkShaderModule vs, fsMask, fsColor;
+    VERIFY_VK(ShaderCacheAcquire(VsSpirv, &vs));
+    VERIFY_VK(ShaderCacheAcquire(FsSpirv, &fsMask));
+    VERIFY_VK(ShaderCacheAcquire(FsConstantColorSpirv, &fsColor));
+
+    VkQueryPool timestampPool = VK_NULL_HANDLE;
+    {
+        VkQueryPoolCreateInfo info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        info.queryCount = 2;
+        VERIFY_VK(vkCreateQueryPool(device, &info, ALLOC_CBS, &timestampPool));
+    }
+
+    const VkRect2D RenderArea = { { 0, 0 }, { PathFillSize, PathFillSize } };
+    VkViewport Viewport;
+    vkuUpwardsViewportFromRect(RenderArea, 0, 1, &Viewport);
+
+    printf("%ux%u target, %u paths of %u fan triangles, %u frames per timing, verified with the %s CPU rasterizer:\n",
+           PathFillSize, PathFillSize, PathFillGrid * PathFillGrid, PathFillFanTriangles, PathFillFrames, RasterRefKernelName());
+    printf("  %-8s %7s %10s %10s %16s\n", "mode", "samples", "GPU ms", "Mpix/s", "attachment MiB");
+
+    static const VkSampleCountFlagBits SweepSampleCounts[] = {
+        VK_SAMPLE_COUNT_2_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_16_BIT
+    };
+    uint16_t *const pExpected = (uint16_t *)malloc(nPixelsTotal * sizeof(uint16_t));
+    bool bTestPassed = true;
+    for (VkSampleCountFlagBits samples : SweepSampleCounts) {
+        bool bSupported[NumPathFillModes];
+        bSupported[PathFillForcedSamples] = (limits.framebufferNoAttachmentsSampleCounts & samples) != 0;
+        bSupported[PathFillMsaa] = stencilFormat != VK_FORMAT_UNDEFINED &&
+                                   (limits.framebufferColorSampleCounts & limits.framebufferStencilSampleCounts & samples) != 0;
+        bSupported[PathFillMixedSamples] = stencilFormat != VK_FORMAT_UNDEFINED && vk.NV_framebuffer_mixed_samples &&
+                                           (limits.framebufferStencilSampleCounts & samples) != 0;
+        if (!bSupported[PathFillForcedSamples] && !bSupported[PathFillMsaa] && !bSupported[PathFillMixedSamples]) {
+            continue;
+        }
+        const RasterRefDesc refDesc = {
+            &pVerts[0].x, PathFillFanVerts / 3, Viewport, PathFillSize, PathFillSize,
+            samples, nullptr, limits.subPixelPrecisionBits
+        };
+        if (!RasterRefCoverageXor(refDesc, pExpected)) {
+            bTestPassed = false;
+            continue;
+        }
+
+        for (uint32_t m = 0; m < NumPathFillModes; ++m) {
+            PathFillMode const mode = PathFillMode(m);
+            if (!bSupported[mode]) {
+                printf("  %-8s %6ux %10s\n", PathFillModeNames[mode], uint32_t(samples), "n/a");
+                continue;
+            }
+            PathFillTargets targets;
+            CreatePathFillTargets(device, memProps, mode, samples, stencilFormat, &targets);
+            VkPipeline pipelines[2] = { }; // [PathFillPass], forced only has one
+            if (mode == PathFillForcedSamples) {
+                CreateExtRasterMultisamplePipeline(device, vs, fsMask, targets.renderpass, pipelineLayout, samples, &pipelines[0]);
+            } else {
+                for (uint32_t p = 0; p < 2; ++p) {
+                    CreatePathFillPipeline(device, vs, fsColor, targets.renderpass, pipelineLayout, samples, PathFillPass(p),
+                                           mode == PathFillMixedSamples, &pipelines[p]);
+                }
+            }
+
+            const VkCommandBufferBeginInfo cmdBufbeginInfo = {
+                VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+                VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr
+            };
+            VERIFY_VK(vkBeginCommandBuffer(cmdbuf, &cmdBufbeginInfo));
+            vkCmdResetQueryPool(cmdbuf, timestampPool, 0, 2);
+            VkMemoryBarrier memBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+            VkClearValue clearValues[3] = { };
+            const VkRenderPassBeginInfo rpBeginInfo = {
+                VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO, nullptr,
+                targets.renderpass, targets.framebuffer, RenderArea,
+                targets.numImages, clearValues
+            };
+            VkDeviceSize offsets[1] = { };
+
+            vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, 0);
+            // The render pass's external dependencies order each frame after the previous one, and the copy after the last:
+            for (uint32_t frame = 0; frame < PathFillFrames; ++frame) {
+                vkCmdBeginRenderPass(cmdbuf, &rpBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+                vkCmdSetViewport(cmdbuf, 0, 1, &Viewport);
+                vkCmdSetScissor(cmdbuf, 0, 1, &RenderArea);
+                vkCmdBindVertexBuffers(cmdbuf, 0, 1, &attribs.buffer, offsets);
+                vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[0]);
+                vkCmdDraw(cmdbuf, PathFillFanVerts, 1, 0, 0);
+                if (mode != PathFillForcedSamples) {
+                    // The paths don't overlap, so all the stencil fans can go before all the covers:
+                    vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[1]);
+                    vkCmdDraw(cmdbuf, PathFillCoverVerts, 1, PathFillFanVerts, 0);
+                }
+                vkCmdEndRenderPass(cmdbuf);
+            }
+            vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, 1);
+
+            uint32_t const bytesPerPixel = mode == PathFillForcedSamples ? sizeof(uint16_t) : 4;
+            VkBufferImageCopy bufImgCopy = { };
+            bufImgCopy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 }; // mip, layer{begin, count}
+            bufImgCopy.imageExtent = { PathFillSize, PathFillSize, 1 };
+            bufImgCopy.bufferRowLength = PathFillSize;
+            bufImgCopy.bufferImageHeight = PathFillSize;
+            vkCmdCopyImageToBuffer(cmdbuf, targets.readbackImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stage.buffer, 1, &bufImgCopy);
+            memBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            memBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0x0,
+                                 1, &memBarrier, 0, nullptr, 0 , nullptr);
+            VERIFY_VK(vkEndCommandBuffer(cmdbuf));
+
+            VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &cmdbuf;
+            VERIFY_VK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+            VERIFY_VK(vkQueueWaitIdle(queue));
+            VERIFY_VK(vkResetCommandPool(device, cmdpool, 0x0));
+            vkuInvalidateStagingBuffer(device, stage);
+
+            uint64_t ticks[2];
+            VERIFY_VK(vkGetQueryPoolResults(device, timestampPool, 0, 2, sizeof ticks, ticks, sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+            double const ms = double(ticks[1] - ticks[0]) * nsPerTick * 1e-6;
+            double const mpixPerSec = double(nPixelsTotal) * PathFillFrames / (ms * 1e3);
+            printf("  %-8s %6ux %10.3f %10.1f %16.2f\n", PathFillModeNames[mode], uint32_t(samples), ms, mpixPerSec,
+                   targets.attachmentBytes / 1048576.0);
+
+            char what[64];
+            snprintf(what, sizeof what, "%s %ux vs CPU reference", PathFillModeNames[mode], uint32_t(samples));
+            if (mode == PathFillForcedSamples) {
+                ImageCompareDesc compareDesc = { };
+                compareDesc.pGot = stage.pHost;
+                compareDesc.pExpected = pExpected;
+                compareDesc.width = PathFillSize;
+                compareDesc.height = PathFillSize;
+                compareDesc.bytesPerPixel = bytesPerPixel;
+                ImageCompareResult compareResult;
+                CompareImagesExact(compareDesc, &compareResult);
+                PrintImageCompareResult(what, compareResult);
+                bTestPassed &= compareResult.numMismatches == 0;
+            } else {
+                uint32_t const numMismatches = CountPathFillColorMismatches(static_cast<const uint8_t *>(stage.pHost), pExpected, samples);
+                if (numMismatches != 0) {
+                    printf("%s: %u pixels fully in or out of the paths have the wrong color\n", what, numMismatches);
+                    bTestPassed = false;
+                }
+            }
+
+            for (VkPipeline pipeline : pipelines) {
+                vkDestroyPipeline(device, pipeline, ALLOC_CBS);
+            }
+            DestroyPathFillTargets(device, targets);
+        }
+    }
+    free(pExpected);
+
+    vkDestroyQueryPool(device, timestampPool, ALLOC_CBS);
+    ShaderCacheRelease(vs);
+    ShaderCacheRelease(fsMask);
+    ShaderCacheRelease(fsColor);
+    vkDestroyPipelineLayout(device, pipelineLayout, ALLOC_CBS);
+    vkFreeCommandBuffers(device, cmdpool, 1, &cmdbuf);
+    vkDestroyCommandPool(device, cmdpool, ALLOC_CBS);
+    vkuDestroyStagingBuffer(device, stage);
+    DestroyBufferAndFreeMemory(device, attribs);
+    free(pVerts);
+
+    return bTestPassed;
+}
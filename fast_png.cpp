@@ -0,0 +1,743 @@
+#include "fast_png.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FAST_PNG_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define FAST_PNG_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+enum {
+    WindowSize = 32768,
+    MinMatch = 4,
+    MaxMatch = 258,
+    HashBits = 15,
+    BlockTokens = 1 << 16,
+    MaxStoredLen = 65535,
+
+    NumLitLenSyms = 286,
+    NumDistSyms = 30,
+    NumCodeLenSyms = 19,
+};
+
+// Tokens: a literal byte, or MatchFlag | (length - 3) << 16 | (distance - 1).
+static const uint32_t MatchFlag = 0x80000000u;
+
+static const uint16_t LenBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LenExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DistBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+    4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DistExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t CodeLenOrder[NumCodeLenSyms] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+struct PngTables {
+    uint8_t lenCode[256];  // indexed by length - 3
+    uint8_t distCode[512]; // see DistCodeOf
+    uint8_t fixedLitLen[288];
+    uint16_t fixedLitCode[288];
+    uint8_t fixedDistLen[NumDistSyms];
+    uint16_t fixedDistCode[NumDistSyms];
+    uint32_t crc[8][256];  // slice-by-8
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Filter kernels, dst = a - b bytewise:
+
+#if FAST_PNG_SSE2
+static void
+SubtractBytes(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m128i const a0 = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i const a1 = _mm_loadu_si128((const __m128i *)(a + i + 16));
+        __m128i const b0 = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i const b1 = _mm_loadu_si128((const __m128i *)(b + i + 16));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_sub_epi8(a0, b0));
+        _mm_storeu_si128((__m128i *)(dst + i + 16), _mm_sub_epi8(a1, b1));
+    }
+    for (; i < n; ++i) dst[i] = uint8_t(a[i] - b[i]);
+}
+#define FAST_PNG_KERNEL_NAME "sse2"
+#elif FAST_PNG_NEON
+static void
+SubtractBytes(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        vst1q_u8(dst + i, vsubq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+        vst1q_u8(dst + i + 16, vsubq_u8(vld1q_u8(a + i + 16), vld1q_u8(b + i + 16)));
+    }
+    for (; i < n; ++i) dst[i] = uint8_t(a[i] - b[i]);
+}
+#define FAST_PNG_KERNEL_NAME "neon"
+#else
+static void
+SubtractBytes(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) dst[i] = uint8_t(a[i] - b[i]);
+}
+#define FAST_PNG_KERNEL_NAME "scalar"
+#endif
+
+const char *
+FastPngKernelName()
+{
+    return FAST_PNG_KERNEL_NAME;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+static void BuildCodes(const uint8_t *lengths, unsigned numSyms, uint16_t *codes);
+
+static void
+InitTables(PngTables *t)
+{
+    for (unsigned c = 0; c < 29; ++c) {
+        for (unsigned k = 0; k < (1u << LenExtra[c]); ++k) {
+            t->lenCode[LenBase[c] - 3 + k] = uint8_t(c);
+        }
+    }
+    t->lenCode[MaxMatch - 3] = 28; // 258 has its own code, and isn't the last length of code 27
+
+    for (unsigned c = 0; c < NumDistSyms; ++c) {
+        for (unsigned k = 0; k < (1u << DistExtra[c]); ++k) {
+            unsigned const d = DistBase[c] - 1 + k;
+            if (d < 256) t->distCode[d] = uint8_t(c);
+            else t->distCode[256 + (d >> 7)] = uint8_t(c);
+        }
+    }
+
+    for (unsigned i = 0; i < 288; ++i) {
+        t->fixedLitLen[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+    }
+    BuildCodes(t->fixedLitLen, 288, t->fixedLitCode);
+    memset(t->fixedDistLen, 5, sizeof t->fixedDistLen);
+    BuildCodes(t->fixedDistLen, NumDistSyms, t->fixedDistCode);
+
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1)));
+        t->crc[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+        for (int s = 1; s < 8; ++s) {
+            t->crc[s][i] = (t->crc[s - 1][i] >> 8) ^ t->crc[0][t->crc[s - 1][i] & 0xFF];
+        }
+    }
+}
+
+static const PngTables&
+GetTables()
+{
+    struct Holder {
+        PngTables t;
+        Holder() { InitTables(&t); }
+    };
+    static const Holder s_holder; // thread-safe init, the artifact writer encodes from several threads
+    return s_holder.t;
+}
+
+static inline unsigned
+DistCodeOf(const PngTables& t, unsigned dist)
+{
+    unsigned const d = dist - 1;
+    return d < 256 ? t.distCode[d] : t.distCode[256 + (d >> 7)];
+}
+
+static inline uint32_t
+Load32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint64_t
+Load64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline unsigned
+CountTrailingZeros64(uint64_t x)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return unsigned(i);
+#else
+    return unsigned(__builtin_ctzll(x));
+#endif
+}
+
+static inline void
+StoreBE32(uint8_t *p, uint32_t v)
+{
+    p[0] = uint8_t(v >> 24);
+    p[1] = uint8_t(v >> 16);
+    p[2] = uint8_t(v >> 8);
+    p[3] = uint8_t(v);
+}
+
+// Number of equal bytes at a and b, up to maxLen:
+static inline unsigned
+MatchLength(const uint8_t *a, const uint8_t *b, unsigned maxLen)
+{
+    unsigned n = 0;
+    for (; n + 8 <= maxLen; n += 8) {
+        uint64_t const x = Load64(a + n) ^ Load64(b + n);
+        if (x) return n + CountTrailingZeros64(x) / 8; // little endian
+    }
+    while (n < maxLen && a[n] == b[n]) ++n;
+    return n;
+}
+
+static uint32_t
+Crc32(const PngTables& t, uint32_t crc, const uint8_t *p, size_t n)
+{
+    crc = ~crc;
+    for (; n >= 8; n -= 8, p += 8) {
+        uint32_t const lo = Load32(p) ^ crc;
+        uint32_t const hi = Load32(p + 4);
+        crc = t.crc[7][lo & 0xFF] ^ t.crc[6][(lo >> 8) & 0xFF] ^ t.crc[5][(lo >> 16) & 0xFF] ^ t.crc[4][lo >> 24] ^
+              t.crc[3][hi & 0xFF] ^ t.crc[2][(hi >> 8) & 0xFF] ^ t.crc[1][(hi >> 16) & 0xFF] ^ t.crc[0][hi >> 24];
+    }
+    for (; n; --n) crc = (crc >> 8) ^ t.crc[0][(crc ^ *p++) & 0xFF];
+    return ~crc;
+}
+
+static uint32_t
+Adler32(const uint8_t *p, size_t n)
+{
+    uint32_t a = 1, b = 0;
+    while (n) {
+        size_t k = n < 5552 ? n : 5552; // largest run before b can overflow
+        n -= k;
+        for (; k >= 8; k -= 8, p += 8) {
+            a += p[0]; b += a; a += p[1]; b += a; a += p[2]; b += a; a += p[3]; b += a;
+            a += p[4]; b += a; a += p[5]; b += a; a += p[6]; b += a; a += p[7]; b += a;
+        }
+        for (; k; --k) {
+            a += *p++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Huffman codes:
+
+static int
+CompareU32(const void *a, const void *b)
+{
+    uint32_t const x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Length-limited code lengths for the symbols with nonzero freq, at least one code is always used.
+static void
+BuildCodeLengths(const uint32_t *freq, unsigned numSyms, unsigned maxLen, uint8_t *lengths)
+{
+    enum { MaxSyms = 288 };
+    assert(numSyms <= MaxSyms);
+    uint32_t sorted[MaxSyms]; // freq << 9 | sym, freqs here are at most BlockTokens + 1
+    unsigned n = 0;
+    memset(lengths, 0, numSyms);
+    for (unsigned s = 0; s < numSyms; ++s) {
+        if (freq[s]) sorted[n++] = (freq[s] << 9) | s;
+    }
+    if (n == 0) return;
+    if (n == 1) {
+        lengths[sorted[0] & 511] = 1;
+        return;
+    }
+    qsort(sorted, n, sizeof sorted[0], CompareU32);
+
+    // Leaves are sorted and internal nodes are made in increasing weight, so two queues find the minimums:
+    uint32_t weight[2 * MaxSyms];
+    uint16_t parent[2 * MaxSyms];
+    for (unsigned i = 0; i < n; ++i) weight[i] = sorted[i] >> 9;
+    unsigned nextLeaf = 0, nextNode = n;
+    for (unsigned k = n; k < 2 * n - 1; ++k) {
+        unsigned pick[2];
+        for (unsigned j = 0; j < 2; ++j) {
+            if (nextLeaf < n && (nextNode >= k || weight[nextLeaf] <= weight[nextNode])) pick[j] = nextLeaf++;
+            else pick[j] = nextNode++;
+        }
+        weight[k] = weight[pick[0]] + weight[pick[1]];
+        parent[pick[0]] = parent[pick[1]] = uint16_t(k);
+    }
+
+    // Parents always come after their children, so depths can be filled from the root down:
+    unsigned numAtLen[2 * MaxSyms] = {};
+    unsigned depth[2 * MaxSyms];
+    depth[2 * n - 2] = 0;
+    for (unsigned i = 2 * n - 2; i-- > 0;) {
+        depth[i] = depth[parent[i]] + 1;
+    }
+    for (unsigned i = 0; i < n; ++i) {
+        numAtLen[depth[i] < maxLen ? depth[i] : maxLen]++;
+    }
+
+    // Clamping made the code oversubscribed, lengthen short codes until the Kraft sum is exact again:
+    uint32_t total = 0;
+    for (unsigned len = 1; len <= maxLen; ++len) total += numAtLen[len] << (maxLen - len);
+    while (total != (1u << maxLen)) {
+        numAtLen[maxLen]--;
+        for (unsigned len = maxLen - 1; len > 0; --len) {
+            if (numAtLen[len]) {
+                numAtLen[len]--;
+                numAtLen[len + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    // Rarest symbols get the longest codes:
+    unsigned i = 0;
+    for (unsigned len = maxLen; len > 0; --len) {
+        for (unsigned c = numAtLen[len]; c; --c) lengths[sorted[i++] & 511] = uint8_t(len);
+    }
+}
+
+// Canonical codes, bit reversed since deflate sends Huffman codes MSB first into an LSB first stream.
+static void
+BuildCodes(const uint8_t *lengths, unsigned numSyms, uint16_t *codes)
+{
+    unsigned numAtLen[16] = {};
+    for (unsigned s = 0; s < numSyms; ++s) numAtLen[lengths[s]]++;
+    numAtLen[0] = 0;
+    unsigned next[16];
+    unsigned code = 0;
+    for (unsigned len = 1; len < 16; ++len) {
+        code = (code + numAtLen[len - 1]) << 1;
+        next[len] = code;
+    }
+    for (unsigned s = 0; s < numSyms; ++s) {
+        unsigned const len = lengths[s];
+        if (!len) {
+            codes[s] = 0;
+            continue;
+        }
+        unsigned c = next[len]++, r = 0;
+        for (unsigned k = 0; k < len; ++k, c >>= 1) r = (r << 1) | (c & 1);
+        codes[s] = uint16_t(r);
+    }
+}
+
+// zlib rejects incomplete distance and code length codes, a lone code gets a partner:
+static void
+MakeComplete(uint8_t *lengths, unsigned numSyms)
+{
+    unsigned used = 0, last = 0;
+    for (unsigned s = 0; s < numSyms; ++s) {
+        if (lengths[s]) {
+            used++;
+            last = s;
+        }
+    }
+    if (used == 0) {
+        lengths[0] = lengths[1] = 1;
+    } else if (used == 1) {
+        lengths[last == 0 ? 1 : 0] = 1;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Bit output:
+
+struct BitWriter {
+    uint8_t *p;
+    uint64_t bits;
+    unsigned numBits;
+};
+
+static inline void
+PutBits(BitWriter *w, uint32_t v, unsigned n)
+{
+    w->bits |= uint64_t(v) << w->numBits;
+    w->numBits += n;
+    if (w->numBits >= 32) {
+        uint32_t const lo = uint32_t(w->bits);
+        w->p[0] = uint8_t(lo);
+        w->p[1] = uint8_t(lo >> 8);
+        w->p[2] = uint8_t(lo >> 16);
+        w->p[3] = uint8_t(lo >> 24);
+        w->p += 4;
+        w->bits >>= 32;
+        w->numBits -= 32;
+    }
+}
+
+// Pads to a byte boundary and writes out everything pending.
+static void
+FlushBits(BitWriter *w)
+{
+    for (; w->numBits > 0; w->numBits = w->numBits > 8 ? w->numBits - 8 : 0) {
+        *w->p++ = uint8_t(w->bits);
+        w->bits >>= 8;
+    }
+    w->bits = 0;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Deflate:
+
+struct BlockStats {
+    uint32_t litFreq[NumLitLenSyms];
+    uint32_t distFreq[NumDistSyms];
+    uint64_t extraBits; // length and distance extra bits, the same for every block type
+};
+
+static void
+WriteTokens(BitWriter *w, const PngTables& t, const uint32_t *tokens, unsigned numTokens,
+            const uint8_t *litLen, const uint16_t *litCode, const uint8_t *distLen, const uint16_t *distCode)
+{
+    for (unsigned i = 0; i < numTokens; ++i) {
+        uint32_t const tok = tokens[i];
+        if (!(tok & MatchFlag)) {
+            PutBits(w, litCode[tok], litLen[tok]);
+            continue;
+        }
+        unsigned const len = ((tok >> 16) & 0xFF) + 3;
+        unsigned const dist = (tok & 0x7FFF) + 1;
+        unsigned const lc = t.lenCode[len - 3];
+        PutBits(w, litCode[257 + lc], litLen[257 + lc]);
+        if (LenExtra[lc]) PutBits(w, len - LenBase[lc], LenExtra[lc]);
+        unsigned const dc = DistCodeOf(t, dist);
+        PutBits(w, distCode[dc], distLen[dc]);
+        if (DistExtra[dc]) PutBits(w, dist - DistBase[dc], DistExtra[dc]);
+    }
+    PutBits(w, litCode[256], litLen[256]);
+}
+
+struct CodeLenRun {
+    uint8_t sym;   // 0-18
+    uint8_t extra; // value of the repeat count bits
+};
+
+static unsigned
+RunLengthCodeLengths(const uint8_t *lens, unsigned n, CodeLenRun *runs)
+{
+    unsigned numRuns = 0;
+    for (unsigned i = 0; i < n;) {
+        uint8_t const v = lens[i];
+        unsigned run = 1;
+        while (i + run < n && lens[i + run] == v) ++run;
+        i += run;
+        if (v == 0) {
+            for (; run >= 11; ) {
+                unsigned const r = run < 138 ? run : 138;
+                runs[numRuns++] = { 18, uint8_t(r - 11) };
+                run -= r;
+            }
+            if (run >= 3) {
+                runs[numRuns++] = { 17, uint8_t(run - 3) };
+                run = 0;
+            }
+        } else {
+            runs[numRuns++] = { v, 0 };
+            run--;
+            for (; run >= 3; ) {
+                unsigned const r = run < 6 ? run : 6;
+                runs[numRuns++] = { 16, uint8_t(r - 3) };
+                run -= r;
+            }
+        }
+        for (; run; --run) runs[numRuns++] = { v, 0 };
+    }
+    return numRuns;
+}
+
+static const uint8_t CodeLenExtraBits[NumCodeLenSyms] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7 };
+
+/*
+ * Writes the tokens of src[blockBegin, blockEnd) as whichever of a dynamic, fixed or stored block is smallest.
+ * The stored estimate assumes the worst padding, which is what FastPngEncode sizes the output for.
+ */
+static void
+WriteBlock(BitWriter *w, const PngTables& t, const uint8_t *src, size_t blockBegin, size_t blockEnd,
+           const uint32_t *tokens, unsigned numTokens, BlockStats *stats, bool bFinal)
+{
+    stats->litFreq[256] = 1;
+
+    uint8_t litLen[NumLitLenSyms], distLen[NumDistSyms];
+    BuildCodeLengths(stats->litFreq, NumLitLenSyms, 15, litLen);
+    BuildCodeLengths(stats->distFreq, NumDistSyms, 15, distLen);
+    MakeComplete(distLen, NumDistSyms);
+
+    unsigned numLit = NumLitLenSyms, numDist = NumDistSyms;
+    while (numLit > 257 && !litLen[numLit - 1]) --numLit;
+    while (numDist > 1 && !distLen[numDist - 1]) --numDist;
+
+    uint8_t allLens[NumLitLenSyms + NumDistSyms];
+    memcpy(allLens, litLen, numLit);
+    memcpy(allLens + numLit, distLen, numDist);
+    CodeLenRun runs[NumLitLenSyms + NumDistSyms];
+    unsigned const numRuns = RunLengthCodeLengths(allLens, numLit + numDist, runs);
+
+    uint32_t clFreq[NumCodeLenSyms] = {};
+    for (unsigned i = 0; i < numRuns; ++i) clFreq[runs[i].sym]++;
+    uint8_t clLen[NumCodeLenSyms];
+    BuildCodeLengths(clFreq, NumCodeLenSyms, 7, clLen);
+    MakeComplete(clLen, NumCodeLenSyms);
+    unsigned numCl = NumCodeLenSyms;
+    while (numCl > 4 && !clLen[CodeLenOrder[numCl - 1]]) --numCl;
+
+    uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3 * numCl + stats->extraBits;
+    uint64_t fixedBits = 3 + stats->extraBits;
+    for (unsigned i = 0; i < numRuns; ++i) dynamicBits += clLen[runs[i].sym] + CodeLenExtraBits[runs[i].sym];
+    for (unsigned s = 0; s < NumLitLenSyms; ++s) {
+        dynamicBits += uint64_t(stats->litFreq[s]) * litLen[s];
+        fixedBits += uint64_t(stats->litFreq[s]) * t.fixedLitLen[s];
+    }
+    for (unsigned s = 0; s < NumDistSyms; ++s) {
+        dynamicBits += uint64_t(stats->distFreq[s]) * distLen[s];
+        fixedBits += uint64_t(stats->distFreq[s]) * 5;
+    }
+    size_t const rawBytes = blockEnd - blockBegin;
+    uint64_t const numStored = (rawBytes + MaxStoredLen - 1) / MaxStoredLen;
+    uint64_t const storedBits = (numStored ? numStored : 1) * (3 + 7 + 32) + 8 * uint64_t(rawBytes);
+
+    if (storedBits <= dynamicBits && storedBits <= fixedBits) {
+        size_t pos = blockBegin;
+        do {
+            size_t const len = blockEnd - pos < size_t(MaxStoredLen) ? blockEnd - pos : size_t(MaxStoredLen);
+            PutBits(w, (bFinal && pos + len == blockEnd) ? 1 : 0, 3); // BTYPE 00
+            FlushBits(w);
+            w->p[0] = uint8_t(len);
+            w->p[1] = uint8_t(len >> 8);
+            w->p[2] = uint8_t(~len);
+            w->p[3] = uint8_t(~len >> 8);
+            memcpy(w->p + 4, src + pos, len);
+            w->p += 4 + len;
+            pos += len;
+        } while (pos < blockEnd);
+    } else if (fixedBits <= dynamicBits) {
+        PutBits(w, (bFinal ? 1 : 0) | (1 << 1), 3);
+        WriteTokens(w, t, tokens, numTokens, t.fixedLitLen, t.fixedLitCode, t.fixedDistLen, t.fixedDistCode);
+    } else {
+        uint16_t litCode[NumLitLenSyms], distCode[NumDistSyms], clCode[NumCodeLenSyms];
+        BuildCodes(litLen, NumLitLenSyms, litCode);
+        BuildCodes(distLen, NumDistSyms, distCode);
+        BuildCodes(clLen, NumCodeLenSyms, clCode);
+        PutBits(w, (bFinal ? 1 : 0) | (2 << 1), 3);
+        PutBits(w, numLit - 257, 5);
+        PutBits(w, numDist - 1, 5);
+        PutBits(w, numCl - 4, 4);
+        for (unsigned i = 0; i < numCl; ++i) PutBits(w, clLen[CodeLenOrder[i]], 3);
+        for (unsigned i = 0; i < numRuns; ++i) {
+            unsigned const sym = runs[i].sym;
+            PutBits(w, clCode[sym], clLen[sym]);
+            if (CodeLenExtraBits[sym]) PutBits(w, runs[i].extra, CodeLenExtraBits[sym]);
+        }
+        WriteTokens(w, t, tokens, numTokens, litLen, litCode, distLen, distCode);
+    }
+}
+
+// Upper bound for Deflate's output, every block can fall back to stored:
+static size_t
+DeflateBound(size_t n)
+{
+    return n + (n / MaxStoredLen + 2) * 6 + (n / BlockTokens + 2) * 8 + 16;
+}
+
+// Raw deflate stream of src into dst (at least DeflateBound(n) bytes). Returns the number of bytes written.
+static size_t
+Deflate(const PngTables& t, const uint8_t *src, size_t n, uint8_t *dst)
+{
+    int32_t *const head = (int32_t *)malloc(sizeof(int32_t) << HashBits);
+    uint32_t *const tokens = (uint32_t *)malloc(sizeof(uint32_t) * BlockTokens);
+    if (!head || !tokens) {
+        free(head);
+        free(tokens);
+        return 0;
+    }
+    memset(head, 0xFF, sizeof(int32_t) << HashBits); // -1: empty
+
+    BitWriter w = { dst, 0, 0 };
+    size_t pos = 0;
+    do {
+        BlockStats stats;
+        memset(&stats, 0, sizeof stats);
+        size_t const blockBegin = pos;
+        unsigned numTokens = 0;
+        while (pos < n && numTokens < BlockTokens) {
+            if (pos + MinMatch <= n) {
+                uint32_t const seq = Load32(src + pos);
+                uint32_t const h = (seq * 2654435761u) >> (32 - HashBits);
+                int32_t const cand = head[h];
+                head[h] = int32_t(pos);
+                if (cand >= 0 && pos - size_t(cand) <= WindowSize && Load32(src + cand) == seq) {
+                    size_t const avail = n - pos < size_t(MaxMatch) ? n - pos : size_t(MaxMatch);
+                    unsigned const len = MinMatch + MatchLength(src + cand + MinMatch, src + pos + MinMatch, unsigned(avail) - MinMatch);
+                    unsigned const dist = unsigned(pos - size_t(cand));
+                    tokens[numTokens++] = MatchFlag | ((len - 3) << 16) | (dist - 1);
+                    unsigned const lc = t.lenCode[len - 3];
+                    unsigned const dc = DistCodeOf(t, dist);
+                    stats.litFreq[257 + lc]++;
+                    stats.distFreq[dc]++;
+                    stats.extraBits += LenExtra[lc] + DistExtra[dc];
+                    pos += len;
+                    continue;
+                }
+            }
+            tokens[numTokens++] = src[pos];
+            stats.litFreq[src[pos]]++;
+            pos++;
+        }
+        WriteBlock(&w, t, src, blockBegin, pos, tokens, numTokens, &stats, pos == n);
+    } while (pos < n);
+    FlushBits(&w);
+
+    free(head);
+    free(tokens);
+    return size_t(w.p - dst);
+}
+
+size_t
+FastDeflateBound(size_t n)
+{
+    return DeflateBound(n);
+}
+
+size_t
+FastDeflate(const void *src, size_t n, void *dst)
+{
+    if (n == 0) {
+        static const uint8_t EmptyFinalBlock[2] = { 0x03, 0x00 }; // fixed Huffman block with just the end code
+        memcpy(dst, EmptyFinalBlock, 2);
+        return 2;
+    }
+    return Deflate(GetTables(), static_cast<const uint8_t *>(src), n, static_cast<uint8_t *>(dst));
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+static uint8_t *
+WriteChunkHeader(uint8_t *p, uint32_t len, const char *type)
+{
+    StoreBE32(p, len);
+    memcpy(p + 4, type, 4);
+    return p + 8;
+}
+
+// p points past the chunk data, the CRC covers the type and data:
+static uint8_t *
+WriteChunkCrc(const PngTables& t, uint8_t *p, uint32_t len)
+{
+    StoreBE32(p, Crc32(t, 0, p - len - 4, len + 4));
+    return p + 4;
+}
+
+unsigned char *
+FastPngEncode(const void *data, int strideBytes, int w, int h, int comps, int *pOutLen)
+{
+    if (!data || w <= 0 || h <= 0 || comps < 1 || comps > 4) return NULL;
+    const PngTables& t = GetTables();
+
+    size_t const rowBytes = size_t(w) * size_t(comps);
+    size_t const stride = strideBytes ? size_t(strideBytes) : rowBytes;
+    size_t const rawSize = (rowBytes + 1) * size_t(h);
+    size_t const idatBound = 2 + DeflateBound(rawSize) + 4;
+    if (idatBound > 0x7FFFFFFFu) return NULL; // one IDAT chunk, and the length has to fit in an int
+
+    uint8_t *const filtered = (uint8_t *)malloc(rawSize);
+    uint8_t *const out = (uint8_t *)malloc(8 + 25 + 12 + idatBound + 12);
+    if (!filtered || !out) {
+        free(filtered);
+        free(out);
+        return NULL;
+    }
+
+    const uint8_t *const pixels = (const uint8_t *)data;
+    for (size_t y = 0; y < size_t(h); ++y) {
+        const uint8_t *const row = pixels + y * stride;
+        uint8_t *const dst = filtered + y * (rowBytes + 1);
+        if (y == 0) {
+            dst[0] = 1; // Sub
+            memcpy(dst + 1, row, size_t(comps));
+            SubtractBytes(dst + 1 + comps, row + comps, row, rowBytes - size_t(comps));
+        } else {
+            dst[0] = 2; // Up
+            SubtractBytes(dst + 1, row, row - stride, rowBytes);
+        }
+    }
+
+    static const uint8_t Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    static const uint8_t ColorTypes[5] = { 0, 0, 4, 2, 6 }; // gray, gray+alpha, RGB, RGBA
+    uint8_t *p = out;
+    memcpy(p, Signature, 8);
+    p = WriteChunkHeader(p + 8, 13, "IHDR");
+    StoreBE32(p, uint32_t(w));
+    StoreBE32(p + 4, uint32_t(h));
+    p[8] = 8; // bit depth
+    p[9] = ColorTypes[comps];
+    p[10] = p[11] = p[12] = 0; // deflate, adaptive filtering, no interlace
+    p = WriteChunkCrc(t, p + 13, 13);
+
+    uint8_t *const idat = WriteChunkHeader(p, 0, "IDAT");
+    idat[0] = 0x78; // 32K window, deflate
+    idat[1] = 0x01; // fastest level, header check bits
+    size_t const deflateSize = Deflate(t, filtered, rawSize, idat + 2);
+    if (deflateSize == 0) {
+        free(filtered);
+        free(out);
+        return NULL;
+    }
+    StoreBE32(idat + 2 + deflateSize, Adler32(filtered, rawSize));
+    uint32_t const idatLen = uint32_t(2 + deflateSize + 4);
+    StoreBE32(p, idatLen);
+    p = WriteChunkCrc(t, idat + idatLen, idatLen);
+    free(filtered);
+
+    p = WriteChunkHeader(p, 0, "IEND");
+    p = WriteChunkCrc(t, p, 0);
+
+    if (pOutLen) *pOutLen = int(p - out);
+    return out;
+}
+
+int
+FastPngWrite(const char *path, int w, int h, int comps, const void *data, int strideBytes)
+{
+    int len = 0;
+    unsigned char *const png = FastPngEncode(data, strideBytes, w, h, comps, &len);
+    if (!png) return 0;
+    FILE *const fp = fopen(path, "wb");
+    bool ok = false;
+    if (fp) {
+        ok = fwrite(png, 1, size_t(len), fp) == size_t(len);
+        ok = (fclose(fp) == 0) && ok;
+    }
+    free(png);
+    return ok ? 1 : 0;
+}
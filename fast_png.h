@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * PNG writer for test output images, a faster stand-in for stbi_write_png.
+ *
+ * Every row gets the Up filter (Sub for the first row), computed with SIMD. The filtered rows
+ * go through a greedy single-probe LZ77 parse, and each run of up to 64K tokens becomes one
+ * deflate block with dynamic Huffman, fixed Huffman or stored encoding, whichever is smallest.
+ * Rendered test images are mostly flat, so this compresses them about as well as stb's
+ * exhaustive filter search and hash chains, in a fraction of the time.
+ *
+ * The output is a plain 8-bit PNG that any decoder reads.
+ */
+
+// Same arguments and return value as stbi_write_png: comps is 1-4, returns nonzero on success.
+int
+FastPngWrite(const char *path, int w, int h, int comps, const void *data, int strideBytes);
+
+// Same as stbi_write_png_to_mem: returns the PNG file contents in a buffer to free(), or NULL.
+unsigned char *
+FastPngEncode(const void *data, int strideBytes, int w, int h, int comps, int *pOutLen);
+
+// The compressor on its own: a raw deflate stream (RFC 1951, no zlib header) of n bytes of src.
+// dst must hold FastDeflateBound(n) bytes. Returns the compressed size, 0 if out of memory.
+size_t
+FastDeflateBound(size_t n);
+
+size_t
+FastDeflate(const void *src, size_t n, void *dst);
+
+// "sse2", "neon" or "scalar", for the filter kernel.
+const char *
+FastPngKernelName();
@@ -0,0 +1,436 @@
+#include "golden_hash.h"
+#include "vk_simple_init.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GOLDEN_HASH_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define GOLDEN_HASH_NEON 1
+#include <arm_neon.h>
+#endif
+
+/*
+ * Hash structure: 8 64-bit accumulator lanes. Each 64-byte stripe does, per lane i,
+ *     k = data[i] ^ secret[s + i];  acc[i ^ 1] += data[i];  acc[i] += lo32(k) * hi32(k);
+ * where s is the stripe's index within its block of StripesPerBlock stripes.
+ * After each full block the accumulators are scrambled so the multiplies can't cancel out.
+ */
+enum { StripeBytes = 64, StripesPerBlock = 8 };
+
+static const uint64_t Prime32_1 = 0x9E3779B1u;
+static const uint64_t Prime64_1 = 0x9E3779B185EBCA87ull;
+static const uint64_t Prime64_2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t Prime64_3 = 0x165667B19E3779F9ull;
+
+// [0, 16) stripe keys (stripe s uses [s, s + 8)), [16, 24) scramble key, [24, 32) finalization key:
+static const uint64_t HashSecret[32] = {
+    0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+    0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull, 0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull,
+    0xcb00c391bb52283cull, 0xa32e531b8b65d088ull, 0x4ef90da297486471ull, 0xd8acdea946ef1938ull,
+    0x3f349ce33f76faa8ull, 0x1d4f0bc7c7bbdcf9ull, 0x3159b4cd4be0518aull, 0x647378d9c97e9fc8ull,
+    0xc3ebd33483acc5eaull, 0xeb6313faffa081c5ull, 0x49daf0b751dd0d17ull, 0x9e68d429265516d3ull,
+    0xfca1477d58be162bull, 0xce31d07ad1b8f88full, 0x280416958f3acb45ull, 0x7e404bbbcafbd7afull,
+    0x4c3a3ed8d2e19c3aull, 0x4a2a6a6c6a6e3b8dull, 0x7a2c3f3e5b8d9e1full, 0x8b5e0f1d2c3a4b59ull,
+    0x1a2b3c4d5e6f7081ull, 0x92a3b4c5d6e7f809ull, 0x0f1e2d3c4b5a6978ull, 0x8796a5b4c3d2e1f0ull,
+};
+
+static inline uint64_t
+Load64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v; // little-endian hosts only, like the rest of the tests
+}
+
+// Accumulates nStripes consecutive stripes starting at key offset firstStripe.
+typedef void (*AccumulateFn)(uint64_t acc[8], const uint8_t *p, size_t nStripes, size_t firstStripe);
+typedef void (*ScrambleFn)(uint64_t acc[8]);
+
+struct HashKernels {
+    const char *name;
+    AccumulateFn accumulate;
+    ScrambleFn scramble;
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+static void
+Accumulate_Scalar(uint64_t acc[8], const uint8_t *p, size_t nStripes, size_t firstStripe)
+{
+    for (size_t s = 0; s < nStripes; ++s, p += StripeBytes) {
+        const uint64_t *const key = HashSecret + firstStripe + s;
+        for (unsigned i = 0; i < 8; ++i) {
+            uint64_t const d = Load64(p + 8 * i);
+            uint64_t const k = d ^ key[i];
+            acc[i ^ 1] += d;
+            acc[i] += (k & 0xffffffffu) * (k >> 32);
+        }
+    }
+}
+
+static void
+Scramble_Scalar(uint64_t acc[8])
+{
+    for (unsigned i = 0; i < 8; ++i) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= HashSecret[16 + i];
+        acc[i] = a * Prime32_1;
+    }
+}
+
+static const HashKernels ScalarKernels = { "scalar", Accumulate_Scalar, Scramble_Scalar };
+
+// ---------------------------------------------------------------------------------------------------------------------
+#if GOLDEN_HASH_X86
+
+static void
+Accumulate_SSE2(uint64_t acc[8], const uint8_t *p, size_t nStripes, size_t firstStripe)
+{
+    __m128i a[4];
+    for (unsigned j = 0; j < 4; ++j) a[j] = _mm_loadu_si128((const __m128i *)acc + j);
+    for (size_t s = 0; s < nStripes; ++s, p += StripeBytes) {
+        const uint64_t *const key = HashSecret + firstStripe + s;
+        for (unsigned j = 0; j < 4; ++j) {
+            __m128i const d = _mm_loadu_si128((const __m128i *)p + j);
+            __m128i const k = _mm_xor_si128(d, _mm_loadu_si128((const __m128i *)(key + 2 * j)));
+            __m128i const kHi = _mm_shuffle_epi32(k, _MM_SHUFFLE(0, 3, 0, 1));
+            __m128i const product = _mm_mul_epu32(k, kHi);
+            __m128i const dSwapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+            a[j] = _mm_add_epi64(a[j], _mm_add_epi64(product, dSwapped));
+        }
+    }
+    for (unsigned j = 0; j < 4; ++j) _mm_storeu_si128((__m128i *)acc + j, a[j]);
+}
+
+static void
+Scramble_SSE2(uint64_t acc[8])
+{
+    __m128i const prime = _mm_set1_epi32(int(Prime32_1));
+    for (unsigned j = 0; j < 4; ++j) {
+        __m128i a = _mm_loadu_si128((const __m128i *)acc + j);
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i *)(HashSecret + 16 + 2 * j)));
+        // 64x32 multiply from two 32x32->64 ones:
+        __m128i const lo = _mm_mul_epu32(a, prime);
+        __m128i const hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+        _mm_storeu_si128((__m128i *)acc + j, _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+    }
+}
+
+static const HashKernels Sse2Kernels = { "sse2", Accumulate_SSE2, Scramble_SSE2 };
+
+
+TARGET_AVX2 static void
+Accumulate_AVX2(uint64_t acc[8], const uint8_t *p, size_t nStripes, size_t firstStripe)
+{
+    __m256i a0 = _mm256_loadu_si256((const __m256i *)acc);
+    __m256i a1 = _mm256_loadu_si256((const __m256i *)acc + 1);
+    for (size_t s = 0; s < nStripes; ++s, p += StripeBytes) {
+        const uint64_t *const key = HashSecret + firstStripe + s;
+        __m256i const d0 = _mm256_loadu_si256((const __m256i *)p);
+        __m256i const d1 = _mm256_loadu_si256((const __m256i *)p + 1);
+        __m256i const k0 = _mm256_xor_si256(d0, _mm256_loadu_si256((const __m256i *)key));
+        __m256i const k1 = _mm256_xor_si256(d1, _mm256_loadu_si256((const __m256i *)(key + 4)));
+        __m256i const p0 = _mm256_mul_epu32(k0, _mm256_shuffle_epi32(k0, _MM_SHUFFLE(0, 3, 0, 1)));
+        __m256i const p1 = _mm256_mul_epu32(k1, _mm256_shuffle_epi32(k1, _MM_SHUFFLE(0, 3, 0, 1)));
+        a0 = _mm256_add_epi64(a0, _mm256_add_epi64(p0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2))));
+        a1 = _mm256_add_epi64(a1, _mm256_add_epi64(p1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+    _mm256_storeu_si256((__m256i *)acc, a0);
+    _mm256_storeu_si256((__m256i *)acc + 1, a1);
+}
+
+// Scrambling runs once per 512 bytes, the SSE2 version is fine for it:
+static const HashKernels Avx2Kernels = { "avx2", Accumulate_AVX2, Scramble_SSE2 };
+
+static bool
+CpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7) return false;
+    __cpuid(regs, 1);
+    bool const osxsave = (regs[2] & (1 << 27)) != 0;
+    bool const avx = (regs[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // GOLDEN_HASH_X86
+
+// ---------------------------------------------------------------------------------------------------------------------
+#if GOLDEN_HASH_NEON
+
+static void
+Accumulate_NEON(uint64_t acc[8], const uint8_t *p, size_t nStripes, size_t firstStripe)
+{
+    uint64x2_t a[4];
+    for (unsigned j = 0; j < 4; ++j) a[j] = vld1q_u64(acc + 2 * j);
+    for (size_t s = 0; s < nStripes; ++s, p += StripeBytes) {
+        const uint64_t *const key = HashSecret + firstStripe + s;
+        for (unsigned j = 0; j < 4; ++j) {
+            uint64x2_t const d = vreinterpretq_u64_u8(vld1q_u8(p + 16 * j));
+            uint64x2_t const k = veorq_u64(d, vld1q_u64(key + 2 * j));
+            uint64x2_t const product = vmull_u32(vmovn_u64(k), vshrn_n_u64(k, 32));
+            a[j] = vaddq_u64(a[j], vaddq_u64(product, vextq_u64(d, d, 1)));
+        }
+    }
+    for (unsigned j = 0; j < 4; ++j) vst1q_u64(acc + 2 * j, a[j]);
+}
+
+static void
+Scramble_NEON(uint64_t acc[8])
+{
+    uint32x2_t const prime = vdup_n_u32(uint32_t(Prime32_1));
+    for (unsigned j = 0; j < 4; ++j) {
+        uint64x2_t a = vld1q_u64(acc + 2 * j);
+        a = veorq_u64(a, vshrq_n_u64(a, 47));
+        a = veorq_u64(a, vld1q_u64(HashSecret + 16 + 2 * j));
+        uint64x2_t const lo = vmull_u32(vmovn_u64(a), prime);
+        uint64x2_t const hi = vmull_u32(vshrn_n_u64(a, 32), prime);
+        vst1q_u64(acc + 2 * j, vaddq_u64(lo, vshlq_n_u64(hi, 32)));
+    }
+}
+
+static const HashKernels NeonKernels = { "neon", Accumulate_NEON, Scramble_NEON };
+
+#endif // GOLDEN_HASH_NEON
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+static const HashKernels *
+PickHashKernels()
+{
+#if GOLDEN_HASH_X86
+    return CpuHasAvx2() ? &Avx2Kernels : &Sse2Kernels;
+#elif GOLDEN_HASH_NEON
+    return &NeonKernels;
+#else
+    return &ScalarKernels;
+#endif
+}
+
+static const HashKernels *
+GetHashKernels()
+{
+    static const HashKernels *const s_pKernels = PickHashKernels(); // thread-safe init, the result archive hashes on its writer thread
+    return s_pKernels;
+}
+
+const char *
+GoldenHashKernelName()
+{
+    return GetHashKernels()->name;
+}
+
+uint64_t
+GoldenHash(const void *pData, size_t nBytes)
+{
+    const HashKernels *const k = GetHashKernels();
+    const uint8_t *p = static_cast<const uint8_t *>(pData);
+    uint64_t acc[8] = {
+        Prime32_1, Prime64_1, Prime64_2, Prime64_3,
+        0x85EBCA77C2B2AE63ull, 0x27D4EB2F165667C5ull, 0x9E3779B97F4A7C15ull, 0xD6E8FEB86659FD93ull
+    };
+
+    size_t const BlockBytes = StripeBytes * StripesPerBlock;
+    size_t const nBlocks = nBytes / BlockBytes;
+    for (size_t b = 0; b < nBlocks; ++b, p += BlockBytes) {
+        k->accumulate(acc, p, StripesPerBlock, 0);
+        k->scramble(acc);
+    }
+    size_t const nLeft = nBytes - nBlocks * BlockBytes;
+    size_t const nStripes = nLeft / StripeBytes;
+    k->accumulate(acc, p, nStripes, 0);
+    p += nStripes * StripeBytes;
+    if (size_t const nTail = nLeft - nStripes * StripeBytes) {
+        uint8_t last[StripeBytes] = { };
+        memcpy(last, p, nTail);
+        k->accumulate(acc, last, 1, StripesPerBlock - 1);
+    }
+
+    // The zero padding of the last stripe is disambiguated by mixing in the length:
+    uint64_t h = uint64_t(nBytes) * Prime64_1;
+    for (unsigned i = 0; i < 8; ++i) {
+        uint64_t const a = acc[i] ^ HashSecret[24 + i];
+        h ^= a;
+        h = ((h << 31) | (h >> 33)) * Prime64_2;
+    }
+    h ^= h >> 37;
+    h *= Prime64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+struct GoldenEntry {
+    char key[192];
+    uint64_t hash;
+};
+
+static GoldenMode s_goldenMode = GoldenMode::Off;
+static char s_manifestPath[1024];
+static char s_deviceClass[32];
+static GoldenEntry *s_goldenEntries;
+static size_t s_numGoldenEntries, s_goldenCapacity;
+static bool s_bManifestDirty;
+
+// Sorted by key; returns the insertion point if not found.
+static size_t
+FindGoldenEntry(const char *key, bool *pbFound)
+{
+    size_t lo = 0, hi = s_numGoldenEntries;
+    while (lo < hi) {
+        size_t const mid = (lo + hi) / 2;
+        int const c = strcmp(s_goldenEntries[mid].key, key);
+        if (c == 0) {
+            *pbFound = true;
+            return mid;
+        }
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    *pbFound = false;
+    return lo;
+}
+
+static void
+SetGoldenEntry(const char *key, uint64_t hash)
+{
+    bool bFound;
+    size_t const i = FindGoldenEntry(key, &bFound);
+    if (!bFound) {
+        if (s_numGoldenEntries == s_goldenCapacity) {
+            s_goldenCapacity = s_goldenCapacity ? s_goldenCapacity * 2 : 256;
+            s_goldenEntries = static_cast<GoldenEntry *>(realloc(s_goldenEntries, s_goldenCapacity * sizeof(GoldenEntry)));
+        }
+        memmove(s_goldenEntries + i + 1, s_goldenEntries + i, (s_numGoldenEntries - i) * sizeof(GoldenEntry));
+        s_numGoldenEntries++;
+        snprintf(s_goldenEntries[i].key, sizeof s_goldenEntries[i].key, "%s", key);
+    }
+    s_goldenEntries[i].hash = hash;
+}
+
+bool
+GoldenInit(GoldenMode mode, const char *manifestPath, const VulkanObjetcs& vk)
+{
+    s_goldenMode = mode;
+    if (mode == GoldenMode::Off) {
+        return true;
+    }
+    snprintf(s_manifestPath, sizeof s_manifestPath, "%s", manifestPath);
+    const VkPhysicalDeviceProperties& props = vk.props2.properties;
+    snprintf(s_deviceClass, sizeof s_deviceClass, "%04x-%04x", props.vendorID, props.deviceID);
+
+    FILE *const fp = fopen(manifestPath, "r");
+    if (!fp) {
+        if (mode == GoldenMode::Check) {
+            printf("ERROR: failed to open golden manifest %s\n", manifestPath);
+            return false;
+        }
+        return true; // recording a new one
+    }
+    char line[512];
+    unsigned lineNumber = 0;
+    while (fgets(line, sizeof line, fp)) {
+        lineNumber++;
+        char key[192];
+        unsigned long long hash;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (sscanf(line, "%191s %llx", key, &hash) != 2) {
+            printf("WARNING: %s:%u is not \"<key> <hash>\", ignoring it\n", manifestPath, lineNumber);
+            continue;
+        }
+        SetGoldenEntry(key, uint64_t(hash));
+    }
+    fclose(fp);
+    return true;
+}
+
+GoldenMode
+GoldenGetMode()
+{
+    return s_goldenMode;
+}
+
+GoldenResult
+GoldenCheck(const char *testName, const char *params, const void *p, size_t nBytes)
+{
+    if (s_goldenMode == GoldenMode::Off) {
+        return GoldenResult::Off;
+    }
+    if (s_goldenMode == GoldenMode::Record) {
+        return GoldenResult::Record;
+    }
+    char key[192];
+    snprintf(key, sizeof key, "%s/%s@%s", testName, params, s_deviceClass);
+    uint64_t const hash = GoldenHash(p, nBytes);
+
+    bool bFound;
+    size_t const i = FindGoldenEntry(key, &bFound);
+    if (!bFound) {
+        printf("Golden: no entry for %s (hash %016llx)\n", key, (unsigned long long)hash);
+        return GoldenResult::Missing;
+    }
+    if (s_goldenEntries[i].hash != hash) {
+        printf("Golden: %s hash %016llx != expected %016llx\n",
+               key, (unsigned long long)hash, (unsigned long long)s_goldenEntries[i].hash);
+        return GoldenResult::Mismatch;
+    }
+    return GoldenResult::Match;
+}
+
+void
+GoldenRecord(const char *testName, const char *params, const void *p, size_t nBytes)
+{
+    if (s_goldenMode != GoldenMode::Record) {
+        return;
+    }
+    char key[192];
+    snprintf(key, sizeof key, "%s/%s@%s", testName, params, s_deviceClass);
+    SetGoldenEntry(key, GoldenHash(p, nBytes));
+    s_bManifestDirty = true;
+}
+
+bool
+GoldenFlush()
+{
+    if (s_goldenMode != GoldenMode::Record || !s_bManifestDirty) {
+        return true;
+    }
+    FILE *const fp = fopen(s_manifestPath, "w");
+    if (!fp) {
+        printf("ERROR: failed to write golden manifest %s\n", s_manifestPath);
+        return false;
+    }
+    fprintf(fp, "# vktest golden manifest: <test>/<params>@<vendorID>-<deviceID> <hash>\n");
+    for (size_t i = 0; i < s_numGoldenEntries; ++i) {
+        fprintf(fp, "%s %016llx\n", s_goldenEntries[i].key, (unsigned long long)s_goldenEntries[i].hash);
+    }
+    bool const bOk = (fclose(fp) == 0);
+    if (bOk) {
+        printf("Wrote %u golden hashes to %s\n", unsigned(s_numGoldenEntries), s_manifestPath);
+        s_bManifestDirty = false;
+    }
+    return bOk;
+}
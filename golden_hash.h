@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct VulkanObjetcs;
+
+/*
+ * Golden mode: instead of comparing a readback against a reference image, hash it and compare
+ * against a manifest of known-good hashes, keyed by "<test>/<params>@<vendorID>-<deviceID>".
+ * A passing check costs one streaming pass over the staging memory; tests only fall back to
+ * a full image compare (and saving images) when the hash differs or is missing.
+ *
+ * The manifest is a text file with one "<key> <hash as 16 hex digits>" per line, kept sorted.
+ */
+
+enum class GoldenMode { Off, Check, Record };
+
+enum class GoldenResult {
+    Off,      // golden mode not enabled, do the usual verification
+    Match,
+    Mismatch,
+    Missing,  // no entry for this key in the manifest
+    Record    // record mode: nothing stored yet, the test verifies as usual and calls GoldenRecord if that passes
+};
+
+/*
+ * 64-bit hash over 64-byte stripes, with the same accumulate/scramble structure as XXH3
+ * but NOT compatible with it. Every kernel (AVX2, SSE2, NEON, scalar) gives the same result,
+ * so manifests can be shared between machines.
+ */
+uint64_t
+GoldenHash(const void *p, size_t nBytes);
+
+// Name of the kernel set picked at runtime, e.g. "avx2".
+const char *
+GoldenHashKernelName();
+
+// Loads the manifest (a missing file is only an error in Check mode). The device class is taken from vk.
+bool
+GoldenInit(GoldenMode mode, const char *manifestPath, const VulkanObjetcs& vk);
+
+GoldenMode
+GoldenGetMode();
+
+// params can be "" for tests without parameters. Neither testName nor params may contain whitespace.
+GoldenResult
+GoldenCheck(const char *testName, const char *params, const void *p, size_t nBytes);
+
+// Record mode: stores the hash of a readback the test has verified, so a failing run never becomes golden. No-op otherwise.
+void
+GoldenRecord(const char *testName, const char *params, const void *p, size_t nBytes);
+
+// Record mode: writes the manifest back out. Returns false if that fails.
+bool
+GoldenFlush();
@@ -0,0 +1,264 @@
+// Hand-written SPIR-V matching gpu_verify.comp, words assembled from the listing below.
+
+/*
+; SPIR-V
+; Version: 1.3
+; Bound: 83
+; Schema: 0
+               OpCapability Shader ; 0x00000014
+          %glsl = OpExtInstImport "GLSL.std.450" ; 0x0000001c
+               OpMemoryModel Logical GLSL450 ; 0x00000034
+               OpEntryPoint GLCompute %main "main" %gid ; 0x00000040
+               OpExecutionMode %main LocalSize 64 1 1 ; 0x00000058
+               OpDecorate %gid BuiltIn GlobalInvocationId ; 0x00000070
+               OpMemberDecorate %PushConsts 0 Offset 0 ; 0x00000080
+               OpMemberDecorate %PushConsts 1 Offset 4 ; 0x00000094
+               OpMemberDecorate %PushConsts 2 Offset 8 ; 0x000000a8
+               OpMemberDecorate %PushConsts 3 Offset 12 ; 0x000000bc
+               OpDecorate %PushConsts Block ; 0x000000d0
+               OpDecorate %_runtimearr_uint ArrayStride 4 ; 0x000000dc
+               OpMemberDecorate %Data 0 NonWritable ; 0x000000ec
+               OpMemberDecorate %Data 0 Offset 0 ; 0x000000fc
+               OpDecorate %Data Block ; 0x00000110
+               OpDecorate %got DescriptorSet 0 ; 0x0000011c
+               OpDecorate %got Binding 0 ; 0x0000012c
+               OpDecorate %ref DescriptorSet 0 ; 0x0000013c
+               OpDecorate %ref Binding 1 ; 0x0000014c
+               OpDecorate %_arr_uint_32 ArrayStride 4 ; 0x0000015c
+               OpDecorate %_arr_v4uint_8 ArrayStride 16 ; 0x0000016c
+               OpMemberDecorate %Summary 0 Offset 0 ; 0x0000017c
+               OpMemberDecorate %Summary 1 Offset 4 ; 0x00000190
+               OpMemberDecorate %Summary 2 Offset 8 ; 0x000001a4
+               OpMemberDecorate %Summary 3 Offset 12 ; 0x000001b8
+               OpMemberDecorate %Summary 4 Offset 16 ; 0x000001cc
+               OpMemberDecorate %Summary 5 Offset 144 ; 0x000001e0
+               OpDecorate %Summary Block ; 0x000001f4
+               OpDecorate %summary DescriptorSet 0 ; 0x00000200
+               OpDecorate %summary Binding 2 ; 0x00000210
+          %void = OpTypeVoid ; 0x00000220
+        %fnvoid = OpTypeFunction %void ; 0x00000228
+          %uint = OpTypeInt 32 0 ; 0x00000234
+           %int = OpTypeInt 32 1 ; 0x00000244
+          %bool = OpTypeBool ; 0x00000254
+        %v3uint = OpTypeVector %uint 3 ; 0x0000025c
+        %v4uint = OpTypeVector %uint 4 ; 0x0000026c
+         %int_0 = OpConstant %int 0 ; 0x0000027c
+         %int_1 = OpConstant %int 1 ; 0x0000028c
+         %int_2 = OpConstant %int 2 ; 0x0000029c
+         %int_3 = OpConstant %int 3 ; 0x000002ac
+         %int_4 = OpConstant %int 4 ; 0x000002bc
+         %int_5 = OpConstant %int 5 ; 0x000002cc
+        %uint_0 = OpConstant %uint 0 ; 0x000002dc
+        %uint_1 = OpConstant %uint 1 ; 0x000002ec
+        %uint_8 = OpConstant %uint 8 ; 0x000002fc
+       %uint_32 = OpConstant %uint 32 ; 0x0000030c
+%_ptr_Input_v3uint = OpTypePointer Input %v3uint ; 0x0000031c
+           %gid = OpVariable %_ptr_Input_v3uint Input ; 0x0000032c
+    %PushConsts = OpTypeStruct %uint %uint %uint %uint ; 0x0000033c
+%_ptr_PushConstant_PushConsts = OpTypePointer PushConstant %PushConsts ; 0x00000354
+            %pc = OpVariable %_ptr_PushConstant_PushConsts PushConstant ; 0x00000364
+%_ptr_PushConstant_uint = OpTypePointer PushConstant %uint ; 0x00000374
+%_runtimearr_uint = OpTypeRuntimeArray %uint ; 0x00000384
+          %Data = OpTypeStruct %_runtimearr_uint ; 0x00000390
+%_ptr_StorageBuffer_Data = OpTypePointer StorageBuffer %Data ; 0x0000039c
+           %got = OpVariable %_ptr_StorageBuffer_Data StorageBuffer ; 0x000003ac
+           %ref = OpVariable %_ptr_StorageBuffer_Data StorageBuffer ; 0x000003bc
+%_ptr_StorageBuffer_uint = OpTypePointer StorageBuffer %uint ; 0x000003cc
+  %_arr_uint_32 = OpTypeArray %uint %uint_32 ; 0x000003dc
+ %_arr_v4uint_8 = OpTypeArray %v4uint %uint_8 ; 0x000003ec
+       %Summary = OpTypeStruct %uint %uint %uint %uint %_arr_uint_32 %_arr_v4uint_8 ; 0x000003fc
+%_ptr_StorageBuffer_Summary = OpTypePointer StorageBuffer %Summary ; 0x0000041c
+       %summary = OpVariable %_ptr_StorageBuffer_Summary StorageBuffer ; 0x0000042c
+%_ptr_StorageBuffer_v4uint = OpTypePointer StorageBuffer %v4uint ; 0x0000043c
+          %main = OpFunction %void None %fnvoid ; 0x0000044c
+         %entry = OpLabel ; 0x00000460
+            %id = OpLoad %v3uint %gid ; 0x00000468
+             %i = OpCompositeExtract %uint %id 0 ; 0x00000478
+       %pcCount = OpAccessChain %_ptr_PushConstant_uint %pc %int_0 ; 0x0000048c
+         %count = OpLoad %uint %pcCount ; 0x000004a0
+      %inBounds = OpULessThan %bool %i %count ; 0x000004b0
+               OpSelectionMerge %end None ; 0x000004c4
+               OpBranchConditional %inBounds %body %end ; 0x000004d0
+          %body = OpLabel ; 0x000004e0
+          %pGot = OpAccessChain %_ptr_StorageBuffer_uint %got %int_0 %i ; 0x000004e8
+        %gotVal = OpLoad %uint %pGot ; 0x00000500
+          %pRef = OpAccessChain %_ptr_StorageBuffer_uint %ref %int_0 %i ; 0x00000510
+        %refVal = OpLoad %uint %pRef ; 0x00000528
+        %pcMode = OpAccessChain %_ptr_PushConstant_uint %pc %int_1 ; 0x00000538
+          %mode = OpLoad %uint %pcMode ; 0x0000054c
+       %pcScale = OpAccessChain %_ptr_PushConstant_uint %pc %int_2 ; 0x0000055c
+         %scale = OpLoad %uint %pcScale ; 0x00000570
+        %pcBias = OpAccessChain %_ptr_PushConstant_uint %pc %int_3 ; 0x00000580
+          %bias = OpLoad %uint %pcBias ; 0x00000594
+        %scaled = OpIMul %uint %i %scale ; 0x000005a4
+      %analytic = OpIAdd %uint %scaled %bias ; 0x000005b8
+     %useBuffer = OpIEqual %bool %mode %uint_0 ; 0x000005cc
+      %expected = OpSelect %uint %useBuffer %refVal %analytic ; 0x000005e0
+      %mismatch = OpINotEqual %bool %gotVal %expected ; 0x000005f8
+               OpSelectionMerge %bodyEnd None ; 0x0000060c
+               OpBranchConditional %mismatch %record %bodyEnd ; 0x00000618
+        %record = OpLabel ; 0x00000628
+     %gotIsMore = OpUGreaterThan %bool %gotVal %expected ; 0x00000630
+         %diff0 = OpISub %uint %gotVal %expected ; 0x00000644
+         %diff1 = OpISub %uint %expected %gotVal ; 0x00000658
+           %err = OpSelect %uint %gotIsMore %diff0 %diff1 ; 0x0000066c
+       %pNumBad = OpAccessChain %_ptr_StorageBuffer_uint %summary %int_0 ; 0x00000684
+          %slot = OpAtomicIAdd %uint %pNumBad %uint_1 %uint_0 %uint_1 ; 0x00000698
+       %pMinErr = OpAccessChain %_ptr_StorageBuffer_uint %summary %int_1 ; 0x000006b4
+           %ig0 = OpAtomicUMin %uint %pMinErr %uint_1 %uint_0 %err ; 0x000006c8
+       %pMaxErr = OpAccessChain %_ptr_StorageBuffer_uint %summary %int_2 ; 0x000006e4
+           %ig1 = OpAtomicUMax %uint %pMaxErr %uint_1 %uint_0 %err ; 0x000006f8
+        %pFirst = OpAccessChain %_ptr_StorageBuffer_uint %summary %int_3 ; 0x00000714
+           %ig2 = OpAtomicUMin %uint %pFirst %uint_1 %uint_0 %i ; 0x00000728
+        %bucket = OpExtInst %uint %glsl FindUMsb %err ; 0x00000744
+         %pHist = OpAccessChain %_ptr_StorageBuffer_uint %summary %int_4 %bucket ; 0x0000075c
+           %ig3 = OpAtomicIAdd %uint %pHist %uint_1 %uint_0 %uint_1 ; 0x00000774
+        %inList = OpULessThan %bool %slot %uint_8 ; 0x00000790
+               OpSelectionMerge %recordEnd None ; 0x000007a4
+               OpBranchConditional %inList %store %recordEnd ; 0x000007b0
+         %store = OpLabel ; 0x000007c0
+        %sample = OpCompositeConstruct %v4uint %i %gotVal %expected %uint_0 ; 0x000007c8
+       %pSample = OpAccessChain %_ptr_StorageBuffer_v4uint %summary %int_5 %slot ; 0x000007e4
+               OpStore %pSample %sample ; 0x000007fc
+               OpBranch %recordEnd ; 0x00000808
+     %recordEnd = OpLabel ; 0x00000810
+               OpBranch %bodyEnd ; 0x00000818
+       %bodyEnd = OpLabel ; 0x00000820
+               OpBranch %end ; 0x00000828
+           %end = OpLabel ; 0x00000830
+               OpReturn ; 0x00000838
+               OpFunctionEnd ; 0x0000083c
+*/
+
+{0x07230203,0x00010300,0x00000000,0x00000053,
+0x00000000,0x00020011,0x00000001,0x0006000b,
+0x00000001,0x4c534c47,0x6474732e,0x3035342e,
+0x00000000,0x0003000e,0x00000000,0x00000001,
+0x0006000f,0x00000005,0x00000025,0x6e69616d,
+0x00000000,0x00000014,0x00060010,0x00000025,
+0x00000011,0x00000040,0x00000001,0x00000001,
+0x00040047,0x00000014,0x0000000b,0x0000001c,
+0x00050048,0x00000015,0x00000000,0x00000023,
+0x00000000,0x00050048,0x00000015,0x00000001,
+0x00000023,0x00000004,0x00050048,0x00000015,
+0x00000002,0x00000023,0x00000008,0x00050048,
+0x00000015,0x00000003,0x00000023,0x0000000c,
+0x00030047,0x00000015,0x00000002,0x00040047,
+0x00000019,0x00000006,0x00000004,0x00040048,
+0x0000001a,0x00000000,0x00000018,0x00050048,
+0x0000001a,0x00000000,0x00000023,0x00000000,
+0x00030047,0x0000001a,0x00000002,0x00040047,
+0x0000001c,0x00000022,0x00000000,0x00040047,
+0x0000001c,0x00000021,0x00000000,0x00040047,
+0x0000001d,0x00000022,0x00000000,0x00040047,
+0x0000001d,0x00000021,0x00000001,0x00040047,
+0x0000001f,0x00000006,0x00000004,0x00040047,
+0x00000020,0x00000006,0x00000010,0x00050048,
+0x00000021,0x00000000,0x00000023,0x00000000,
+0x00050048,0x00000021,0x00000001,0x00000023,
+0x00000004,0x00050048,0x00000021,0x00000002,
+0x00000023,0x00000008,0x00050048,0x00000021,
+0x00000003,0x00000023,0x0000000c,0x00050048,
+0x00000021,0x00000004,0x00000023,0x00000010,
+0x00050048,0x00000021,0x00000005,0x00000023,
+0x00000090,0x00030047,0x00000021,0x00000002,
+0x00040047,0x00000023,0x00000022,0x00000000,
+0x00040047,0x00000023,0x00000021,0x00000002,
+0x00020013,0x00000002,0x00030021,0x00000003,
+0x00000002,0x00040015,0x00000004,0x00000020,
+0x00000000,0x00040015,0x00000005,0x00000020,
+0x00000001,0x00020014,0x00000006,0x00040017,
+0x00000007,0x00000004,0x00000003,0x00040017,
+0x00000008,0x00000004,0x00000004,0x0004002b,
+0x00000005,0x00000009,0x00000000,0x0004002b,
+0x00000005,0x0000000a,0x00000001,0x0004002b,
+0x00000005,0x0000000b,0x00000002,0x0004002b,
+0x00000005,0x0000000c,0x00000003,0x0004002b,
+0x00000005,0x0000000d,0x00000004,0x0004002b,
+0x00000005,0x0000000e,0x00000005,0x0004002b,
+0x00000004,0x0000000f,0x00000000,0x0004002b,
+0x00000004,0x00000010,0x00000001,0x0004002b,
+0x00000004,0x00000011,0x00000008,0x0004002b,
+0x00000004,0x00000012,0x00000020,0x00040020,
+0x00000013,0x00000001,0x00000007,0x0004003b,
+0x00000013,0x00000014,0x00000001,0x0006001e,
+0x00000015,0x00000004,0x00000004,0x00000004,
+0x00000004,0x00040020,0x00000016,0x00000009,
+0x00000015,0x0004003b,0x00000016,0x00000017,
+0x00000009,0x00040020,0x00000018,0x00000009,
+0x00000004,0x0003001d,0x00000019,0x00000004,
+0x0003001e,0x0000001a,0x00000019,0x00040020,
+0x0000001b,0x0000000c,0x0000001a,0x0004003b,
+0x0000001b,0x0000001c,0x0000000c,0x0004003b,
+0x0000001b,0x0000001d,0x0000000c,0x00040020,
+0x0000001e,0x0000000c,0x00000004,0x0004001c,
+0x0000001f,0x00000004,0x00000012,0x0004001c,
+0x00000020,0x00000008,0x00000011,0x0008001e,
+0x00000021,0x00000004,0x00000004,0x00000004,
+0x00000004,0x0000001f,0x00000020,0x00040020,
+0x00000022,0x0000000c,0x00000021,0x0004003b,
+0x00000022,0x00000023,0x0000000c,0x00040020,
+0x00000024,0x0000000c,0x00000008,0x00050036,
+0x00000002,0x00000025,0x00000000,0x00000003,
+0x000200f8,0x00000026,0x0004003d,0x00000007,
+0x00000027,0x00000014,0x00050051,0x00000004,
+0x00000028,0x00000027,0x00000000,0x00050041,
+0x00000018,0x00000029,0x00000017,0x00000009,
+0x0004003d,0x00000004,0x0000002a,0x00000029,
+0x000500b0,0x00000006,0x0000002b,0x00000028,
+0x0000002a,0x000300f7,0x00000052,0x00000000,
+0x000400fa,0x0000002b,0x0000002c,0x00000052,
+0x000200f8,0x0000002c,0x00060041,0x0000001e,
+0x0000002d,0x0000001c,0x00000009,0x00000028,
+0x0004003d,0x00000004,0x0000002e,0x0000002d,
+0x00060041,0x0000001e,0x0000002f,0x0000001d,
+0x00000009,0x00000028,0x0004003d,0x00000004,
+0x00000030,0x0000002f,0x00050041,0x00000018,
+0x00000031,0x00000017,0x0000000a,0x0004003d,
+0x00000004,0x00000032,0x00000031,0x00050041,
+0x00000018,0x00000033,0x00000017,0x0000000b,
+0x0004003d,0x00000004,0x00000034,0x00000033,
+0x00050041,0x00000018,0x00000035,0x00000017,
+0x0000000c,0x0004003d,0x00000004,0x00000036,
+0x00000035,0x00050084,0x00000004,0x00000037,
+0x00000028,0x00000034,0x00050080,0x00000004,
+0x00000038,0x00000037,0x00000036,0x000500aa,
+0x00000006,0x00000039,0x00000032,0x0000000f,
+0x000600a9,0x00000004,0x0000003a,0x00000039,
+0x00000030,0x00000038,0x000500ab,0x00000006,
+0x0000003b,0x0000002e,0x0000003a,0x000300f7,
+0x00000051,0x00000000,0x000400fa,0x0000003b,
+0x0000003c,0x00000051,0x000200f8,0x0000003c,
+0x000500ac,0x00000006,0x0000003d,0x0000002e,
+0x0000003a,0x00050082,0x00000004,0x0000003e,
+0x0000002e,0x0000003a,0x00050082,0x00000004,
+0x0000003f,0x0000003a,0x0000002e,0x000600a9,
+0x00000004,0x00000040,0x0000003d,0x0000003e,
+0x0000003f,0x00050041,0x0000001e,0x00000041,
+0x00000023,0x00000009,0x000700ea,0x00000004,
+0x00000042,0x00000041,0x00000010,0x0000000f,
+0x00000010,0x00050041,0x0000001e,0x00000043,
+0x00000023,0x0000000a,0x000700ed,0x00000004,
+0x00000044,0x00000043,0x00000010,0x0000000f,
+0x00000040,0x00050041,0x0000001e,0x00000045,
+0x00000023,0x0000000b,0x000700ef,0x00000004,
+0x00000046,0x00000045,0x00000010,0x0000000f,
+0x00000040,0x00050041,0x0000001e,0x00000047,
+0x00000023,0x0000000c,0x000700ed,0x00000004,
+0x00000048,0x00000047,0x00000010,0x0000000f,
+0x00000028,0x0006000c,0x00000004,0x00000049,
+0x00000001,0x0000004b,0x00000040,0x00060041,
+0x0000001e,0x0000004a,0x00000023,0x0000000d,
+0x00000049,0x000700ea,0x00000004,0x0000004b,
+0x0000004a,0x00000010,0x0000000f,0x00000010,
+0x000500b0,0x00000006,0x0000004c,0x00000042,
+0x00000011,0x000300f7,0x00000050,0x00000000,
+0x000400fa,0x0000004c,0x0000004d,0x00000050,
+0x000200f8,0x0000004d,0x00070050,0x00000008,
+0x0000004e,0x00000028,0x0000002e,0x0000003a,
+0x0000000f,0x00060041,0x00000024,0x0000004f,
+0x00000023,0x0000000e,0x00000042,0x0003003e,
+0x0000004f,0x0000004e,0x000200f9,0x00000050,
+0x000200f8,0x00000050,0x000200f9,0x00000051,
+0x000200f8,0x00000051,0x000200f9,0x00000052,
+0x000200f8,0x00000052,0x000100fd,0x00010038}
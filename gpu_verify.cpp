@@ -0,0 +1,186 @@
+#include "gpu_verify.h"
+#include "vk_simple_init.h"
+#include "volk/volk.h"
+#include "shader_cache.h"
+
+#include <stdio.h>
+
+static const uint32_t VerifyCsSpirvWords[] =
+#include "gpu_verify.comp.h"
+;
+
+struct VerifyPushConstants {
+    uint32_t count;
+    uint32_t mode; // 0: compare against the reference buffer
+    uint32_t scale;
+    uint32_t bias;
+};
+
+// Returns at the first failure, leaving whatever was created in *v for GpuVerifierInit to destroy.
+static VkResult
+CreateVerifierObjects(const VulkanObjetcs& vk, GpuVerifier *v)
+{
+    VkResult r;
+
+    {
+        VkDescriptorSetLayoutBinding bindings[3] = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT }
+        };
+        VkDescriptorSetLayoutCreateInfo setInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0,
+            3, bindings
+        };
+        if ((r = vkCreateDescriptorSetLayout(vk.device, &setInfo, VKU_ALLOC_CBS, &v->setLayout)) != VK_SUCCESS) return r;
+    }
+    {
+        const VkPushConstantRange pcRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(VerifyPushConstants) };
+        VkPipelineLayoutCreateInfo layoutInfo = {
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, nullptr, 0,
+            1, &v->setLayout,
+            1, &pcRange
+        };
+        if ((r = vkCreatePipelineLayout(vk.device, &layoutInfo, VKU_ALLOC_CBS, &v->pipelineLayout)) != VK_SUCCESS) return r;
+    }
+    {
+        VkShaderModule module = VK_NULL_HANDLE;
+        if ((r = ShaderCacheAcquire(VerifyCsSpirvWords, &module)) != VK_SUCCESS) return r;
+
+        VkComputePipelineCreateInfo pipelineInfo = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+        pipelineInfo.stage = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = module;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = v->pipelineLayout;
+        pipelineInfo.basePipelineIndex = -1;
+        r = ShaderCacheCreateComputePipeline(pipelineInfo, &v->pipeline);
+        ShaderCacheRelease(module);
+        if (r != VK_SUCCESS) return r;
+    }
+    {
+        const VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 };
+        VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        if ((r = vkCreateDescriptorPool(vk.device, &poolInfo, VKU_ALLOC_CBS, &v->descriptorPool)) != VK_SUCCESS) return r;
+
+        VkDescriptorSetAllocateInfo allocInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
+            v->descriptorPool, 1, &v->setLayout
+        };
+        if ((r = vkAllocateDescriptorSets(vk.device, &allocInfo, &v->descriptorSet)) != VK_SUCCESS) return r;
+    }
+
+    // The shader writes the summary straight into host-visible memory, it is small enough to not bother with a copy:
+    return vkuStagingBuffer(vk.device, sizeof(GpuVerifySummary),
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                            &v->summary, vk.memProps);
+}
+
+VkResult
+GpuVerifierInit(const VulkanObjetcs& vk, GpuVerifier *v)
+{
+    *v = { };
+    v->device = vk.device;
+    VkResult const r = CreateVerifierObjects(vk, v);
+    if (r != VK_SUCCESS) {
+        GpuVerifierDestroy(*v); // null handles are skipped, so this is fine on a partly created verifier
+        *v = { };
+    }
+    return r;
+}
+
+void
+GpuVerifierDestroy(const GpuVerifier& v)
+{
+    if (v.summary.buffer) vkuDestroyStagingBuffer(v.device, v.summary);
+    vkDestroyDescriptorPool(v.device, v.descriptorPool, VKU_ALLOC_CBS);
+    vkDestroyPipeline(v.device, v.pipeline, VKU_ALLOC_CBS);
+    vkDestroyPipelineLayout(v.device, v.pipelineLayout, VKU_ALLOC_CBS);
+    vkDestroyDescriptorSetLayout(v.device, v.setLayout, VKU_ALLOC_CBS);
+}
+
+static void
+CmdVerify(GpuVerifier *v, VkCommandBuffer cmdbuf, VkBuffer got, VkBuffer expected, const VerifyPushConstants& pc)
+{
+    const VkDescriptorBufferInfo bufferInfos[3] = {
+        { got, 0, VK_WHOLE_SIZE },
+        { expected, 0, VK_WHOLE_SIZE },
+        { v->summary.buffer, 0, VK_WHOLE_SIZE }
+    };
+    VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstSet = v->descriptorSet;
+    write.dstBinding = 0;
+    write.descriptorCount = 3; // consecutive bindings of the same type
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = bufferInfos;
+    vkUpdateDescriptorSets(v->device, 1, &write, 0, nullptr);
+
+    // One command for the reset so there is no write-after-write between transfers to worry about:
+    GpuVerifySummary init = { };
+    init.minError = ~0u;
+    init.firstIndex = ~0u;
+    vkCmdUpdateBuffer(cmdbuf, v->summary.buffer, 0, sizeof init, &init);
+
+    VkMemoryBarrier membar = {
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    };
+    vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0x0, 1, &membar, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, v->pipeline);
+    vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, v->pipelineLayout, 0, 1, &v->descriptorSet, 0, nullptr);
+    vkCmdPushConstants(cmdbuf, v->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof pc, &pc);
+    vkCmdDispatch(cmdbuf, (pc.count + 63) / 64, 1, 1);
+
+    membar.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    membar.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0x0,
+                         1, &membar, 0, nullptr, 0, nullptr);
+}
+
+void
+GpuVerifierCmdCompareBuffers(GpuVerifier *v, VkCommandBuffer cmdbuf, VkBuffer got, VkBuffer expected, uint32_t numElements)
+{
+    const VerifyPushConstants pc = { numElements, 0, 0, 0 };
+    CmdVerify(v, cmdbuf, got, expected, pc);
+}
+
+void
+GpuVerifierCmdCompareAnalytic(GpuVerifier *v, VkCommandBuffer cmdbuf, VkBuffer got, uint32_t numElements,
+                              uint32_t scale, uint32_t bias)
+{
+    // The shader always loads the reference binding; pointing it at got keeps those loads in cache:
+    const VerifyPushConstants pc = { numElements, 1, scale, bias };
+    CmdVerify(v, cmdbuf, got, got, pc);
+}
+
+const GpuVerifySummary&
+GpuVerifierReadSummary(const GpuVerifier& v)
+{
+    vkuInvalidateStagingBuffer(v.device, v.summary);
+    return *static_cast<const GpuVerifySummary *>(v.summary.pHost);
+}
+
+void
+PrintGpuVerifySummary(const char *what, const GpuVerifySummary& s)
+{
+    if (s.numMismatches == 0) {
+        return;
+    }
+    printf("%s: %u mismatches, first at index %u, abs error in [%u, %u].\n",
+           what, s.numMismatches, s.firstIndex, s.minError, s.maxError);
+    printf("    error histogram (log2 buckets):");
+    for (unsigned k = 0; k < 32; ++k) {
+        if (s.errorHistogram[k]) printf(" [2^%u]=%u", k, s.errorHistogram[k]);
+    }
+    putchar('\n');
+    uint32_t const numSamples = s.numMismatches < GpuVerifyMaxSamples ? s.numMismatches : GpuVerifyMaxSamples;
+    for (uint32_t i = 0; i < numSamples; ++i) {
+        printf("    [%u]: got 0x%X, expected 0x%X\n", s.samples[i].index, s.samples[i].got, s.samples[i].expected);
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "vk_util.h"
+
+struct VulkanObjetcs;
+
+/*
+ * Compares a buffer of 32-bit values on the device, either against a reference buffer
+ * or against an analytic expectation, and writes only a small summary to host memory.
+ * Images can be compared by first copying them to a buffer with vkCmdCopyImageToBuffer.
+ * This keeps the full-size readback and host compare out of repeat runs; do a full readback
+ * only once a summary reports a mismatch.
+ *
+ * Shader: gpu_verify.comp, hand-written SPIR-V in gpu_verify.comp.h.
+ */
+
+enum { GpuVerifyMaxSamples = 8 };
+
+// Layout matches the Summary block in gpu_verify.comp.
+struct GpuVerifySummary {
+    uint32_t numMismatches;
+    uint32_t minError;   // abs difference, as unsigned integers. Only valid if numMismatches != 0.
+    uint32_t maxError;
+    uint32_t firstIndex; // lowest mismatching index
+    uint32_t errorHistogram[32]; // [k] counts mismatches with abs error in [2^k, 2^(k+1))
+    struct { uint32_t index, got, expected, unused; } samples[GpuVerifyMaxSamples]; // min(numMismatches, 8) valid, in no particular order
+};
+
+/*
+ * One comparison may be in flight per GpuVerifier: the descriptor set is rewritten
+ * when recording, so wait for the previous submit before recording the next compare.
+ */
+struct GpuVerifier {
+    VkDevice device;
+    VkDescriptorSetLayout setLayout;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+    VkuStagingBuffer summary;
+};
+
+// On failure nothing is left to destroy.
+VkResult
+GpuVerifierInit(const VulkanObjetcs& vk, GpuVerifier *v);
+void
+GpuVerifierDestroy(const GpuVerifier& v);
+
+/*
+ * Records got[i] == expected[i] for i in [0, numElements).
+ * Buffers need VK_BUFFER_USAGE_STORAGE_BUFFER_BIT. Earlier transfer or compute writes to them in the same
+ * queue are made visible by a barrier recorded here; anything else is up to the caller.
+ */
+void
+GpuVerifierCmdCompareBuffers(GpuVerifier *v, VkCommandBuffer cmdbuf, VkBuffer got, VkBuffer expected, uint32_t numElements);
+
+// Records got[i] == i * scale + bias (wrapping) for i in [0, numElements).
+void
+GpuVerifierCmdCompareAnalytic(GpuVerifier *v, VkCommandBuffer cmdbuf, VkBuffer got, uint32_t numElements,
+                              uint32_t scale, uint32_t bias);
+
+// Call after the submit containing the compare has completed.
+const GpuVerifySummary&
+GpuVerifierReadSummary(const GpuVerifier& v);
+
+// Prints nothing if there were no mismatches.
+void
+PrintGpuVerifySummary(const char *what, const GpuVerifySummary& s);
@@ -0,0 +1,440 @@
+#include "image_compare.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define IMAGE_COMPARE_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define IMAGE_COMPARE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/*
+ * Each kernel returns the index of the first mismatching element in [0, n), or n if all match.
+ * Elements are bytes for the exact and u8 kernels, and 32-bit words for the float kernel.
+ */
+typedef size_t (*FindExactFn)(const uint8_t *a, const uint8_t *b, size_t n);
+typedef size_t (*FindTolU8Fn)(const uint8_t *a, const uint8_t *b, size_t n, uint8_t tol);
+typedef size_t (*FindUlpF32Fn)(const uint32_t *a, const uint32_t *b, size_t n, uint32_t maxUlp);
+
+struct CompareKernels {
+    const char *name;
+    FindExactFn findExact;
+    FindTolU8Fn findTolU8;
+    FindUlpF32Fn findUlpF32;
+};
+
+static inline unsigned
+CountTrailingZeros(uint32_t x)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, x);
+    return unsigned(i);
+#else
+    return unsigned(__builtin_ctz(x));
+#endif
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Scalar, also used for the tails of the SIMD kernels:
+
+static size_t
+FindExact_Scalar(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i < n; ++i) {
+        if (a[i] != b[i]) break;
+    }
+    return i;
+}
+
+static size_t
+FindTolU8_Scalar(const uint8_t *a, const uint8_t *b, size_t n, uint8_t tol)
+{
+    size_t i = 0;
+    for (; i < n; ++i) {
+        int const d = int(a[i]) - int(b[i]);
+        if (d > tol || -d > tol) break;
+    }
+    return i;
+}
+
+// Maps float bits to an unsigned key that increases with the float value, so ULP distance is a subtraction:
+static inline uint32_t
+OrderedKeyF32(uint32_t u)
+{
+    return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+static inline bool
+IsNanF32(uint32_t u)
+{
+    return (u & 0x7fffffffu) > 0x7f800000u;
+}
+
+static size_t
+FindUlpF32_Scalar(const uint32_t *a, const uint32_t *b, size_t n, uint32_t maxUlp)
+{
+    size_t i = 0;
+    for (; i < n; ++i) {
+        uint32_t const x = a[i], y = b[i];
+        if (x == y) continue;
+        if (IsNanF32(x) || IsNanF32(y)) break;
+        uint32_t const kx = OrderedKeyF32(x), ky = OrderedKeyF32(y);
+        if ((kx > ky ? kx - ky : ky - kx) > maxUlp) break;
+    }
+    return i;
+}
+
+static const CompareKernels ScalarKernels = { "scalar", FindExact_Scalar, FindTolU8_Scalar, FindUlpF32_Scalar };
+
+// ---------------------------------------------------------------------------------------------------------------------
+#if IMAGE_COMPARE_X86
+
+static size_t
+FindExact_SSE2(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    // Unrolled so the common all-equal case is one movemask per 64 bytes:
+    for (; i + 64 <= n; i += 64) {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i)));
+        eq = _mm_and_si128(eq, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 16)), _mm_loadu_si128((const __m128i *)(b + i + 16))));
+        eq = _mm_and_si128(eq, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 32)), _mm_loadu_si128((const __m128i *)(b + i + 32))));
+        eq = _mm_and_si128(eq, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 48)), _mm_loadu_si128((const __m128i *)(b + i + 48))));
+        if (_mm_movemask_epi8(eq) != 0xffff) break;
+    }
+    for (; i + 16 <= n; i += 16) {
+        __m128i const eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i)));
+        uint32_t const ne = ~uint32_t(_mm_movemask_epi8(eq)) & 0xffffu;
+        if (ne) return i + CountTrailingZeros(ne);
+    }
+    return i + FindExact_Scalar(a + i, b + i, n - i);
+}
+
+static size_t
+FindTolU8_SSE2(const uint8_t *a, const uint8_t *b, size_t n, uint8_t tol)
+{
+    __m128i const tolv = _mm_set1_epi8(char(tol));
+    __m128i const zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i const x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i const y = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i const absDiff = _mm_or_si128(_mm_subs_epu8(x, y), _mm_subs_epu8(y, x));
+        __m128i const over = _mm_subs_epu8(absDiff, tolv); // nonzero where absDiff > tol
+        uint32_t const ne = ~uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(over, zero))) & 0xffffu;
+        if (ne) return i + CountTrailingZeros(ne);
+    }
+    return i + FindTolU8_Scalar(a + i, b + i, n - i, tol);
+}
+
+/* SSE2 has no unsigned 32-bit compare, so unsigned values are compared as signed after flipping the sign bit.
+ * Returns a 4-bit mask of lanes that mismatch. */
+static inline uint32_t
+UlpMismatchMask_SSE2(__m128i x, __m128i y, __m128i maxUlpBiased)
+{
+    __m128i const sign = _mm_set1_epi32(int(0x80000000u));
+    __m128i const expMask = _mm_set1_epi32(0x7f800000);
+    __m128i const absMask = _mm_set1_epi32(0x7fffffff);
+
+    // key = negative ? ~u : u | sign
+    __m128i const xNeg = _mm_srai_epi32(x, 31);
+    __m128i const yNeg = _mm_srai_epi32(y, 31);
+    __m128i const kx = _mm_xor_si128(x, _mm_or_si128(xNeg, sign));
+    __m128i const ky = _mm_xor_si128(y, _mm_or_si128(yNeg, sign));
+
+    __m128i const xGreater = _mm_cmpgt_epi32(_mm_xor_si128(kx, sign), _mm_xor_si128(ky, sign));
+    __m128i const dxy = _mm_sub_epi32(kx, ky);
+    __m128i const dyx = _mm_sub_epi32(ky, kx);
+    __m128i const dist = _mm_or_si128(_mm_and_si128(xGreater, dxy), _mm_andnot_si128(xGreater, dyx));
+    __m128i bad = _mm_cmpgt_epi32(_mm_xor_si128(dist, sign), maxUlpBiased);
+
+    __m128i const anyNan = _mm_or_si128(_mm_cmpgt_epi32(_mm_and_si128(x, absMask), expMask),
+                                        _mm_cmpgt_epi32(_mm_and_si128(y, absMask), expMask));
+    __m128i const bitsEqual = _mm_cmpeq_epi32(x, y);
+    bad = _mm_andnot_si128(bitsEqual, _mm_or_si128(bad, anyNan));
+    return uint32_t(_mm_movemask_ps(_mm_castsi128_ps(bad)));
+}
+
+static size_t
+FindUlpF32_SSE2(const uint32_t *a, const uint32_t *b, size_t n, uint32_t maxUlp)
+{
+    __m128i const maxUlpBiased = _mm_set1_epi32(int(maxUlp ^ 0x80000000u));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32_t const ne = UlpMismatchMask_SSE2(_mm_loadu_si128((const __m128i *)(a + i)),
+                                                 _mm_loadu_si128((const __m128i *)(b + i)), maxUlpBiased);
+        if (ne) return i + CountTrailingZeros(ne);
+    }
+    return i + FindUlpF32_Scalar(a + i, b + i, n - i, maxUlp);
+}
+
+static const CompareKernels Sse2Kernels = { "sse2", FindExact_SSE2, FindTolU8_SSE2, FindUlpF32_SSE2 };
+
+
+TARGET_AVX2 static size_t
+FindExact_AVX2(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 128 <= n; i += 128) {
+        __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i)));
+        eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i + 32)), _mm256_loadu_si256((const __m256i *)(b + i + 32))));
+        eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i + 64)), _mm256_loadu_si256((const __m256i *)(b + i + 64))));
+        eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i + 96)), _mm256_loadu_si256((const __m256i *)(b + i + 96))));
+        if (uint32_t(_mm256_movemask_epi8(eq)) != 0xffffffffu) break;
+    }
+    for (; i + 32 <= n; i += 32) {
+        __m256i const eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i)));
+        uint32_t const ne = ~uint32_t(_mm256_movemask_epi8(eq));
+        if (ne) return i + CountTrailingZeros(ne);
+    }
+    return i + FindExact_SSE2(a + i, b + i, n - i);
+}
+
+TARGET_AVX2 static size_t
+FindTolU8_AVX2(const uint8_t *a, const uint8_t *b, size_t n, uint8_t tol)
+{
+    __m256i const tolv = _mm256_set1_epi8(char(tol));
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i const x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i const y = _mm256_loadu_si256((const __m256i *)(b + i));
+        // absDiff <= tol  <=>  max(absDiff, tol) == tol
+        __m256i const absDiff = _mm256_sub_epi8(_mm256_max_epu8(x, y), _mm256_min_epu8(x, y));
+        uint32_t const ne = ~uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(absDiff, tolv), tolv)));
+        if (ne) return i + CountTrailingZeros(ne);
+    }
+    return i + FindTolU8_SSE2(a + i, b + i, n - i, tol);
+}
+
+TARGET_AVX2 static size_t
+FindUlpF32_AVX2(const uint32_t *a, const uint32_t *b, size_t n, uint32_t maxUlp)
+{
+    __m256i const sign = _mm256_set1_epi32(int(0x80000000u));
+    __m256i const expMask = _mm256_set1_epi32(0x7f800000);
+    __m256i const absMask = _mm256_set1_epi32(0x7fffffff);
+    __m256i const maxUlpv = _mm256_set1_epi32(int(maxUlp));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i const x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i const y = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i const kx = _mm256_xor_si256(x, _mm256_or_si256(_mm256_srai_epi32(x, 31), sign));
+        __m256i const ky = _mm256_xor_si256(y, _mm256_or_si256(_mm256_srai_epi32(y, 31), sign));
+        // AVX2 has unsigned min/max, so dist = max - min, and dist <= maxUlp <=> min(dist, maxUlp) == dist:
+        __m256i const dist = _mm256_sub_epi32(_mm256_max_epu32(kx, ky), _mm256_min_epu32(kx, ky));
+        __m256i const ok = _mm256_cmpeq_epi32(_mm256_min_epu32(dist, maxUlpv), dist);
+        __m256i const anyNan = _mm256_or_si256(_mm256_cmpgt_epi32(_mm256_and_si256(x, absMask), expMask),
+                                               _mm256_cmpgt_epi32(_mm256_and_si256(y, absMask), expMask));
+        __m256i const bad = _mm256_andnot_si256(_mm256_cmpeq_epi32(x, y), _mm256_or_si256(_mm256_andnot_si256(ok, sign), anyNan));
+        uint32_t const ne = uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(bad)));
+        if (ne) return i + CountTrailingZeros(ne);
+    }
+    return i + FindUlpF32_SSE2(a + i, b + i, n - i, maxUlp);
+}
+
+static const CompareKernels Avx2Kernels = { "avx2", FindExact_AVX2, FindTolU8_AVX2, FindUlpF32_AVX2 };
+
+static bool
+CpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7) return false;
+    __cpuid(regs, 1);
+    bool const osxsave = (regs[2] & (1 << 27)) != 0;
+    bool const avx = (regs[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false; // OS saves ymm state
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // IMAGE_COMPARE_X86
+
+// ---------------------------------------------------------------------------------------------------------------------
+#if IMAGE_COMPARE_NEON
+
+static size_t
+FindExact_NEON(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        uint8x16_t eq = vceqq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        eq = vandq_u8(eq, vceqq_u8(vld1q_u8(a + i + 16), vld1q_u8(b + i + 16)));
+        eq = vandq_u8(eq, vceqq_u8(vld1q_u8(a + i + 32), vld1q_u8(b + i + 32)));
+        eq = vandq_u8(eq, vceqq_u8(vld1q_u8(a + i + 48), vld1q_u8(b + i + 48)));
+        if (vminvq_u8(eq) != 0xff) break;
+    }
+    for (; i + 16 <= n; i += 16) {
+        if (vminvq_u8(vceqq_u8(vld1q_u8(a + i), vld1q_u8(b + i))) != 0xff) break;
+    }
+    return i + FindExact_Scalar(a + i, b + i, n - i);
+}
+
+static size_t
+FindTolU8_NEON(const uint8_t *a, const uint8_t *b, size_t n, uint8_t tol)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        if (vmaxvq_u8(vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i))) > tol) break;
+    }
+    return i + FindTolU8_Scalar(a + i, b + i, n - i, tol);
+}
+
+static size_t
+FindUlpF32_NEON(const uint32_t *a, const uint32_t *b, size_t n, uint32_t maxUlp)
+{
+    uint32x4_t const sign = vdupq_n_u32(0x80000000u);
+    uint32x4_t const expMask = vdupq_n_u32(0x7f800000u);
+    uint32x4_t const absMask = vdupq_n_u32(0x7fffffffu);
+    uint32x4_t const maxUlpv = vdupq_n_u32(maxUlp);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t const x = vld1q_u32(a + i);
+        uint32x4_t const y = vld1q_u32(b + i);
+        uint32x4_t const xNeg = vreinterpretq_u32_s32(vshrq_n_s32(vreinterpretq_s32_u32(x), 31));
+        uint32x4_t const yNeg = vreinterpretq_u32_s32(vshrq_n_s32(vreinterpretq_s32_u32(y), 31));
+        uint32x4_t const kx = veorq_u32(x, vorrq_u32(xNeg, sign));
+        uint32x4_t const ky = veorq_u32(y, vorrq_u32(yNeg, sign));
+        uint32x4_t const far = vcgtq_u32(vabdq_u32(kx, ky), maxUlpv);
+        uint32x4_t const anyNan = vorrq_u32(vcgtq_u32(vandq_u32(x, absMask), expMask),
+                                            vcgtq_u32(vandq_u32(y, absMask), expMask));
+        uint32x4_t const bad = vbicq_u32(vorrq_u32(far, anyNan), vceqq_u32(x, y));
+        if (vmaxvq_u32(bad) != 0) break;
+    }
+    return i + FindUlpF32_Scalar(a + i, b + i, n - i, maxUlp);
+}
+
+static const CompareKernels NeonKernels = { "neon", FindExact_NEON, FindTolU8_NEON, FindUlpF32_NEON };
+
+#endif // IMAGE_COMPARE_NEON
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+static const CompareKernels *
+SelectKernels()
+{
+#if IMAGE_COMPARE_X86
+    return CpuHasAvx2() ? &Avx2Kernels : &Sse2Kernels;
+#elif IMAGE_COMPARE_NEON
+    return &NeonKernels;
+#else
+    return &ScalarKernels;
+#endif
+}
+
+// Compares run on thread pool workers, so the choice is a thread-safe function-local static initialization:
+static const CompareKernels *
+GetKernels()
+{
+    static const CompareKernels *const s_pKernels = SelectKernels();
+    return s_pKernels;
+}
+
+const char *
+ImageCompareKernelName()
+{
+    return GetKernels()->name;
+}
+
+static void
+RecordMismatch(ImageCompareResult *r, uint32_t x, uint32_t y)
+{
+    if (r->numMismatches == 0) {
+        r->minX = r->maxX = x;
+        r->minY = r->maxY = y;
+    } else {
+        if (x < r->minX) r->minX = x;
+        if (x > r->maxX) r->maxX = x;
+        if (y < r->minY) r->minY = y;
+        if (y > r->maxY) r->maxY = y;
+    }
+    if (r->numReported < ImageCompareMaxReported) {
+        r->first[r->numReported].x = x;
+        r->first[r->numReported].y = y;
+        r->numReported++;
+    }
+    r->numMismatches++;
+}
+
+/*
+ * Scans runs of pixels with find(a, b, nElems) and restarts after the pixel holding each mismatch.
+ * If both images are tightly packed the whole image is a single run.
+ */
+template<class Elem, class FindFn> static void
+CompareRuns(const ImageCompareDesc& desc, FindFn find, ImageCompareResult *result)
+{
+    *result = { };
+    assert(desc.bytesPerPixel % sizeof(Elem) == 0);
+    size_t const packedPitch = size_t(desc.width) * desc.bytesPerPixel;
+    size_t const gotPitch = desc.gotRowPitch ? desc.gotRowPitch : packedPitch;
+    size_t const expectedPitch = desc.expectedRowPitch ? desc.expectedRowPitch : packedPitch;
+    bool const bSingleRun = (gotPitch == packedPitch && expectedPitch == packedPitch);
+    uint32_t const numRuns = bSingleRun ? 1 : desc.height;
+    size_t const elemsPerRun = (bSingleRun ? packedPitch * desc.height : packedPitch) / sizeof(Elem);
+    size_t const elemsPerPixel = desc.bytesPerPixel / sizeof(Elem);
+
+    for (uint32_t run = 0; run < numRuns; ++run) {
+        const Elem *const a = reinterpret_cast<const Elem *>(static_cast<const uint8_t *>(desc.pGot) + run * gotPitch);
+        const Elem *const b = reinterpret_cast<const Elem *>(static_cast<const uint8_t *>(desc.pExpected) + run * expectedPitch);
+        size_t i = 0;
+        while (i < elemsPerRun) {
+            i += find(a + i, b + i, elemsPerRun - i);
+            if (i >= elemsPerRun) break;
+            size_t const pixel = i / elemsPerPixel;
+            uint32_t const x = bSingleRun ? uint32_t(pixel % desc.width) : uint32_t(pixel);
+            uint32_t const y = bSingleRun ? uint32_t(pixel / desc.width) : run;
+            RecordMismatch(result, x, y);
+            i = (pixel + 1) * elemsPerPixel;
+        }
+    }
+}
+
+void
+CompareImagesExact(const ImageCompareDesc& desc, ImageCompareResult *result)
+{
+    FindExactFn const fn = GetKernels()->findExact;
+    CompareRuns<uint8_t>(desc, [fn](const uint8_t *a, const uint8_t *b, size_t n) { return fn(a, b, n); }, result);
+}
+
+void
+CompareImagesTolU8(const ImageCompareDesc& desc, uint8_t tolerance, ImageCompareResult *result)
+{
+    FindTolU8Fn const fn = GetKernels()->findTolU8;
+    CompareRuns<uint8_t>(desc, [fn, tolerance](const uint8_t *a, const uint8_t *b, size_t n) { return fn(a, b, n, tolerance); }, result);
+}
+
+void
+CompareImagesUlpF32(const ImageCompareDesc& desc, uint32_t maxUlp, ImageCompareResult *result)
+{
+    FindUlpF32Fn const fn = GetKernels()->findUlpF32;
+    CompareRuns<uint32_t>(desc, [fn, maxUlp](const uint32_t *a, const uint32_t *b, size_t n) { return fn(a, b, n, maxUlp); }, result);
+}
+
+void
+PrintImageCompareResult(const char *what, const ImageCompareResult& r)
+{
+    if (r.numMismatches == 0) {
+        return;
+    }
+    printf("%s: %llu mismatching pixels within x=[%u, %u], y=[%u, %u]. First:",
+           what, (unsigned long long)r.numMismatches, r.minX, r.maxX, r.minY, r.maxY);
+    for (uint32_t i = 0; i < r.numReported; ++i) {
+        printf(" (%u, %u)", r.first[i].x, r.first[i].y);
+    }
+    putchar('\n');
+}
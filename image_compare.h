@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Compare a generated image against an expected one. Used by the verification loops instead of
+ * per-pixel scalar compares; each row is scanned with the widest kernel the CPU supports
+ * (AVX2, SSE2 or NEON, else scalar) and only mismatching pixels are looked at individually.
+ */
+
+enum { ImageCompareMaxReported = 8 };
+
+struct ImageCompareDesc {
+    const void *pGot;
+    const void *pExpected;
+    uint32_t width, height;
+    uint32_t bytesPerPixel;
+    size_t gotRowPitch;      // 0 means tightly packed
+    size_t expectedRowPitch; // 0 means tightly packed
+};
+
+struct ImageCompareResult {
+    uint64_t numMismatches;
+    uint32_t numReported; // min(numMismatches, ImageCompareMaxReported)
+    struct { uint32_t x, y; } first[ImageCompareMaxReported]; // in scan order
+    // Bounding box of all mismatches, inclusive. Only valid if numMismatches != 0.
+    uint32_t minX, minY, maxX, maxY;
+};
+
+// Every byte must match. Works for any format.
+void CompareImagesExact(const ImageCompareDesc& desc, ImageCompareResult *result);
+
+// Each 8-bit channel may differ by at most tolerance.
+void CompareImagesTolU8(const ImageCompareDesc& desc, uint8_t tolerance, ImageCompareResult *result);
+
+/*
+ * Each 32-bit float channel may be at most maxUlp representable values apart (bytesPerPixel must be a multiple of 4).
+ * +0 and -0 are 1 ULP apart. A NaN only matches the exact same bit pattern.
+ */
+void CompareImagesUlpF32(const ImageCompareDesc& desc, uint32_t maxUlp, ImageCompareResult *result);
+
+// Name of the kernel set picked at runtime, e.g. "avx2".
+const char *ImageCompareKernelName();
+
+// Prints the mismatch count, bounding box and first reported coordinates, if any.
+void PrintImageCompareResult(const char *what, const ImageCompareResult& result);
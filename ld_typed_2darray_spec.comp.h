@@ -0,0 +1,164 @@
+// Hand-written SPIR-V matching ld_typed_2darray_spec.comp, words assembled from the listing below.
+
+/*
+; SPIR-V
+; Version: 1.3
+; Bound: 55
+; Schema: 0
+               OpCapability Shader ; 0x00000014
+          %glsl = OpExtInstImport "GLSL.std.450" ; 0x0000001c
+               OpMemoryModel Logical GLSL450 ; 0x00000034
+               OpEntryPoint GLCompute %main "main" %gid ; 0x00000040
+               OpExecutionMode %main LocalSize 8 8 1 ; 0x00000058
+               OpDecorate %gid BuiltIn GlobalInvocationId ; 0x00000070
+               OpDecorate %OobLayer SpecId 0 ; 0x00000080
+               OpDecorate %CoordOffsetX SpecId 1 ; 0x00000090
+               OpDecorate %LocalSizeX SpecId 2 ; 0x000000a0
+               OpDecorate %LocalSizeY SpecId 3 ; 0x000000b0
+               OpDecorate %FromPushConstants SpecId 4 ; 0x000000c0
+               OpDecorate %gl_WorkGroupSize BuiltIn WorkgroupSize ; 0x000000d0
+               OpMemberDecorate %PushConsts 0 Offset 0 ; 0x000000e0
+               OpDecorate %PushConsts Block ; 0x000000f4
+               OpDecorate %inputSrv DescriptorSet 0 ; 0x00000100
+               OpDecorate %inputSrv Binding 0 ; 0x00000110
+               OpDecorate %outputUav DescriptorSet 0 ; 0x00000120
+               OpDecorate %outputUav Binding 1 ; 0x00000130
+          %void = OpTypeVoid ; 0x00000140
+        %fnvoid = OpTypeFunction %void ; 0x00000148
+          %uint = OpTypeInt 32 0 ; 0x00000154
+           %int = OpTypeInt 32 1 ; 0x00000164
+          %bool = OpTypeBool ; 0x00000174
+        %v2uint = OpTypeVector %uint 2 ; 0x0000017c
+        %v3uint = OpTypeVector %uint 3 ; 0x0000018c
+        %v4uint = OpTypeVector %uint 4 ; 0x0000019c
+         %v2int = OpTypeVector %int 2 ; 0x000001ac
+         %v3int = OpTypeVector %int 3 ; 0x000001bc
+%_ptr_Input_v3uint = OpTypePointer Input %v3uint ; 0x000001cc
+           %gid = OpVariable %_ptr_Input_v3uint Input ; 0x000001dc
+        %uint_0 = OpConstant %uint 0 ; 0x000001ec
+        %uint_1 = OpConstant %uint 1 ; 0x000001fc
+        %uint_7 = OpConstant %uint 7 ; 0x0000020c
+         %int_0 = OpConstant %int 0 ; 0x0000021c
+      %OobLayer = OpSpecConstant %uint 0xffffffff ; 0x0000022c
+  %CoordOffsetX = OpSpecConstant %uint 1 ; 0x0000023c
+    %LocalSizeX = OpSpecConstant %uint 8 ; 0x0000024c
+    %LocalSizeY = OpSpecConstant %uint 8 ; 0x0000025c
+%FromPushConstants = OpSpecConstantFalse %bool ; 0x0000026c
+%gl_WorkGroupSize = OpSpecConstantComposite %v3uint %LocalSizeX %LocalSizeY %uint_1 ; 0x00000278
+    %PushConsts = OpTypeStruct %v4uint ; 0x00000290
+%_ptr_PushConstant_PushConsts = OpTypePointer PushConstant %PushConsts ; 0x0000029c
+            %pc = OpVariable %_ptr_PushConstant_PushConsts PushConstant ; 0x000002ac
+%_ptr_PushConstant_uint = OpTypePointer PushConstant %uint ; 0x000002bc
+       %srvType = OpTypeImage %uint 2D 0 1 0 1 Unknown ; 0x000002cc
+%_ptr_UniformConstant_srvType = OpTypePointer UniformConstant %srvType ; 0x000002f0
+      %inputSrv = OpVariable %_ptr_UniformConstant_srvType UniformConstant ; 0x00000300
+       %uavType = OpTypeImage %uint 2D 0 0 0 2 R32ui ; 0x00000310
+%_ptr_UniformConstant_uavType = OpTypePointer UniformConstant %uavType ; 0x00000334
+     %outputUav = OpVariable %_ptr_UniformConstant_uavType UniformConstant ; 0x00000344
+          %main = OpFunction %void None %fnvoid ; 0x00000354
+         %entry = OpLabel ; 0x00000368
+             %g = OpLoad %v3uint %gid ; 0x00000370
+           %tid = OpVectorShuffle %v2uint %g %g 0 1 ; 0x00000380
+            %tx = OpCompositeExtract %uint %g 0 ; 0x0000039c
+            %ty = OpCompositeExtract %uint %g 1 ; 0x000003b0
+        %pcxPtr = OpAccessChain %_ptr_PushConstant_uint %pc %int_0 %uint_0 ; 0x000003c4
+           %pcx = OpLoad %uint %pcxPtr ; 0x000003dc
+        %pcyPtr = OpAccessChain %_ptr_PushConstant_uint %pc %int_0 %uint_1 ; 0x000003ec
+           %pcy = OpLoad %uint %pcyPtr ; 0x00000404
+           %oob = OpSelect %uint %FromPushConstants %pcx %OobLayer ; 0x00000414
+       %offsetX = OpSelect %uint %FromPushConstants %pcy %CoordOffsetX ; 0x0000042c
+            %cx = OpIAdd %uint %tx %offsetX ; 0x00000444
+       %inRange = OpULessThan %bool %ty %uint_7 ; 0x00000458
+            %cz = OpSelect %uint %inRange %ty %oob ; 0x0000046c
+             %c = OpCompositeConstruct %v3uint %cx %ty %cz ; 0x00000484
+           %img = OpLoad %srvType %inputSrv ; 0x0000049c
+            %ci = OpBitcast %v3int %c ; 0x000004ac
+          %data = OpImageFetch %v4uint %img %ci Lod %int_0 ; 0x000004bc
+           %out = OpLoad %uavType %outputUav ; 0x000004d8
+            %oi = OpBitcast %v2int %tid ; 0x000004e8
+               OpImageWrite %out %oi %data ; 0x000004f8
+               OpReturn ; 0x00000508
+               OpFunctionEnd ; 0x0000050c
+*/
+
+{0x07230203,0x00010300,0x00000000,0x00000037,
+0x00000000,0x00020011,0x00000001,0x0006000b,
+0x00000001,0x4c534c47,0x6474732e,0x3035342e,
+0x00000000,0x0003000e,0x00000000,0x00000001,
+0x0006000f,0x00000005,0x00000022,0x6e69616d,
+0x00000000,0x0000000d,0x00060010,0x00000022,
+0x00000011,0x00000008,0x00000008,0x00000001,
+0x00040047,0x0000000d,0x0000000b,0x0000001c,
+0x00040047,0x00000012,0x00000001,0x00000000,
+0x00040047,0x00000013,0x00000001,0x00000001,
+0x00040047,0x00000014,0x00000001,0x00000002,
+0x00040047,0x00000015,0x00000001,0x00000003,
+0x00040047,0x00000016,0x00000001,0x00000004,
+0x00040047,0x00000017,0x0000000b,0x00000019,
+0x00050048,0x00000018,0x00000000,0x00000023,
+0x00000000,0x00030047,0x00000018,0x00000002,
+0x00040047,0x0000001e,0x00000022,0x00000000,
+0x00040047,0x0000001e,0x00000021,0x00000000,
+0x00040047,0x00000021,0x00000022,0x00000000,
+0x00040047,0x00000021,0x00000021,0x00000001,
+0x00020013,0x00000002,0x00030021,0x00000003,
+0x00000002,0x00040015,0x00000004,0x00000020,
+0x00000000,0x00040015,0x00000005,0x00000020,
+0x00000001,0x00020014,0x00000006,0x00040017,
+0x00000007,0x00000004,0x00000002,0x00040017,
+0x00000008,0x00000004,0x00000003,0x00040017,
+0x00000009,0x00000004,0x00000004,0x00040017,
+0x0000000a,0x00000005,0x00000002,0x00040017,
+0x0000000b,0x00000005,0x00000003,0x00040020,
+0x0000000c,0x00000001,0x00000008,0x0004003b,
+0x0000000c,0x0000000d,0x00000001,0x0004002b,
+0x00000004,0x0000000e,0x00000000,0x0004002b,
+0x00000004,0x0000000f,0x00000001,0x0004002b,
+0x00000004,0x00000010,0x00000007,0x0004002b,
+0x00000005,0x00000011,0x00000000,0x00040032,
+0x00000004,0x00000012,0xffffffff,0x00040032,
+0x00000004,0x00000013,0x00000001,0x00040032,
+0x00000004,0x00000014,0x00000008,0x00040032,
+0x00000004,0x00000015,0x00000008,0x00030031,
+0x00000006,0x00000016,0x00060033,0x00000008,
+0x00000017,0x00000014,0x00000015,0x0000000f,
+0x0003001e,0x00000018,0x00000009,0x00040020,
+0x00000019,0x00000009,0x00000018,0x0004003b,
+0x00000019,0x0000001a,0x00000009,0x00040020,
+0x0000001b,0x00000009,0x00000004,0x00090019,
+0x0000001c,0x00000004,0x00000001,0x00000000,
+0x00000001,0x00000000,0x00000001,0x00000000,
+0x00040020,0x0000001d,0x00000000,0x0000001c,
+0x0004003b,0x0000001d,0x0000001e,0x00000000,
+0x00090019,0x0000001f,0x00000004,0x00000001,
+0x00000000,0x00000000,0x00000000,0x00000002,
+0x00000021,0x00040020,0x00000020,0x00000000,
+0x0000001f,0x0004003b,0x00000020,0x00000021,
+0x00000000,0x00050036,0x00000002,0x00000022,
+0x00000000,0x00000003,0x000200f8,0x00000023,
+0x0004003d,0x00000008,0x00000024,0x0000000d,
+0x0007004f,0x00000007,0x00000025,0x00000024,
+0x00000024,0x00000000,0x00000001,0x00050051,
+0x00000004,0x00000026,0x00000024,0x00000000,
+0x00050051,0x00000004,0x00000027,0x00000024,
+0x00000001,0x00060041,0x0000001b,0x00000028,
+0x0000001a,0x00000011,0x0000000e,0x0004003d,
+0x00000004,0x00000029,0x00000028,0x00060041,
+0x0000001b,0x0000002a,0x0000001a,0x00000011,
+0x0000000f,0x0004003d,0x00000004,0x0000002b,
+0x0000002a,0x000600a9,0x00000004,0x0000002c,
+0x00000016,0x00000029,0x00000012,0x000600a9,
+0x00000004,0x0000002d,0x00000016,0x0000002b,
+0x00000013,0x00050080,0x00000004,0x0000002e,
+0x00000026,0x0000002d,0x000500b0,0x00000006,
+0x0000002f,0x00000027,0x00000010,0x000600a9,
+0x00000004,0x00000030,0x0000002f,0x00000027,
+0x0000002c,0x00060050,0x00000008,0x00000031,
+0x0000002e,0x00000027,0x00000030,0x0004003d,
+0x0000001c,0x00000032,0x0000001e,0x0004007c,
+0x0000000b,0x00000033,0x00000031,0x0007005f,
+0x00000009,0x00000034,0x00000032,0x00000033,
+0x00000002,0x00000011,0x0004003d,0x0000001f,
+0x00000035,0x00000021,0x0004007c,0x0000000a,
+0x00000036,0x00000025,0x00040063,0x00000035,
+0x00000036,0x00000034,0x000100fd,0x00010038}
@@ -1,5 +1,5 @@
 /*
-g++ -DVK_NO_PROTOTYPES  *.cpp -std=c++11 -Wall -Wshadow -ldl -o vktest.out
+g++ -DVK_NO_PROTOTYPES  *.cpp -std=c++11 -Wall -Wshadow -pthread -ldl -o vktest.out
 
 Run via:
 
@@ -14,16 +14,31 @@ Run via:
 #include <stdio.h>
 #include "vk_simple_init.h"
 #include "volk/volk.h"
+#include "ref_store.h"
+#include "golden_hash.h"
+#include "artifact_writer.h"
+#include "result_archive.h"
+#include "shader_cache.h"
+#include "pipeline_library.h"
+#include "descriptor_binder.h"
 
 #include <stdlib.h>
 #include <string.h>
 
-bool TestExtRasterMultisample(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex, const VkPhysicalDeviceMemoryProperties& memProps);
-bool TestUavLoadOob(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex, const VkPhysicalDeviceMemoryProperties& memProps);
+bool TestExtRasterMultisample(const VulkanObjetcs& vk);
+bool TestPathFillBench(const VulkanObjetcs& vk);
+bool TestTessClipBench(const VulkanObjetcs& vk);
+bool TestUavLoadOob(const VulkanObjetcs& vk);
+bool TestSpecConstantBench(const VulkanObjetcs& vk);
+bool TestDescriptorTableBench(const VulkanObjetcs& vk);
 
-bool TestClipDistanceIo(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex, const VkPhysicalDeviceMemoryProperties& memProps);
+bool TestClipDistanceIo(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex, const VkPhysicalDeviceMemoryProperties& memProps,
+                        const VkPhysicalDeviceLimits& limits);
 
 bool TestXfbPingPong(const VulkanObjetcs& vk);
+bool TestXfbBench(const VulkanObjetcs& vk);
+bool TestPngEncodeBench();
+bool TestRobustnessBench(unsigned initFlags, int gpuIndex);
 
 #include "thirdparty/renderdoc_app.h"
 extern RENDERDOC_API_1_1_2 *rdoc_api;
@@ -37,6 +52,31 @@ RENDERDOC_API_1_1_2 *rdoc_api = NULL;
 extern bool g_bSaveFailingImages;
 bool g_bSaveFailingImages = false;
 
+// Back readback buffers with our own memory via VK_EXT_external_memory_host when supported:
+extern bool g_bHostImportStaging;
+bool g_bHostImportStaging = false;
+
+// Record graphics passes with VK_KHR_dynamic_rendering instead of render pass and framebuffer objects when supported:
+extern bool g_bDynamicRendering;
+bool g_bDynamicRendering = false;
+
+// Draw xfb_vb_pingpong's passes with vkCmdDrawIndirectByteCountEXT from the previous pass's counter:
+extern bool g_bXfbIndirect;
+bool g_bXfbIndirect = false;
+
+// How compute tests write descriptors, see --descriptors:
+DescriptorBindMode g_descriptorBindMode = DescriptorBindMode::Auto;
+
+// Number of times tests that support it submit and verify their work, verification stays on the device:
+extern unsigned g_repeatCount;
+unsigned g_repeatCount = 1;
+
+// Vertices per draw and draws of xfb_bench:
+extern unsigned g_xfbBenchVertices;
+unsigned g_xfbBenchVertices = 1u << 20;
+extern unsigned g_xfbBenchIters;
+unsigned g_xfbBenchIters = 16;
+
 void TestYuy2Copy(const VulkanObjetcs& vk);
 
 int main(int argc, char **argv)
@@ -47,6 +87,13 @@ int main(int argc, char **argv)
     int gpuIndex = -1;
 
     const char *singleTestName = "";
+    GoldenMode goldenMode = GoldenMode::Off;
+    const char *goldenManifestPath = "golden_manifest.txt";
+    const char *archivePath = nullptr;
+    const char *archiveListPath = nullptr;
+    bool bArchiveCompress = true;
+    const char *pipelineCachePath = nullptr;
+    bool bPipelineLibrary = false;
     unsigned vkInitFlags =
         SIMPLE_INIT_BUFFER_ROBUSTNESS_1 |
         SIMPLE_INIT_BUFFER_ROBUSTNESS_2 |
@@ -61,6 +108,40 @@ int main(int argc, char **argv)
                 singleTestName = a + 7;
             } else if (strcmp(a, "--save-failing-images") == 0) {
                 g_bSaveFailingImages = true;
+            } else if (strcmp(a, "--golden=check") == 0) {
+                goldenMode = GoldenMode::Check;
+            } else if (strcmp(a, "--golden=record") == 0) {
+                goldenMode = GoldenMode::Record;
+            } else if (memcmp(a, "--golden-manifest=", 18) == 0) {
+                goldenManifestPath = a + 18;
+            } else if (memcmp(a, "--archive=", 10) == 0) {
+                archivePath = a + 10;
+            } else if (strcmp(a, "--archive-raw") == 0) {
+                bArchiveCompress = false;
+            } else if (memcmp(a, "--archive-list=", 15) == 0) {
+                archiveListPath = a + 15;
+            } else if (memcmp(a, "--pipeline-cache=", 17) == 0) {
+                pipelineCachePath = a + 17;
+            } else if (strcmp(a, "--pipeline-library") == 0) {
+                bPipelineLibrary = true;
+            } else if (strcmp(a, "--host-import-staging") == 0) {
+                g_bHostImportStaging = true;
+            } else if (strcmp(a, "--dynamic-rendering") == 0) {
+                g_bDynamicRendering = true;
+            } else if (strcmp(a, "--xfb-indirect") == 0) {
+                g_bXfbIndirect = true;
+            } else if (strcmp(a, "--descriptors=pool") == 0) {
+                g_descriptorBindMode = DescriptorBindMode::Pool;
+            } else if (strcmp(a, "--descriptors=template") == 0) {
+                g_descriptorBindMode = DescriptorBindMode::Template;
+            } else if (strcmp(a, "--descriptors=push") == 0) {
+                g_descriptorBindMode = DescriptorBindMode::Push;
+            } else if (sscanf(a, "--repeat=%d\n", &ival) == 1 && ival > 0) {
+                g_repeatCount = unsigned(ival);
+            } else if (sscanf(a, "--xfb-verts=%d\n", &ival) == 1 && ival > 0) {
+                g_xfbBenchVertices = unsigned(ival);
+            } else if (sscanf(a, "--xfb-iters=%d\n", &ival) == 1 && ival > 0) {
+                g_xfbBenchIters = unsigned(ival);
             } else if (sscanf(a, "--gpuindex=%d\n", &ival) == 1) {
                 printf("Preferring --gpuindex=%d\n", ival);
                 gpuIndex = ival;
@@ -96,11 +177,46 @@ int main(int argc, char **argv)
     }
 #endif
 
+    if (archiveListPath) {
+        return ResultArchiveList(archiveListPath) ? 0 : 1;
+    }
+
+    if (strcmp(singleTestName, "png_encode_bench") == 0) {
+        // CPU only, no device needed:
+        puts("Running test png_encode_bench..."); fflush(stdout);
+        bool const passed = TestPngEncodeBench();
+        puts(passed ? "Test PASSED." : "\nTest FAILED."); fflush(stdout);
+        return 0;
+    }
+    if (strcmp(singleTestName, "robustness_bench") == 0) {
+        // Creates a device per robustness mode itself:
+        puts("Running test robustness_bench..."); fflush(stdout);
+        bool const passed = TestRobustnessBench(vkInitFlags, gpuIndex);
+        puts(passed ? "Test PASSED." : "\nTest FAILED."); fflush(stdout);
+        return 0;
+    }
+
     VulkanObjetcs vk;
     VkResult const initResult = SimpleInitVulkan(&vk, vkInitFlags, gpuIndex, GpuVendorID::Intel);
+    if (initResult == VK_SUCCESS && !GoldenInit(goldenMode, goldenManifestPath, vk)) {
+        SimpleDestroyVulkan(&vk);
+        return 1;
+    }
+    if (initResult == VK_SUCCESS && archivePath && !ResultArchiveOpen(archivePath, bArchiveCompress, vk)) {
+        SimpleDestroyVulkan(&vk);
+        return 1;
+    }
     if (initResult == VK_SUCCESS) {
+        ShaderCacheInit(vk, pipelineCachePath);
+        PipelineLibraryInit(vk, bPipelineLibrary);
         fflush(stderr);
         fflush(stdout);
+        if (g_bHostImportStaging && !vk.EXT_external_memory_host) {
+            puts("NOTE: --host-import-staging given but VK_EXT_external_memory_host is not supported, using mapped staging memory.");
+        }
+        if (bPipelineLibrary && !PipelineLibraryEnabled()) {
+            puts("NOTE: --pipeline-library given but graphicsPipelineLibrary is not supported, only building complete pipelines.");
+        }
         bool passed = false;
         if (strcmp(singleTestName, "xfb_vb_pingpong") == 0) {
             if (rdoc_api) rdoc_api->StartFrameCapture(NULL, NULL);
@@ -108,12 +224,52 @@ int main(int argc, char **argv)
             passed = TestXfbPingPong(vk);
             if (rdoc_api) rdoc_api->EndFrameCapture(NULL, NULL);
             puts(passed ? "Test PASSED." : "\nTest FAILED."); fflush(stdout);
+        } else if (strcmp(singleTestName, "xfb_bench") == 0) {
+            puts("Running test xfb_bench..."); fflush(stdout);
+            passed = TestXfbBench(vk);
+            puts(passed ? "Test PASSED." : "\nTest FAILED."); fflush(stdout);
         } else if (strcmp(singleTestName, "ld_typed_2darray_oob") == 0) {
             puts("Running test ld_typed_2darray_oob..."); fflush(stdout);
             if (!vk.robustness2Features.robustImageAccess2) {
                 puts("NOTE: robustImageAccess2 not supported, failing the test may be okay.");
             }
-            passed = TestUavLoadOob(vk.device, vk.universalQueue, vk.universalFamilyIndex, vk.memProps);
+            passed = TestUavLoadOob(vk);
+            puts(passed ? "Test PASSED." : "\nTest FAILED."); fflush(stdout);
+        } else if (strcmp(singleTestName, "ld_typed_spec_bench") == 0) {
+            puts("Running test ld_typed_spec_bench..."); fflush(stdout);
+            if (!vk.robustness2Features.robustImageAccess2) {
+                puts("NOTE: robustImageAccess2 not supported, the oob=-1 variants read out of bounds.");
+            }
+            passed = TestSpecConstantBench(vk);
+            puts(passed ? "Test PASSED." : "\nTest FAILED."); fflush(stdout);
+        } else if (strcmp(singleTestName, "ld_typed_table_bench") == 0) {
+            puts("Running test ld_typed_table_bench..."); fflush(stdout);
+            if (!vk.robustness2Features.robustImageAccess2) {
+                puts("NOTE: robustImageAccess2 not supported, failing the test may be okay.");
+            }
+            passed = TestDescriptorTableBench(vk);
+            puts(passed ? "Test PASSED." : "\nTest FAILED."); fflush(stdout);
+        } else if (strcmp(singleTestName, "ext_raster_multisample") == 0) {
+            puts("Running test ext_raster_multisample..."); fflush(stdout);
+            passed = TestExtRasterMultisample(vk);
+            puts(passed ? "Test PASSED." : "\nTest FAILED."); fflush(stdout);
+        } else if (strcmp(singleTestName, "path_fill_bench") == 0) {
+            puts("Running test path_fill_bench..."); fflush(stdout);
+            passed = TestPathFillBench(vk);
+            puts(passed ? "Test PASSED." : "\nTest FAILED."); fflush(stdout);
+        } else if (strcmp(singleTestName, "clipdistance_io") == 0) {
+            puts("Running test clipdistance_io..."); fflush(stdout);
+            const VkPhysicalDeviceFeatures& features = vk.features2.features;
+            if (!features.tessellationShader || !features.shaderClipDistance || !features.pipelineStatisticsQuery) {
+                puts("ERROR: tessellationShader, shaderClipDistance and pipelineStatisticsQuery are all needed.");
+            } else {
+                passed = TestClipDistanceIo(vk.device, vk.universalQueue, vk.universalFamilyIndex, vk.memProps,
+                                            vk.props2.properties.limits);
+            }
+            puts(passed ? "Test PASSED." : "\nTest FAILED."); fflush(stdout);
+        } else if (strcmp(singleTestName, "tess_clip_bench") == 0) {
+            puts("Running test tess_clip_bench..."); fflush(stdout);
+            passed = TestTessClipBench(vk);
             puts(passed ? "Test PASSED." : "\nTest FAILED."); fflush(stdout);
         } else {
             TestYuy2Copy(vk);
@@ -122,6 +278,11 @@ int main(int argc, char **argv)
         printf("Failed to initialize Vulkan, VkResult = %d\n", initResult);
     }
 
+    ResultArchiveClose();
+    ArtifactFlush();
+    GoldenFlush();
+    ShaderCacheDestroy();
     SimpleDestroyVulkan(&vk);
+    RefStoreCloseAll();
     return 0;
 }
@@ -0,0 +1,70 @@
+#include "pipeline_batch.h"
+#include "thread_pool.h"
+#include "bench_util.h"
+
+#include <stdio.h>
+#include <assert.h>
+
+void
+PipelineBatchInit(PipelineBatch *b, const char *testName)
+{
+    b->testName = testName;
+    b->numJobs = 0;
+}
+
+void
+PipelineBatchAdd(PipelineBatch *b, const char *name, PFN_PipelineBuildJob pfnBuild, void *pArgs)
+{
+    assert(b->numJobs < PipelineBatchMaxJobs);
+    PipelineBatchJob *const job = &b->jobs[b->numJobs++];
+    job->name = name;
+    job->pfnBuild = pfnBuild;
+    job->pArgs = pArgs;
+    job->stats = { };
+}
+
+static void
+RunJob(void *pArg)
+{
+    PipelineBatchJob *const job = static_cast<PipelineBatchJob *>(pArg);
+    job->pfnBuild(job->pArgs);
+    job->stats = ShaderCacheLastBuildStats();
+}
+
+void
+PipelineBatchBuild(PipelineBatch *b)
+{
+    unsigned numThreads = ThreadPoolDefaultThreadCount();
+    if (numThreads > b->numJobs) numThreads = b->numJobs;
+
+    uint64_t const startNs = BenchNowNs();
+    if (numThreads <= 1) {
+        for (uint32_t i = 0; i < b->numJobs; ++i) RunJob(&b->jobs[i]);
+    } else {
+        ThreadPool *const pool = ThreadPoolCreate(numThreads, b->numJobs);
+        for (uint32_t i = 0; i < b->numJobs; ++i) ThreadPoolSubmit(pool, RunJob, &b->jobs[i]);
+        ThreadPoolDestroy(pool);
+    }
+    uint64_t const totalNs = BenchNowNs() - startNs;
+
+    printf("Pipelines for %s: %u built on %u thread(s) in %.2f ms\n",
+           b->testName, b->numJobs, numThreads > 1 ? numThreads : 1u, totalNs * 1e-6);
+    for (uint32_t i = 0; i < b->numJobs; ++i) {
+        PipelineBuildStats const& s = b->jobs[i].stats;
+        printf("    %-24s %8.2f ms", b->jobs[i].name, s.wallNs * 1e-6);
+        if (s.bFeedback) {
+            printf("  driver %8.2f ms  cache %-4s  stages hit %u/%u", s.driverNs * 1e-6, s.bCacheHit ? "hit" : "miss",
+                   s.stageCacheHits, s.stageCount);
+        }
+        puts(s.bIdentifier ? "  (identifiers)" : "");
+    }
+    fflush(stdout);
+}
+
+uint64_t
+PipelineBatchBuildNs(const PipelineBatch& b)
+{
+    uint64_t ns = 0;
+    for (uint32_t i = 0; i < b.numJobs; ++i) ns += b.jobs[i].stats.wallNs;
+    return ns;
+}
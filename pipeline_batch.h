@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include "shader_cache.h"
+
+/*
+ * Builds a test's pipelines together on worker threads before it starts recording, instead of
+ * one after another as the test reaches them. A job builds one pipeline through
+ * ShaderCacheCreate*Pipeline, usually by calling the test's own CreateXxxPipeline helper with
+ * arguments the test keeps alive until PipelineBatchBuild returns, so each create info is put
+ * together on the worker's stack. Afterwards one line per pipeline reports its build time and
+ * whether the pipeline cache had it.
+ */
+
+typedef void (*PFN_PipelineBuildJob)(void *pArgs);
+
+enum { PipelineBatchMaxJobs = 32 };
+
+struct PipelineBatchJob {
+    const char *name;
+    PFN_PipelineBuildJob pfnBuild;
+    void *pArgs;
+    PipelineBuildStats stats;
+};
+
+struct PipelineBatch {
+    const char *testName;
+    uint32_t numJobs;
+    PipelineBatchJob jobs[PipelineBatchMaxJobs];
+};
+
+void
+PipelineBatchInit(PipelineBatch *b, const char *testName);
+
+void
+PipelineBatchAdd(PipelineBatch *b, const char *name, PFN_PipelineBuildJob pfnBuild, void *pArgs);
+
+// Runs every job and waits for them, then prints the report. Jobs report failures themselves.
+void
+PipelineBatchBuild(PipelineBatch *b);
+
+// Sum of the jobs' vkCreate*Pipelines times after PipelineBatchBuild, CPU time rather than elapsed.
+uint64_t
+PipelineBatchBuildNs(const PipelineBatch& b);
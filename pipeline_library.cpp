@@ -0,0 +1,120 @@
+#include "pipeline_library.h"
+#include "pipeline_batch.h"
+#include "shader_cache.h"
+#include "vk_simple_init.h"
+#include "volk/volk.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static bool s_bEnabled;
+
+void
+PipelineLibraryInit(const VulkanObjetcs& vk, bool bWanted)
+{
+    s_bEnabled = bWanted && vk.EXT_graphics_pipeline_library;
+#ifdef VK_EXT_graphics_pipeline_library
+    if (s_bEnabled && !vk.graphicsPipelineLibraryProperties.graphicsPipelineLibraryFastLinking) {
+        puts("NOTE: graphicsPipelineLibraryFastLinking is not supported, links without optimization may not be fast.");
+    }
+#endif
+}
+
+bool
+PipelineLibraryEnabled()
+{
+    return s_bEnabled;
+}
+
+#ifdef VK_EXT_graphics_pipeline_library
+
+static_assert(PipelineLibraryVertexInput == uint32_t(VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT) &&
+              PipelineLibraryPreRaster == uint32_t(VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT) &&
+              PipelineLibraryFragmentShader == uint32_t(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT) &&
+              PipelineLibraryFragmentOutput == uint32_t(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT),
+              "PipelineLibrary* must match VkGraphicsPipelineLibraryFlagBitsEXT");
+
+VkResult
+PipelineLibraryCreatePart(const VkGraphicsPipelineCreateInfo& info, uint32_t parts, VkPipeline *pLibrary)
+{
+    VkShaderStageFlags ownedStages = 0;
+    if (parts & PipelineLibraryPreRaster) ownedStages |= VK_SHADER_STAGE_ALL_GRAPHICS & ~VK_SHADER_STAGE_FRAGMENT_BIT;
+    if (parts & PipelineLibraryFragmentShader) ownedStages |= VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkPipelineShaderStageCreateInfo stages[8];
+    uint32_t numStages = 0;
+    for (uint32_t i = 0; i < info.stageCount && numStages < 8; ++i) {
+        if (info.pStages[i].stage & ownedStages) stages[numStages++] = info.pStages[i];
+    }
+
+    const VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo = {
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT, info.pNext, parts
+    };
+    VkGraphicsPipelineCreateInfo partInfo = info;
+    partInfo.pNext = &libraryInfo;
+    partInfo.flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+    partInfo.stageCount = numStages;
+    partInfo.pStages = numStages ? stages : nullptr;
+    return ShaderCacheCreateGraphicsPipeline(partInfo, pLibrary);
+}
+
+VkResult
+PipelineLibraryLink(const VkPipeline *pLibraries, uint32_t numLibraries, VkPipelineLayout layout, bool bOptimize,
+                    VkPipeline *pPipeline)
+{
+    const VkPipelineLibraryCreateInfoKHR libraries = {
+        VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR, nullptr, numLibraries, pLibraries
+    };
+    VkGraphicsPipelineCreateInfo info = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO, &libraries };
+    info.flags = bOptimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+    info.layout = layout;
+    info.basePipelineHandle = VK_NULL_HANDLE;
+    info.basePipelineIndex = -1;
+    return ShaderCacheCreateGraphicsPipeline(info, pPipeline);
+}
+
+#else // headers without VK_EXT_graphics_pipeline_library, PipelineLibraryEnabled() is always false
+
+VkResult
+PipelineLibraryCreatePart(const VkGraphicsPipelineCreateInfo&, uint32_t, VkPipeline *pLibrary)
+{
+    *pLibrary = VK_NULL_HANDLE;
+    return VK_ERROR_EXTENSION_NOT_PRESENT;
+}
+
+VkResult
+PipelineLibraryLink(const VkPipeline *, uint32_t, VkPipelineLayout, bool, VkPipeline *pPipeline)
+{
+    *pPipeline = VK_NULL_HANDLE;
+    return VK_ERROR_EXTENSION_NOT_PRESENT;
+}
+
+#endif
+
+void
+PipelineLibraryLinkJob(void *pArgs)
+{
+    PipelineLibraryLinkArgs const *const a = static_cast<const PipelineLibraryLinkArgs *>(pArgs);
+    VkResult const r = PipelineLibraryLink(a->pLibraries, a->numLibraries, a->layout, a->bOptimize, a->pPipeline);
+    if (r != VK_SUCCESS) {
+        fprintf(stderr, "%s:%d linking %u pipeline libraries failed: %d\n", __FILE__, __LINE__, a->numLibraries, r);
+        exit(r);
+    }
+}
+
+void
+PipelineLibraryReport(const char *testName, const PipelineBatch& monolithic, const PipelineBatch& parts,
+                      const PipelineBatch& fastLinks, const PipelineBatch& optimizedLinks)
+{
+    double const monolithicMs = PipelineBatchBuildNs(monolithic) * 1e-6;
+    double const partsMs = PipelineBatchBuildNs(parts) * 1e-6;
+    double const fastMs = PipelineBatchBuildNs(fastLinks) * 1e-6;
+    double const optimizedMs = PipelineBatchBuildNs(optimizedLinks) * 1e-6;
+    uint32_t const n = monolithic.numJobs ? monolithic.numJobs : 1;
+    printf("Pipeline libraries for %s: %u monolithic %.2f ms (%.2f ms each), %u parts %.2f ms, "
+           "link %.3f ms each, optimized link %.2f ms each\n",
+           testName, monolithic.numJobs, monolithicMs, monolithicMs / n, parts.numJobs, partsMs,
+           fastLinks.numJobs ? fastMs / fastLinks.numJobs : 0.0,
+           optimizedLinks.numJobs ? optimizedMs / optimizedLinks.numJobs : 0.0);
+    fflush(stdout);
+}
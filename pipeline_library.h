@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+struct VulkanObjetcs;
+struct PipelineBatch;
+
+/*
+ * VK_EXT_graphics_pipeline_library path (--pipeline-library). A graphics pipeline is split into
+ * its four parts, each compiled once as a library and shared by every variant that has the same
+ * part, and variants are made by linking parts, which is meant to be much cheaper than building
+ * a complete pipeline. A test builds its parts from the same create info it would build the
+ * complete pipeline from; state a part doesn't own is ignored by the driver and shader stages it
+ * doesn't own are dropped here.
+ *
+ * Parts and links go through ShaderCacheCreateGraphicsPipeline, so they use the shared pipeline
+ * cache and creation feedback like any other pipeline. Parts are always created with
+ * RETAIN_LINK_TIME_OPTIMIZATION_INFO so they can be linked either way.
+ */
+
+// Same values as VkGraphicsPipelineLibraryFlagBitsEXT:
+enum : uint32_t {
+    PipelineLibraryVertexInput    = 1u << 0,
+    PipelineLibraryPreRaster      = 1u << 1,
+    PipelineLibraryFragmentShader = 1u << 2,
+    PipelineLibraryFragmentOutput = 1u << 3,
+};
+
+// Enables the path if wanted and the device has graphicsPipelineLibrary.
+void
+PipelineLibraryInit(const VulkanObjetcs& vk, bool bWanted);
+
+bool
+PipelineLibraryEnabled();
+
+// Creates a library of the parts of info named by 'parts', a mask of PipelineLibrary*.
+VkResult
+PipelineLibraryCreatePart(const VkGraphicsPipelineCreateInfo& info, uint32_t parts, VkPipeline *pLibrary);
+
+/*
+ * Links libraries that together have all four parts into a complete pipeline, or just vertex input
+ * and pre-rasterization if rasterizer discard is statically enabled. bOptimize asks for link time
+ * optimization, which should give the same code as a monolithic build at some of its cost.
+ */
+VkResult
+PipelineLibraryLink(const VkPipeline *pLibraries, uint32_t numLibraries, VkPipelineLayout layout, bool bOptimize,
+                    VkPipeline *pPipeline);
+
+// For PipelineBatchAdd:
+struct PipelineLibraryLinkArgs {
+    const VkPipeline *pLibraries;
+    uint32_t numLibraries;
+    VkPipelineLayout layout;
+    bool bOptimize;
+    VkPipeline *pPipeline;
+};
+
+void
+PipelineLibraryLinkJob(void *pArgs);
+
+// One line comparing the monolithic builds with building the parts once and linking each pipeline.
+void
+PipelineLibraryReport(const char *testName, const PipelineBatch& monolithic, const PipelineBatch& parts,
+                      const PipelineBatch& fastLinks, const PipelineBatch& optimizedLinks);
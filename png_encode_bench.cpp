@@ -0,0 +1,194 @@
+#include "fast_png.h"
+#include "bench_util.h"
+#include "stb/stb_image.h"
+#include "stb/stb_image_write.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Compares FastPngEncode against stbi_write_png on the images the tests save: the checked in
+ * 256x256 outputs, plus 4K images built from them, since farm machines archive every failing image.
+ * Both encoders write to memory so disk speed doesn't count. Each encode is repeated until
+ * MinBenchNs has passed and the fastest run is reported.
+ *
+ * Fails if the fast encoder's output doesn't decode back to the input.
+ */
+
+static const uint64_t MinBenchNs = 250 * 1000 * 1000;
+
+struct BenchImage {
+    char name[64];
+    int width, height, comps;
+    unsigned char *pPixels;
+};
+
+struct EncodeTiming {
+    uint64_t bestNs;
+    size_t bytes;
+};
+
+static void
+CountPngBytes(void *context, void *data, int size)
+{
+    (void)data;
+    *(size_t *)context += size_t(size);
+}
+
+static EncodeTiming
+TimeStbEncode(const BenchImage& img)
+{
+    EncodeTiming r = { ~uint64_t(0), 0 };
+    uint64_t const start = BenchNowNs();
+    unsigned runs = 0;
+    do {
+        size_t bytes = 0;
+        uint64_t const t0 = BenchNowNs();
+        stbi_write_png_to_func(CountPngBytes, &bytes, img.width, img.height, img.comps, img.pPixels, img.width * img.comps);
+        uint64_t const dt = BenchNowNs() - t0;
+        if (dt < r.bestNs) r.bestNs = dt;
+        r.bytes = bytes;
+    } while (++runs < 3 || BenchNowNs() - start < MinBenchNs);
+    return r;
+}
+
+static EncodeTiming
+TimeFastEncode(const BenchImage& img, bool *pRoundTripOk)
+{
+    EncodeTiming r = { ~uint64_t(0), 0 };
+    uint64_t const start = BenchNowNs();
+    unsigned runs = 0;
+    unsigned char *png = NULL;
+    int len = 0;
+    do {
+        free(png);
+        uint64_t const t0 = BenchNowNs();
+        png = FastPngEncode(img.pPixels, img.width * img.comps, img.width, img.height, img.comps, &len);
+        uint64_t const dt = BenchNowNs() - t0;
+        if (dt < r.bestNs) r.bestNs = dt;
+    } while (png && (++runs < 3 || BenchNowNs() - start < MinBenchNs));
+
+    *pRoundTripOk = false;
+    if (png) {
+        r.bytes = size_t(len);
+        int w, h, n;
+        unsigned char *const decoded = stbi_load_from_memory(png, len, &w, &h, &n, img.comps);
+        if (decoded) {
+            *pRoundTripOk = w == img.width && h == img.height &&
+                            memcmp(decoded, img.pPixels, size_t(w) * size_t(h) * size_t(img.comps)) == 0;
+            stbi_image_free(decoded);
+        }
+        free(png);
+    }
+    return r;
+}
+
+static bool
+LoadBenchImage(const char *path, BenchImage *img)
+{
+    int n;
+    img->pPixels = stbi_load(path, &img->width, &img->height, &n, 0);
+    if (!img->pPixels) {
+        printf("Failed to load %s: %s\n", path, stbi_failure_reason());
+        return false;
+    }
+    img->comps = n;
+    snprintf(img->name, sizeof img->name, "%s", path);
+    return true;
+}
+
+// Nearest upscale of src to 3840x2160, like a test rendering the same scene at 4K:
+static BenchImage
+Upscale4K(const BenchImage& src)
+{
+    BenchImage img;
+    img.width = 3840;
+    img.height = 2160;
+    img.comps = src.comps;
+    img.pPixels = (unsigned char *)malloc(size_t(img.width) * img.height * img.comps);
+    for (int y = 0; y < img.height; ++y) {
+        int const sy = y * src.height / img.height;
+        for (int x = 0; x < img.width; ++x) {
+            int const sx = x * src.width / img.width;
+            memcpy(img.pPixels + (size_t(y) * img.width + x) * img.comps,
+                   src.pPixels + (size_t(sy) * src.width + sx) * src.comps, size_t(src.comps));
+        }
+    }
+    snprintf(img.name, sizeof img.name, "%.56s@4K", src.name);
+    return img;
+}
+
+// 4K gradient with noise in the low bits, close to the worst case for both encoders:
+static BenchImage
+Noisy4K()
+{
+    BenchImage img;
+    img.width = 3840;
+    img.height = 2160;
+    img.comps = 4;
+    img.pPixels = (unsigned char *)malloc(size_t(img.width) * img.height * 4);
+    uint32_t state = 0x12345678u;
+    for (int y = 0; y < img.height; ++y) {
+        for (int x = 0; x < img.width; ++x) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            unsigned char *const p = img.pPixels + (size_t(y) * img.width + x) * 4;
+            p[0] = (unsigned char)((x * 255 / img.width) ^ (state & 7));
+            p[1] = (unsigned char)((y * 255 / img.height) ^ ((state >> 3) & 7));
+            p[2] = (unsigned char)(((x + y) >> 4) ^ ((state >> 6) & 7));
+            p[3] = 255;
+        }
+    }
+    snprintf(img.name, sizeof img.name, "noisy_gradient@4K");
+    return img;
+}
+
+bool
+TestPngEncodeBench()
+{
+    static const char *const SourcePaths[] = {
+        "pass_via_clipdist.png",
+        "expected_xfb_output.png",
+        "reference_2x.png",
+    };
+    enum { NumSources = sizeof SourcePaths / sizeof SourcePaths[0] };
+
+    BenchImage images[2 * NumSources + 1];
+    unsigned numImages = 0;
+    for (unsigned i = 0; i < NumSources; ++i) {
+        if (!LoadBenchImage(SourcePaths[i], &images[numImages])) continue;
+        numImages++;
+    }
+    unsigned const numLoaded = numImages;
+    if (numLoaded == 0) return false;
+    for (unsigned i = 0; i < numLoaded; ++i) {
+        images[numImages++] = Upscale4K(images[i]);
+    }
+    images[numImages++] = Noisy4K();
+
+    printf("filter kernel: %s\n\n", FastPngKernelName());
+    printf("%-30s %10s | %10s %10s | %10s %10s | %7s\n", "image", "size", "stb ms", "stb bytes", "fast ms", "fast bytes", "speedup");
+
+    bool passed = true;
+    for (unsigned i = 0; i < numImages; ++i) {
+        const BenchImage& img = images[i];
+        bool bRoundTripOk;
+        EncodeTiming const stb = TimeStbEncode(img);
+        EncodeTiming const fast = TimeFastEncode(img, &bRoundTripOk);
+        char size[32];
+        snprintf(size, sizeof size, "%dx%dx%d", img.width, img.height, img.comps);
+        printf("%-30s %10s | %10.3f %10zu | %10.3f %10zu | %6.1fx%s\n", img.name, size,
+               stb.bestNs * 1e-6, stb.bytes, fast.bestNs * 1e-6, fast.bytes,
+               double(stb.bestNs) / double(fast.bestNs ? fast.bestNs : 1),
+               bRoundTripOk ? "" : "  ERROR: round trip mismatch");
+        passed = passed && bRoundTripOk;
+    }
+
+    for (unsigned i = 0; i < numImages; ++i) {
+        if (i < numLoaded) stbi_image_free(images[i].pPixels);
+        else free(images[i].pPixels);
+    }
+    return passed;
+}
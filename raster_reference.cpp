@@ -0,0 +1,413 @@
+#include "raster_reference.h"
+#include "thread_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RASTER_REFERENCE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define RASTER_REFERENCE_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Vulkan's standard sample locations, all multiples of 1/16:
+static const RasterRefSampleLocation Locations1[1] = { { 0.5f, 0.5f } };
+static const RasterRefSampleLocation Locations2[2] = { { 0.75f, 0.75f }, { 0.25f, 0.25f } };
+static const RasterRefSampleLocation Locations4[4] = {
+    { 0.375f, 0.125f }, { 0.875f, 0.375f }, { 0.125f, 0.625f }, { 0.625f, 0.875f }
+};
+static const RasterRefSampleLocation Locations8[8] = {
+    { 0.5625f, 0.3125f }, { 0.4375f, 0.6875f }, { 0.8125f, 0.5625f }, { 0.3125f, 0.1875f },
+    { 0.1875f, 0.8125f }, { 0.0625f, 0.4375f }, { 0.6875f, 0.9375f }, { 0.9375f, 0.0625f }
+};
+static const RasterRefSampleLocation Locations16[16] = {
+    { 0.5625f, 0.5625f }, { 0.4375f, 0.3125f }, { 0.3125f, 0.625f  }, { 0.75f,   0.4375f },
+    { 0.1875f, 0.375f  }, { 0.625f,  0.8125f }, { 0.8125f, 0.6875f }, { 0.6875f, 0.1875f },
+    { 0.375f,  0.875f  }, { 0.5f,    0.0625f }, { 0.25f,   0.125f  }, { 0.125f,  0.75f   },
+    { 0.0f,    0.5f    }, { 0.9375f, 0.25f   }, { 0.875f,  0.9375f }, { 0.0625f, 0.0f    }
+};
+
+const RasterRefSampleLocation *
+RasterRefStandardSampleLocations(uint32_t numSamples)
+{
+    switch (numSamples) {
+    case 1: return Locations1;
+    case 2: return Locations2;
+    case 4: return Locations4;
+    case 8: return Locations8;
+    case 16: return Locations16;
+    default: return nullptr;
+    }
+}
+
+enum {
+    TileSize = 64, // pixels per side of a thread pool job
+    BlockSize = 8  // pixels per side of a block resolved from its corners when possible
+};
+
+/*
+ * E(p) = dx * (p.y - a.y) - dy * (p.x - a.x) for the edge a -> b of a triangle wound so that E >= 0
+ * inside. A sample with E == 0 is only inside for a top edge (horizontal, going right) or a left
+ * edge (going up), which bias = 0 allows and bias = -1 rejects in E + bias >= 0.
+ */
+struct RefEdge {
+    int64_t ax, ay, dx, dy, bias;
+};
+
+static inline RefEdge
+MakeEdge(int64_t ax, int64_t ay, int64_t bx, int64_t by)
+{
+    RefEdge e = { ax, ay, bx - ax, by - ay, 0 };
+    bool const bTopLeft = e.dy < 0 || (e.dy == 0 && e.dx > 0);
+    e.bias = bTopLeft ? 0 : -1;
+    return e;
+}
+
+static inline int64_t
+EdgeValue(const RefEdge& e, int64_t px, int64_t py)
+{
+    return e.dx * (py - e.ay) - e.dy * (px - e.ax) + e.bias;
+}
+
+struct RefTriangle {
+    RefEdge edges[3];
+    int64_t minX, minY, maxX, maxY; // pixels that can hold a covered sample, inclusive, within the framebuffer
+};
+
+struct RasterShared {
+    const RefTriangle *pTriangles;
+    uint32_t numTriangles;
+    uint32_t width;
+    uint32_t numSamples;
+    int shift; // sub-pixel bits
+    int64_t sampleX[RasterRefMaxSamples], sampleY[RasterRefMaxSamples]; // fixed point, from the pixel's corner
+    uint16_t *pMasks;
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+// XOR the masks of samples a triangle covers into row[x] for x in [x0, x1] of row y. Scalar, also used for the tails:
+
+static void
+CoverRow_Scalar(const RasterShared& sh, const RefTriangle& t, int64_t y, int64_t x0, int64_t x1, uint16_t *row)
+{
+    for (int64_t x = x0; x <= x1; ++x) {
+        uint32_t mask = 0;
+        for (uint32_t s = 0; s < sh.numSamples; ++s) {
+            int64_t const px = (x << sh.shift) + sh.sampleX[s];
+            int64_t const py = (y << sh.shift) + sh.sampleY[s];
+            if (EdgeValue(t.edges[0], px, py) >= 0 && EdgeValue(t.edges[1], px, py) >= 0 && EdgeValue(t.edges[2], px, py) >= 0) {
+                mask |= 1u << s;
+            }
+        }
+        row[x] ^= uint16_t(mask);
+    }
+}
+
+/*
+ * For a sample s on row y, E = rowTerm - dy * px with rowTerm = dx * (py - ay) + dy * ax + bias. With
+ * coordinates below 2^24 both terms are integers below 2^53, so the double math below is exact.
+ */
+#if RASTER_REFERENCE_SSE2
+
+static void
+CoverRow_SSE2(const RasterShared& sh, const RefTriangle& t, int64_t y, int64_t x0, int64_t x1, uint16_t *row)
+{
+    int64_t const n = x1 - x0 + 1;
+    int64_t const pairEnd = x0 + (n & ~int64_t(1));
+    double const pixelStep = double(int64_t(1) << sh.shift);
+    __m128d const zero = _mm_setzero_pd();
+    __m128d const step2 = _mm_set1_pd(2.0 * pixelStep);
+    __m128d ndy[3];
+    for (int k = 0; k < 3; ++k) ndy[k] = _mm_set1_pd(-double(t.edges[k].dy));
+
+    for (uint32_t s = 0; s < sh.numSamples; ++s) {
+        uint16_t const bit = uint16_t(1u << s);
+        int64_t const py = (y << sh.shift) + sh.sampleY[s];
+        __m128d rowTerm[3];
+        for (int k = 0; k < 3; ++k) {
+            const RefEdge& e = t.edges[k];
+            rowTerm[k] = _mm_set1_pd(double(e.dx * (py - e.ay) + e.dy * e.ax + e.bias));
+        }
+        double const px0 = double((x0 << sh.shift) + sh.sampleX[s]);
+        __m128d px = _mm_set_pd(px0 + pixelStep, px0);
+        for (int64_t x = x0; x < pairEnd; x += 2) {
+            __m128d inside = _mm_cmpge_pd(_mm_add_pd(rowTerm[0], _mm_mul_pd(ndy[0], px)), zero);
+            inside = _mm_and_pd(inside, _mm_cmpge_pd(_mm_add_pd(rowTerm[1], _mm_mul_pd(ndy[1], px)), zero));
+            inside = _mm_and_pd(inside, _mm_cmpge_pd(_mm_add_pd(rowTerm[2], _mm_mul_pd(ndy[2], px)), zero));
+            int const m = _mm_movemask_pd(inside);
+            if (m & 1) row[x] ^= bit;
+            if (m & 2) row[x + 1] ^= bit;
+            px = _mm_add_pd(px, step2);
+        }
+    }
+    if (pairEnd <= x1) CoverRow_Scalar(sh, t, y, pairEnd, x1, row);
+}
+
+#define CoverRowKernel CoverRow_SSE2
+#define CoverRowKernelName "sse2"
+
+#endif // RASTER_REFERENCE_SSE2
+
+#if RASTER_REFERENCE_NEON
+
+static void
+CoverRow_NEON(const RasterShared& sh, const RefTriangle& t, int64_t y, int64_t x0, int64_t x1, uint16_t *row)
+{
+    int64_t const n = x1 - x0 + 1;
+    int64_t const pairEnd = x0 + (n & ~int64_t(1));
+    double const pixelStep = double(int64_t(1) << sh.shift);
+    float64x2_t const zero = vdupq_n_f64(0.0);
+    float64x2_t const step2 = vdupq_n_f64(2.0 * pixelStep);
+    float64x2_t ndy[3];
+    for (int k = 0; k < 3; ++k) ndy[k] = vdupq_n_f64(-double(t.edges[k].dy));
+
+    for (uint32_t s = 0; s < sh.numSamples; ++s) {
+        uint16_t const bit = uint16_t(1u << s);
+        int64_t const py = (y << sh.shift) + sh.sampleY[s];
+        float64x2_t rowTerm[3];
+        for (int k = 0; k < 3; ++k) {
+            const RefEdge& e = t.edges[k];
+            rowTerm[k] = vdupq_n_f64(double(e.dx * (py - e.ay) + e.dy * e.ax + e.bias));
+        }
+        double const px0 = double((x0 << sh.shift) + sh.sampleX[s]);
+        const double pxInit[2] = { px0, px0 + pixelStep };
+        float64x2_t px = vld1q_f64(pxInit);
+        for (int64_t x = x0; x < pairEnd; x += 2) {
+            uint64x2_t inside = vcgeq_f64(vaddq_f64(rowTerm[0], vmulq_f64(ndy[0], px)), zero);
+            inside = vandq_u64(inside, vcgeq_f64(vaddq_f64(rowTerm[1], vmulq_f64(ndy[1], px)), zero));
+            inside = vandq_u64(inside, vcgeq_f64(vaddq_f64(rowTerm[2], vmulq_f64(ndy[2], px)), zero));
+            if (vgetq_lane_u64(inside, 0)) row[x] ^= bit;
+            if (vgetq_lane_u64(inside, 1)) row[x + 1] ^= bit;
+            px = vaddq_f64(px, step2);
+        }
+    }
+    if (pairEnd <= x1) CoverRow_Scalar(sh, t, y, pairEnd, x1, row);
+}
+
+#define CoverRowKernel CoverRow_NEON
+#define CoverRowKernelName "neon"
+
+#endif // RASTER_REFERENCE_NEON
+
+#ifndef CoverRowKernel
+#define CoverRowKernel CoverRow_Scalar
+#define CoverRowKernelName "scalar"
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const char *
+RasterRefKernelName()
+{
+    return CoverRowKernelName;
+}
+
+enum BlockCoverage { BlockOutside, BlockInside, BlockPartial };
+
+// Edge functions are linear, so the corners of the block bound them over every sample in it:
+static BlockCoverage
+ClassifyBlock(const RasterShared& sh, const RefTriangle& t, int64_t x0, int64_t y0, int64_t x1, int64_t y1)
+{
+    int64_t const cx[2] = { x0 << sh.shift, (x1 + 1) << sh.shift };
+    int64_t const cy[2] = { y0 << sh.shift, (y1 + 1) << sh.shift };
+    bool bInside = true;
+    for (const RefEdge& e : t.edges) {
+        int64_t minE = INT64_MAX, maxE = INT64_MIN;
+        for (int64_t px : cx) {
+            for (int64_t py : cy) {
+                int64_t const v = EdgeValue(e, px, py);
+                if (v < minE) minE = v;
+                if (v > maxE) maxE = v;
+            }
+        }
+        if (maxE < 0) return BlockOutside;
+        bInside &= (minE >= 0);
+    }
+    return bInside ? BlockInside : BlockPartial;
+}
+
+static inline void
+XorSpan(uint16_t *p, int64_t n, uint16_t mask)
+{
+    int64_t i = 0;
+#if RASTER_REFERENCE_SSE2
+    __m128i const m = _mm_set1_epi16(short(mask));
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_si128((__m128i *)(p + i), _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + i)), m));
+    }
+#elif RASTER_REFERENCE_NEON
+    uint16x8_t const m = vdupq_n_u16(mask);
+    for (; i + 8 <= n; i += 8) {
+        vst1q_u16(p + i, veorq_u16(vld1q_u16(p + i), m));
+    }
+#endif
+    for (; i < n; ++i) p[i] ^= mask;
+}
+
+struct RasterTile {
+    const RasterShared *pShared;
+    int64_t x0, y0, x1, y1; // inclusive
+};
+
+static void
+RasterTileJob(void *pArg)
+{
+    const RasterTile& tile = *static_cast<RasterTile *>(pArg);
+    const RasterShared& sh = *tile.pShared;
+    uint16_t const fullMask = uint16_t((1u << sh.numSamples) - 1);
+
+    for (uint32_t i = 0; i < sh.numTriangles; ++i) {
+        const RefTriangle& t = sh.pTriangles[i];
+        int64_t const minX = t.minX > tile.x0 ? t.minX : tile.x0;
+        int64_t const maxX = t.maxX < tile.x1 ? t.maxX : tile.x1;
+        int64_t const minY = t.minY > tile.y0 ? t.minY : tile.y0;
+        int64_t const maxY = t.maxY < tile.y1 ? t.maxY : tile.y1;
+        if (minX > maxX || minY > maxY) continue;
+
+        for (int64_t by = minY; by <= maxY; by += BlockSize - (by % BlockSize)) {
+            int64_t const byEnd = (by / BlockSize + 1) * BlockSize - 1 < maxY ? (by / BlockSize + 1) * BlockSize - 1 : maxY;
+            for (int64_t bx = minX; bx <= maxX; bx += BlockSize - (bx % BlockSize)) {
+                int64_t const bxEnd = (bx / BlockSize + 1) * BlockSize - 1 < maxX ? (bx / BlockSize + 1) * BlockSize - 1 : maxX;
+                BlockCoverage const coverage = ClassifyBlock(sh, t, bx, by, bxEnd, byEnd);
+                if (coverage == BlockOutside) continue;
+                for (int64_t y = by; y <= byEnd; ++y) {
+                    uint16_t *const row = sh.pMasks + size_t(y) * sh.width;
+                    if (coverage == BlockInside) {
+                        XorSpan(row + bx, bxEnd - bx + 1, fullMask);
+                    } else {
+                        CoverRowKernel(sh, t, y, bx, bxEnd, row);
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool
+RasterRefCoverageXor(const RasterRefDesc& desc, uint16_t *pMasks)
+{
+    const RasterRefSampleLocation *const locations =
+        desc.pSampleLocations ? desc.pSampleLocations : RasterRefStandardSampleLocations(desc.numSamples);
+    if (!locations || desc.numSamples > RasterRefMaxSamples) {
+        printf("ERROR: raster reference: no sample locations for %u samples\n", desc.numSamples);
+        return false;
+    }
+    int const shift = int(desc.subPixelBits);
+    float const one = float(1 << shift);
+    // Past this the edge function products don't fit the 53 bits the doubles are exact for:
+    float const maxFixed = float(int64_t(1) << 24);
+
+    // Viewport transform as in the spec, x_f = (p_x / 2) x_d + o_x, then snap.
+    // Every vertex is snapped before touching pMasks, one out of range fails the whole reference:
+    const VkViewport& vp = desc.viewport;
+    float const halfW = vp.width * 0.5f, halfH = vp.height * 0.5f;
+    float const ox = vp.x + halfW, oy = vp.y + halfH;
+    int64_t *const snapped = static_cast<int64_t *>(malloc((desc.numTriangles ? desc.numTriangles : 1) * 6 * sizeof(int64_t)));
+    if (!snapped) {
+        printf("ERROR: raster reference: out of memory for %u triangles\n", desc.numTriangles);
+        return false;
+    }
+    for (uint32_t i = 0; i < desc.numTriangles * 3; ++i) {
+        float const fx = (halfW * desc.pPositions[2*i + 0] + ox) * one;
+        float const fy = (halfH * desc.pPositions[2*i + 1] + oy) * one;
+        if (!(fx > -maxFixed && fx < maxFixed && fy > -maxFixed && fy < maxFixed)) { // also catches NaN
+            printf("ERROR: raster reference: vertex %u at (%g, %g) is more than 2^%d pixels from the origin\n",
+                   i, fx / one, fy / one, 24 - shift);
+            free(snapped);
+            return false;
+        }
+        snapped[2*i + 0] = int64_t(llroundf(fx));
+        snapped[2*i + 1] = int64_t(llroundf(fy));
+    }
+
+    memset(pMasks, 0, size_t(desc.width) * desc.height * sizeof(uint16_t));
+
+    RasterShared sh;
+    sh.width = desc.width;
+    sh.numSamples = desc.numSamples;
+    sh.shift = shift;
+    sh.pMasks = pMasks;
+    for (uint32_t s = 0; s < desc.numSamples; ++s) {
+        sh.sampleX[s] = int64_t(llroundf(locations[s].x * one));
+        sh.sampleY[s] = int64_t(llroundf(locations[s].y * one));
+    }
+
+    RefTriangle *const triangles = static_cast<RefTriangle *>(malloc((desc.numTriangles ? desc.numTriangles : 1) * sizeof(RefTriangle)));
+    if (!triangles) {
+        printf("ERROR: raster reference: out of memory for %u triangles\n", desc.numTriangles);
+        free(snapped);
+        return false;
+    }
+    uint32_t numTriangles = 0;
+    for (uint32_t i = 0; i < desc.numTriangles; ++i) {
+        const int64_t *const p = snapped + 6*i;
+        int64_t vx[3], vy[3];
+        for (int v = 0; v < 3; ++v) {
+            vx[v] = p[2*v + 0];
+            vy[v] = p[2*v + 1];
+        }
+        int64_t const area = (vx[1] - vx[0]) * (vy[2] - vy[0]) - (vy[1] - vy[0]) * (vx[2] - vx[0]);
+        if (area == 0) continue;
+        int const i1 = area > 0 ? 1 : 2, i2 = area > 0 ? 2 : 1;
+        RefTriangle& t = triangles[numTriangles];
+        t.edges[0] = MakeEdge(vx[0], vy[0], vx[i1], vy[i1]);
+        t.edges[1] = MakeEdge(vx[i1], vy[i1], vx[i2], vy[i2]);
+        t.edges[2] = MakeEdge(vx[i2], vy[i2], vx[0], vy[0]);
+
+        // Arithmetic shifts round toward -inf, so these are the pixels holding the bounding box:
+        t.minX = (vx[0] < vx[1] ? (vx[0] < vx[2] ? vx[0] : vx[2]) : (vx[1] < vx[2] ? vx[1] : vx[2])) >> shift;
+        t.maxX = (vx[0] > vx[1] ? (vx[0] > vx[2] ? vx[0] : vx[2]) : (vx[1] > vx[2] ? vx[1] : vx[2])) >> shift;
+        t.minY = (vy[0] < vy[1] ? (vy[0] < vy[2] ? vy[0] : vy[2]) : (vy[1] < vy[2] ? vy[1] : vy[2])) >> shift;
+        t.maxY = (vy[0] > vy[1] ? (vy[0] > vy[2] ? vy[0] : vy[2]) : (vy[1] > vy[2] ? vy[1] : vy[2])) >> shift;
+        if (t.minX < 0) t.minX = 0;
+        if (t.minY < 0) t.minY = 0;
+        if (t.maxX > int64_t(desc.width) - 1) t.maxX = int64_t(desc.width) - 1;
+        if (t.maxY > int64_t(desc.height) - 1) t.maxY = int64_t(desc.height) - 1;
+        if (t.minX <= t.maxX && t.minY <= t.maxY) ++numTriangles;
+    }
+    sh.pTriangles = triangles;
+    sh.numTriangles = numTriangles;
+
+    uint32_t const tilesX = (desc.width + TileSize - 1) / TileSize;
+    uint32_t const tilesY = (desc.height + TileSize - 1) / TileSize;
+    uint32_t const numTiles = tilesX * tilesY;
+    RasterTile *const tiles = static_cast<RasterTile *>(malloc((numTiles ? numTiles : 1) * sizeof(RasterTile)));
+    if (!tiles) {
+        // Without the tile array, rasterize the whole target as one tile on this thread:
+        RasterTile whole = { &sh, 0, 0, int64_t(desc.width) - 1, int64_t(desc.height) - 1 };
+        RasterTileJob(&whole);
+        free(triangles);
+        free(snapped);
+        return true;
+    }
+    for (uint32_t ty = 0; ty < tilesY; ++ty) {
+        for (uint32_t tx = 0; tx < tilesX; ++tx) {
+            RasterTile& tile = tiles[ty * tilesX + tx];
+            tile.pShared = &sh;
+            tile.x0 = int64_t(tx) * TileSize;
+            tile.y0 = int64_t(ty) * TileSize;
+            tile.x1 = (tx + 1) * TileSize < desc.width ? int64_t(tx + 1) * TileSize - 1 : int64_t(desc.width) - 1;
+            tile.y1 = (ty + 1) * TileSize < desc.height ? int64_t(ty + 1) * TileSize - 1 : int64_t(desc.height) - 1;
+        }
+    }
+
+    // Tiles write disjoint pixels:
+    unsigned numThreads = ThreadPoolDefaultThreadCount();
+    if (numThreads > numTiles) numThreads = numTiles;
+    if (numThreads <= 1) {
+        for (uint32_t i = 0; i < numTiles; ++i) RasterTileJob(&tiles[i]);
+    } else {
+        ThreadPool *const pool = ThreadPoolCreate(numThreads, numTiles);
+        for (uint32_t i = 0; i < numTiles; ++i) ThreadPoolSubmit(pool, RasterTileJob, &tiles[i]);
+        ThreadPoolDestroy(pool);
+    }
+
+    free(tiles);
+    free(triangles);
+    free(snapped);
+    return true;
+}
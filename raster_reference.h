@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+/*
+ * CPU rasterizer for checking coverage: which samples of each pixel a list of triangles covers.
+ * Vertices go through the viewport transform, are snapped to the device's sub-pixel grid, and the
+ * edge functions are evaluated exactly. Vulkan leaves the owner of a sample exactly on an edge to
+ * the implementation; this uses D3D's top-left rule in framebuffer coordinates (y down), which is
+ * what desktop hardware does.
+ *
+ * The framebuffer is split into tiles rasterized on a thread pool. Within a tile, 8x8 pixel blocks
+ * fully inside or outside a triangle are resolved from their corners, and the rest evaluate the
+ * edge functions for several pixels at once (SSE2 or NEON, else scalar) in doubles, which are exact
+ * for the fixed point products involved.
+ */
+
+enum { RasterRefMaxSamples = 16 };
+
+struct RasterRefSampleLocation {
+    float x, y; // in [0, 1) from the top-left corner of the pixel
+};
+
+// Standard sample locations (VkPhysicalDeviceLimits::standardSampleLocations) for 1, 2, 4, 8 or 16 samples, else null.
+const RasterRefSampleLocation *
+RasterRefStandardSampleLocations(uint32_t numSamples);
+
+struct RasterRefDesc {
+    // x, y of each vertex as the xy01 passthrough vertex shader outputs it (z = 0, w = 1), 3 per triangle:
+    const float *pPositions;
+    uint32_t numTriangles;
+    VkViewport viewport;     // e.g. from vkuUpwardsViewportFromRect
+    uint32_t width, height;  // of the framebuffer, which is also the scissor
+    uint32_t numSamples;     // at most RasterRefMaxSamples
+    const RasterRefSampleLocation *pSampleLocations; // numSamples of them, null for the standard locations
+    uint32_t subPixelBits;   // VkPhysicalDeviceLimits::subPixelPrecisionBits, sample locations are snapped to it too
+};
+
+/*
+ * Writes width * height masks (tightly packed) where bit i is set if an odd number of the
+ * triangles cover sample i, which is what a fragment shader writing its input SampleMask
+ * produces with VK_LOGIC_OP_XOR. Triangles of either winding count, zero-area ones cover nothing.
+ * Vertices must land within 2^(24 - subPixelBits) pixels of the origin and the sample locations
+ * must be known, else this prints an error and returns false without writing pMasks.
+ */
+bool
+RasterRefCoverageXor(const RasterRefDesc& desc, uint16_t *pMasks);
+
+// Name of the edge function kernel picked at compile time, e.g. "sse2".
+const char *
+RasterRefKernelName();
@@ -0,0 +1,293 @@
+#include "ref_store.h"
+#include "stb/stb_image.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t RefStoreMagic = 0x46455256; // "VREF"
+static const uint32_t RefStoreVersion = 1;
+
+struct MappedFile {
+    const void *pBase;
+    size_t size;
+#ifdef _WIN32
+    HANDLE hFile;
+    HANDLE hMapping;
+#endif
+};
+
+static bool
+MapFileReadOnly(const char *path, MappedFile *m)
+{
+    *m = { };
+#ifdef _WIN32
+    m->hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m->hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m->hFile, &size) || size.QuadPart == 0 ||
+        !(m->hMapping = CreateFileMappingA(m->hFile, nullptr, PAGE_READONLY, 0, 0, nullptr))) {
+        CloseHandle(m->hFile);
+        return false;
+    }
+    m->pBase = MapViewOfFile(m->hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m->pBase) {
+        CloseHandle(m->hMapping);
+        CloseHandle(m->hFile);
+        return false;
+    }
+    m->size = size_t(size.QuadPart);
+#else
+    int const fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd); // the mapping keeps the file referenced
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    m->pBase = p;
+    m->size = size_t(st.st_size);
+#endif
+    return true;
+}
+
+static void
+UnmapFile(const MappedFile& m)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(m.pBase);
+    CloseHandle(m.hMapping);
+    CloseHandle(m.hFile);
+#else
+    munmap(const_cast<void *>(m.pBase), m.size);
+#endif
+}
+
+static bool
+StatSource(const char *path, uint64_t *pSize, int64_t *pMtime)
+{
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(path, &st) != 0) return false;
+#else
+    struct stat st;
+    if (stat(path, &st) != 0) return false;
+#endif
+    *pSize = uint64_t(st.st_size);
+    *pMtime = int64_t(st.st_mtime);
+    return true;
+}
+
+// FNV-1a style, but over 64-bit words with an extra shift so it isn't byte-serial:
+uint64_t
+RefStoreChecksum(const void *p, size_t nBytes)
+{
+    const uint8_t *const b = static_cast<const uint8_t *>(p);
+    uint64_t const Prime = 0x100000001b3ull;
+    uint64_t h = 0xcbf29ce484222325ull;
+    size_t i = 0;
+    for (; i + 8 <= nBytes; i += 8) {
+        uint64_t w;
+        memcpy(&w, b + i, 8);
+        h = (h ^ w) * Prime;
+        h ^= h >> 29;
+    }
+    for (; i < nBytes; ++i) {
+        h = (h ^ b[i]) * Prime;
+    }
+    return h;
+}
+
+// "dir/foo.png" -> "dir/foo.<VkFormat>.vkref", so different conversions of one PNG don't collide:
+static bool
+StorePathFromDesc(const RefStoreDesc& desc, char *buf, size_t bufSize)
+{
+    size_t len = strlen(desc.pngPath);
+    if (len >= 4 && strcmp(desc.pngPath + len - 4, ".png") == 0) {
+        len -= 4;
+    }
+    int const n = snprintf(buf, bufSize, "%.*s.%d.vkref", int(len), desc.pngPath, int(desc.format));
+    return n > 0 && size_t(n) < bufSize;
+}
+
+static bool
+ValidateStore(const MappedFile& m, const RefStoreDesc& desc, uint64_t sourceSize, int64_t sourceMtime)
+{
+    if (m.size < sizeof(RefStoreHeader)) {
+        return false;
+    }
+    const RefStoreHeader& hdr = *static_cast<const RefStoreHeader *>(m.pBase);
+    if (hdr.magic != RefStoreMagic || hdr.version != RefStoreVersion ||
+        hdr.format != uint32_t(desc.format) || hdr.bytesPerPixel != desc.bytesPerPixel ||
+        hdr.sourceSize != sourceSize || hdr.sourceMtime != sourceMtime) {
+        return false; // stale or not ours
+    }
+    if (hdr.pixelOffset % RefStorePixelAlignment != 0 ||
+        hdr.pixelOffset > m.size || hdr.pixelBytes > m.size - hdr.pixelOffset ||
+        hdr.rowPitch < uint64_t(hdr.width) * hdr.bytesPerPixel ||
+        hdr.rowPitch * hdr.height > hdr.pixelBytes) {
+        return false;
+    }
+    // Only done on the first open in a process, repeat runs hit the cache in RefStoreOpen:
+    return RefStoreChecksum(static_cast<const uint8_t *>(m.pBase) + hdr.pixelOffset, size_t(hdr.pixelBytes)) == hdr.checksum;
+}
+
+static bool
+BuildStore(const RefStoreDesc& desc, const char *storePath, uint64_t sourceSize, int64_t sourceMtime)
+{
+    int w, h, ncomps;
+    stbi_uc *const pDecoded = stbi_load(desc.pngPath, &w, &h, &ncomps, int(desc.pngComps));
+    if (!pDecoded) {
+        printf("Failed to load %s: %s\n", desc.pngPath, stbi_failure_reason());
+        return false;
+    }
+
+    RefStoreHeader hdr = { };
+    hdr.magic = RefStoreMagic;
+    hdr.version = RefStoreVersion;
+    hdr.format = uint32_t(desc.format);
+    hdr.width = uint32_t(w);
+    hdr.height = uint32_t(h);
+    hdr.bytesPerPixel = desc.bytesPerPixel;
+    hdr.rowPitch = uint64_t(w) * desc.bytesPerPixel;
+    hdr.pixelOffset = RefStorePixelAlignment;
+    hdr.pixelBytes = hdr.rowPitch * uint32_t(h);
+    hdr.sourceSize = sourceSize;
+    hdr.sourceMtime = sourceMtime;
+
+    uint8_t *const pPixels = static_cast<uint8_t *>(malloc(size_t(hdr.pixelBytes)));
+    size_t const srcPitch = size_t(w) * desc.pngComps;
+    for (uint32_t y = 0; y < hdr.height; ++y) {
+        if (desc.pfnConvertRow) {
+            desc.pfnConvertRow(pDecoded + y * srcPitch, pPixels + y * hdr.rowPitch, hdr.width);
+        } else {
+            memcpy(pPixels + y * hdr.rowPitch, pDecoded + y * srcPitch, srcPitch);
+        }
+    }
+    stbi_image_free(pDecoded);
+    hdr.checksum = RefStoreChecksum(pPixels, size_t(hdr.pixelBytes));
+
+    // Write under a temporary name and rename, so a crash can't leave a half-written store behind:
+    char tmpPath[1024];
+    snprintf(tmpPath, sizeof tmpPath, "%s.tmp", storePath);
+    bool bOk = false;
+    if (FILE *fp = fopen(tmpPath, "wb")) {
+        static const uint8_t Zeros[RefStorePixelAlignment] = { };
+        bOk = fwrite(&hdr, sizeof hdr, 1, fp) == 1 &&
+              fwrite(Zeros, RefStorePixelAlignment - sizeof hdr, 1, fp) == 1 &&
+              fwrite(pPixels, size_t(hdr.pixelBytes), 1, fp) == 1;
+        bOk &= (fclose(fp) == 0);
+        remove(storePath); // rename doesn't replace on Windows
+        bOk = bOk && rename(tmpPath, storePath) == 0;
+    }
+    free(pPixels);
+    if (bOk) {
+        printf("Converted %s to %s\n", desc.pngPath, storePath);
+    } else {
+        printf("Failed to write %s\n", storePath);
+        remove(tmpPath);
+    }
+    return bOk;
+}
+
+
+struct RefStoreEntry {
+    char path[1024];
+    MappedFile file;
+    RefImage image;
+};
+
+enum { RefStoreMaxEntries = 32 };
+static RefStoreEntry s_refStoreEntries[RefStoreMaxEntries];
+static unsigned s_numRefStoreEntries;
+
+bool
+RefStoreOpen(const RefStoreDesc& desc, RefImage *pImage)
+{
+    *pImage = { };
+    char storePath[1024];
+    if (!StorePathFromDesc(desc, storePath, sizeof storePath)) {
+        printf("Path too long: %s\n", desc.pngPath);
+        return false;
+    }
+    for (unsigned i = 0; i < s_numRefStoreEntries; ++i) {
+        if (strcmp(s_refStoreEntries[i].path, storePath) == 0) {
+            *pImage = s_refStoreEntries[i].image;
+            return true;
+        }
+    }
+    if (s_numRefStoreEntries == RefStoreMaxEntries) {
+        printf("Too many reference stores open, can't open %s\n", storePath);
+        return false;
+    }
+
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    if (!StatSource(desc.pngPath, &sourceSize, &sourceMtime)) {
+        printf("Failed to find %s\n", desc.pngPath);
+        return false;
+    }
+
+    MappedFile m;
+    bool bOk = MapFileReadOnly(storePath, &m);
+    if (bOk && !ValidateStore(m, desc, sourceSize, sourceMtime)) {
+        UnmapFile(m);
+        bOk = false;
+    }
+    if (!bOk) {
+        if (!BuildStore(desc, storePath, sourceSize, sourceMtime)) {
+            return false;
+        }
+        bOk = MapFileReadOnly(storePath, &m);
+        if (bOk && !ValidateStore(m, desc, sourceSize, sourceMtime)) {
+            UnmapFile(m);
+            bOk = false;
+        }
+        if (!bOk) {
+            printf("Failed to map %s after writing it\n", storePath);
+            return false;
+        }
+    }
+
+    const RefStoreHeader& hdr = *static_cast<const RefStoreHeader *>(m.pBase);
+    RefStoreEntry& e = s_refStoreEntries[s_numRefStoreEntries++];
+    strcpy(e.path, storePath);
+    e.file = m;
+    e.image.pPixels = static_cast<const uint8_t *>(m.pBase) + hdr.pixelOffset;
+    e.image.width = hdr.width;
+    e.image.height = hdr.height;
+    e.image.bytesPerPixel = hdr.bytesPerPixel;
+    e.image.rowPitch = size_t(hdr.rowPitch);
+    e.image.format = VkFormat(hdr.format);
+    *pImage = e.image;
+    return true;
+}
+
+void
+RefStoreCloseAll()
+{
+    for (unsigned i = 0; i < s_numRefStoreEntries; ++i) {
+        UnmapFile(s_refStoreEntries[i].file);
+    }
+    s_numRefStoreEntries = 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vulkan/vulkan_core.h>
+
+/*
+ * Reference images are checked in as PNGs, but decoding them on every run is wasted work.
+ * The first RefStoreOpen of a PNG converts it into an uncompressed .vkref file next to it:
+ *
+ *     RefStoreHeader, zero padding, pixels at RefStorePixelAlignment (page aligned), rows packed.
+ *
+ * Later opens (and later runs) just map that file, so verification reads the reference
+ * straight from the mapped pages. The store is rebuilt when the PNG's size or mtime changes.
+ * Opens are cached per process; mappings stay valid until RefStoreCloseAll.
+ */
+
+enum { RefStorePixelAlignment = 4096 };
+
+struct RefStoreHeader {
+    uint32_t magic;   // RefStoreMagic
+    uint32_t version; // RefStoreVersion
+    uint32_t format;  // VkFormat of the stored pixels
+    uint32_t width, height;
+    uint32_t bytesPerPixel;
+    uint64_t rowPitch;
+    uint64_t pixelOffset;
+    uint64_t pixelBytes;
+    uint64_t sourceSize;  // of the PNG it was converted from
+    int64_t sourceMtime;
+    uint64_t checksum;    // of the pixel bytes, see RefStoreChecksum
+};
+
+// Converts one row of decoded 8-bit PNG pixels (pngComps channels) to the stored format.
+typedef void (*PFN_RefStoreConvertRow)(const uint8_t *pSrc, void *pDst, uint32_t width);
+
+struct RefStoreDesc {
+    const char *pngPath;
+    uint32_t pngComps;      // channels requested from the PNG decoder, 1-4
+    VkFormat format;        // what RefImage::format will be, also part of the store's file name
+    uint32_t bytesPerPixel; // of format
+    PFN_RefStoreConvertRow pfnConvertRow; // nullptr stores the decoded pixels as is (bytesPerPixel must be pngComps)
+};
+
+struct RefImage {
+    const void *pPixels;
+    uint32_t width, height;
+    uint32_t bytesPerPixel;
+    size_t rowPitch;
+    VkFormat format;
+};
+
+// Returns false and prints why if the PNG can't be loaded or the store can't be created.
+bool
+RefStoreOpen(const RefStoreDesc& desc, RefImage *pImage);
+
+// Unmaps everything opened so far. RefImages from RefStoreOpen are invalid afterwards.
+void
+RefStoreCloseAll();
+
+uint64_t
+RefStoreChecksum(const void *p, size_t nBytes);
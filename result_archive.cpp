@@ -0,0 +1,347 @@
+#include "result_archive.h"
+#include "vk_simple_init.h"
+#include "thread_pool.h"
+#include "fast_png.h"
+#include "golden_hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+// The writer thread only ever has a few readbacks in flight, adds block beyond that:
+enum { ArchiveMaxQueued = 8, ArchiveWriteBufferSize = 1 << 20 };
+
+struct ArchiveJob {
+    ResultArchiveEntryHeader header; // everything but the offsets, sizes and hash
+    uint8_t data[1];                 // header.rawSize bytes
+};
+
+struct ArchiveState {
+    FILE *fp;
+    char *pWriteBuffer;
+    ThreadPool *pWriter;
+    bool bCompress;
+    bool bWriteFailed;
+    uint32_t vendorID, deviceID, driverVersion;
+    uint64_t nextSequence; // owned by the adding thread
+    uint64_t writePos;     // the rest is owned by the writer thread until ResultArchiveClose
+    ResultArchiveEntryHeader *pIndex;
+    size_t numEntries, indexCapacity;
+};
+
+static ArchiveState s_archive;
+
+static int
+Seek64(FILE *fp, uint64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(fp, int64_t(offset), SEEK_SET);
+#else
+    return fseeko(fp, off_t(offset), SEEK_SET);
+#endif
+}
+
+static uint64_t
+FileSize64(FILE *fp)
+{
+#ifdef _WIN32
+    _fseeki64(fp, 0, SEEK_END);
+    return uint64_t(_ftelli64(fp));
+#else
+    fseeko(fp, 0, SEEK_END);
+    return uint64_t(ftello(fp));
+#endif
+}
+
+static bool
+Truncate64(FILE *fp, uint64_t size)
+{
+    fflush(fp);
+#ifdef _WIN32
+    return _chsize_s(_fileno(fp), int64_t(size)) == 0;
+#else
+    return ftruncate(fileno(fp), off_t(size)) == 0;
+#endif
+}
+
+static bool
+ReadAt(FILE *fp, uint64_t offset, void *p, size_t n)
+{
+    return Seek64(fp, offset) == 0 && fread(p, 1, n, fp) == n;
+}
+
+static uint64_t
+AlignUp(uint64_t x)
+{
+    return (x + (ResultArchiveAlignment - 1)) & ~uint64_t(ResultArchiveAlignment - 1);
+}
+
+// Returns false if the index can't grow, leaving it as it was.
+static bool
+AppendToIndex(ArchiveState *a, const ResultArchiveEntryHeader& header)
+{
+    if (a->numEntries == a->indexCapacity) {
+        size_t const newCapacity = a->indexCapacity ? a->indexCapacity * 2 : 256;
+        void *const pNew = realloc(a->pIndex, newCapacity * sizeof(ResultArchiveEntryHeader));
+        if (!pNew) {
+            printf("ERROR: out of memory for the result archive index (%zu entries)\n", a->numEntries);
+            return false;
+        }
+        a->pIndex = (ResultArchiveEntryHeader *)pNew;
+        a->indexCapacity = newCapacity;
+    }
+    a->pIndex[a->numEntries++] = header;
+    return true;
+}
+
+static bool
+IsEntryHeader(const ResultArchiveEntryHeader& h, uint64_t pos, uint64_t fileSize)
+{
+    return h.magic == ResultArchiveEntryMagic &&
+           h.dataOffset == pos + sizeof(ResultArchiveEntryHeader) &&
+           h.storedSize <= fileSize - h.dataOffset;
+}
+
+// Loads the index of an existing archive, walking the entries if there is none. Returns where the next entry goes.
+static bool
+LoadExistingIndex(ArchiveState *a, FILE *fp, const char *path, uint64_t fileSize, uint64_t *pEndOfEntries)
+{
+    ResultArchiveFileHeader fileHeader;
+    if (!ReadAt(fp, 0, &fileHeader, sizeof fileHeader) ||
+        fileHeader.magic != ResultArchiveMagic ||
+        fileHeader.version != ResultArchiveVersion ||
+        fileHeader.entryHeaderSize != sizeof(ResultArchiveEntryHeader)) {
+        printf("ERROR: %s is not a version %u result archive.\n", path, ResultArchiveVersion);
+        return false;
+    }
+
+    ResultArchiveFooter footer;
+    if (fileSize >= sizeof fileHeader + sizeof footer &&
+        ReadAt(fp, fileSize - sizeof footer, &footer, sizeof footer) &&
+        footer.magic == ResultArchiveFooterMagic &&
+        footer.indexOffset + footer.numEntries * sizeof(ResultArchiveEntryHeader) + sizeof footer == fileSize) {
+        size_t const capacity = footer.numEntries ? size_t(footer.numEntries) : 1;
+        a->pIndex = (ResultArchiveEntryHeader *)malloc(capacity * sizeof(ResultArchiveEntryHeader));
+        if (!a->pIndex) {
+            printf("ERROR: out of memory for the index of %s (%llu entries).\n", path, (unsigned long long)footer.numEntries);
+            return false;
+        }
+        a->indexCapacity = capacity;
+        a->numEntries = size_t(footer.numEntries);
+        if (!ReadAt(fp, footer.indexOffset, a->pIndex, a->numEntries * sizeof(ResultArchiveEntryHeader))) {
+            printf("ERROR: failed to read the index of %s.\n", path);
+            return false;
+        }
+        *pEndOfEntries = footer.indexOffset;
+        return true;
+    }
+
+    uint64_t pos = sizeof fileHeader;
+    ResultArchiveEntryHeader header;
+    while (pos + sizeof header <= fileSize && ReadAt(fp, pos, &header, sizeof header) &&
+           IsEntryHeader(header, pos, fileSize)) {
+        if (!AppendToIndex(a, header)) return false;
+        pos = AlignUp(header.dataOffset + header.storedSize);
+    }
+    printf("NOTE: %s has no index (writer didn't finish?), recovered %zu entries.\n", path, a->numEntries);
+    *pEndOfEntries = pos;
+    return true;
+}
+
+bool
+ResultArchiveOpen(const char *path, bool bCompress, const VulkanObjetcs& vk)
+{
+    ArchiveState *const a = &s_archive;
+    *a = { };
+    FILE *fp = fopen(path, "r+b");
+    if (!fp) fp = fopen(path, "w+b");
+    if (!fp) {
+        printf("ERROR: failed to open result archive %s\n", path);
+        return false;
+    }
+
+    uint64_t const fileSize = FileSize64(fp);
+    uint64_t endOfEntries = sizeof(ResultArchiveFileHeader);
+    bool bOk = true;
+    if (fileSize == 0) {
+        const ResultArchiveFileHeader fileHeader = {
+            ResultArchiveMagic, ResultArchiveVersion, sizeof(ResultArchiveEntryHeader), 0
+        };
+        bOk = fwrite(&fileHeader, sizeof fileHeader, 1, fp) == 1;
+    } else {
+        bOk = LoadExistingIndex(a, fp, path, fileSize, &endOfEntries);
+    }
+    // Drop the old index now rather than at close, so a crash leaves a file that is easy to recover:
+    bOk = bOk && Truncate64(fp, endOfEntries);
+    bOk = (fclose(fp) == 0) && bOk;
+
+    // From here on the file is only appended to:
+    a->fp = bOk ? fopen(path, "ab") : nullptr;
+    if (!a->fp) {
+        printf("ERROR: failed to open result archive %s for appending\n", path);
+        free(a->pIndex);
+        *a = { };
+        return false;
+    }
+    a->pWriteBuffer = (char *)malloc(ArchiveWriteBufferSize);
+    setvbuf(a->fp, a->pWriteBuffer, _IOFBF, ArchiveWriteBufferSize);
+
+    const VkPhysicalDeviceProperties& props = vk.props2.properties;
+    a->vendorID = props.vendorID;
+    a->deviceID = props.deviceID;
+    a->driverVersion = props.driverVersion;
+    a->bCompress = bCompress;
+    a->writePos = endOfEntries;
+    a->nextSequence = a->numEntries;
+    a->pWriter = ThreadPoolCreate(1, ArchiveMaxQueued); // one writer keeps the entries in order
+    return true;
+}
+
+bool
+ResultArchiveIsOpen()
+{
+    return s_archive.fp != nullptr;
+}
+
+static void
+WriteArchiveEntry(void *pArg)
+{
+    ArchiveJob *const job = static_cast<ArchiveJob *>(pArg);
+    ArchiveState *const a = &s_archive;
+    ResultArchiveEntryHeader& header = job->header;
+    size_t const rawSize = size_t(header.rawSize);
+
+    header.rawHash = GoldenHash(job->data, rawSize);
+    header.compression = uint32_t(ResultArchiveCompression::None);
+    const void *pPayload = job->data;
+    size_t storedSize = rawSize;
+
+    uint8_t *pCompressed = nullptr;
+    if (a->bCompress) {
+        pCompressed = (uint8_t *)malloc(FastDeflateBound(rawSize));
+        size_t const n = pCompressed ? FastDeflate(job->data, rawSize, pCompressed) : 0;
+        if (n && n < rawSize) {
+            header.compression = uint32_t(ResultArchiveCompression::Deflate);
+            pPayload = pCompressed;
+            storedSize = n;
+        }
+    }
+
+    header.dataOffset = a->writePos + sizeof header;
+    header.storedSize = storedSize;
+    static const uint8_t Zeros[ResultArchiveAlignment] = { };
+    uint64_t const end = AlignUp(header.dataOffset + storedSize);
+    bool const bOk = fwrite(&header, sizeof header, 1, a->fp) == 1 &&
+                     fwrite(pPayload, 1, storedSize, a->fp) == storedSize &&
+                     fwrite(Zeros, 1, size_t(end - header.dataOffset - storedSize), a->fp) == size_t(end - header.dataOffset - storedSize);
+    if (bOk) {
+        a->writePos = end;
+        // Without a complete index, close leaves none, and the next open walks the entries instead:
+        if (!AppendToIndex(a, header)) a->bWriteFailed = true;
+    } else if (!a->bWriteFailed) {
+        printf("ERROR: failed to write result archive entry %s/%s\n", header.testName, header.params);
+        a->bWriteFailed = true;
+    }
+
+    free(pCompressed);
+    free(job);
+}
+
+void
+ResultArchiveAdd(const ResultArchiveAddDesc& desc)
+{
+    ArchiveState *const a = &s_archive;
+    if (!a->fp) return;
+
+    size_t const rowBytes = size_t(desc.width) * desc.bytesPerPixel;
+    size_t const numRows = size_t(desc.height) * desc.depth;
+    ArchiveJob *const job = (ArchiveJob *)malloc(offsetof(ArchiveJob, data) + rowBytes * numRows);
+    if (!job) {
+        printf("ERROR: out of memory for result archive entry %s/%s, skipped\n", desc.testName, desc.params);
+        return;
+    }
+    for (size_t r = 0; r < numRows; ++r) {
+        memcpy(job->data + r * rowBytes, static_cast<const uint8_t *>(desc.pData) + r * desc.rowPitch, rowBytes);
+    }
+
+    ResultArchiveEntryHeader& header = job->header;
+    header = { };
+    header.magic = ResultArchiveEntryMagic;
+    header.flags = desc.bFailed ? uint32_t(ResultArchiveEntryFailed) : 0u;
+    header.sequence = a->nextSequence++;
+    header.rawSize = rowBytes * numRows;
+    header.unixTime = uint64_t(time(nullptr));
+    header.format = uint32_t(desc.format);
+    header.width = desc.width;
+    header.height = desc.height;
+    header.depth = desc.depth;
+    header.rowPitch = uint32_t(rowBytes);
+    header.vendorID = a->vendorID;
+    header.deviceID = a->deviceID;
+    header.driverVersion = a->driverVersion;
+    snprintf(header.testName, sizeof header.testName, "%s", desc.testName);
+    snprintf(header.params, sizeof header.params, "%s", desc.params);
+
+    ThreadPoolSubmit(a->pWriter, WriteArchiveEntry, job);
+}
+
+bool
+ResultArchiveClose()
+{
+    ArchiveState *const a = &s_archive;
+    if (!a->fp) return true;
+    ThreadPoolDestroy(a->pWriter);
+
+    const ResultArchiveFooter footer = {
+        a->writePos, a->numEntries, ResultArchiveFooterMagic, ResultArchiveVersion
+    };
+    bool bOk = !a->bWriteFailed;
+    bOk = bOk && fwrite(a->pIndex, sizeof(ResultArchiveEntryHeader), a->numEntries, a->fp) == a->numEntries;
+    bOk = bOk && fwrite(&footer, sizeof footer, 1, a->fp) == 1;
+    bOk = (fclose(a->fp) == 0) && bOk;
+    if (!bOk) {
+        puts("ERROR: failed to finish the result archive, its index may be missing.");
+    }
+    free(a->pWriteBuffer);
+    free(a->pIndex);
+    *a = { };
+    return bOk;
+}
+
+bool
+ResultArchiveList(const char *path)
+{
+    ArchiveState a = { };
+    a.fp = fopen(path, "rb");
+    if (!a.fp) {
+        printf("ERROR: failed to open %s\n", path);
+        return false;
+    }
+    uint64_t endOfEntries;
+    bool const bOk = LoadExistingIndex(&a, a.fp, path, FileSize64(a.fp), &endOfEntries);
+    if (bOk) {
+        size_t numFailed = 0;
+        for (size_t i = 0; i < a.numEntries; ++i) {
+            const ResultArchiveEntryHeader& h = a.pIndex[i];
+            numFailed += (h.flags & ResultArchiveEntryFailed) ? 1 : 0;
+            printf("%6llu %-24s %-12s %4ux%-4u x%-3u format=%-3u %04x-%04x %s %10llu -> %-10llu hash=%016llx%s\n",
+                   (unsigned long long)h.sequence, h.testName, h.params, h.width, h.height, h.depth, h.format,
+                   h.vendorID, h.deviceID,
+                   h.compression == uint32_t(ResultArchiveCompression::Deflate) ? "deflate" : "raw    ",
+                   (unsigned long long)h.rawSize, (unsigned long long)h.storedSize, (unsigned long long)h.rawHash,
+                   (h.flags & ResultArchiveEntryFailed) ? "  FAILED" : "");
+        }
+        printf("%zu entries, %zu failed\n", a.numEntries, numFailed);
+    }
+    fclose(a.fp);
+    free(a.pIndex);
+    return bOk;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vulkan/vulkan_core.h>
+
+struct VulkanObjetcs;
+
+/*
+ * Append-only archive of test readbacks, so a soak run leaves one file to triage instead of
+ * thousands of loose PNGs in the working directory. File layout, all little endian:
+ *
+ *     ResultArchiveFileHeader
+ *     per entry: ResultArchiveEntryHeader, payload, zero padding to ResultArchiveAlignment
+ *     index:     ResultArchiveEntryHeader[numEntries]
+ *     ResultArchiveFooter, the last bytes of the file
+ *
+ * A viewer maps the file, reads the footer and then seeks to any entry through the index.
+ * The index repeats the entry headers, so if the writer died before writing it, the entries
+ * can still be walked from the start; ResultArchiveOpen does that when appending to such a file.
+ *
+ * Payloads are the rows packed tightly, for depth > 1 the slices follow each other. They are
+ * stored either as is or as a raw deflate stream (zlib's inflate with windowBits = -15).
+ */
+
+enum { ResultArchiveAlignment = 16, ResultArchiveVersion = 1 };
+
+enum : uint32_t {
+    ResultArchiveMagic       = 0x41524B56, // "VKRA"
+    ResultArchiveEntryMagic  = 0x45524B56, // "VKRE"
+    ResultArchiveFooterMagic = 0x49524B56, // "VKRI"
+};
+
+enum class ResultArchiveCompression : uint32_t { None, Deflate };
+
+enum : uint32_t { ResultArchiveEntryFailed = 1u << 0 };
+
+struct ResultArchiveFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryHeaderSize; // sizeof(ResultArchiveEntryHeader)
+    uint32_t reserved;
+};
+
+struct ResultArchiveEntryHeader {
+    uint32_t magic;
+    uint32_t flags;           // ResultArchiveEntry*
+    uint64_t sequence;        // 0, 1, 2... across every run that appended to the archive
+    uint64_t dataOffset;      // file offset of the payload, right after this header
+    uint64_t storedSize;      // payload bytes in the file
+    uint64_t rawSize;         // payload bytes once decompressed
+    uint64_t rawHash;         // GoldenHash of the decompressed payload, equal hashes mean equal results
+    uint64_t unixTime;
+    uint32_t compression;     // ResultArchiveCompression
+    uint32_t format;          // VkFormat of the readback
+    uint32_t width, height, depth;
+    uint32_t rowPitch;        // of the decompressed payload
+    uint32_t vendorID, deviceID, driverVersion;
+    uint32_t reserved;
+    char testName[48];        // NUL terminated
+    char params[48];
+};
+
+struct ResultArchiveFooter {
+    uint64_t indexOffset;
+    uint64_t numEntries;
+    uint32_t magic;
+    uint32_t version;
+};
+
+static_assert(sizeof(ResultArchiveEntryHeader) % ResultArchiveAlignment == 0, "payloads must stay aligned");
+
+struct ResultArchiveAddDesc {
+    const char *testName;
+    const char *params;       // "" if the test has no parameters
+    VkFormat format;
+    uint32_t width, height, depth;
+    uint32_t bytesPerPixel;
+    const void *pData;
+    size_t rowPitch;          // of pData, slices are height * rowPitch apart
+    bool bFailed;
+};
+
+// Opens an archive to append to, creating it if needed, and starts the writer thread. Device identity comes from vk.
+bool
+ResultArchiveOpen(const char *path, bool bCompress, const VulkanObjetcs& vk);
+
+bool
+ResultArchiveIsOpen();
+
+/*
+ * Copies the readback and queues it for the writer thread, which compresses and appends
+ * entries in the order they were added. Does nothing if no archive is open, so tests can
+ * call it for every readback.
+ */
+void
+ResultArchiveAdd(const ResultArchiveAddDesc& desc);
+
+// Finishes queued entries, writes the index and closes the file. Returns false if any write failed.
+bool
+ResultArchiveClose();
+
+// Prints one line per entry of an existing archive.
+bool
+ResultArchiveList(const char *path);
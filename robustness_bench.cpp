@@ -0,0 +1,467 @@
+#include "vk_simple_init.h"
+#include "vk_util.h"
+#include "volk/volk.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * What each robustness feature that main() enables costs for loads that are always in bounds, the
+ * case a shipping title pays for. A separate device is created with each mode, as the features are
+ * fixed at device creation, and the robustness_ld kernel (ld_srv_typed_2darray.comp's loads, 16 per
+ * invocation over 1024x1024 invocations) reads 64 MiB from an image array, a storage buffer and a
+ * texel buffer. The GPU time of each is turned into load throughput and compared to the device
+ * without any robustness.
+ */
+
+static void
+#ifdef __GNUC__
+__attribute__((noreturn))
+#endif
+VerifyVkResultFaild(VkResult r, const char *expr, int line)
+{
+   fprintf(stderr, "%s:%d (%s) returned non-VK_SUCCESS: %d\n", __FILE__, line, expr, r);
+   exit(r);
+}
+#define VERIFY_VK(e) do { if (VkResult _r = e) VerifyVkResultFaild(_r, #e, __LINE__); } while(0)
+
+// spirv-as --target-env vulkan1.1 robustness_ld.spvasm
+static const uint32_t RobustnessLdSpirv[] =
+{
+0x7230203,0x10300,0x70000,0x40,0,0x20011,1,0x20011,46,0x3000E,0,1,0x6000F,5,1,0x6E69616D,0,2,0x60010,1,17,8,8,1,
+0x40047,2,11,28,0x40047,3,1,0,0x40047,4,34,0,0x40047,4,33,0,0x40047,5,6,4,0x40048,6,0,24,0x50048,6,0,35,0,0x30047,6,
+2,0x40047,7,34,0,0x40047,7,33,1,0x40047,8,34,0,0x40047,8,33,2,0x40048,9,0,25,0x50048,9,0,35,0,0x30047,9,2,0x40047,
+10,34,0,0x40047,10,33,3,0x20013,11,0x30021,12,11,0x20014,13,0x40015,14,32,0,0x40015,15,32,1,0x40017,16,14,3,0x40017,
+17,14,4,0x90019,18,14,1,0,1,0,1,0,0x90019,19,14,5,0,0,0,1,0,0x3001D,5,14,0x3001E,6,5,0x3001E,9,5,0x40020,20,1,16,
+0x40020,21,0,18,0x40020,22,0,19,0x40020,23,12,6,0x40020,24,12,9,0x40020,25,12,14,0x40032,14,3,0,0x4002B,15,26,0,
+0x4002B,14,27,0,0x4002B,14,28,1,0x4002B,14,29,10,0x4002B,14,30,16,0x4002B,14,31,0x100000,0x4003B,20,2,1,0x4003B,21,
+4,0,0x4003B,23,7,12,0x4003B,22,8,0,0x4003B,24,10,12,0x50036,11,1,0,12,0x200F8,32,0x4003D,16,33,2,0x50051,14,34,33,0,
+0x50051,14,35,33,1,0x500C4,14,36,35,29,0x50080,14,37,36,34,0x200F9,38,0x200F8,38,0x700F5,14,39,27,32,40,41,0x700F5,
+14,42,27,32,43,41,0x500B0,13,44,39,30,0x400F6,45,41,0,0x400FA,44,46,45,0x200F8,46,0x50084,14,47,39,31,0x50080,14,48,
+37,47,0x300F7,49,0,0x700FB,3,50,1,51,2,52,0x200F8,50,0x4003D,18,53,4,0x60050,16,54,34,35,39,0x7005F,17,55,53,54,2,
+26,0x50051,14,56,55,0,0x200F9,49,0x200F8,51,0x60041,25,57,7,26,48,0x4003D,14,58,57,0x200F9,49,0x200F8,52,0x4003D,19,
+59,8,0x5005F,17,60,59,48,0x50051,14,61,60,0,0x200F9,49,0x200F8,49,0x900F5,14,62,56,50,58,51,61,52,0x50080,14,43,42,
+62,0x200F9,41,0x200F8,41,0x50080,14,40,39,28,0x200F9,38,0x200F8,45,0x60041,25,63,10,26,37,0x3003E,63,42,0x100FD,
+0x10038
+};
+
+
+// see robustness_ld.spvasm:
+enum : uint32_t { SpecIdSource = 0 };
+enum { SourceImage, SourceBuffer, SourceTexelBuffer, NumSources };
+static const char *const SourceNames[NumSources] = { "image", "storage buffer", "texel buffer" };
+
+struct RobustnessMode {
+    const char *name;
+    unsigned initFlags; // SIMPLE_INIT_*
+};
+
+// One device each, the last is what main() creates:
+static const RobustnessMode RobustnessModes[] = {
+    { "none",                0 },
+    { "robustBufferAccess",  SIMPLE_INIT_BUFFER_ROBUSTNESS_1 },
+    { "robustBufferAccess2", SIMPLE_INIT_BUFFER_ROBUSTNESS_1 | SIMPLE_INIT_BUFFER_ROBUSTNESS_2 },
+    { "robustImageAccess2",  SIMPLE_INIT_IMAGE_ROBUSTNESS_2 },
+    { "nullDescriptor",      SIMPLE_INIT_NULL_DESCRIPTOR },
+    { "all (main's default)", SIMPLE_INIT_BUFFER_ROBUSTNESS_1 | SIMPLE_INIT_BUFFER_ROBUSTNESS_2 |
+                              SIMPLE_INIT_IMAGE_ROBUSTNESS_2 | SIMPLE_INIT_NULL_DESCRIPTOR },
+};
+
+static constexpr unsigned RobustnessInitFlags = SIMPLE_INIT_BUFFER_ROBUSTNESS_1 | SIMPLE_INIT_BUFFER_ROBUSTNESS_2 |
+                                                SIMPLE_INIT_IMAGE_ROBUSTNESS_2 | SIMPLE_INIT_NULL_DESCRIPTOR;
+
+// The SIMPLE_INIT_* robustness flags of what the device was created with, which drops what isn't supported:
+static unsigned
+EnabledRobustness(const VulkanObjetcs& vk)
+{
+    unsigned flags = 0;
+    if (vk.features2.features.robustBufferAccess) flags |= SIMPLE_INIT_BUFFER_ROBUSTNESS_1;
+    if (vk.robustness2Features.robustBufferAccess2) flags |= SIMPLE_INIT_BUFFER_ROBUSTNESS_2;
+    if (vk.robustness2Features.robustImageAccess2) flags |= SIMPLE_INIT_IMAGE_ROBUSTNESS_2;
+    if (vk.robustness2Features.nullDescriptor) flags |= SIMPLE_INIT_NULL_DESCRIPTOR;
+    return flags;
+}
+
+enum : uint32_t {
+    GridWidth = 1024, GridHeight = 1024, LoadsPerInvocation = 16, // the kernel's constants
+    DispatchesPerSample = 8,
+    FillValue = 3 // every source word, so every output is LoadsPerInvocation * FillValue
+};
+static constexpr VkDeviceSize SourceBytes = VkDeviceSize(GridWidth) * GridHeight * LoadsPerInvocation * sizeof(uint32_t);
+static constexpr VkDeviceSize OutputBytes = VkDeviceSize(GridWidth) * GridHeight * sizeof(uint32_t);
+
+/*
+ * Times DispatchesPerSample dispatches of each source on an already created device, writing the
+ * us per dispatch, or a negative value for a source the device can't run. Returns false if an
+ * output isn't the expected sum.
+ */
+static bool
+TimeRobustnessLoads(const VulkanObjetcs& vk, double usPerDispatch[NumSources])
+{
+    VkDevice const device = vk.device;
+    VkQueue const queue = vk.universalQueue;
+    const VkPhysicalDeviceMemoryProperties& memProps = vk.memProps;
+    const VkPhysicalDeviceLimits& limits = vk.props2.properties.limits;
+    double const nsPerTick = limits.timestampPeriod;
+
+    bool bSourceOk[NumSources] = { true, true, true };
+    bSourceOk[SourceBuffer] = limits.maxStorageBufferRange >= SourceBytes;
+    bSourceOk[SourceTexelBuffer] = limits.maxTexelBufferElements >= SourceBytes / sizeof(uint32_t);
+
+    VkDescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout psoLayout = VK_NULL_HANDLE;
+    {
+        const VkDescriptorSetLayoutBinding bindings[4] = {
+            { 0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 2, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        };
+        const VkDescriptorSetLayoutCreateInfo setInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0,
+            4, bindings
+        };
+        VERIFY_VK(vkCreateDescriptorSetLayout(device, &setInfo, ALLOC_CBS, &descSetLayout));
+
+        const VkPipelineLayoutCreateInfo layoutInfo = {
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, nullptr, 0,
+            1, &descSetLayout,
+            0, nullptr
+        };
+        VERIFY_VK(vkCreatePipelineLayout(device, &layoutInfo, ALLOC_CBS, &psoLayout));
+    }
+
+    // The shader cache and pipeline batches belong to main()'s device, so these are plain creates:
+    VkPipeline pipelines[NumSources];
+    {
+        VkShaderModule shaderModule;
+        const VkShaderModuleCreateInfo moduleInfo = {
+            VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
+            sizeof RobustnessLdSpirv, RobustnessLdSpirv
+        };
+        VERIFY_VK(vkCreateShaderModule(device, &moduleInfo, ALLOC_CBS, &shaderModule));
+        uint32_t sources[NumSources];
+        VkSpecializationInfo specInfos[NumSources];
+        VkComputePipelineCreateInfo pipelineInfos[NumSources];
+        const VkSpecializationMapEntry specEntry = { SpecIdSource, 0, sizeof(uint32_t) };
+        for (uint32_t s = 0; s < NumSources; ++s) {
+            sources[s] = s;
+            specInfos[s] = { 1, &specEntry, sizeof(uint32_t), &sources[s] };
+            pipelineInfos[s] = {
+                VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                nullptr, // pNext
+                0, // VkPipelineCreateFlags
+                {
+                    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    nullptr,
+                    0, // VkPipelineShaderStageCreateFlags
+                    VK_SHADER_STAGE_COMPUTE_BIT,
+                    shaderModule,
+                    "main",
+                    &specInfos[s] },
+                psoLayout,
+                VK_NULL_HANDLE, // basePipelineHandle
+                -1 // basePipelineIndex
+            };
+        }
+        VERIFY_VK(vkCreateComputePipelines(device, VK_NULL_HANDLE, NumSources, pipelineInfos, ALLOC_CBS, pipelines));
+        vkDestroyShaderModule(device, shaderModule, ALLOC_CBS);
+    }
+
+    VkuImageAndMemory image;
+    VkImageView imageView;
+    {
+        VkImageCreateInfo imageInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = VK_FORMAT_R32_UINT;
+        imageInfo.extent = { GridWidth, GridHeight, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = LoadsPerInvocation;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        VERIFY_VK(vkuDedicatedImage(device, imageInfo, &image, memProps));
+
+        const VkImageViewCreateInfo viewInfo = {
+            VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, nullptr, 0,
+            image.image,
+            VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+            VK_FORMAT_R32_UINT,
+            { }, // VkComponentMapping all zeroes is identity
+            { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, LoadsPerInvocation }
+        };
+        VERIFY_VK(vkCreateImageView(device, &viewInfo, ALLOC_CBS, &imageView));
+    }
+
+    VkuBufferAndMemory srcBuffer, dstBuffer;
+    VkBufferView texelView;
+    {
+        VERIFY_VK(vkuDedicatedBuffer(device, SourceBytes,
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                     &srcBuffer, memProps, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+        VERIFY_VK(vkuDedicatedBuffer(device, OutputBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                     &dstBuffer, memProps, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+        // Clamped to the limit if the texel buffer source is too big for it, it then isn't run:
+        const VkBufferViewCreateInfo viewInfo = {
+            VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO, nullptr, 0,
+            srcBuffer.buffer, VK_FORMAT_R32_UINT,
+            0, // offset
+            bSourceOk[SourceTexelBuffer] ? SourceBytes : VkDeviceSize(limits.maxTexelBufferElements) * sizeof(uint32_t)
+        };
+        VERIFY_VK(vkCreateBufferView(device, &viewInfo, ALLOC_CBS, &texelView));
+    }
+
+    VkuStagingBuffer stage;
+    VERIFY_VK(vkuStagingBuffer(device, OutputBytes * NumSources, VK_BUFFER_USAGE_TRANSFER_DST_BIT, &stage, memProps));
+
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descSet = VK_NULL_HANDLE;
+    {
+        static const VkDescriptorPoolSize poolSizes[] = {
+           { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1 },
+           { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 },
+           { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1 },
+        };
+        const VkDescriptorPoolCreateInfo descPoolInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr, 0,
+            1, // maxSets
+            lengthof(poolSizes), poolSizes
+        };
+        VERIFY_VK(vkCreateDescriptorPool(device, &descPoolInfo, ALLOC_CBS, &descriptorPool));
+        const VkDescriptorSetAllocateInfo descAllocInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
+            descriptorPool, 1, &descSetLayout
+        };
+        VERIFY_VK(vkAllocateDescriptorSets(device, &descAllocInfo, &descSet));
+
+        // The storage buffer range is clamped the same way:
+        const VkDescriptorImageInfo imageInfo = { VkSampler(), imageView, VK_IMAGE_LAYOUT_GENERAL };
+        const VkDescriptorBufferInfo srcInfo = {
+            srcBuffer.buffer, 0, bSourceOk[SourceBuffer] ? SourceBytes : VkDeviceSize(limits.maxStorageBufferRange)
+        };
+        const VkDescriptorBufferInfo dstInfo = { dstBuffer.buffer, 0, OutputBytes };
+        const VkWriteDescriptorSet writes[4] = {
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, descSet, 0, 0, 1, // binding, arrayIndex, count
+              VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, &imageInfo, nullptr, nullptr },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, descSet, 1, 0, 1, // binding, arrayIndex, count
+              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &srcInfo, nullptr },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, descSet, 2, 0, 1, // binding, arrayIndex, count
+              VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, nullptr, nullptr, &texelView },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, descSet, 3, 0, 1, // binding, arrayIndex, count
+              VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, &dstInfo, nullptr },
+        };
+        vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+    }
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    {
+        VkQueryPoolCreateInfo info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        info.queryCount = NumSources * 2; // begin, end per source
+        VERIFY_VK(vkCreateQueryPool(device, &info, ALLOC_CBS, &queryPool));
+    }
+
+    VkCommandPool cmdpool = VK_NULL_HANDLE;
+    VkCommandBuffer cmdbuf = VK_NULL_HANDLE;
+    {
+        const VkCommandPoolCreateInfo cmdPoolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr,
+            0, // flags
+            vk.universalFamilyIndex
+        };
+        VERIFY_VK(vkCreateCommandPool(device, &cmdPoolInfo, ALLOC_CBS, &cmdpool));
+
+        const VkCommandBufferAllocateInfo cmdBufAllocInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr, cmdpool,
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            1 // commandBufferCount
+        };
+        VERIFY_VK(vkAllocateCommandBuffers(device, &cmdBufAllocInfo, &cmdbuf));
+    }
+
+    // record commands:
+    {
+        const VkCommandBufferBeginInfo cmdBufbeginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr
+        };
+        VERIFY_VK(vkBeginCommandBuffer(cmdbuf, &cmdBufbeginInfo));
+        vkCmdResetQueryPool(cmdbuf, queryPool, 0, NumSources * 2);
+
+        VkImageMemoryBarrier ib = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        ib.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        ib.image = image.image;
+        ib.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        ib.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        ib.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        ib.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, -1u, 0, -1u };
+        vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0x0,
+                             0, nullptr, 0, nullptr, 1, &ib);
+        {
+            VkClearColorValue clearVal; for (uint32_t &r : clearVal.uint32) r = FillValue;
+            const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, LoadsPerInvocation };
+            vkCmdClearColorImage(cmdbuf, image.image, VK_IMAGE_LAYOUT_GENERAL, &clearVal, 1, &range);
+        }
+        vkCmdFillBuffer(cmdbuf, srcBuffer.buffer, 0, VK_WHOLE_SIZE, FillValue);
+        VkMemoryBarrier memBarrier = {
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_SHADER_READ_BIT,
+        };
+        vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0x0,
+                             1, &memBarrier, 0, nullptr, 0 , nullptr);
+
+        vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, psoLayout, 0, 1, &descSet, 0, nullptr);
+        for (uint32_t s = 0; s < NumSources; ++s) {
+            if (!bSourceOk[s]) {
+                // Still written so every result of the pool becomes available:
+                vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, s * 2);
+                vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, s * 2 + 1);
+                continue;
+            }
+            vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[s]);
+            // An untimed dispatch first so the sample doesn't include warming up caches and clocks:
+            vkCmdDispatch(cmdbuf, GridWidth / 8, GridHeight / 8, 1);
+            // Serialize the dispatches so each sample is their summed execution time, not how well they overlap.
+            // The begin timestamp waits on the warm-up too, else the sample starts while it is still running:
+            memBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            memBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0x0,
+                                 1, &memBarrier, 0, nullptr, 0 , nullptr);
+            vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, s * 2);
+            for (uint32_t d = 0; d < DispatchesPerSample; ++d) {
+                if (d != 0) {
+                    vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0x0,
+                                         1, &memBarrier, 0, nullptr, 0 , nullptr);
+                }
+                vkCmdDispatch(cmdbuf, GridWidth / 8, GridHeight / 8, 1);
+            }
+            vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, s * 2 + 1);
+
+            memBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            memBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0x0,
+                                 1, &memBarrier, 0, nullptr, 0 , nullptr);
+            const VkBufferCopy copy = { 0, s * OutputBytes, OutputBytes };
+            vkCmdCopyBuffer(cmdbuf, dstBuffer.buffer, stage.buffer, 1, &copy);
+            // The next source's dispatches overwrite the output the copy reads:
+            memBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            memBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0x0,
+                                 1, &memBarrier, 0, nullptr, 0 , nullptr);
+        }
+        memBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        memBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0x0,
+                             1, &memBarrier, 0, nullptr, 0 , nullptr);
+        VERIFY_VK(vkEndCommandBuffer(cmdbuf));
+    }
+
+    // submit and WFI:
+    {
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmdbuf;
+        VERIFY_VK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+        VERIFY_VK(vkQueueWaitIdle(queue));
+        vkuInvalidateStagingBuffer(device, stage);
+    }
+
+    uint64_t ticks[NumSources * 2];
+    VERIFY_VK(vkGetQueryPoolResults(device, queryPool, 0, NumSources * 2, sizeof ticks, ticks, sizeof(uint64_t),
+                                    VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    bool bPassed = true;
+    for (uint32_t s = 0; s < NumSources; ++s) {
+        if (!bSourceOk[s]) {
+            usPerDispatch[s] = -1.0;
+            continue;
+        }
+        usPerDispatch[s] = double(ticks[s * 2 + 1] - ticks[s * 2]) * nsPerTick / 1e3 / DispatchesPerSample;
+        const uint32_t *const pOut = (const uint32_t *)((const char *)stage.pHost + s * OutputBytes);
+        uint32_t const expected = LoadsPerInvocation * FillValue;
+        for (uint32_t i = 0; i < GridWidth * GridHeight; ++i) {
+            if (pOut[i] != expected) {
+                printf("ERROR: %s output[%u] = %u, expected %u.\n", SourceNames[s], i, pOut[i], expected);
+                bPassed = false;
+                break;
+            }
+        }
+    }
+
+    vkDestroyCommandPool(device, cmdpool, ALLOC_CBS);
+    vkDestroyQueryPool(device, queryPool, ALLOC_CBS);
+    vkDestroyDescriptorPool(device, descriptorPool, ALLOC_CBS);
+    vkuDestroyStagingBuffer(device, stage);
+    vkDestroyBufferView(device, texelView, ALLOC_CBS);
+    vkuDestroyBufferAndFreeMemory(device, srcBuffer);
+    vkuDestroyBufferAndFreeMemory(device, dstBuffer);
+    vkDestroyImageView(device, imageView, ALLOC_CBS);
+    vkuDestroyImageAndFreeMemory(device, image);
+    for (VkPipeline pso : pipelines) vkDestroyPipeline(device, pso, ALLOC_CBS);
+    vkDestroyPipelineLayout(device, psoLayout, ALLOC_CBS);
+    vkDestroyDescriptorSetLayout(device, descSetLayout, ALLOC_CBS);
+    return bPassed;
+}
+
+/*
+ * Creates its own devices, so main() runs it before creating one. initFlags: the flags main() would
+ * create its device with, only the validation and debug ones are kept.
+ */
+bool TestRobustnessBench(unsigned initFlags, int gpuIndex)
+{
+    static constexpr uint32_t NumModes = lengthof(RobustnessModes);
+    double us[NumModes][NumSources];
+    bool bRan[NumModes] = { };
+    bool bPassed = true;
+    char deviceName[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE] = "";
+    for (uint32_t m = 0; m < NumModes; ++m) {
+        const RobustnessMode& mode = RobustnessModes[m];
+        printf("Creating a device with robustness: %s\n", mode.name); fflush(stdout);
+        VulkanObjetcs vk;
+        if (VkResult r = SimpleInitVulkan(&vk, (initFlags & ~RobustnessInitFlags) | mode.initFlags, gpuIndex, GpuVendorID::Intel)) {
+            printf("ERROR: SimpleInitVulkan returned %d (%s).\n", r, StringFromVkResult(r));
+            SimpleDestroyVulkan(&vk);
+            return false;
+        }
+        unsigned const enabled = EnabledRobustness(vk);
+        if (enabled != mode.initFlags) {
+            printf("NOTE: %s is not supported, skipped.\n", mode.name);
+        } else if (vk.props2.properties.limits.timestampComputeAndGraphics == VK_FALSE) {
+            puts("ERROR: timestamps are not supported.");
+            SimpleDestroyVulkan(&vk);
+            return false;
+        } else {
+            memcpy(deviceName, vk.props2.properties.deviceName, sizeof deviceName);
+            bPassed &= TimeRobustnessLoads(vk, us[m]);
+            bRan[m] = true;
+        }
+        SimpleDestroyVulkan(&vk);
+    }
+    if (!bRan[0]) {
+        puts("ERROR: couldn't create a device without robustness to compare to.");
+        return false;
+    }
+
+    printf("%s, %ux%u invocations of %u in bounds loads (%u MiB) per dispatch, %u dispatches per sample.\n",
+           deviceName, GridWidth, GridHeight, LoadsPerInvocation, unsigned(SourceBytes >> 20), DispatchesPerSample);
+    printf("GB/s, and the change from no robustness:\n");
+    printf("  %-22s", "mode");
+    for (const char *name : SourceNames) printf(" %22s", name);
+    putchar('\n');
+    for (uint32_t m = 0; m < NumModes; ++m) {
+        if (!bRan[m]) continue;
+        printf("  %-22s", RobustnessModes[m].name);
+        for (uint32_t s = 0; s < NumSources; ++s) {
+            if (us[m][s] <= 0.0 || us[0][s] <= 0.0) {
+                printf(" %22s", "n/a");
+                continue;
+            }
+            double const gbps = double(SourceBytes) / (us[m][s] * 1e3);
+            printf(" %13.1f (%+5.1f%%)", gbps, (us[0][s] / us[m][s] - 1.0) * 100.0);
+        }
+        putchar('\n');
+    }
+    return bPassed;
+}
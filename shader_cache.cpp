@@ -0,0 +1,374 @@
+#include "shader_cache.h"
+#include "vk_simple_init.h"
+#include "volk/volk.h"
+#include "golden_hash.h"
+#include "bench_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <mutex>
+
+enum { MaxCachedModules = 128, MaxPipelineStages = 6 };
+
+struct CachedModule {
+    uint64_t hash;
+    uint32_t *pWords; // copy of the SPIR-V, to tell hash collisions apart
+    size_t nBytes;
+    VkShaderModule module;
+    uint32_t refCount;
+    bool bBuilt;      // some pipeline using it went into s_pipelineCache
+#ifdef VK_EXT_shader_module_identifier
+    VkShaderModuleIdentifierEXT identifier; // identifierSize = 0 if not available
+#endif
+};
+
+static std::mutex s_mutex;
+static VkDevice s_device;
+static VkPipelineCache s_pipelineCache;
+static const char *s_pipelineCachePath;
+static bool s_bIdentifiers;
+static bool s_bFeedback;
+static CachedModule s_modules[MaxCachedModules];
+static uint32_t s_numModules;
+static uint32_t s_numHits, s_numIdentifierBuilds, s_numIdentifierMisses;
+
+static thread_local PipelineBuildStats t_lastBuild;
+
+/*
+ * Reads a file written by SaveCacheData if it came from this device and driver. Drivers should
+ * reject foreign data themselves, but not all of them are careful about it.
+ */
+static void *
+LoadCacheData(const char *path, const VkPhysicalDeviceProperties& props, size_t *pSize)
+{
+    *pSize = 0;
+    FILE *const fp = fopen(path, "rb");
+    if (!fp) return nullptr; // first run
+    void *pData = nullptr;
+    long size = -1;
+    if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) >= 32 && fseek(fp, 0, SEEK_SET) == 0 &&
+        (pData = malloc(size)) && fread(pData, 1, size, fp) == size_t(size)) {
+        // VkPipelineCacheHeaderVersionOne: headerSize, headerVersion, vendorID, deviceID, pipelineCacheUUID
+        uint32_t header[4];
+        memcpy(header, pData, sizeof header);
+        if (header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE && header[2] == props.vendorID && header[3] == props.deviceID &&
+            memcmp(static_cast<const uint8_t *>(pData) + 16, props.pipelineCacheUUID, VK_UUID_SIZE) == 0) {
+            *pSize = size_t(size);
+        } else {
+            printf("NOTE: pipeline cache %s is from another device or driver, starting empty.\n", path);
+        }
+    }
+    fclose(fp);
+    if (*pSize == 0) {
+        free(pData);
+        pData = nullptr;
+    }
+    return pData;
+}
+
+static void
+SaveCacheData(const char *path)
+{
+    size_t size = 0;
+    void *pData = nullptr;
+    if (vkGetPipelineCacheData(s_device, s_pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0 ||
+        !(pData = malloc(size)) || vkGetPipelineCacheData(s_device, s_pipelineCache, &size, pData) != VK_SUCCESS) {
+        free(pData);
+        return;
+    }
+    bool bOk = false;
+    if (FILE *const fp = fopen(path, "wb")) {
+        bOk = fwrite(pData, 1, size, fp) == size;
+        bOk &= fclose(fp) == 0;
+    }
+    if (!bOk) {
+        printf("WARNING: failed to write pipeline cache %s\n", path);
+    }
+    free(pData);
+}
+
+void
+ShaderCacheInit(const VulkanObjetcs& vk, const char *pipelineCachePath)
+{
+    s_device = vk.device;
+    s_pipelineCachePath = pipelineCachePath;
+    s_bIdentifiers = vk.EXT_shader_module_identifier;
+    s_bFeedback = vk.EXT_pipeline_creation_feedback;
+    VkPipelineCacheCreateInfo cacheInfo = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+    void *pInitialData = pipelineCachePath ? LoadCacheData(pipelineCachePath, vk.props2.properties, &cacheInfo.initialDataSize) : nullptr;
+    cacheInfo.pInitialData = pInitialData;
+    if (vkCreatePipelineCache(vk.device, &cacheInfo, ALLOC_CBS, &s_pipelineCache) != VK_SUCCESS) {
+        s_pipelineCache = VK_NULL_HANDLE; // still fine to build pipelines, just without reuse
+    }
+    free(pInitialData);
+}
+
+void
+ShaderCacheDestroy()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (!s_device) return;
+    uint32_t numLeaked = 0;
+    for (uint32_t i = 0; i < s_numModules; ++i) {
+        numLeaked += s_modules[i].refCount != 0;
+        vkDestroyShaderModule(s_device, s_modules[i].module, ALLOC_CBS);
+        free(s_modules[i].pWords);
+    }
+    if (s_numModules) {
+        printf("Shader cache: %u modules, %u hits, %u of %u identifier builds needed a compile.\n",
+               s_numModules, s_numHits, s_numIdentifierMisses, s_numIdentifierBuilds);
+    }
+    if (numLeaked) {
+        printf("WARNING: %u cached shader modules were never released.\n", numLeaked);
+    }
+    if (s_pipelineCachePath && s_pipelineCache) {
+        SaveCacheData(s_pipelineCachePath);
+    }
+    vkDestroyPipelineCache(s_device, s_pipelineCache, ALLOC_CBS);
+    s_pipelineCache = VK_NULL_HANDLE;
+    s_numModules = 0;
+    s_device = VK_NULL_HANDLE;
+}
+
+static CachedModule *
+FindModule(VkShaderModule module)
+{
+    for (uint32_t i = 0; i < s_numModules; ++i) {
+        if (s_modules[i].module == module) return &s_modules[i];
+    }
+    return nullptr;
+}
+
+VkResult
+ShaderCacheAcquire(const uint32_t *pCode, size_t nBytes, VkShaderModule *pModule)
+{
+    uint64_t const hash = GoldenHash(pCode, nBytes) ^ nBytes;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    for (uint32_t i = 0; i < s_numModules; ++i) {
+        CachedModule *const c = &s_modules[i];
+        if (c->hash == hash && c->nBytes == nBytes && memcmp(c->pWords, pCode, nBytes) == 0) {
+            c->refCount++;
+            s_numHits++;
+            *pModule = c->module;
+            return VK_SUCCESS;
+        }
+    }
+
+    VkShaderModuleCreateInfo info = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+    info.codeSize = nBytes;
+    info.pCode = pCode;
+    *pModule = VK_NULL_HANDLE;
+    VkResult const r = vkCreateShaderModule(s_device, &info, ALLOC_CBS, pModule);
+    if (r != VK_SUCCESS || s_numModules == MaxCachedModules) {
+        return r; // if the cache is full the module is just not shared, ShaderCacheRelease destroys it
+    }
+
+    CachedModule *const c = &s_modules[s_numModules];
+    *c = { };
+    if (!(c->pWords = static_cast<uint32_t *>(malloc(nBytes)))) return r;
+    memcpy(c->pWords, pCode, nBytes);
+    c->hash = hash;
+    c->nBytes = nBytes;
+    c->module = *pModule;
+    c->refCount = 1;
+#ifdef VK_EXT_shader_module_identifier
+    if (s_bIdentifiers) {
+        c->identifier.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_IDENTIFIER_EXT;
+        vkGetShaderModuleIdentifierEXT(s_device, c->module, &c->identifier);
+    }
+#endif
+    s_numModules++;
+    return r;
+}
+
+VkResult
+ShaderCacheAcquireFile(const char *path, VkShaderModule *pModule)
+{
+    *pModule = VK_NULL_HANDLE;
+    FILE *const fp = fopen(path, "rb");
+    if (!fp) {
+        perror("fopen");
+        fprintf(stderr, "(path)=(%s)\n", path);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    VkResult r = VK_ERROR_INITIALIZATION_FAILED;
+    long size = -1;
+    if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) >= 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        if (size > 0x7fffffff || size < 20 || (size & 3u)) {
+            printf("%s: bad size = %ld\n", path, size);
+        } else if (uint32_t *const pWords = static_cast<uint32_t *>(malloc(size))) {
+            if (fread(pWords, 1, size, fp) == size_t(size)) {
+                r = ShaderCacheAcquire(pWords, size_t(size), pModule);
+            } else {
+                perror("fread");
+            }
+            free(pWords);
+        }
+    } else {
+        perror("fseek/ftell/fseek");
+    }
+    fclose(fp);
+    return r;
+}
+
+void
+ShaderCacheRelease(VkShaderModule module)
+{
+    if (module == VK_NULL_HANDLE) return;
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (CachedModule *const c = FindModule(module)) {
+        assert(c->refCount > 0);
+        c->refCount--;
+    } else {
+        vkDestroyShaderModule(s_device, module, ALLOC_CBS);
+    }
+}
+
+VkPipelineCache
+ShaderCachePipelineCache()
+{
+    return s_pipelineCache;
+}
+
+#ifdef VK_EXT_shader_module_identifier
+/*
+ * Copies the stages, naming each module by its identifier instead. Only done once every module
+ * has been in a pipeline built into the cache, otherwise a compile is certain and the identifier
+ * attempt is wasted.
+ */
+static bool
+UseIdentifiers(const VkPipelineShaderStageCreateInfo *pSrc, uint32_t n, VkPipelineShaderStageCreateInfo *pDst,
+               VkPipelineShaderStageModuleIdentifierCreateInfoEXT *pIds)
+{
+    // No stages (library links, vertex input and fragment output parts) means nothing to name:
+    if (!s_bIdentifiers || !s_pipelineCache || n == 0 || n > MaxPipelineStages) return false;
+    std::lock_guard<std::mutex> lock(s_mutex);
+    for (uint32_t i = 0; i < n; ++i) {
+        CachedModule const *const c = FindModule(pSrc[i].module);
+        if (!c || !c->bBuilt || c->identifier.identifierSize == 0) return false;
+        pIds[i] = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_MODULE_IDENTIFIER_CREATE_INFO_EXT };
+        pIds[i].pNext = pSrc[i].pNext;
+        pIds[i].identifierSize = c->identifier.identifierSize;
+        pIds[i].pIdentifier = c->identifier.identifier;
+        pDst[i] = pSrc[i];
+        pDst[i].pNext = &pIds[i];
+        pDst[i].module = VK_NULL_HANDLE;
+    }
+    s_numIdentifierBuilds++;
+    return true;
+}
+#endif
+
+static void
+MarkBuilt(const VkPipelineShaderStageCreateInfo *pStages, uint32_t n)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    for (uint32_t i = 0; i < n; ++i) {
+        if (CachedModule *const c = FindModule(pStages[i].module)) c->bBuilt = true;
+    }
+}
+
+/*
+ * Chains VkPipelineCreationFeedback onto a build and times it, filling t_lastBuild.
+ * Stage feedback is only asked for when it fits, the count has to match the stage count.
+ */
+struct FeedbackChain {
+    VkPipelineCreationFeedbackCreateInfoEXT info;
+    VkPipelineCreationFeedbackEXT pipeline;
+    VkPipelineCreationFeedbackEXT stages[MaxPipelineStages];
+    uint64_t startNs;
+};
+
+static const void *
+BeginBuild(FeedbackChain *f, const void *pNext, uint32_t stageCount, bool bIdentifier)
+{
+    t_lastBuild = { };
+    t_lastBuild.bIdentifier = bIdentifier;
+    t_lastBuild.stageCount = stageCount;
+    f->startNs = BenchNowNs();
+    if (!s_bFeedback) return pNext;
+    f->info = { VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT };
+    f->info.pNext = pNext;
+    f->info.pPipelineCreationFeedback = &f->pipeline;
+    if (stageCount <= MaxPipelineStages) {
+        f->info.pipelineStageCreationFeedbackCount = stageCount;
+        f->info.pPipelineStageCreationFeedbacks = f->stages;
+    }
+    return &f->info;
+}
+
+static void
+EndBuild(const FeedbackChain& f, VkResult r)
+{
+    t_lastBuild.wallNs = BenchNowNs() - f.startNs;
+    if (!s_bFeedback || r != VK_SUCCESS || !(f.pipeline.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)) return;
+    t_lastBuild.bFeedback = true;
+    t_lastBuild.driverNs = f.pipeline.duration;
+    t_lastBuild.bCacheHit = (f.pipeline.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) != 0;
+    for (uint32_t i = 0; i < f.info.pipelineStageCreationFeedbackCount; ++i) {
+        t_lastBuild.stageCacheHits += (f.stages[i].flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) != 0;
+    }
+}
+
+const PipelineBuildStats&
+ShaderCacheLastBuildStats()
+{
+    return t_lastBuild;
+}
+
+VkResult
+ShaderCacheCreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& info, VkPipeline *pPipeline)
+{
+    FeedbackChain feedback;
+#ifdef VK_EXT_shader_module_identifier
+    VkPipelineShaderStageCreateInfo stages[MaxPipelineStages];
+    VkPipelineShaderStageModuleIdentifierCreateInfoEXT ids[MaxPipelineStages];
+    if (UseIdentifiers(info.pStages, info.stageCount, stages, ids)) {
+        VkGraphicsPipelineCreateInfo idInfo = info;
+        idInfo.pNext = BeginBuild(&feedback, info.pNext, info.stageCount, true);
+        idInfo.flags |= VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT_EXT;
+        idInfo.pStages = stages;
+        VkResult const r = vkCreateGraphicsPipelines(s_device, s_pipelineCache, 1, &idInfo, ALLOC_CBS, pPipeline);
+        EndBuild(feedback, r);
+        if (r != VK_PIPELINE_COMPILE_REQUIRED_EXT) return r;
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_numIdentifierMisses++;
+    }
+#endif
+    VkGraphicsPipelineCreateInfo fbInfo = info;
+    fbInfo.pNext = BeginBuild(&feedback, info.pNext, info.stageCount, false);
+    VkResult const r = vkCreateGraphicsPipelines(s_device, s_pipelineCache, 1, &fbInfo, ALLOC_CBS, pPipeline);
+    EndBuild(feedback, r);
+    if (r == VK_SUCCESS) MarkBuilt(info.pStages, info.stageCount);
+    return r;
+}
+
+VkResult
+ShaderCacheCreateComputePipeline(const VkComputePipelineCreateInfo& info, VkPipeline *pPipeline)
+{
+    FeedbackChain feedback;
+#ifdef VK_EXT_shader_module_identifier
+    VkPipelineShaderStageCreateInfo stage;
+    VkPipelineShaderStageModuleIdentifierCreateInfoEXT id;
+    if (UseIdentifiers(&info.stage, 1, &stage, &id)) {
+        VkComputePipelineCreateInfo idInfo = info;
+        idInfo.pNext = BeginBuild(&feedback, info.pNext, 1, true);
+        idInfo.flags |= VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT_EXT;
+        idInfo.stage = stage;
+        VkResult const r = vkCreateComputePipelines(s_device, s_pipelineCache, 1, &idInfo, ALLOC_CBS, pPipeline);
+        EndBuild(feedback, r);
+        if (r != VK_PIPELINE_COMPILE_REQUIRED_EXT) return r;
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_numIdentifierMisses++;
+    }
+#endif
+    VkComputePipelineCreateInfo fbInfo = info;
+    fbInfo.pNext = BeginBuild(&feedback, info.pNext, 1, false);
+    VkResult const r = vkCreateComputePipelines(s_device, s_pipelineCache, 1, &fbInfo, ALLOC_CBS, pPipeline);
+    EndBuild(feedback, r);
+    if (r == VK_SUCCESS) MarkBuilt(&info.stage, 1);
+    return r;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vulkan/vulkan_core.h>
+
+struct VulkanObjetcs;
+
+/*
+ * Process-wide shader module cache, keyed by a hash of the SPIR-V words (a hit also compares
+ * the words, so a hash collision only costs a second module). Modules are refcounted but stay
+ * alive when released until ShaderCacheDestroy, so repeat and sweep runs that rebuild their
+ * pipelines get the same VkShaderModule back instead of having the driver parse the SPIR-V again.
+ *
+ * Pipelines built through ShaderCacheCreate*Pipeline go into one shared VkPipelineCache. With
+ * VK_EXT_shader_module_identifier, once a cached module has been built into a pipeline, later
+ * builds name it by its identifier with FAIL_ON_PIPELINE_COMPILE_REQUIRED, so a pipeline cache
+ * hit never touches the SPIR-V; on VK_PIPELINE_COMPILE_REQUIRED they retry with the module.
+ *
+ * The pipeline cache can be kept in a file between runs (--pipeline-cache), which takes most
+ * of the compile time out of starting a test on a cold process.
+ *
+ * Thread safe, pipelines may be built from several threads.
+ */
+
+// pipelineCachePath: file the pipeline cache is loaded from and saved to, or null to keep it in memory.
+void
+ShaderCacheInit(const VulkanObjetcs& vk, const char *pipelineCachePath);
+
+// Destroys every cached module and the pipeline cache, saving it first. Call before destroying the device.
+void
+ShaderCacheDestroy();
+
+// Returns the cached module for this SPIR-V, creating it on first use, and takes a reference.
+VkResult
+ShaderCacheAcquire(const uint32_t *pCode, size_t nBytes, VkShaderModule *pModule);
+
+template<size_t N> inline VkResult
+ShaderCacheAcquire(const uint32_t (&a)[N], VkShaderModule *pModule)
+{
+    return ShaderCacheAcquire(a, N * sizeof (uint32_t), pModule);
+}
+
+// Reads a .spv file and acquires its module, VK_ERROR_INITIALIZATION_FAILED if the file can't be read.
+VkResult
+ShaderCacheAcquireFile(const char *path, VkShaderModule *pModule);
+
+// Drops a reference; pipelines created from the module remain valid either way.
+void
+ShaderCacheRelease(VkShaderModule module);
+
+VkPipelineCache
+ShaderCachePipelineCache();
+
+VkResult
+ShaderCacheCreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& info, VkPipeline *pPipeline);
+
+VkResult
+ShaderCacheCreateComputePipeline(const VkComputePipelineCreateInfo& info, VkPipeline *pPipeline);
+
+struct PipelineBuildStats {
+    uint64_t wallNs;         // time spent in vkCreate*Pipelines, the successful attempt only
+    uint64_t driverNs;       // VkPipelineCreationFeedback duration
+    bool bFeedback;          // driverNs, bCacheHit and stageCacheHits are valid (VK_EXT_pipeline_creation_feedback)
+    bool bCacheHit;          // found in the pipeline cache
+    bool bIdentifier;        // built from module identifiers
+    uint32_t stageCount;
+    uint32_t stageCacheHits;
+};
+
+// What the last ShaderCacheCreate*Pipeline call on the calling thread did.
+const PipelineBuildStats&
+ShaderCacheLastBuildStats();
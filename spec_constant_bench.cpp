@@ -0,0 +1,385 @@
+#include "vk_simple_init.h"
+#include "vk_util.h"
+#include "shader_cache.h"
+#include "pipeline_batch.h"
+#include "spec_variant.h"
+#include "volk/volk.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * How much specializing the OOB layer, coordinate offset and workgroup size of the
+ * ld_typed_2darray_oob kernel gains over reading the first two from push constants. Both kernels
+ * come from the same module (FromPushConstants picks the path), so the only difference is
+ * whether the driver could fold the values. Each variant is dispatched over a 1024x1024 output
+ * several times and the GPU time between timestamps is compared. The rows every variant loads in
+ * bounds are read back after each, so a variant that is fast because it is wrong fails the test.
+ */
+
+static void
+#ifdef __GNUC__
+__attribute__((noreturn))
+#endif
+VerifyVkResultFaild(VkResult r, const char *expr, int line)
+{
+   fprintf(stderr, "%s:%d (%s) returned non-VK_SUCCESS: %d\n", __FILE__, line, expr, r);
+   exit(r);
+}
+#define VERIFY_VK(e) do { if (VkResult _r = e) VerifyVkResultFaild(_r, #e, __LINE__); } while(0)
+
+static const uint32_t CsSpecSpirvWords[] =
+#include "ld_typed_2darray_spec.comp.h"
+;
+
+// see ld_typed_2darray_spec.comp:
+enum : uint32_t {
+    SpecIdOobLayer = 0,
+    SpecIdCoordOffsetX = 1,
+    SpecIdLocalSizeX = 2,
+    SpecIdLocalSizeY = 3,
+    SpecIdFromPushConstants = 4
+};
+
+struct BenchPipelineArgs {
+    VkDevice device;
+    VkShaderModule shaderModule;
+    VkPipelineLayout layout;
+    SpecVariant spec;
+    VkPipeline pso; // OUT
+};
+
+static void
+BuildBenchPipelineJob(void *pArgs)
+{
+    BenchPipelineArgs *const a = static_cast<BenchPipelineArgs *>(pArgs);
+    VkSpecializationInfo const specInfo = SpecVariantInfo(a->spec);
+    VkComputePipelineCreateInfo pipelineInfo = {
+        VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        nullptr, // pNext
+        0, // VkPipelineCreateFlags
+        {
+            VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            nullptr,
+            0, // VkPipelineShaderStageCreateFlags
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            a->shaderModule,
+            "main",
+            &specInfo },
+        a->layout,
+        VK_NULL_HANDLE, // basePipelineHandle
+        -1 // basePipelineIndex
+    };
+    VERIFY_VK(ShaderCacheCreateComputePipeline(pipelineInfo, &a->pso));
+}
+
+bool TestSpecConstantBench(const VulkanObjetcs& vk)
+{
+    VkDevice const device = vk.device;
+    VkQueue const queue = vk.universalQueue;
+    const VkPhysicalDeviceMemoryProperties& memProps = vk.memProps;
+
+    {
+        uint32_t numFamilies = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(vk.physicalDevice, &numFamilies, nullptr);
+        VkQueueFamilyProperties families[16];
+        numFamilies = numFamilies < 16 ? numFamilies : 16;
+        vkGetPhysicalDeviceQueueFamilyProperties(vk.physicalDevice, &numFamilies, families);
+        if (vk.universalFamilyIndex >= numFamilies || families[vk.universalFamilyIndex].timestampValidBits == 0) {
+            puts("ERROR: the queue does not support timestamps.");
+            return false;
+        }
+    }
+    double const nsPerTick = vk.props2.properties.limits.timestampPeriod;
+
+    static constexpr uint32_t ImageWidth = 1024, ImageHeight = 1024, InputLayers = 8;
+    static constexpr uint32_t DispatchesPerSample = 16;
+    // Rows below this load a layer in bounds whatever the OOB layer is, see ld_typed_2darray_spec.comp:
+    static constexpr uint32_t CheckedRows = 7;
+    static constexpr uint32_t CheckedBytes = ImageWidth * CheckedRows * sizeof(uint32_t);
+    static constexpr uint32_t ClearValue = 0xff00ff00u;
+
+    static const uint32_t OobValues[] = { uint32_t(-1), 0 };
+    static const uint32_t OffsetValues[] = { 0, 1 };
+    static const uint32_t WorkgroupValues[] = { 8, 8,  16, 16,  32, 4 };
+    static const SpecAxis Axes[] = {
+        { "oob", 1, { SpecIdOobLayer }, lengthof(OobValues), OobValues },
+        { "offset", 1, { SpecIdCoordOffsetX }, lengthof(OffsetValues), OffsetValues },
+        { "wg", 2, { SpecIdLocalSizeX, SpecIdLocalSizeY }, lengthof(WorkgroupValues) / 2, WorkgroupValues },
+    };
+    static constexpr uint32_t NumVariants = lengthof(OobValues) * lengthof(OffsetValues) * (lengthof(WorkgroupValues) / 2);
+    static_assert(NumVariants * 2 <= PipelineBatchMaxJobs, "one batch builds every pipeline");
+
+    VkDescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout psoLayout = VK_NULL_HANDLE;
+    {
+        const VkDescriptorSetLayoutBinding bindings[2] = {
+            { 0, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        };
+        const VkDescriptorSetLayoutCreateInfo setInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0,
+            2, bindings
+        };
+        VERIFY_VK(vkCreateDescriptorSetLayout(device, &setInfo, ALLOC_CBS, &descSetLayout));
+
+        const VkPushConstantRange pcRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, 16 };
+        const VkPipelineLayoutCreateInfo layoutInfo = {
+            VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, nullptr, 0,
+            1, &descSetLayout,
+            1, &pcRange
+        };
+        VERIFY_VK(vkCreatePipelineLayout(device, &layoutInfo, ALLOC_CBS, &psoLayout));
+    }
+
+    // [variant * 2 + bPush], the push constant kernel keeps the variant's workgroup size:
+    BenchPipelineArgs psoArgs[NumVariants * 2];
+    {
+        VkShaderModule shaderModule;
+        VERIFY_VK(ShaderCacheAcquire(CsSpecSpirvWords, &shaderModule));
+        PipelineBatch batch;
+        PipelineBatchInit(&batch, "ld_typed_spec_bench");
+        for (uint32_t i = 0; i < NumVariants * 2; ++i) {
+            BenchPipelineArgs& a = psoArgs[i];
+            a = { };
+            a.device = device;
+            a.shaderModule = shaderModule;
+            a.layout = psoLayout;
+            SpecVariantGet(Axes, lengthof(Axes), i / 2, &a.spec);
+            SpecVariantSet(&a.spec, SpecIdFromPushConstants, i & 1);
+            PipelineBatchAdd(&batch, (i & 1) ? "push" : a.spec.name, BuildBenchPipelineJob, &a);
+        }
+        PipelineBatchBuild(&batch);
+        ShaderCacheRelease(shaderModule);
+    }
+
+    VkuImageAndMemory images[2]; // [0] input array, [1] output
+    VkImageView views[2];
+    {
+        VkImageCreateInfo imageInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = VK_FORMAT_R32_UINT;
+        imageInfo.extent = { ImageWidth, ImageHeight, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        for (int i = 0; i < 2; ++i) {
+            imageInfo.arrayLayers = i ? 1 : InputLayers;
+            imageInfo.usage = i ? (VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT) :
+                                  (VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+            VERIFY_VK(vkuDedicatedImage(device, imageInfo, &images[i], memProps));
+
+            const VkImageViewCreateInfo viewInfo = {
+                VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, nullptr, 0,
+                images[i].image,
+                i ? VK_IMAGE_VIEW_TYPE_2D : VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+                VK_FORMAT_R32_UINT,
+                { }, // VkComponentMapping all zeroes is identity
+                { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, imageInfo.arrayLayers }
+            };
+            VERIFY_VK(vkCreateImageView(device, &viewInfo, ALLOC_CBS, &views[i]));
+        }
+    }
+
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descSet = VK_NULL_HANDLE;
+    {
+        static const VkDescriptorPoolSize poolSizes[] = {
+           { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1 },
+           { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+        };
+        const VkDescriptorPoolCreateInfo descPoolInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr, 0,
+            1, // maxSets
+            2, poolSizes
+        };
+        VERIFY_VK(vkCreateDescriptorPool(device, &descPoolInfo, ALLOC_CBS, &descriptorPool));
+        const VkDescriptorSetAllocateInfo descAllocInfo = {
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
+            descriptorPool, 1, &descSetLayout
+        };
+        VERIFY_VK(vkAllocateDescriptorSets(device, &descAllocInfo, &descSet));
+
+        const VkDescriptorImageInfo inputInfo = { VkSampler(), views[0], VK_IMAGE_LAYOUT_GENERAL };
+        const VkDescriptorImageInfo outputInfo = { VkSampler(), views[1], VK_IMAGE_LAYOUT_GENERAL };
+        const VkWriteDescriptorSet writes[2] = {
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, descSet, 0, 0, 1, // binding, arrayIndex, count
+              VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, &inputInfo, nullptr, nullptr },
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, descSet, 1, 0, 1, // binding, arrayIndex, count
+              VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &outputInfo, nullptr, nullptr },
+        };
+        vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+    }
+
+    VkuStagingBuffer stage; // CheckedRows of the output per pipeline
+    VERIFY_VK(vkuStagingBuffer(device, NumVariants * 2 * CheckedBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT, &stage, memProps));
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    {
+        VkQueryPoolCreateInfo info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        info.queryCount = NumVariants * 2 * 2; // begin, end per pipeline
+        VERIFY_VK(vkCreateQueryPool(device, &info, ALLOC_CBS, &queryPool));
+    }
+
+    VkCommandPool cmdpool = VK_NULL_HANDLE;
+    VkCommandBuffer cmdbuf = VK_NULL_HANDLE;
+    {
+        const VkCommandPoolCreateInfo cmdPoolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr,
+            0, // flags
+            vk.universalFamilyIndex
+        };
+        VERIFY_VK(vkCreateCommandPool(device, &cmdPoolInfo, ALLOC_CBS, &cmdpool));
+
+        const VkCommandBufferAllocateInfo cmdBufAllocInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr, cmdpool,
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            1 // commandBufferCount
+        };
+        VERIFY_VK(vkAllocateCommandBuffers(device, &cmdBufAllocInfo, &cmdbuf));
+    }
+
+    // record commands:
+    {
+        const VkCommandBufferBeginInfo cmdBufbeginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr
+        };
+        VERIFY_VK(vkBeginCommandBuffer(cmdbuf, &cmdBufbeginInfo));
+        vkCmdResetQueryPool(cmdbuf, queryPool, 0, NumVariants * 2 * 2);
+
+        VkImageMemoryBarrier ib[2] = { };
+        for (int i = 0; i < 2; ++i) {
+            ib[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            ib[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            ib[i].image = images[i].image;
+            ib[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            ib[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            ib[i].dstAccessMask = i ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_TRANSFER_WRITE_BIT;
+            ib[i].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, -1u, 0, -1u };
+        }
+        vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0x0,
+                             0, nullptr, 0, nullptr, 2, ib);
+        {
+            VkClearColorValue clearVal; for (uint32_t &r : clearVal.uint32) r = ClearValue;
+            const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, InputLayers };
+            vkCmdClearColorImage(cmdbuf, images[0].image, VK_IMAGE_LAYOUT_GENERAL, &clearVal, 1, &range);
+        }
+        VkMemoryBarrier memBarrier = {
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_SHADER_READ_BIT,
+        };
+        vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0x0,
+                             1, &memBarrier, 0, nullptr, 0 , nullptr);
+
+        vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, psoLayout, 0, 1, &descSet, 0, nullptr);
+        // Serialize the dispatches so each sample is their summed execution time, not how well they overlap:
+        memBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        memBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        VkMemoryBarrier copyBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        VkBufferImageCopy checkedCopy = { };
+        checkedCopy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 }; // mip, layer{begin, count}
+        checkedCopy.imageExtent = { ImageWidth, CheckedRows, 1 };
+        for (uint32_t i = 0; i < NumVariants * 2; ++i) {
+            const SpecVariant& spec = psoArgs[i].spec;
+            uint32_t const wgX = SpecVariantValue(spec, SpecIdLocalSizeX, 8);
+            uint32_t const wgY = SpecVariantValue(spec, SpecIdLocalSizeY, 8);
+            const uint32_t pcData[4] = {
+                SpecVariantValue(spec, SpecIdOobLayer, uint32_t(-1)),
+                SpecVariantValue(spec, SpecIdCoordOffsetX, 1),
+                0, 0
+            };
+            vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, psoArgs[i].pso);
+            vkCmdPushConstants(cmdbuf, psoLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, 16, pcData);
+            if (i != 0) {
+                // The previous pipeline's copy is done before the sample starts, so it isn't timed:
+                copyBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                copyBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0x0,
+                                     1, &copyBarrier, 0, nullptr, 0 , nullptr);
+            }
+            vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, i * 2);
+            for (uint32_t d = 0; d < DispatchesPerSample; ++d) {
+                vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0x0,
+                                     1, &memBarrier, 0, nullptr, 0 , nullptr);
+                vkCmdDispatch(cmdbuf, ImageWidth / wgX, ImageHeight / wgY, 1);
+            }
+            vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, i * 2 + 1);
+
+            copyBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            copyBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0x0,
+                                 1, &copyBarrier, 0, nullptr, 0 , nullptr);
+            checkedCopy.bufferOffset = i * CheckedBytes;
+            vkCmdCopyImageToBuffer(cmdbuf, images[1].image, VK_IMAGE_LAYOUT_GENERAL, stage.buffer, 1, &checkedCopy);
+        }
+        copyBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        copyBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0x0,
+                             1, &copyBarrier, 0, nullptr, 0 , nullptr);
+        VERIFY_VK(vkEndCommandBuffer(cmdbuf));
+    }
+
+    // submit and WFI:
+    {
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmdbuf;
+        VERIFY_VK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+        VERIFY_VK(vkQueueWaitIdle(queue));
+    }
+
+    vkuInvalidateStagingBuffer(device, stage);
+
+    // Every pixel that loads in bounds reads the clear value, only the last columns may read past the width:
+    bool bOutputOk = true;
+    for (uint32_t i = 0; i < NumVariants * 2; ++i) {
+        const uint32_t *const pRows = reinterpret_cast<const uint32_t *>(static_cast<const uint8_t *>(stage.pHost) + i * CheckedBytes);
+        uint32_t const inBoundsWidth = ImageWidth - SpecVariantValue(psoArgs[i].spec, SpecIdCoordOffsetX, 1);
+        uint32_t numMismatches = 0;
+        for (uint32_t y = 0; y < CheckedRows; ++y) {
+            for (uint32_t x = 0; x < inBoundsWidth; ++x) {
+                numMismatches += pRows[y * ImageWidth + x] != ClearValue;
+            }
+        }
+        if (numMismatches) {
+            printf("ERROR: %s (%s): %u of the in-bounds pixels don't hold the input.\n",
+                   psoArgs[i].spec.name, (i & 1) ? "push" : "spec", numMismatches);
+            bOutputOk = false;
+        }
+    }
+
+    uint64_t ticks[NumVariants * 2 * 2];
+    VERIFY_VK(vkGetQueryPoolResults(device, queryPool, 0, NumVariants * 2 * 2, sizeof ticks, ticks, sizeof(uint64_t),
+                                    VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    printf("%ux%u output, %u dispatches per sample, us per dispatch:\n", ImageWidth, ImageHeight, DispatchesPerSample);
+    printf("  %-32s %10s %10s %8s\n", "variant", "spec", "push", "speedup");
+    for (uint32_t v = 0; v < NumVariants; ++v) {
+        double us[2];
+        for (int bPush = 0; bPush < 2; ++bPush) {
+            uint32_t const q = (v * 2 + bPush) * 2;
+            us[bPush] = double(ticks[q + 1] - ticks[q]) * nsPerTick / 1e3 / DispatchesPerSample;
+        }
+        printf("  %-32s %10.2f %10.2f %7.2fx\n", psoArgs[v * 2].spec.name, us[0], us[1], us[0] > 0.0 ? us[1] / us[0] : 0.0);
+    }
+
+    vkDestroyCommandPool(device, cmdpool, ALLOC_CBS);
+    vkDestroyQueryPool(device, queryPool, ALLOC_CBS);
+    vkuDestroyStagingBuffer(device, stage);
+    vkDestroyDescriptorPool(device, descriptorPool, ALLOC_CBS);
+    for (int i = 0; i < 2; ++i) {
+        vkDestroyImageView(device, views[i], ALLOC_CBS);
+        vkuDestroyImageAndFreeMemory(device, images[i]);
+    }
+    for (uint32_t i = 0; i < NumVariants * 2; ++i) {
+        vkDestroyPipeline(device, psoArgs[i].pso, ALLOC_CBS);
+    }
+    vkDestroyPipelineLayout(device, psoLayout, ALLOC_CBS);
+    vkDestroyDescriptorSetLayout(device, descSetLayout, ALLOC_CBS);
+
+    return bOutputOk;
+}
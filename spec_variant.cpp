@@ -0,0 +1,66 @@
+#include "spec_variant.h"
+
+#include <stdio.h>
+#include <string.h>
+
+uint32_t
+SpecVariantCount(const SpecAxis *pAxes, uint32_t numAxes)
+{
+    uint32_t n = 1;
+    for (uint32_t i = 0; i < numAxes; ++i) n *= pAxes[i].numValues;
+    return n;
+}
+
+bool
+SpecVariantSet(SpecVariant *v, uint32_t constantId, uint32_t value)
+{
+    for (uint32_t i = 0; i < v->numConstants; ++i) {
+        if (v->entries[i].constantID == constantId) {
+            v->data[i] = value;
+            return true;
+        }
+    }
+    if (v->numConstants == SpecVariantMaxConstants) return false;
+    uint32_t const i = v->numConstants++;
+    v->entries[i].constantID = constantId;
+    v->entries[i].offset = i * sizeof(uint32_t);
+    v->entries[i].size = sizeof(uint32_t);
+    v->data[i] = value;
+    return true;
+}
+
+bool
+SpecVariantGet(const SpecAxis *pAxes, uint32_t numAxes, uint32_t index, SpecVariant *pOut)
+{
+    *pOut = { };
+    size_t len = 0;
+
+    // Mixed radix, last axis fastest:
+    uint32_t stride = SpecVariantCount(pAxes, numAxes);
+    for (uint32_t a = 0; a < numAxes; ++a) {
+        SpecAxis const& axis = pAxes[a];
+        stride /= axis.numValues;
+        uint32_t const valueIndex = (index / stride) % axis.numValues;
+        const uint32_t *const pTuple = axis.pValues + valueIndex * axis.numIds;
+
+        if (len < sizeof pOut->name) {
+            len += snprintf(pOut->name + len, sizeof pOut->name - len, "%s%s=", a ? " " : "", axis.name);
+        }
+        for (uint32_t k = 0; k < axis.numIds; ++k) {
+            if (!SpecVariantSet(pOut, axis.constantIds[k], pTuple[k])) return false;
+            if (len < sizeof pOut->name) {
+                len += snprintf(pOut->name + len, sizeof pOut->name - len, "%s%d", k ? "x" : "", int32_t(pTuple[k]));
+            }
+        }
+    }
+    return true;
+}
+
+uint32_t
+SpecVariantValue(const SpecVariant& v, uint32_t constantId, uint32_t defaultValue)
+{
+    for (uint32_t i = 0; i < v.numConstants; ++i) {
+        if (v.entries[i].constantID == constantId) return v.data[i];
+    }
+    return defaultValue;
+}
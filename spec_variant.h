@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+
+/*
+ * Specialization constant variants of one shader. A test declares axes, each setting one or
+ * more 32-bit constants together (a workgroup size sets two) to one of a list of values, and
+ * gets one variant per point of their cartesian product, to build a pipeline per variant with.
+ * The driver then sees the values as constants and can fold them into the kernel, which a push
+ * constant or uniform never allows. Bool constants are VkBool32, so 32-bit as well.
+ */
+
+enum { SpecAxisMaxIds = 3, SpecVariantMaxConstants = 8 };
+
+struct SpecAxis {
+    const char *name;         // for variant names, e.g. "wg"
+    uint32_t numIds;          // constants this axis sets, at most SpecAxisMaxIds
+    uint32_t constantIds[SpecAxisMaxIds];
+    uint32_t numValues;
+    const uint32_t *pValues;  // numValues tuples of numIds values
+};
+
+struct SpecVariant {
+    uint32_t numConstants;
+    uint32_t data[SpecVariantMaxConstants];
+    VkSpecializationMapEntry entries[SpecVariantMaxConstants];
+    char name[96];            // e.g. "oob=-1 offset=1 wg=8x8"
+};
+
+uint32_t
+SpecVariantCount(const SpecAxis *pAxes, uint32_t numAxes);
+
+// index in [0, SpecVariantCount), the first axis varies slowest. Returns false if the axes set too many constants.
+bool
+SpecVariantGet(const SpecAxis *pAxes, uint32_t numAxes, uint32_t index, SpecVariant *pOut);
+
+// Sets one more constant, or overrides one an axis set, without changing the name.
+bool
+SpecVariantSet(SpecVariant *v, uint32_t constantId, uint32_t value);
+
+// Value an axis gave constantId, or defaultValue.
+uint32_t
+SpecVariantValue(const SpecVariant& v, uint32_t constantId, uint32_t defaultValue);
+
+// Points into v, which must outlive pipeline creation.
+inline VkSpecializationInfo
+SpecVariantInfo(const SpecVariant& v)
+{
+    VkSpecializationInfo info;
+    info.mapEntryCount = v.numConstants;
+    info.pMapEntries = v.entries;
+    info.dataSize = v.numConstants * sizeof(uint32_t);
+    info.pData = v.data;
+    return info;
+}
@@ -0,0 +1,160 @@
+#include "spirv_patch.h"
+
+#include <string.h>
+#include <assert.h>
+
+/*
+ * Where an instruction's result id is: 0 if it has none, 1 for instructions without a result type
+ * (types, OpLabel, ...), otherwise 2. Opcodes not listed are assumed to have both a result type and
+ * a result id, which holds for everything that computes a value.
+ */
+static unsigned
+ResultIdWord(uint16_t op)
+{
+    switch (op) {
+    case 0:    // OpNop
+    case 2:    // OpSourceContinued
+    case 3:    // OpSource
+    case 4:    // OpSourceExtension
+    case 5:    // OpName
+    case 6:    // OpMemberName
+    case 8:    // OpLine
+    case 10:   // OpExtension
+    case 14:   // OpMemoryModel
+    case 15:   // OpEntryPoint
+    case 16:   // OpExecutionMode
+    case 17:   // OpCapability
+    case 39:   // OpTypeForwardPointer
+    case 56:   // OpFunctionEnd
+    case 62:   // OpStore
+    case 63:   // OpCopyMemory
+    case 64:   // OpCopyMemorySized
+    case 71:   // OpDecorate
+    case 72:   // OpMemberDecorate
+    case 74:   // OpGroupDecorate
+    case 75:   // OpGroupMemberDecorate
+    case 99:   // OpImageWrite
+    case 218:  // OpEmitVertex
+    case 219:  // OpEndPrimitive
+    case 220:  // OpEmitStreamVertex
+    case 221:  // OpEndStreamPrimitive
+    case 224:  // OpControlBarrier
+    case 225:  // OpMemoryBarrier
+    case 228:  // OpAtomicStore
+    case 246:  // OpLoopMerge
+    case 247:  // OpSelectionMerge
+    case 249:  // OpBranch
+    case 250:  // OpBranchConditional
+    case 251:  // OpSwitch
+    case 252:  // OpKill
+    case 253:  // OpReturn
+    case 254:  // OpReturnValue
+    case 255:  // OpUnreachable
+    case 256:  // OpLifetimeStart
+    case 257:  // OpLifetimeStop
+    case 317:  // OpNoLine
+    case 331:  // OpExecutionModeId
+    case 332:  // OpDecorateId
+    case 4416: // OpTerminateInvocation
+    case 5632: // OpDecorateString
+    case 5633: // OpMemberDecorateString
+        return 0;
+    case 7:    // OpString
+    case 11:   // OpExtInstImport
+    case 73:   // OpDecorationGroup
+    case 248:  // OpLabel
+        return 1;
+    default:
+        return (op >= 19 && op <= 38) ? 1 : 2; // OpTypeVoid..OpTypeQueue, OpTypePipe
+    }
+}
+
+bool
+SpirvInit(SpirvModule *m, uint32_t *pBuf, uint32_t capacityWords, const uint32_t *pSrc, size_t srcBytes)
+{
+    *m = { };
+    if (srcBytes % sizeof(uint32_t) != 0) return false;
+    uint32_t const n = uint32_t(srcBytes / sizeof(uint32_t));
+    if (n < SpirvHeaderWords || n > capacityWords || pSrc[0] != SpirvMagic) return false;
+
+    for (uint32_t at = SpirvHeaderWords; at < n;) {
+        uint32_t const wordCount = pSrc[at] >> 16;
+        if (wordCount == 0 || wordCount > n - at) return false;
+        at += wordCount;
+    }
+
+    memcpy(pBuf, pSrc, srcBytes);
+    m->pWords = pBuf;
+    m->numWords = n;
+    m->capacity = capacityWords;
+    return true;
+}
+
+uint32_t
+SpirvFindOp(const SpirvModule& m, uint16_t opcode, uint32_t from)
+{
+    for (uint32_t at = from; at < m.numWords; at += SpirvWordCount(m, at)) {
+        if (SpirvOpcode(m, at) == opcode) return at;
+    }
+    return 0;
+}
+
+uint32_t
+SpirvFindResult(const SpirvModule& m, uint32_t id)
+{
+    for (uint32_t at = SpirvHeaderWords; at < m.numWords; at += SpirvWordCount(m, at)) {
+        unsigned const w = ResultIdWord(SpirvOpcode(m, at));
+        if (w && w < SpirvWordCount(m, at) && m.pWords[at + w] == id) return at;
+    }
+    return 0;
+}
+
+uint32_t
+SpirvFindDecoration(const SpirvModule& m, uint32_t targetId, uint32_t decoration)
+{
+    for (uint32_t at = SpirvFindOp(m, SpirvOpDecorate); at; at = SpirvFindOp(m, SpirvOpDecorate, at + SpirvWordCount(m, at))) {
+        if (m.pWords[at + 1] == targetId && m.pWords[at + 2] == decoration) return at;
+    }
+    return 0;
+}
+
+uint32_t
+SpirvFindBuiltInDecoration(const SpirvModule& m, uint32_t builtIn)
+{
+    for (uint32_t at = SpirvFindOp(m, SpirvOpDecorate); at; at = SpirvFindOp(m, SpirvOpDecorate, at + SpirvWordCount(m, at))) {
+        if (SpirvWordCount(m, at) >= 4 && m.pWords[at + 2] == SpirvDecorationBuiltIn && m.pWords[at + 3] == builtIn) return at;
+    }
+    return 0;
+}
+
+void
+SpirvSetOpcode(SpirvModule *m, uint32_t at, uint16_t opcode)
+{
+    m->pWords[at] = (m->pWords[at] & 0xFFFF0000u) | opcode;
+}
+
+bool
+SpirvSplice(SpirvModule *m, uint32_t at, uint32_t numRemove, const uint32_t *pInsert, uint32_t numInsert)
+{
+    assert(at >= SpirvHeaderWords && at + numRemove <= m->numWords);
+    if (m->numWords - numRemove + numInsert > m->capacity) return false;
+    memmove(m->pWords + at + numInsert, m->pWords + at + numRemove, (m->numWords - at - numRemove) * sizeof(uint32_t));
+    if (numInsert) memcpy(m->pWords + at, pInsert, numInsert * sizeof(uint32_t));
+    m->numWords = m->numWords - numRemove + numInsert;
+    return true;
+}
+
+bool
+SpirvTruncate(SpirvModule *m, uint32_t at, uint32_t keepWords)
+{
+    uint32_t const wordCount = SpirvWordCount(*m, at);
+    if (keepWords == 0 || keepWords > wordCount) return false;
+    m->pWords[at] = (keepWords << 16) | SpirvOpcode(*m, at);
+    return SpirvSplice(m, at + keepWords, wordCount - keepWords, nullptr, 0);
+}
+
+uint32_t
+SpirvNewId(SpirvModule *m)
+{
+    return m->pWords[3]++;
+}
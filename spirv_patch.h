@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Minimal SPIR-V walker and in-place editor, for making shader variants at load time without a
+ * toolchain, instead of poking hard-coded word offsets that break whenever the shader is rebuilt.
+ *
+ * Works on a word buffer the caller provides (usually a stack array with some room to spare) and
+ * never allocates. Instructions are addressed by their word offset in the module; 0 means
+ * "not found" since the header occupies words [0, 5). Splicing shifts everything after the
+ * edited instruction, so offsets found before an edit that grows or shrinks the module are stale.
+ */
+
+enum { SpirvHeaderWords = 5, SpirvMagic = 0x07230203 };
+
+// Only the opcodes and enums the tests patch, numbered as in the SPIR-V spec:
+enum : uint16_t {
+    SpirvOpTypeInt          = 21,
+    SpirvOpTypeImage        = 25,
+    SpirvOpTypeArray        = 28,
+    SpirvOpTypePointer      = 32,
+    SpirvOpConstant         = 43,
+    SpirvOpVariable         = 59,
+    SpirvOpLoad             = 61,
+    SpirvOpAccessChain      = 65,
+    SpirvOpDecorate         = 71,
+    SpirvOpImageFetch       = 95,
+    SpirvOpImageRead        = 98,
+};
+
+enum : uint32_t {
+    SpirvDecorationBuiltIn  = 11,
+    SpirvDecorationLocation = 30,
+    SpirvDecorationBinding  = 33,
+
+    SpirvStorageClassUniformConstant = 0,
+    SpirvStorageClassPushConstant    = 9,
+
+    SpirvBuiltInPosition    = 0,
+    SpirvBuiltInClipDistance = 3,
+
+    SpirvImageFormatR32ui   = 33,
+};
+
+// Word offsets within an OpTypeImage:
+enum { SpirvTypeImageSampled = 7, SpirvTypeImageFormat = 8 };
+
+struct SpirvModule {
+    uint32_t *pWords;
+    uint32_t numWords;
+    uint32_t capacity; // words available at pWords
+};
+
+// Copies the module into pBuf and checks that its instructions are well formed.
+bool
+SpirvInit(SpirvModule *m, uint32_t *pBuf, uint32_t capacityWords, const uint32_t *pSrc, size_t srcBytes);
+
+inline uint16_t
+SpirvOpcode(const SpirvModule& m, uint32_t at)
+{
+    return uint16_t(m.pWords[at] & 0xFFFF);
+}
+
+inline uint32_t
+SpirvWordCount(const SpirvModule& m, uint32_t at)
+{
+    return m.pWords[at] >> 16;
+}
+
+// First instruction with this opcode at or after 'from', 0 if none.
+uint32_t
+SpirvFindOp(const SpirvModule& m, uint16_t opcode, uint32_t from = SpirvHeaderWords);
+
+// The instruction defining id, 0 if none.
+uint32_t
+SpirvFindResult(const SpirvModule& m, uint32_t id);
+
+// OpDecorate of targetId with this decoration, 0 if none.
+uint32_t
+SpirvFindDecoration(const SpirvModule& m, uint32_t targetId, uint32_t decoration);
+
+// OpDecorate <id> BuiltIn <builtIn>, 0 if none.
+uint32_t
+SpirvFindBuiltInDecoration(const SpirvModule& m, uint32_t builtIn);
+
+// Changes the opcode of the instruction at 'at', keeping its operands.
+void
+SpirvSetOpcode(SpirvModule *m, uint32_t at, uint16_t opcode);
+
+/*
+ * Replaces numRemove words at 'at' with numInsert new words, shifting the rest of the module.
+ * With at pointing at an instruction and numRemove = its word count this replaces the
+ * instruction, with numRemove = 0 it inserts. Returns false if the buffer is too small.
+ */
+bool
+SpirvSplice(SpirvModule *m, uint32_t at, uint32_t numRemove, const uint32_t *pInsert, uint32_t numInsert);
+
+// Drops the trailing operands of the instruction at 'at' so it is keepWords long, e.g. optional image operands.
+bool
+SpirvTruncate(SpirvModule *m, uint32_t at, uint32_t keepWords);
+
+// Allocates a fresh id by bumping the header's bound.
+uint32_t
+SpirvNewId(SpirvModule *m);
+
+inline size_t
+SpirvByteSize(const SpirvModule& m)
+{
+    return size_t(m.numWords) * sizeof(uint32_t);
+}
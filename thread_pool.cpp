@@ -0,0 +1,99 @@
+#include "thread_pool.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+struct ThreadPoolJob {
+    PFN_ThreadPoolJob pfn;
+    void *pArg;
+};
+
+struct ThreadPool {
+    std::mutex mutex;
+    std::condition_variable jobAvailable; // workers wait on this
+    std::condition_variable slotAvailable; // ThreadPoolSubmit waits on this when the queue is full
+
+    ThreadPoolJob *ring;
+    unsigned capacity;
+    unsigned head; // next job to take
+    unsigned count;
+    bool bQuit;
+
+    std::thread *threads;
+    unsigned numThreads;
+};
+
+static void
+WorkerMain(ThreadPool *pool)
+{
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    for (;;) {
+        while (pool->count == 0 && !pool->bQuit) {
+            pool->jobAvailable.wait(lock);
+        }
+        if (pool->count == 0) {
+            return; // bQuit and drained
+        }
+        ThreadPoolJob const job = pool->ring[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+        pool->slotAvailable.notify_one();
+
+        lock.unlock();
+        job.pfn(job.pArg);
+        lock.lock();
+    }
+}
+
+unsigned
+ThreadPoolDefaultThreadCount()
+{
+    unsigned const n = std::thread::hardware_concurrency(); // 0 if unknown
+    return n > 1 ? n - 1 : 1;
+}
+
+ThreadPool *
+ThreadPoolCreate(unsigned numThreads, unsigned maxQueuedJobs)
+{
+    ThreadPool *const pool = new ThreadPool();
+    pool->capacity = maxQueuedJobs ? maxQueuedJobs : 1;
+    pool->ring = new ThreadPoolJob[pool->capacity];
+    pool->head = pool->count = 0;
+    pool->bQuit = false;
+    pool->numThreads = numThreads ? numThreads : ThreadPoolDefaultThreadCount();
+    pool->threads = new std::thread[pool->numThreads];
+    for (unsigned i = 0; i < pool->numThreads; ++i) {
+        pool->threads[i] = std::thread(WorkerMain, pool);
+    }
+    return pool;
+}
+
+void
+ThreadPoolDestroy(ThreadPool *pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->bQuit = true;
+    }
+    pool->jobAvailable.notify_all();
+    for (unsigned i = 0; i < pool->numThreads; ++i) {
+        pool->threads[i].join();
+    }
+    delete[] pool->threads;
+    delete[] pool->ring;
+    delete pool;
+}
+
+void
+ThreadPoolSubmit(ThreadPool *pool, PFN_ThreadPoolJob pfnJob, void *pArg)
+{
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    while (pool->count == pool->capacity) {
+        pool->slotAvailable.wait(lock);
+    }
+    pool->ring[(pool->head + pool->count) % pool->capacity] = { pfnJob, pArg };
+    pool->count++;
+    lock.unlock();
+    pool->jobAvailable.notify_one();
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+/*
+ * Fixed set of worker threads pulling jobs from a bounded FIFO.
+ * Submitting to a full queue blocks until a worker takes a job, so producers that
+ * outrun the workers get back-pressure instead of unbounded memory growth.
+ */
+
+typedef void (*PFN_ThreadPoolJob)(void *pArg);
+
+struct ThreadPool;
+
+// numThreads = 0 means ThreadPoolDefaultThreadCount().
+ThreadPool *
+ThreadPoolCreate(unsigned numThreads, unsigned maxQueuedJobs);
+
+// Waits for all submitted jobs, then joins the workers.
+void
+ThreadPoolDestroy(ThreadPool *pool);
+
+void
+ThreadPoolSubmit(ThreadPool *pool, PFN_ThreadPoolJob pfnJob, void *pArg);
+
+// One less than the number of hardware threads (the submitting thread keeps one), at least 1.
+unsigned
+ThreadPoolDefaultThreadCount();
@@ -1,17 +1,38 @@
+#include "vk_simple_init.h"
 #include "vk_util.h"
+#include "image_compare.h"
+#include "ref_store.h"
+#include "golden_hash.h"
+#include "result_archive.h"
+#include "spirv_patch.h"
+#include "shader_cache.h"
+#include "pipeline_batch.h"
+#include "spec_variant.h"
+#include "descriptor_binder.h"
 #include "volk/volk.h"
 
-#include "stb/stb_image_write.h"
+#include "artifact_writer.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 extern bool g_bSaveFailingImages;
+extern bool g_bHostImportStaging;
 
-struct uvec2 { uint32_t x, y; };
 struct uvec3 { uint32_t x, y, z; };
 
+// Coordinate the shader loads from for invocation (x, y):
+static uvec3
+ShaderLoadCoord(uint32_t x, uint32_t y)
+{
+    uvec3 c;
+    c.x = x + 1; // rightmost goes OOB
+    c.y = y;
+    c.z = y < 7u ? y : uint32_t(-1);
+    return c;
+}
+
 static void
 #ifdef __GNUC__
 __attribute__((noreturn))
@@ -23,27 +44,11 @@ VerifyVkResultFaild(VkResult r, const char *expr, int line)
 }
 #define VERIFY_VK(e) do { if (VkResult _r = e) VerifyVkResultFaild(_r, #e, __LINE__); } while(0)
 
-static VkShaderModule
-CreateShaderModule(VkDevice device, uint32_t nBytes, const void *spirv)
-{
-    VkShaderModule module = nullptr;
-    VkShaderModuleCreateInfo info = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-    info.codeSize = nBytes;
-    info.pCode = static_cast<const uint32_t *>(spirv);
-    VERIFY_VK(vkCreateShaderModule(device, &info, VKU_ALLOC_CBS, &module));
-    return module;
-}
-
-template<uint32_t N> static VkShaderModule
-CreateShaderModule(VkDevice device, const uint32_t (&a)[N])
-{
-    return CreateShaderModule(device, N * sizeof (uint32_t), a);
-}
-
 
 static VkResult
 CreateComputePipeline(VkDevice device,
                       VkShaderModule shaderModule,
+                      const VkSpecializationInfo *pSpecInfo,
                       VkPipelineLayout layout,
                       VkPipeline *pPipeline)  // OUT
 {
@@ -60,16 +65,12 @@ CreateComputePipeline(VkDevice device,
             VK_SHADER_STAGE_COMPUTE_BIT,
             shaderModule,
             "main",
-            nullptr }, // pSpecializationInfo
+            pSpecInfo },
         layout,
         VK_NULL_HANDLE, // basePipelineHandle
         -1, // basePipelineIndex
     };
-    VERIFY_VK((r = vkCreateComputePipelines(device,
-                                            VK_NULL_HANDLE, // VkPipelineCache
-                                            1, &pipelineInfo,
-                                            VKU_ALLOC_CBS,
-                                            pPipeline)));
+    VERIFY_VK((r = ShaderCacheCreateComputePipeline(pipelineInfo, pPipeline)));
     return r;
 }
 
@@ -79,47 +80,74 @@ static const uint32_t CsSpirvWords[] =
 #include "ld_srv_typed_2darray.comp.h"
 ;
 
+// Same loads, OOB layer and x offset as specialization constants:
+static const uint32_t CsSpecSpirvWords[] =
+#include "ld_typed_2darray_spec.comp.h"
+;
+
+enum : uint32_t { SpecIdOobLayer = 0, SpecIdCoordOffsetX = 1 };
+
+struct ComputePipelineObjects {
+    VkDevice device;
+    VkShaderModule shaderModule;
+    SpecVariant spec;
+    bool bSpec;
+    DescriptorBinder binder; // [0] = input, [1] = output
+    VkPipelineLayout psoLayout;
+    VkPipeline pso;
+};
+
+// Everything but the pipeline, which BuildComputePipelineJob builds as part of a batch:
 static void
-CreatePipelineObjects(VkDevice device, bool bInputUav, VkPipeline *pPso, VkPipelineLayout *pPsoLayout, VkDescriptorSetLayout *pDescSetLayout)
+CreatePipelineObjects(const VulkanObjetcs& vk, bool bInputUav, bool bSpec, ComputePipelineObjects *o)
 {
-    VkShaderModule shaderModule;
+    VkDevice const device = vk.device;
+    *o = { };
+    o->device = device;
+    o->bSpec = bSpec;
+    if (bSpec) {
+        // The values the push constants give the other shader, ShaderLoadCoord must agree:
+        SpecVariantSet(&o->spec, SpecIdOobLayer, uint32_t(-1));
+        SpecVariantSet(&o->spec, SpecIdCoordOffsetX, 1);
+    }
     {
-        const uint32_t *pFinalCode = CsSpirvWords;
-        uint32_t nCodeBytes = sizeof CsSpirvWords;
-        uint32_t tmpcode[sizeof(CsSpirvWords) / sizeof(CsSpirvWords[0])];
+        const uint32_t *const pSrcCode = bSpec ? CsSpecSpirvWords : CsSpirvWords;
+        uint32_t const nSrcBytes = bSpec ? sizeof CsSpecSpirvWords : sizeof CsSpirvWords;
+        const uint32_t *pFinalCode = pSrcCode;
+        uint32_t nCodeBytes = nSrcBytes;
+        uint32_t tmpcode[(sizeof CsSpirvWords > sizeof CsSpecSpirvWords ? sizeof CsSpirvWords : sizeof CsSpecSpirvWords) / sizeof(uint32_t)];
         if (bInputUav) {
-            const size_t InputOpTypeImageWordIndex = 0x000001f8 / 4;
-            const size_t OpImageFetchWordIndex = 0x0000045c / 4;
-
-            // Copy through fist 5 words of OpImageFetch { opcode, result type, result, image, coord }:
-            memcpy(tmpcode, CsSpirvWords, (OpImageFetchWordIndex + 5) * sizeof(uint32_t));
-
-            tmpcode[InputOpTypeImageWordIndex + 7] = 2; // "sampled"=2 means UAV
-            tmpcode[InputOpTypeImageWordIndex + 8] = 33; // R32ui, replace Unknown
-
-            tmpcode[OpImageFetchWordIndex + 0] = 5u << 16 | 98; // OpImageRead, replace OpImageFetch
-
-            const size_t srcSuffixWordIndex = OpImageFetchWordIndex + 7; // skip image operands mask and lod=0
-            memcpy(tmpcode + OpImageFetchWordIndex + 5,
-                   CsSpirvWords + srcSuffixWordIndex,
-                   sizeof(CsSpirvWords) - srcSuffixWordIndex * sizeof(uint32_t));
+            SpirvModule m;
+            bool bOk = SpirvInit(&m, tmpcode, lengthof(tmpcode), pSrcCode, nSrcBytes);
+            // OpImageFetch { opcode, result type, result, image, coord, image operands = Lod, lod = 0 }:
+            uint32_t const fetch = bOk ? SpirvFindOp(m, SpirvOpImageFetch) : 0;
+            uint32_t const load = fetch ? SpirvFindResult(m, m.pWords[fetch + 3]) : 0;
+            uint32_t const imageType = load ? SpirvFindResult(m, m.pWords[load + 1]) : 0;
+            bOk = imageType && SpirvOpcode(m, imageType) == SpirvOpTypeImage;
+            if (bOk) {
+                m.pWords[imageType + SpirvTypeImageSampled] = 2; // "sampled"=2 means UAV
+                m.pWords[imageType + SpirvTypeImageFormat] = SpirvImageFormatR32ui; // replace Unknown
+                SpirvSetOpcode(&m, fetch, SpirvOpImageRead);
+                bOk = SpirvTruncate(&m, fetch, 5); // drop the Lod operand, reads have no mips
+            }
+            if (!bOk) {
+                printf("ERROR: failed to patch %s into the UAV variant\n", bSpec ? "ld_typed_2darray_spec.comp.h" : "ld_srv_typed_2darray.comp.h");
+                abort();
+            }
             pFinalCode = tmpcode;
-            nCodeBytes = sizeof(CsSpirvWords) - 2 * sizeof(uint32_t);
+            nCodeBytes = uint32_t(SpirvByteSize(m));
         }
-        shaderModule = CreateShaderModule(device, nCodeBytes, pFinalCode);
+        VERIFY_VK(ShaderCacheAcquire(pFinalCode, nCodeBytes, &o->shaderModule));
     }
 
     {
-        VkDescriptorType inputDescriptorType = bInputUav ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-        VkDescriptorSetLayoutBinding bindings[2] = {
-            { 0, inputDescriptorType,              1, VK_SHADER_STAGE_COMPUTE_BIT },
-            { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT }
-        };
-        VkDescriptorSetLayoutCreateInfo setInfo = {
-            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0,
-            2, bindings
+        const VkDescriptorType types[2] = {
+            bInputUav ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
         };
-        vkCreateDescriptorSetLayout(device, &setInfo, VKU_ALLOC_CBS, pDescSetLayout);
+        // A set per input image if pooled:
+        VERIFY_VK(DescriptorBinderInit(&o->binder, vk, g_descriptorBindMode, VK_PIPELINE_BIND_POINT_COMPUTE, VK_SHADER_STAGE_COMPUTE_BIT,
+                                       types, 2, 4));
     }
 
     {
@@ -128,22 +156,33 @@ CreatePipelineObjects(VkDevice device, bool bInputUav, VkPipeline *pPso, VkPipel
             VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
             nullptr,
             0,
-            1, pDescSetLayout,
+            1, &o->binder.setLayout,
             1, &pcRange
         };
-        vkCreatePipelineLayout(device, &layoutInfo, VKU_ALLOC_CBS, pPsoLayout);
+        vkCreatePipelineLayout(device, &layoutInfo, VKU_ALLOC_CBS, &o->psoLayout);
     }
+    VERIFY_VK(DescriptorBinderSetPipelineLayout(&o->binder, o->psoLayout));
+}
 
-    VERIFY_VK(CreateComputePipeline(device, shaderModule, *pPsoLayout, pPso));
-
-    vkDestroyShaderModule(device, shaderModule, VKU_ALLOC_CBS);
+static void
+BuildComputePipelineJob(void *pArgs)
+{
+    ComputePipelineObjects *const o = static_cast<ComputePipelineObjects *>(pArgs);
+    VkSpecializationInfo const specInfo = SpecVariantInfo(o->spec);
+    VERIFY_VK(CreateComputePipeline(o->device, o->shaderModule, o->bSpec ? &specInfo : nullptr, o->psoLayout, &o->pso));
+    ShaderCacheRelease(o->shaderModule);
 }
 
 #include "thirdparty/renderdoc_app.h"
 extern RENDERDOC_API_1_1_2 *rdoc_api;
 
-bool TestUavLoadOob(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex, const VkPhysicalDeviceMemoryProperties& memProps)
+bool TestUavLoadOob(const VulkanObjetcs& vk)
 {
+    VkDevice const device = vk.device;
+    VkQueue const queue = vk.universalQueue;
+    uint32_t const graphicsFamilyIndex = vk.universalFamilyIndex;
+    const VkPhysicalDeviceMemoryProperties& memProps = vk.memProps;
+
     VkCommandPool cmdpool = VK_NULL_HANDLE;
     VkCommandBuffer cmdbuf = VK_NULL_HANDLE;
     {
@@ -162,31 +201,13 @@ bool TestUavLoadOob(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex
         VERIFY_VK(vkAllocateCommandBuffers(device, &cmdBufAllocInfo, &cmdbuf));
     }
 
-    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
-    {
-        static const VkDescriptorPoolSize poolSizes[] = {
-           { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 32 },
-           { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 32 },
-        };
-        const VkDescriptorPoolCreateInfo descPoolInfo = {
-           VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-            nullptr, // pNext
-           0, // flags
-           64,
-           2, poolSizes
-        };
-        VERIFY_VK(vkCreateDescriptorPool(device, &descPoolInfo, VKU_ALLOC_CBS, &descriptorPool));
-    }
-
     static constexpr uint32_t ImageWidth = 8, ImageHeight = 8;
     static constexpr uint32_t SerializedByteSizePerImage = ImageWidth * ImageHeight * sizeof(uint32_t);
 
     static constexpr uint32_t BufferByteCapacity = SerializedByteSizePerImage * 4;
-    VkuBufferAndMemory stage;
-    VERIFY_VK(vkuDedicatedBuffer(device, BufferByteCapacity, VK_BUFFER_USAGE_TRANSFER_DST_BIT, &stage,
-                                 memProps,
-                                 VK_MEMORY_PROPERTY_HOST_CACHED_BIT |
-                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
+    VkuStagingBuffer stage;
+    VERIFY_VK(vkuStagingBuffer(device, BufferByteCapacity, VK_BUFFER_USAGE_TRANSFER_DST_BIT, &stage,
+                               memProps, HostImportAlignment(vk, g_bHostImportStaging)));
 
     static const uint8_t ImageLayerCounts[5] = { 1, 3, 4, 5, 1 };
     static const struct Span { uint8_t base, n; } ViewLayerSpans[4] = { {0, 1}, {1, 1}, {0, 4}, {2, 2} };
@@ -222,9 +243,7 @@ bool TestUavLoadOob(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex
     VERIFY_VK(vkCreateImageView(device, &viewCreateInfo, VKU_ALLOC_CBS, &views[4]));
     viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY; // for the rest
 
-    VkMappedMemoryRange const MapRange = { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, stage.memory, 0x0, VK_WHOLE_SIZE };
-    void *pMap = nullptr;
-    VERIFY_VK(vkMapMemory(device, stage.memory, 0, VK_WHOLE_SIZE, 0, &pMap));
+    void *const pMap = stage.pHost;
 
     auto CmdClearLayers = [cmdbuf](VkImage image, Span span, uint32_t val) {
         VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, span.base, span.n };
@@ -236,13 +255,25 @@ bool TestUavLoadOob(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex
 
     bool const bUseDebugtUtil = (vkCmdBeginDebugUtilsLabelEXT != nullptr);
     if (rdoc_api) rdoc_api->StartFrameCapture(NULL, NULL);
-    for (int n = 2; n; --n) {
-        bool const bUav = (n == 1);
-        VkPipeline pso = VK_NULL_HANDLE;
-        VkPipelineLayout psoLayout = VK_NULL_HANDLE;
-        VkDescriptorSetLayout descSetLayout = VK_NULL_HANDLE;
-
-        CreatePipelineObjects(device, bUav, &pso, &psoLayout, &descSetLayout);
+    // [bSpec * 2 + bUav], the specialized kernels must give the same results as the push constant ones:
+    ComputePipelineObjects psoObjects[4];
+    static const char *const PsoNames[4] = { "srv", "uav", "srv_spec", "uav_spec" };
+    {
+        PipelineBatch batch;
+        PipelineBatchInit(&batch, "ld_typed_2darray_oob");
+        for (int i = 0; i < 4; ++i) {
+            CreatePipelineObjects(vk, (i & 1) != 0, i >= 2, &psoObjects[i]);
+            PipelineBatchAdd(&batch, PsoNames[i], BuildComputePipelineJob, &psoObjects[i]);
+        }
+        PipelineBatchBuild(&batch);
+    }
+    for (int variant = 0; variant < 4; ++variant) {
+        bool const bUav = (variant & 1) != 0;
+        bool const bSpec = variant >= 2;
+        const char *const specSuffix = bSpec ? "_spec" : "";
+        VkPipeline const pso = psoObjects[variant].pso;
+        VkPipelineLayout const psoLayout = psoObjects[variant].psoLayout;
+        DescriptorBinder *const binder = &psoObjects[variant].binder;
 
         for (int i = 0; i < 4; ++i) {
             viewCreateInfo.image = images[i].image;
@@ -262,7 +293,8 @@ bool TestUavLoadOob(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex
             VERIFY_VK(vkBeginCommandBuffer(cmdbuf, &cmdBufbeginInfo));
             if (bUseDebugtUtil) {
                 vkuCmdLabel(vkCmdBeginDebugUtilsLabelEXT, cmdbuf,
-                            bUav ? "Input type = UAV" : "Input type = SRV",
+                            bUav ? (bSpec ? "Input type = UAV, specialized" : "Input type = UAV") :
+                                   (bSpec ? "Input type = SRV, specialized" : "Input type = SRV"),
                             bUav ? 0xffff0000 : 0xff00ff00);
             }
 
@@ -295,26 +327,11 @@ bool TestUavLoadOob(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex
             const int32_t pcData[4] = { -1, 42, 0, 0 };
             vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, pso);
             vkCmdPushConstants(cmdbuf, psoLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, 16, pcData);
-            VkDescriptorSet descSets[4] = { };
-            VkDescriptorSetLayout descSetLayouts[4] = { descSetLayout, descSetLayout, descSetLayout, descSetLayout };
-            VkDescriptorSetAllocateInfo descAllocInfo = {
-                VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
-                descriptorPool, 4, descSetLayouts
-            };
-            vkAllocateDescriptorSets(device, &descAllocInfo, descSets);
             for (unsigned inputImageIndex = 0;;) {
-                VkDescriptorSet descSet = descSets[inputImageIndex];
-                VkDescriptorImageInfo inputInfo = { VkSampler(), views[inputImageIndex], VK_IMAGE_LAYOUT_GENERAL };
-                VkDescriptorImageInfo outputInfo = { VkSampler(), views[4], VK_IMAGE_LAYOUT_GENERAL };
-                VkDescriptorType inputDescriptorType = bUav ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-                VkWriteDescriptorSet writes[2] = {
-                    { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, descSet, 0, 0, 1, // binding, arrayIndex, count
-                      inputDescriptorType, &inputInfo, nullptr, nullptr },
-                    { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, descSet, 1, 0, 1, // binding, arrayIndex, count
-                      VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, &outputInfo, nullptr, nullptr },
-                };
-                vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
-                vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, psoLayout, 0, 1, &descSet, 0, nullptr);
+                DescriptorData descriptors[2];
+                descriptors[0].image = { VkSampler(), views[inputImageIndex], VK_IMAGE_LAYOUT_GENERAL };
+                descriptors[1].image = { VkSampler(), views[4], VK_IMAGE_LAYOUT_GENERAL };
+                DescriptorBinderBind(binder, cmdbuf, descriptors);
                 vkCmdDispatch(cmdbuf, 1, 1, 1);
                 memBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
                 memBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
@@ -355,57 +372,92 @@ bool TestUavLoadOob(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex
         // submit and WFI:
         {
             memset(pMap, 0xff, BufferByteCapacity); // opaque white
-            vkFlushMappedMemoryRanges(device, 1, &MapRange);
+            vkuFlushStagingBuffer(device, stage);
             VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
             submitInfo.commandBufferCount = 1;
             submitInfo.pCommandBuffers = &cmdbuf;
             VERIFY_VK(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
             VERIFY_VK(vkQueueWaitIdle(queue));
-            vkInvalidateMappedMemoryRanges(device, 1, &MapRange);
+            vkuInvalidateStagingBuffer(device, stage);
         }
 
         // inspect results:
         for (unsigned imageIndex = 0; imageIndex < 4; ++imageIndex) {
             const uint32_t *const pBaseU32 = (const uint32_t *)(SerializedByteSizePerImage*imageIndex + (const char *)pMap);
-            bool bThisImagePass = true;
-            for (uint y = 0; y < ImageHeight; ++y) {
-                int numMismatchesThisRow = 0;
-                for (uint x = 0; x < ImageWidth; ++x) {
-                    // mostly copied from the shader:
-                    uvec2 tid = { x, y };
-                    uvec3 c;
-                    c.x = tid.x + 1; // rightmost goes OOB
-                    c.y = tid.y;
-                    c.z = tid.y < 7u ? tid.y : uint32_t(-1);
-                    Span const viewLayers = ViewLayerSpans[imageIndex];
-                    uint32_t const expectedTexelValue =
-                            (c.x >= ImageWidth ||
-                             c.y >= ImageHeight ||
-                             c.z >= viewLayers.n) ? 0 : ColorOfLayer[viewLayers.base + c.z];
-                    uint32_t const gotTexelValue = pBaseU32[y * ImageWidth + x];
-                    if (expectedTexelValue != gotTexelValue) {
-                        bThisImagePass = false;
-                        if (numMismatchesThisRow++ == 0) {
-                            printf("Mismatch at x=%d, y=%d, %sV_%d, c={%d,%d,%d}: got=0x%08X, expected=0x%08X\n",
-                                    x, y, bUav ? "UA" : "SR", imageIndex, c.x, c.y, c.z, gotTexelValue, expectedTexelValue);
-                        }
+            char goldenParams[16];
+            sprintf(goldenParams, "%sv_%02u%s", bUav ? "ua" : "sr", imageIndex, specSuffix);
+            ResultArchiveAddDesc archiveDesc = {
+                "ld_typed_2darray_oob", goldenParams, VK_FORMAT_R8G8B8A8_UNORM, ImageWidth, ImageHeight, 1,
+                sizeof(uint32_t), pBaseU32, ImageWidth * sizeof(uint32_t), false
+            };
+            if (GoldenCheck("ld_typed_2darray_oob", goldenParams, pBaseU32, SerializedByteSizePerImage) == GoldenResult::Match) {
+                ResultArchiveAdd(archiveDesc);
+                continue;
+            }
+            Span const viewLayers = ViewLayerSpans[imageIndex];
+            uint32_t analyticExpected[ImageHeight * ImageWidth];
+            const uint32_t *pExpected = analyticExpected;
+            size_t expectedRowPitch = ImageWidth * sizeof(uint32_t);
+
+            // Same for SRV and UAV. Computing it from the shader's logic is the fallback if the reference is missing:
+            char refName[64];
+            sprintf(refName, "ld_typed_ref_%02d.png", imageIndex);
+            const RefStoreDesc refDesc = { refName, 4, VK_FORMAT_R8G8B8A8_UNORM, sizeof(uint32_t), nullptr };
+            RefImage ref;
+            if (RefStoreOpen(refDesc, &ref) && ref.width == ImageWidth && ref.height == ImageHeight) {
+                pExpected = static_cast<const uint32_t *>(ref.pPixels);
+                expectedRowPitch = ref.rowPitch;
+            } else {
+                for (uint y = 0; y < ImageHeight; ++y) {
+                    for (uint x = 0; x < ImageWidth; ++x) {
+                        // mostly copied from the shader:
+                        uvec3 const c = ShaderLoadCoord(x, y);
+                        analyticExpected[y * ImageWidth + x] =
+                                (c.x >= ImageWidth ||
+                                 c.y >= ImageHeight ||
+                                 c.z >= viewLayers.n) ? 0 : ColorOfLayer[viewLayers.base + c.z];
                     }
                 }
-                if (numMismatchesThisRow >= 2) {
-                    printf("%d more mismatches this row not reported\n", numMismatchesThisRow - 1);
-                }
             }
-            if (!bThisImagePass) {
+
+            ImageCompareDesc compareDesc = { };
+            compareDesc.pGot = pBaseU32;
+            compareDesc.pExpected = pExpected;
+            compareDesc.expectedRowPitch = expectedRowPitch;
+            compareDesc.width = ImageWidth;
+            compareDesc.height = ImageHeight;
+            compareDesc.bytesPerPixel = sizeof(uint32_t);
+            ImageCompareResult compareResult;
+            CompareImagesExact(compareDesc, &compareResult);
+            for (uint32_t r = 0; r < compareResult.numReported; ++r) {
+                uint const x = compareResult.first[r].x, y = compareResult.first[r].y;
+                uvec3 const c = ShaderLoadCoord(x, y);
+                printf("Mismatch at x=%d, y=%d, %sV_%d%s, c={%d,%d,%d}: got=0x%08X, expected=0x%08X\n",
+                        x, y, bUav ? "UA" : "SR", imageIndex, specSuffix, c.x, c.y, c.z,
+                        pBaseU32[y * ImageWidth + x], pExpected[y * (expectedRowPitch / sizeof(uint32_t)) + x]);
+            }
+            if (compareResult.numMismatches > compareResult.numReported) {
+                printf("%llu more mismatches not reported\n",
+                       (unsigned long long)(compareResult.numMismatches - compareResult.numReported));
+            }
+            bool const bThisImagePass = (compareResult.numMismatches == 0);
+            archiveDesc.bFailed = !bThisImagePass;
+            ResultArchiveAdd(archiveDesc);
+            if (bThisImagePass) {
+                GoldenRecord("ld_typed_2darray_oob", goldenParams, pBaseU32, SerializedByteSizePerImage);
+            } else {
                 bPassed = false;
-                if (g_bSaveFailingImages) {
+                if (ResultArchiveIsOpen()) {
+                    printf("Failed result is archived as ld_typed_2darray_oob/%s\n", goldenParams);
+                } else if (g_bSaveFailingImages) {
                     char nameBuf[256];
-                    sprintf(nameBuf, "ld_%sv_typed_generated_%02d.png", bUav ? "ua" : "sr", imageIndex);
+                    sprintf(nameBuf, "ld_%sv_typed_generated_%02d%s.png", bUav ? "ua" : "sr", imageIndex, specSuffix);
                     printf("Saving failed result as %s\n", nameBuf);
-                    stbi_write_png(nameBuf, ImageWidth, ImageHeight, 4, pBaseU32, ImageWidth * sizeof(uint32_t));
+                    ArtifactWritePng(nameBuf, ImageWidth, ImageHeight, 4, pBaseU32, ImageWidth * sizeof(uint32_t));
                     printf("Expected result is ld_typed_ref_%02d.png\n\n", imageIndex); // same for SRV and UAV
                 } else {
-                    printf("case ld_%sv_typed_generated_%02d failed, not writing.png (use --save-failing-images if desired).\n",
-                            bUav ? "ua" : "sr", imageIndex);
+                    printf("case ld_%sv_typed_generated_%02d%s failed, not writing.png (use --save-failing-images if desired).\n",
+                            bUav ? "ua" : "sr", imageIndex, specSuffix);
                 }
             }
         }
@@ -413,14 +465,14 @@ bool TestUavLoadOob(VkDevice device, VkQueue queue, uint32_t graphicsFamilyIndex
         for (int i = 0; i < 4; ++i) vkDestroyImageView(device, views[i], VKU_ALLOC_CBS); // keep output view
         vkDestroyPipeline(device, pso, VKU_ALLOC_CBS);
         vkDestroyPipelineLayout(device, psoLayout, VKU_ALLOC_CBS);
-        vkDestroyDescriptorSetLayout(device, descSetLayout, VKU_ALLOC_CBS);
+        DescriptorBinderReport(*binder, PsoNames[variant]);
+        DescriptorBinderDestroy(binder);
     }
     if (rdoc_api) rdoc_api->EndFrameCapture(NULL, NULL);
 
-    vkDestroyDescriptorPool(device, descriptorPool, VKU_ALLOC_CBS);
     vkDestroyImageView(device, views[4], VKU_ALLOC_CBS);
     for (const VkuImageAndMemory& r : images) vkuDestroyImageAndFreeMemory(device, r);
-    vkuDestroyBufferAndFreeMemory(device, stage);
+    vkuDestroyStagingBuffer(device, stage);
     vkFreeCommandBuffers(device, cmdpool, 1, &cmdbuf);
     vkDestroyCommandPool(device, cmdpool, VKU_ALLOC_CBS);
     return bPassed;
@@ -238,7 +238,7 @@ VkResult SimpleInitVulkan(VulkanObjetcs *vk, unsigned flags, int forceGpuIndex,
         VkPhysicalDevice const physdev = physicalDevices[bestIndex];
         vk->physicalDevice = physdev;
 
-        const char *deviceExtensions[16];
+        const char *deviceExtensions[24];
         int nDeviceExtensions = 0;
         {
             vk->props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
@@ -280,6 +280,51 @@ VkResult SimpleInitVulkan(VulkanObjetcs *vk, unsigned flags, int forceGpuIndex,
                 PushFront(&vk->props2, &vk->xfbProperties, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TRANSFORM_FEEDBACK_PROPERTIES_EXT);
             }
 
+            vk->EXT_external_memory_host = TestAndAppend(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+            if (vk->EXT_external_memory_host) {
+                // no features
+                PushFront(&vk->props2, &vk->externalMemoryHostProperties, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT);
+            }
+
+            vk->EXT_pipeline_creation_feedback = TestAndAppend(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+            // no features or properties
+
+#ifdef VK_EXT_shader_module_identifier
+            // Identifiers are only usable with VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT, which cache_control adds:
+            if (HasExtension(extSet, VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME) &&
+                TestAndAppend(VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME)) {
+                TestAndAppend(VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME);
+                PushFront(&vk->features2, &vk->shaderModuleIdentifierFeatures, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT);
+                PushFront(&vk->features2, &vk->cacheControlFeatures, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES_EXT);
+                PushFront(&vk->props2, &vk->shaderModuleIdentifierProperties, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_PROPERTIES_EXT);
+            }
+#endif
+
+#ifdef VK_EXT_graphics_pipeline_library
+            if (HasExtension(extSet, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+                TestAndAppend(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+                TestAndAppend(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+                PushFront(&vk->features2, &vk->graphicsPipelineLibraryFeatures, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT);
+                PushFront(&vk->props2, &vk->graphicsPipelineLibraryProperties, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT);
+            }
+#endif
+
+            // Needs depth_stencil_resolve, which needs create_renderpass2, before Vulkan 1.2:
+            if (HasExtension(extSet, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+                TestAndAppend(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME) &&
+                TestAndAppend(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME)) {
+                TestAndAppend(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+                PushFront(&vk->features2, &vk->dynamicRenderingFeatures, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR);
+                // no properties
+            }
+
+            // Needs VK_KHR_maintenance3, which is core in 1.1:
+            vk->EXT_descriptor_indexing = TestAndAppend(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+            if (vk->EXT_descriptor_indexing) {
+                PushFront(&vk->features2, &vk->descriptorIndexingFeatures, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT);
+                PushFront(&vk->props2, &vk->descriptorIndexingProperties, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT);
+            }
+
             if (flags & (SIMPLE_INIT_BUFFER_ROBUSTNESS_2 | SIMPLE_INIT_IMAGE_ROBUSTNESS_2 | SIMPLE_INIT_NULL_DESCRIPTOR)) {
                 if (TestAndAppend(VK_EXT_ROBUSTNESS_2_EXTENSION_NAME)) {
                     PushFront(&vk->features2, &vk->robustness2Features, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ROBUSTNESS_2_FEATURES_EXT);
@@ -306,6 +351,14 @@ VkResult SimpleInitVulkan(VulkanObjetcs *vk, unsigned flags, int forceGpuIndex,
         vk->robustness2Features.robustBufferAccess2 &= VkBool32((flags & SIMPLE_INIT_BUFFER_ROBUSTNESS_2) != 0);
         vk->robustness2Features.robustImageAccess2  &= VkBool32((flags & SIMPLE_INIT_IMAGE_ROBUSTNESS_2) != 0);
         vk->robustness2Features.nullDescriptor      &= VkBool32((flags & SIMPLE_INIT_NULL_DESCRIPTOR) != 0);
+#ifdef VK_EXT_shader_module_identifier
+        vk->EXT_shader_module_identifier = vk->shaderModuleIdentifierFeatures.shaderModuleIdentifier &&
+                                           vk->cacheControlFeatures.pipelineCreationCacheControl;
+#endif
+#ifdef VK_EXT_graphics_pipeline_library
+        vk->EXT_graphics_pipeline_library = vk->graphicsPipelineLibraryFeatures.graphicsPipelineLibrary != VK_FALSE;
+#endif
+        vk->KHR_dynamic_rendering = vk->dynamicRenderingFeatures.dynamicRendering != VK_FALSE;
 
         // Find universal family:
         int sUniversalFamily = -1;
@@ -26,6 +26,12 @@ struct VulkanObjetcs {
     bool NV_framebuffer_mixed_samples;
     bool KHR_shader_draw_parameters;
     bool KHR_shader_float_controls;
+    bool EXT_external_memory_host;
+    bool EXT_pipeline_creation_feedback;
+    bool EXT_shader_module_identifier; // and its feature enabled, implies pipelineCreationCacheControl
+    bool EXT_graphics_pipeline_library; // and its feature enabled, VK_KHR_pipeline_library is enabled with it
+    bool KHR_dynamic_rendering; // and its feature enabled
+    bool EXT_descriptor_indexing;
 
     VkPhysicalDeviceProperties2 props2;
     VkPhysicalDeviceFeatures2 features2;
@@ -40,8 +46,24 @@ struct VulkanObjetcs {
     VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures;
     // VK_EXT_line_rasterization:
     VkPhysicalDeviceLineRasterizationFeaturesEXT lineRasterizationFeatures;
+    // VK_EXT_external_memory_host:
+    VkPhysicalDeviceExternalMemoryHostPropertiesEXT externalMemoryHostProperties;
+#ifdef VK_EXT_shader_module_identifier
+    // VK_EXT_shader_module_identifier, VK_EXT_pipeline_creation_cache_control:
+    VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT shaderModuleIdentifierFeatures;
+    VkPhysicalDeviceShaderModuleIdentifierPropertiesEXT shaderModuleIdentifierProperties;
+    VkPhysicalDevicePipelineCreationCacheControlFeaturesEXT cacheControlFeatures;
+#endif
+#ifdef VK_EXT_graphics_pipeline_library
+    // VK_EXT_graphics_pipeline_library:
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures;
+    VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT graphicsPipelineLibraryProperties;
+#endif
     // VK_KHR_dynamic_rendering:
-    // VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures;
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures;
+    // VK_EXT_descriptor_indexing:
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures;
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT descriptorIndexingProperties;
 };
 
 enum : unsigned {
@@ -67,3 +89,10 @@ VkResult SimpleInitVulkan(VulkanObjetcs *vk, unsigned flags, int forceGpuIndex =
 
 void SimpleDestroyVulkan(VulkanObjetcs *vk);
 
+// For vkuStagingBuffer's hostImportAlignment: 0 if not wanted or VK_EXT_external_memory_host is not supported.
+inline VkDeviceSize
+HostImportAlignment(const VulkanObjetcs& vk, bool bWanted)
+{
+    return (bWanted && vk.EXT_external_memory_host) ? vk.externalMemoryHostProperties.minImportedHostPointerAlignment : 0;
+}
+
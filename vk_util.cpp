@@ -5,6 +5,11 @@
 #include "vk_util.h"
 #include "volk/volk.h"
 
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
 //XXX: the value of HOST_CACHED may not match:
 static int
 FindMemoryType(const VkPhysicalDeviceMemoryProperties& memProps,
@@ -144,3 +149,167 @@ vkuDestroyBufferAndFreeMemory(VkDevice device, const VkuBufferAndMemory& m)
 }
 
 
+static void *
+AlignedHostAlloc(size_t alignment, size_t size)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void *p = nullptr;
+    return posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+#endif
+}
+
+static void
+AlignedHostFree(void *p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+static VkResult
+ImportHostStagingBuffer(VkDevice device,
+                        VkDeviceSize bytesize,
+                        VkBufferUsageFlags usageFlags,
+                        VkuStagingBuffer *p,
+                        const VkPhysicalDeviceMemoryProperties& memProps,
+                        VkDeviceSize alignment)
+{
+    // Both the pointer and the allocation size must be multiples of minImportedHostPointerAlignment:
+    VkDeviceSize const allocSize = (bytesize + alignment - 1) & ~(alignment - 1);
+    void *const pHost = AlignedHostAlloc(size_t(alignment), size_t(allocSize));
+    if (!pHost) {
+        return VK_ERROR_OUT_OF_HOST_MEMORY;
+    }
+
+    VkExternalMemoryBufferCreateInfo const externalInfo = {
+        VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO, nullptr,
+        VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT
+    };
+    VkBufferCreateInfo const info = {
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        &externalInfo,
+        0, // VkBufferCreateFlags
+        bytesize,
+        usageFlags,
+        VK_SHARING_MODE_EXCLUSIVE, 0, nullptr
+    };
+    VkResult result = vkCreateBuffer(device, &info, VKU_ALLOC_CBS, &p->buffer);
+    if (result == VK_SUCCESS) {
+        VkMemoryHostPointerPropertiesEXT hostPtrProps = { VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT };
+        result = vkGetMemoryHostPointerPropertiesEXT(device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+                                                     pHost, &hostPtrProps);
+        if (result == VK_SUCCESS) {
+            VkMemoryRequirements reqs;
+            vkGetBufferMemoryRequirements(device, p->buffer, &reqs);
+            // Coherent so neither side needs vkMapMemory for flush/invalidate, cached for fast host reads if available:
+            uint32_t const typeBits = reqs.memoryTypeBits & hostPtrProps.memoryTypeBits;
+            int sMemTypeIndex = FindMemoryType(memProps, typeBits,
+                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                               VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+            if (sMemTypeIndex < 0) {
+                sMemTypeIndex = FindMemoryType(memProps, typeBits,
+                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            }
+            if (sMemTypeIndex >= 0 && reqs.size <= allocSize) {
+                VkImportMemoryHostPointerInfoEXT const importInfo = {
+                    VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT, nullptr,
+                    VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+                    pHost
+                };
+                VkMemoryAllocateInfo const allocInfo = {
+                    VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, &importInfo,
+                    allocSize, uint32_t(sMemTypeIndex)
+                };
+                result = vkAllocateMemory(device, &allocInfo, VKU_ALLOC_CBS, &p->memory);
+                if (result == VK_SUCCESS) {
+                    result = vkBindBufferMemory(device, p->buffer, p->memory, 0);
+                    if (result != VK_SUCCESS) {
+                        vkFreeMemory(device, p->memory, VKU_ALLOC_CBS);
+                        p->memory = VK_NULL_HANDLE;
+                    }
+                }
+            } else {
+                result = VK_ERROR_UNKNOWN;
+            }
+        }
+
+        if (result != VK_SUCCESS) {
+            vkDestroyBuffer(device, p->buffer, VKU_ALLOC_CBS);
+            p->buffer = VK_NULL_HANDLE;
+        }
+    }
+
+    if (result == VK_SUCCESS) {
+        p->pHost = pHost;
+        p->size = bytesize;
+        p->bImported = true;
+    } else {
+        AlignedHostFree(pHost);
+    }
+    return result;
+}
+
+VkResult
+vkuStagingBuffer(VkDevice device,
+                 VkDeviceSize bytesize,
+                 VkBufferUsageFlags usageFlags,
+                 VkuStagingBuffer *p,
+                 const VkPhysicalDeviceMemoryProperties& memProps,
+                 VkDeviceSize hostImportAlignment)
+{
+    *p = { };
+    // minImportedHostPointerAlignment is a power of 2 by spec:
+    if (hostImportAlignment != 0 && vkGetMemoryHostPointerPropertiesEXT != nullptr &&
+        ImportHostStagingBuffer(device, bytesize, usageFlags, p, memProps, hostImportAlignment) == VK_SUCCESS) {
+        return VK_SUCCESS;
+    }
+
+    VkuBufferAndMemory bm;
+    VkResult result = vkuDedicatedBuffer(device, bytesize, usageFlags, &bm, memProps,
+                                         VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    if (result == VK_SUCCESS) {
+        result = vkMapMemory(device, bm.memory, 0, VK_WHOLE_SIZE, 0, &p->pHost);
+        if (result == VK_SUCCESS) {
+            p->buffer = bm.buffer;
+            p->memory = bm.memory;
+            p->size = bytesize;
+        } else {
+            vkuDestroyBufferAndFreeMemory(device, bm);
+        }
+    }
+    return result;
+}
+
+void
+vkuInvalidateStagingBuffer(VkDevice device, const VkuStagingBuffer& m)
+{
+    if (!m.bImported) {
+        VkMappedMemoryRange const range = { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, m.memory, 0x0, VK_WHOLE_SIZE };
+        vkInvalidateMappedMemoryRanges(device, 1, &range);
+    }
+}
+
+void
+vkuFlushStagingBuffer(VkDevice device, const VkuStagingBuffer& m)
+{
+    if (!m.bImported) {
+        VkMappedMemoryRange const range = { VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, m.memory, 0x0, VK_WHOLE_SIZE };
+        vkFlushMappedMemoryRanges(device, 1, &range);
+    }
+}
+
+void
+vkuDestroyStagingBuffer(VkDevice device, const VkuStagingBuffer& m)
+{
+    // Memory must be freed before the imported host allocation it aliases:
+    vkDestroyBuffer(device, m.buffer, VKU_ALLOC_CBS);
+    vkFreeMemory(device, m.memory, VKU_ALLOC_CBS);
+    if (m.bImported) {
+        AlignedHostFree(m.pHost);
+    }
+}
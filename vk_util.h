@@ -70,6 +70,39 @@ vkuDedicatedBuffer(VkDevice device,
 void
 vkuDestroyBufferAndFreeMemory(VkDevice device, const VkuBufferAndMemory& m);
 
+
+/*
+ * Host-readable buffer for readbacks/uploads. pHost stays valid until vkuDestroyStagingBuffer.
+ *
+ * If hostImportAlignment != 0 (pass VkPhysicalDeviceExternalMemoryHostPropertiesEXT::minImportedHostPointerAlignment),
+ * the memory is a page-aligned allocation owned by us and imported via VK_EXT_external_memory_host,
+ * so the device writes straight into memory that verification code and image writers can read,
+ * with no vkMapMemory. Falls back to a normal HOST_CACHED allocation that is mapped once if the import fails.
+ */
+struct VkuStagingBuffer {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    void *pHost;
+    VkDeviceSize size;
+    bool bImported;
+};
+
+VkResult
+vkuStagingBuffer(VkDevice device,
+                 VkDeviceSize bytesize,
+                 VkBufferUsageFlags usageFlags,
+                 VkuStagingBuffer *p,
+                 const VkPhysicalDeviceMemoryProperties& memProps,
+                 VkDeviceSize hostImportAlignment = 0);
+// Call after the device writes (and a wait) before reading pHost. No-op for imported memory, which is coherent.
+void
+vkuInvalidateStagingBuffer(VkDevice device, const VkuStagingBuffer& m);
+// Call after host writes to pHost, before the device reads.
+void
+vkuFlushStagingBuffer(VkDevice device, const VkuStagingBuffer& m);
+void
+vkuDestroyStagingBuffer(VkDevice device, const VkuStagingBuffer& m);
+
 // pfn can be vkCmdBeginDebugUtilsLabelEXT or vkCmdInsertDebugUtilsLabelEXT
 inline void
 vkuCmdLabel(PFN_vkCmdBeginDebugUtilsLabelEXT pfn, VkCommandBuffer cmdbuf, const char *s, uint32_t color = 0)
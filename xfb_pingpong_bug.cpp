@@ -7,9 +7,20 @@
 #include <string.h>
 #include <assert.h>
 
-#include "stb/stb_image_write.h"
+#include "artifact_writer.h"
+#include "result_archive.h"
+#include "spirv_patch.h"
+#include "shader_cache.h"
+#include "pipeline_batch.h"
+#include "pipeline_library.h"
+#include "bench_util.h"
+#include "xfb_reference.h"
 
 extern bool g_bSaveFailingImages;
+extern bool g_bDynamicRendering;
+extern bool g_bXfbIndirect;
+extern unsigned g_xfbBenchVertices;
+extern unsigned g_xfbBenchIters;
 
 #ifdef _WIN32
 #include <direct.h>
@@ -31,57 +42,6 @@ VerifyVkResultFaild(VkResult r, const char *expr, int line)
 }
 #define VERIFY_VK(e) do { if (VkResult _r = e) VerifyVkResultFaild(_r, #e, __LINE__); } while(0)
 
-static VkShaderModule
-CreateShaderModule(VkDevice device, uint32_t nBytes, const void *spirv)
-{
-    VkShaderModule module = nullptr;
-    VkShaderModuleCreateInfo info = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-    info.codeSize = nBytes;
-    info.pCode = static_cast<const uint32_t *>(spirv);
-    VERIFY_VK(vkCreateShaderModule(device, &info, ALLOC_CBS, &module));
-    return module;
-}
-
-template<unsigned WordCount> VkShaderModule
-CreateShaderModule(VkDevice device, const uint32_t(&a)[WordCount])
-{
-    return CreateShaderModule(device, WordCount * sizeof(uint32_t), a);
-}
-
-static VkShaderModule
-CreateShaderModuleFromFile(VkDevice device, const char *path)
-{
-    if (FILE *const fp = fopen(path, "rb")) {
-        long err = 0;
-        err |= fseek(fp, 0, SEEK_END);
-        long const size = ftell(fp);
-        err |= size;
-        err |= fseek(fp, 0, SEEK_SET);
-        if (err < 0) {
-            perror("fseek/ftell/fseek");
-            exit(int(err));
-        }
-        if (size > 0x7fffffff || size < 20 || (size & 3u)) {
-            printf("bad size = %ld\n", size);
-            exit(42);
-        }
-        void *const data = malloc(size);
-        if (fread(data, 1, size, fp) != size_t(size)) {
-            perror("fread");
-            exit(43);
-        }
-        VkShaderModule sm = CreateShaderModule(device, uint32_t(size), data);
-        free(data);
-        fclose(fp);
-        return sm;
-    } else {
-        fflush(stdout);
-        perror("fopen");
-        fprintf(stderr, "(path)=(%s)\n", path);
-        exit(1);
-    }
-}
-
 #define USE_STATIC_SHADERS
 #ifdef USE_STATIC_SHADERS
 /* NOTE: following made from custom spirv assembly:
@@ -254,15 +214,25 @@ static const Vertex Verts[] = {
 };
 
 
-// nullness of fs controls rasterizerDiscard and primitive topology:
+// nullness of fs controls rasterizerDiscard and primitive topology.
+// renderpass = VK_NULL_HANDLE is for dynamic rendering into one colorFormat target, or none if VK_FORMAT_UNDEFINED.
+// libraryParts: 0 for a complete pipeline, else the PipelineLibrary* parts to make a library of.
 static void
 CreateGraphicsPipeline(VkDevice device,
                        VkShaderModule vs, VkShaderModule fs,
-                       VkRenderPass renderpass, VkPipelineLayout pipelineLayout,
-                       VkPipeline *pPipline)
+                       VkRenderPass renderpass, VkFormat colorFormat, VkPipelineLayout pipelineLayout,
+                       VkPipeline *pPipline, uint32_t libraryParts)
 {
     VkGraphicsPipelineCreateInfo info = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
 
+    const VkPipelineRenderingCreateInfoKHR renderingInfo = {
+        VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR, nullptr,
+        0, // viewMask
+        colorFormat != VK_FORMAT_UNDEFINED ? 1u : 0u, &colorFormat,
+        VK_FORMAT_UNDEFINED, VK_FORMAT_UNDEFINED // depth, stencil
+    };
+    if (!renderpass) info.pNext = &renderingInfo;
+
     uint numStages = 0;
     VkPipelineShaderStageCreateInfo stages[4];
     auto PutStage = [&numStages, &stages](VkShaderStageFlagBits stageEnum, VkShaderModule sm) {
@@ -342,7 +312,29 @@ CreateGraphicsPipeline(VkDevice device,
     info.stageCount = numStages;
     info.pStages = stages;
 
-    VERIFY_VK(vkCreateGraphicsPipelines(device, VkPipelineCache(), 1, &info, ALLOC_CBS, pPipline));
+    if (libraryParts) {
+        VERIFY_VK(PipelineLibraryCreatePart(info, libraryParts, pPipline));
+    } else {
+        VERIFY_VK(ShaderCacheCreateGraphicsPipeline(info, pPipline));
+    }
+}
+
+struct GraphicsPipelineArgs {
+    VkDevice device;
+    VkShaderModule vs, fs;
+    VkRenderPass renderpass;
+    VkFormat colorFormat;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline *pPipeline;
+    uint32_t libraryParts;
+};
+
+static void
+BuildGraphicsPipelineJob(void *pArgs)
+{
+    GraphicsPipelineArgs const *const a = static_cast<const GraphicsPipelineArgs *>(pArgs);
+    CreateGraphicsPipeline(a->device, a->vs, a->fs, a->renderpass, a->colorFormat, a->pipelineLayout, a->pPipeline,
+                           a->libraryParts);
 }
 
 
@@ -393,7 +385,13 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
     }
 
     /* The counter doesn't really do anything in this test, but in most engines one is always provided in CmdEndXfb(),
-    so we do it too in case there are any sideffects to that. It is not loaded from here in CmdBeginXfb(): */
+    so we do it too in case there are any sideffects to that. It is not loaded from here in CmdBeginXfb().
+    With --xfb-indirect there is one counter per buffer, at 4 * buffer index, and each pass draws as many
+    vertices as the previous one wrote by reading its counter with vkCmdDrawIndirectByteCountEXT: */
+    bool const bIndirect = g_bXfbIndirect && vk.xfbProperties.transformFeedbackDraw;
+    if (g_bXfbIndirect && !bIndirect) {
+        puts("NOTE: --xfb-indirect given but transformFeedbackDraw is not supported, using vkCmdDraw.");
+    }
     VkuBufferAndMemory xfbCounter;
     vkuDedicatedBuffer(device, sizeof Verts,
             VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
@@ -417,8 +415,35 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
 
     // ------------------------------------------------------------
 
-    VkRenderPass renderpass;
+    VkImageView outputView;
     {
+        VkImageViewCreateInfo viewCreateInfo = {
+            VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            nullptr,
+            0, // VkImageViewCreateFlags
+            outputImag.image,
+            VK_IMAGE_VIEW_TYPE_2D,
+            Format,
+            VkComponentMapping(), // identity
+            { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 } // single mip, single layer
+        };
+        VERIFY_VK(vkCreateImageView(device, &viewCreateInfo, ALLOC_CBS, &outputView));
+    }
+
+    /*
+     * With --dynamic-rendering none of the render pass and framebuffer objects below are made and
+     * the passes are recorded with vkCmdBeginRenderingKHR, the pipelines get their attachment
+     * formats from VkPipelineRenderingCreateInfoKHR instead:
+     */
+    bool const bDynamicRendering = g_bDynamicRendering && vk.KHR_dynamic_rendering;
+    if (g_bDynamicRendering && !bDynamicRendering) {
+        puts("NOTE: --dynamic-rendering given but dynamicRendering is not supported, using render passes.");
+    }
+    uint64_t const objectsStartNs = BenchNowNs();
+
+    VkRenderPass renderpass = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    if (!bDynamicRendering) {
         VkAttachmentDescription attDesc = { };
         attDesc.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
         attDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
@@ -436,23 +461,7 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
             1, &attDesc, 1, &subpassDesc,
         };
         VERIFY_VK(vkCreateRenderPass(device, &renderpassInfo, ALLOC_CBS, &renderpass));
-    }
-    VkImageView outputView;
-    {
-        VkImageViewCreateInfo viewCreateInfo = {
-            VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-            nullptr,
-            0, // VkImageViewCreateFlags
-            outputImag.image,
-            VK_IMAGE_VIEW_TYPE_2D,
-            Format,
-            VkComponentMapping(), // identity
-            { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 } // single mip, single layer
-        };
-        VERIFY_VK(vkCreateImageView(device, &viewCreateInfo, ALLOC_CBS, &outputView));
-    }
-    VkFramebuffer framebuffer;
-    {
+
         VkFramebufferCreateInfo framebufferInfo = {
             VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO, nullptr, 0x0,
             renderpass,
@@ -468,8 +477,9 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
         vk.props2.properties.limits.maxFramebufferWidth,
         vk.props2.properties.limits.maxFramebufferHeight
     };
-    VkRenderPass emptyRenderpass;
-    {
+    VkRenderPass emptyRenderpass = VK_NULL_HANDLE;
+    VkFramebuffer emptyFramebuffer = VK_NULL_HANDLE;
+    if (!bDynamicRendering) {
         VkSubpassDescription subpassDesc = { };
         subpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
         VkRenderPassCreateInfo renderpassInfo = {
@@ -477,9 +487,7 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
             0, nullptr, 1, &subpassDesc,
         };
         VERIFY_VK(vkCreateRenderPass(device, &renderpassInfo, ALLOC_CBS, &emptyRenderpass));
-    }
-    VkFramebuffer emptyFramebuffer;
-    {
+
         VkFramebufferCreateInfo framebufferInfo = {
             VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO, nullptr, 0x0,
             emptyRenderpass,
@@ -488,10 +496,17 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
         };
         VERIFY_VK(vkCreateFramebuffer(device, &framebufferInfo, ALLOC_CBS, &emptyFramebuffer));
     }
+    uint64_t const objectsNs = BenchNowNs() - objectsStartNs;
     const VkRenderPassBeginInfo EmptyFramebufferBeginRenderpassInfo = {
         VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO, nullptr,
         emptyRenderpass, emptyFramebuffer, { {0,0}, EmptyFramebufferSize }
     };
+    const VkRenderingInfoKHR EmptyRenderingInfo = {
+        VK_STRUCTURE_TYPE_RENDERING_INFO_KHR, nullptr, 0x0,
+        { {0,0}, EmptyFramebufferSize },
+        1, 0, // layerCount, viewMask
+        0, nullptr, nullptr, nullptr // no attachments
+    };
 
     // ------------------------------------------------------------
 
@@ -506,36 +521,108 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
     VkShaderModule vs_xfb = VK_NULL_HANDLE;
     {
         uint32_t tmp[lengthof(VsXfbSpirv)];
-        memcpy(tmp, VsXfbSpirv, sizeof tmp);
+        SpirvModule m;
+        if (!SpirvInit(&m, tmp, lengthof(tmp), VsXfbSpirv, sizeof VsXfbSpirv)) {
+            puts("ERROR: VsXfbSpirv isn't valid SPIR-V");
+            abort();
+        }
         if (0) { // this doesn't seem to fix the issue:
             /* Can do this because rasterizerDiscard is enabled: */
             puts("Replacing 'OpDecorate %output BuiltIn Position' with 'OpDecorate %output Location 0'.");
-            tmp[0x00000068 / 4 + 2] = 30; // SpvDecorationLocation
-            tmp[0x00000068 / 4 + 3] = 0;
+            uint32_t const decoration = SpirvFindBuiltInDecoration(m, SpirvBuiltInPosition);
+            assert(decoration);
+            m.pWords[decoration + 2] = SpirvDecorationLocation;
+            m.pWords[decoration + 3] = 0;
         } else {
             // leave as: OpDecorate %gl_Position BuiltIn Position ; 0x00000068
             puts("Using variant with Postion as XFB output.");
         }
-        vs_xfb = CreateShaderModule(device, tmp);
+        VERIFY_VK(ShaderCacheAcquire(tmp, SpirvByteSize(m), &vs_xfb));
     }
-    VkShaderModule vs_plain = CreateShaderModule(device, VsPlainSpirv);
-    VkShaderModule fs = CreateShaderModule(device, FsSpirv);
-    (void)CreateShaderModuleFromFile;
+    VkShaderModule vs_plain, fs;
+    VERIFY_VK(ShaderCacheAcquire(VsPlainSpirv, &vs_plain));
+    VERIFY_VK(ShaderCacheAcquire(FsSpirv, &fs));
 #else
     puts("Using shaders from filesystem.");
-    VkShaderModule vs_xfb = CreateShaderModuleFromFile(device, "shaders/xfb/custom_vs_xfb.spv");
-    VkShaderModule vs_plain = CreateShaderModuleFromFile(device, "shaders/xfb/vs_plain.spv");
-    VkShaderModule fs = CreateShaderModuleFromFile(device, "shaders/xfb/fs.spv");
+    VkShaderModule vs_xfb, vs_plain, fs;
+    VERIFY_VK(ShaderCacheAcquireFile("shaders/xfb/custom_vs_xfb.spv", &vs_xfb));
+    VERIFY_VK(ShaderCacheAcquireFile("shaders/xfb/vs_plain.spv", &vs_plain));
+    VERIFY_VK(ShaderCacheAcquireFile("shaders/xfb/fs.spv", &fs));
 #endif
 
     VkPipeline pso_xfb = VK_NULL_HANDLE;
     VkPipeline pso_rast = VK_NULL_HANDLE;
-    CreateGraphicsPipeline(device, vs_xfb, VK_NULL_HANDLE, emptyRenderpass, pipelineLayout, &pso_xfb);
-    CreateGraphicsPipeline(device, vs_plain, fs, renderpass, pipelineLayout, &pso_rast);
+    {
+        GraphicsPipelineArgs psoArgs[2] = {
+            { device, vs_xfb, VK_NULL_HANDLE, emptyRenderpass, VK_FORMAT_UNDEFINED, pipelineLayout, &pso_xfb },
+            { device, vs_plain, fs, renderpass, Format, pipelineLayout, &pso_rast },
+        };
+        PipelineBatch batch;
+        PipelineBatchInit(&batch, "xfb_vb_pingpong");
+        PipelineBatchAdd(&batch, "xfb", BuildGraphicsPipelineJob, &psoArgs[0]);
+        PipelineBatchAdd(&batch, "rast", BuildGraphicsPipelineJob, &psoArgs[1]);
+        PipelineBatchBuild(&batch);
+
+        if (PipelineLibraryEnabled()) {
+            // The same two pipelines linked from parts. The xfb one has rasterizer discard so needs no fragment parts:
+            enum { ViPoints, ViStrip, PreRasterXfb, PreRasterPlain, Fragment, Output, NumParts };
+            VkPipeline parts[NumParts];
+            GraphicsPipelineArgs partArgs[NumParts] = {
+                { device, vs_xfb, VK_NULL_HANDLE, emptyRenderpass, VK_FORMAT_UNDEFINED, pipelineLayout, &parts[ViPoints], PipelineLibraryVertexInput },
+                { device, vs_plain, fs, renderpass, Format, pipelineLayout, &parts[ViStrip], PipelineLibraryVertexInput },
+                { device, vs_xfb, VK_NULL_HANDLE, emptyRenderpass, VK_FORMAT_UNDEFINED, pipelineLayout, &parts[PreRasterXfb], PipelineLibraryPreRaster },
+                { device, vs_plain, fs, renderpass, Format, pipelineLayout, &parts[PreRasterPlain], PipelineLibraryPreRaster },
+                { device, vs_plain, fs, renderpass, Format, pipelineLayout, &parts[Fragment], PipelineLibraryFragmentShader },
+                { device, vs_plain, fs, renderpass, Format, pipelineLayout, &parts[Output], PipelineLibraryFragmentOutput },
+            };
+            static const char *const PartNames[NumParts] = { "vi_points", "vi_strip", "pre_raster_xfb", "pre_raster_plain", "fragment", "output" };
+            PipelineBatch partBatch;
+            PipelineBatchInit(&partBatch, "xfb_vb_pingpong libraries");
+            for (int i = 0; i < NumParts; ++i) {
+                PipelineBatchAdd(&partBatch, PartNames[i], BuildGraphicsPipelineJob, &partArgs[i]);
+            }
+            PipelineBatchBuild(&partBatch);
+
+            const VkPipeline xfbParts[2] = { parts[ViPoints], parts[PreRasterXfb] };
+            const VkPipeline rastParts[4] = { parts[ViStrip], parts[PreRasterPlain], parts[Fragment], parts[Output] };
+            VkPipeline linked[4]; // [bOptimize * 2 + bRast]
+            PipelineLibraryLinkArgs linkArgs[4];
+            PipelineBatch linkBatches[2]; // [bOptimize]
+            for (int bOptimize = 0; bOptimize < 2; ++bOptimize) {
+                PipelineBatchInit(&linkBatches[bOptimize], bOptimize ? "xfb_vb_pingpong optimized links" : "xfb_vb_pingpong links");
+                linkArgs[bOptimize * 2 + 0] = { xfbParts, 2, pipelineLayout, bOptimize != 0, &linked[bOptimize * 2 + 0] };
+                linkArgs[bOptimize * 2 + 1] = { rastParts, 4, pipelineLayout, bOptimize != 0, &linked[bOptimize * 2 + 1] };
+                PipelineBatchAdd(&linkBatches[bOptimize], "xfb", PipelineLibraryLinkJob, &linkArgs[bOptimize * 2 + 0]);
+                PipelineBatchAdd(&linkBatches[bOptimize], "rast", PipelineLibraryLinkJob, &linkArgs[bOptimize * 2 + 1]);
+                PipelineBatchBuild(&linkBatches[bOptimize]);
+            }
+            PipelineLibraryReport("xfb_vb_pingpong", batch, partBatch, linkBatches[0], linkBatches[1]);
+
+            // Draw with the optimized links, the rest was only built to be timed:
+            vkDestroyPipeline(device, pso_xfb, ALLOC_CBS);
+            vkDestroyPipeline(device, pso_rast, ALLOC_CBS);
+            pso_xfb = linked[2];
+            pso_rast = linked[3];
+            vkDestroyPipeline(device, linked[0], ALLOC_CBS);
+            vkDestroyPipeline(device, linked[1], ALLOC_CBS);
+            for (VkPipeline part : parts) vkDestroyPipeline(device, part, ALLOC_CBS);
+        }
+    }
+
+    // GPU time of the XFB loop, to compare what the driver does for its passes with and without render pass objects:
+    bool const bTimestamps = vk.props2.properties.limits.timestampComputeAndGraphics != VK_FALSE;
+    VkQueryPool timestampPool = VK_NULL_HANDLE;
+    if (bTimestamps) {
+        VkQueryPoolCreateInfo info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        info.queryCount = 2;
+        VERIFY_VK(vkCreateQueryPool(device, &info, ALLOC_CBS, &timestampPool));
+    }
 
     const VkRect2D RenderArea = {
         { 0, 0 }, { ImageSize.width, ImageSize.height }
     };
+    uint64_t const recordStartNs = BenchNowNs();
     // begin cmdbuf:
     {
         const VkCommandBufferBeginInfo cmdBufbeginInfo = {
@@ -543,6 +630,7 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
             VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr
         };
         VERIFY_VK(vkBeginCommandBuffer(cmdbuf, &cmdBufbeginInfo));
+        if (bTimestamps) vkCmdResetQueryPool(cmdbuf, timestampPool, 0, 2);
         VkViewport vp;
         vkuUpwardsViewportFromRect(RenderArea, 0, 1, &vp);
         vkCmdSetViewport(cmdbuf, 0, 1, &vp);
@@ -563,7 +651,18 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
     auto CmdGlobalBarrier = [cmdbuf, &barrier](VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages) {
         vkCmdPipelineBarrier(cmdbuf, srcStages, dstStages, 0x0, 1, &barrier, 0, nullptr, 0 , nullptr);
     };
+    // Only the first pass's count comes from the CPU with --xfb-indirect:
+    VkPipelineStageFlags const indirectStage = bIndirect ? VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT : 0;
+    VkAccessFlags const indirectAccess = bIndirect ? VK_ACCESS_INDIRECT_COMMAND_READ_BIT : 0;
+    if (bIndirect) {
+        uint32_t const initialBytes = sizeof Verts;
+        vkCmdUpdateBuffer(cmdbuf, xfbCounter.buffer, 0, sizeof initialBytes, &initialBytes);
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        CmdGlobalBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+    }
     vkuCmdLabel(vkCmdBeginDebugUtilsLabelEXT, cmdbuf, "XFB loop", 0xff0000ffu);
+    if (bTimestamps) vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, 0);
     vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pso_xfb);
     vkCmdBindVertexBuffers(cmdbuf, 0, 1, &buffers[1].buffer, ZeroOffsets);
 
@@ -572,17 +671,17 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
             if (bSingleBarrierCall) {
                 barrier.srcAccessMask = VK_ACCESS_TRANSFORM_FEEDBACK_WRITE_BIT_EXT | VK_ACCESS_TRANSFORM_FEEDBACK_COUNTER_WRITE_BIT_EXT;
                 barrier.dstAccessMask = VK_ACCESS_TRANSFORM_FEEDBACK_WRITE_BIT_EXT | VK_ACCESS_TRANSFORM_FEEDBACK_COUNTER_WRITE_BIT_EXT |
-                                        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+                                        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | indirectAccess;
                 /* I think VK_PIPELINE_STAGE_VERTEX_INPUT_BIT in src stages should not be necessary in conjunction with XFB
                 in src stages since XFB is a later stage, but it's here for good measure if configured: */
                 CmdGlobalBarrier(VK_PIPELINE_STAGE_TRANSFORM_FEEDBACK_BIT_EXT | (bMinimalSrcStageMask ? 0 : VK_PIPELINE_STAGE_VERTEX_INPUT_BIT),
-                                 VK_PIPELINE_STAGE_TRANSFORM_FEEDBACK_BIT_EXT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+                                 VK_PIPELINE_STAGE_TRANSFORM_FEEDBACK_BIT_EXT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | indirectStage);
             } else {
-                /* XfbWrite -> VertexRead: */
-                barrier.srcAccessMask = VK_ACCESS_TRANSFORM_FEEDBACK_WRITE_BIT_EXT;
-                barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+                /* XfbWrite -> VertexRead, and CounterWrite -> IndirectRead with --xfb-indirect: */
+                barrier.srcAccessMask = VK_ACCESS_TRANSFORM_FEEDBACK_WRITE_BIT_EXT | (bIndirect ? VK_ACCESS_TRANSFORM_FEEDBACK_COUNTER_WRITE_BIT_EXT : 0);
+                barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | indirectAccess;
                 CmdGlobalBarrier(VK_PIPELINE_STAGE_TRANSFORM_FEEDBACK_BIT_EXT,
-                                 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+                                 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | indirectStage);
                 /* VertexRead -> XfbWrite. Execution only, no access mask (note a WAR with image layout transation
                 * would need nonzero dstAccessMask since layout transition is considered a write operation). */
                 barrier.srcAccessMask = 0;
@@ -596,20 +695,36 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
                                  VK_PIPELINE_STAGE_TRANSFORM_FEEDBACK_BIT_EXT);
             }
         }
-        vkCmdBeginRenderPass(cmdbuf, &EmptyFramebufferBeginRenderpassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        if (bDynamicRendering) {
+            vkCmdBeginRenderingKHR(cmdbuf, &EmptyRenderingInfo);
+        } else {
+            vkCmdBeginRenderPass(cmdbuf, &EmptyFramebufferBeginRenderpassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        }
         vkCmdBindVertexBuffers(cmdbuf, 0, 1, &buffers[i & 1].buffer, ZeroOffsets);
         vkCmdBindTransformFeedbackBuffersEXT(cmdbuf, 0, 1, &buffers[(i & 1) ^ 1].buffer, ZeroOffsets, WholeSizes);
         vkCmdBeginTransformFeedbackEXT(cmdbuf, 0, 1, nullptr, nullptr); // don't load from counters to add onto offset
-        vkCmdDraw(cmdbuf, 5, 1, 0, 0);
-        vkCmdEndTransformFeedbackEXT(cmdbuf, 0, 1, &xfbCounter.buffer, ZeroOffsets);
-        vkCmdEndRenderPass(cmdbuf);
+        if (bIndirect) {
+            // Read the counter of the buffer being drawn, write the one of the buffer being captured to:
+            vkCmdDrawIndirectByteCountEXT(cmdbuf, 1, 0, xfbCounter.buffer, 4 * (i & 1), 0, sizeof(Vertex));
+            const VkDeviceSize counterOffset = 4 * ((i & 1) ^ 1);
+            vkCmdEndTransformFeedbackEXT(cmdbuf, 0, 1, &xfbCounter.buffer, &counterOffset);
+        } else {
+            vkCmdDraw(cmdbuf, 5, 1, 0, 0);
+            vkCmdEndTransformFeedbackEXT(cmdbuf, 0, 1, &xfbCounter.buffer, ZeroOffsets);
+        }
+        if (bDynamicRendering) {
+            vkCmdEndRenderingKHR(cmdbuf);
+        } else {
+            vkCmdEndRenderPass(cmdbuf);
+        }
     }
+    if (bTimestamps) vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, 1);
     vkCmdEndDebugUtilsLabelEXT(cmdbuf);
     VkBuffer const lastXfbTargetBuffer = buffers[NumIters & 1].buffer;
-    barrier.srcAccessMask = VK_ACCESS_TRANSFORM_FEEDBACK_WRITE_BIT_EXT;
-    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFORM_FEEDBACK_WRITE_BIT_EXT | (bIndirect ? VK_ACCESS_TRANSFORM_FEEDBACK_COUNTER_WRITE_BIT_EXT : 0);
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | indirectAccess;
     vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFORM_FEEDBACK_BIT_EXT,
-                                 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0x0,
+                                 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | indirectStage, 0x0,
                          1, &barrier, 0, nullptr, 0 , nullptr);
     // done later: vkCmdBindVertexBuffers(cmdbuf, 0, 1, &lastXfbTargetBuffer, ZeroOffsets);
 
@@ -627,11 +742,26 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
     vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0x0,
                          0, nullptr, 0, nullptr, 1, &imageBarrier);
 
-    const VkRenderPassBeginInfo rpBeginInfo = {
-        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO, nullptr,
-        renderpass, framebuffer, RenderArea
-    };
-    vkCmdBeginRenderPass(cmdbuf, &rpBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    if (bDynamicRendering) {
+        VkRenderingAttachmentInfoKHR colorAttachment = { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR };
+        colorAttachment.imageView = outputView;
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        const VkRenderingInfoKHR renderingInfo = {
+            VK_STRUCTURE_TYPE_RENDERING_INFO_KHR, nullptr, 0x0,
+            RenderArea,
+            1, 0, // layerCount, viewMask
+            1, &colorAttachment, nullptr, nullptr
+        };
+        vkCmdBeginRenderingKHR(cmdbuf, &renderingInfo);
+    } else {
+        const VkRenderPassBeginInfo rpBeginInfo = {
+            VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO, nullptr,
+            renderpass, framebuffer, RenderArea
+        };
+        vkCmdBeginRenderPass(cmdbuf, &rpBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
     {
         VkClearAttachment attClear = {
             VK_IMAGE_ASPECT_COLOR_BIT,
@@ -642,9 +772,17 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
         vkCmdClearAttachments(cmdbuf, 1, &attClear, 1, &clearRect);
         vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pso_rast);
         vkCmdBindVertexBuffers(cmdbuf, 0, 1, &lastXfbTargetBuffer, ZeroOffsets);
-        vkCmdDraw(cmdbuf, 5, 1, 0, 0);
+        if (bIndirect) {
+            vkCmdDrawIndirectByteCountEXT(cmdbuf, 1, 0, xfbCounter.buffer, 4 * (NumIters & 1), 0, sizeof(Vertex));
+        } else {
+            vkCmdDraw(cmdbuf, 5, 1, 0, 0);
+        }
+    }
+    if (bDynamicRendering) {
+        vkCmdEndRenderingKHR(cmdbuf);
+    } else {
+        vkCmdEndRenderPass(cmdbuf);
     }
-    vkCmdEndRenderPass(cmdbuf);
 
     imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
     imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
@@ -687,6 +825,7 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
                              1, &dev2hostBarrier, 0, nullptr, 0 , nullptr);
         VERIFY_VK(vkEndCommandBuffer(cmdbuf));
     }
+    uint64_t const recordNs = BenchNowNs() - recordStartNs;
 
     // submit:
     void *pMap = nullptr;
@@ -702,6 +841,17 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
         vkInvalidateMappedMemoryRanges(device, 1, &range);
     }
 
+    printf("%s, %s: pass objects created in %.3f ms, recorded in %.3f ms",
+           bDynamicRendering ? "Dynamic rendering" : "Render passes", bIndirect ? "indirect byte count draws" : "direct draws",
+           objectsNs * 1e-6, recordNs * 1e-6);
+    if (bTimestamps) {
+        uint64_t ticks[2];
+        VERIFY_VK(vkGetQueryPoolResults(device, timestampPool, 0, 2, sizeof ticks, ticks, sizeof(uint64_t),
+                                        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        printf(", XFB loop took %.2f us on the GPU", double(ticks[1] - ticks[0]) * vk.props2.properties.limits.timestampPeriod * 1e-3);
+    }
+    puts("");
+
     bool failed = false;
     {
         const Vertex *const data = (const Vertex *)((const char *)pMap + PackedImageByteSize);
@@ -722,15 +872,44 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
                     v.z);
             }
         }
+
+        // The rotated xy too, which the z and w checks above don't see:
+        XfbReferenceVerifyDesc refDesc = { };
+        refDesc.pInput = &Verts[0].x;
+        refDesc.pGot = &data[0].x;
+        refDesc.numVerts = lengthof(Verts);
+        refDesc.numPasses = NumIters;
+        refDesc.maxUlp = XfbReferenceDefaultMaxUlp(NumIters);
+        XfbReferenceResult refResult;
+        XfbReferenceVerify(refDesc, &refResult);
+        if (refResult.numMismatches) {
+            PrintXfbReferenceResult("BAD OUTPUT", refDesc, refResult);
+            failed = true;
+        }
+    }
+
+    {
+        const ResultArchiveAddDesc imageDesc = {
+            "xfb_vb_pingpong", "image", Format, ImageSize.width, ImageSize.height, 1,
+            sizeof(uint32_t), (const unsigned char *)pMap + 0*PackedImageByteSize, ImageSize.width*sizeof(uint32_t), failed
+        };
+        ResultArchiveAdd(imageDesc);
+        const ResultArchiveAddDesc vertexDesc = {
+            "xfb_vb_pingpong", "vertices", VK_FORMAT_R32G32B32A32_SFLOAT, lengthof(Verts), 1, 1,
+            sizeof(Vertex), (const char *)pMap + PackedImageByteSize, lengthof(Verts) * sizeof(Vertex), failed
+        };
+        ResultArchiveAdd(vertexDesc);
     }
 
     if (failed) {
         puts("\n *** Test FAILED ***");
-        if (g_bSaveFailingImages) {
+        if (ResultArchiveIsOpen()) {
+            puts("Output image and vertices are archived as xfb_vb_pingpong/image and xfb_vb_pingpong/vertices");
+        } else if (g_bSaveFailingImages) {
             const char *relName = "xfb_output.png";
             char cwdbuf[4096];
             printf("Writing (file)=(%s) from (cwd)=(%s)\n", relName, GetCwd(cwdbuf, sizeof cwdbuf));
-            stbi_write_png(relName, ImageSize.width, ImageSize.height, 4,
+            ArtifactWritePng(relName, ImageSize.width, ImageSize.height, 4,
                         (const unsigned char *)pMap + 0*PackedImageByteSize, ImageSize.width*sizeof(uint32_t));
         } else {
             puts("Not saving output image, pass --save-failing-images if desired.");
@@ -741,6 +920,7 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
     vkDestroyPipeline(device, pso_xfb, ALLOC_CBS);
     vkDestroyPipeline(device, pso_rast, ALLOC_CBS);
     vkDestroyPipelineLayout(device, pipelineLayout, ALLOC_CBS);
+    vkDestroyQueryPool(device, timestampPool, ALLOC_CBS);
     vkFreeCommandBuffers(device, cmdpool, 1, &cmdbuf);
     vkDestroyCommandPool(device, cmdpool, ALLOC_CBS);
     vkDestroyImageView(device, outputView, ALLOC_CBS);
@@ -753,9 +933,9 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
     vkuDestroyBufferAndFreeMemory(device, xfbCounter);
     for (auto& r : buffers) vkuDestroyBufferAndFreeMemory(device, r);
 
-    vkDestroyShaderModule(device, vs_xfb, ALLOC_CBS);
-    vkDestroyShaderModule(device, vs_plain, ALLOC_CBS);
-    vkDestroyShaderModule(device, fs, ALLOC_CBS);
+    ShaderCacheRelease(vs_xfb);
+    ShaderCacheRelease(vs_plain);
+    ShaderCacheRelease(fs);
 
     fflush(stderr);
     printf("Leaving function %s\n", __FUNCTION__);
@@ -763,6 +943,317 @@ bool TestXfbPingPong(const VulkanObjetcs& vk)
     return !failed;
 }
 
+/*
+ * The ping-pong loop of TestXfbPingPong with many vertices, timed for each way of writing its
+ * barriers: one barrier call with or without VERTEX_INPUT in the source stages, or the three
+ * separate barriers, each with no counter buffer in vkCmdEndTransformFeedbackEXT, with one that
+ * is only written, and with each iteration drawn by vkCmdDrawIndirectByteCountEXT from the counter
+ * the previous one wrote, so that the whole chain runs without a CPU-provided vertex count.
+ * Every vertex is read once and written once per iteration, so bytes per second counts both.
+ * The first buffer starts as random vertices for each config, and every vertex of the result is
+ * checked against the CPU reference of the shader, whose time is printed next to the GPU time.
+ */
+bool TestXfbBench(const VulkanObjetcs& vk)
+{
+    VkDevice const device = vk.device;
+    if (!vk.xfbFeatures.transformFeedback) {
+        puts("ERROR: transformFeedback is not supported.");
+        return false;
+    }
+    if (!vk.props2.properties.limits.timestampComputeAndGraphics) {
+        puts("ERROR: timestamps are not supported.");
+        return false;
+    }
+    double const nsPerTick = vk.props2.properties.limits.timestampPeriod;
+
+    uint32_t numVerts = g_xfbBenchVertices;
+    uint32_t const numIters = g_xfbBenchIters;
+    {
+        // One draw writes the whole buffer:
+        VkDeviceSize const maxBytes = vk.xfbProperties.maxTransformFeedbackBufferSize < vk.xfbProperties.maxTransformFeedbackBufferDataSize ?
+                                      vk.xfbProperties.maxTransformFeedbackBufferSize : vk.xfbProperties.maxTransformFeedbackBufferDataSize;
+        if (VkDeviceSize(numVerts) * sizeof(Vertex) > maxBytes) {
+            numVerts = uint32_t(maxBytes / sizeof(Vertex));
+            printf("NOTE: XFB buffers are limited to %llu bytes, using %u vertices.\n", (unsigned long long)maxBytes, numVerts);
+        }
+    }
+    if (numVerts == 0 || numIters == 0) {
+        puts("ERROR: --xfb-verts and --xfb-iters must be nonzero.");
+        return false;
+    }
+    VkDeviceSize const bufferBytes = VkDeviceSize(numVerts) * sizeof(Vertex);
+
+    enum BarrierStrategy { SingleWithVertexInput, SingleMinimal, Split, NumStrategies };
+    static const char *const StrategyNames[NumStrategies] = {
+        "single barrier, VERTEX_INPUT in src", "single barrier, XFB src only", "3 barriers"
+    };
+    enum CounterMode { NoCounter, CounterWritten, CounterIndirect, NumCounterModes };
+    static const char *const CounterModeNames[NumCounterModes] = { "no", "yes", "indirect" };
+    enum { NumConfigs = NumStrategies * NumCounterModes }; // [strategy * NumCounterModes + counterMode]
+    // The byte count is a uint32_t in the counter:
+    bool const bIndirectSupported = vk.xfbProperties.transformFeedbackDraw && bufferBytes <= UINT32_MAX;
+    if (!bIndirectSupported) {
+        puts("NOTE: skipping the indirect configs, transformFeedbackDraw is not supported or the buffers are too big.");
+    }
+
+    VkCommandPool cmdpool = VK_NULL_HANDLE;
+    VkCommandBuffer cmdbuf = VK_NULL_HANDLE;
+    {
+        const VkCommandPoolCreateInfo cmdPoolInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr,
+            0, // flags
+            vk.universalFamilyIndex
+        };
+        VERIFY_VK(vkCreateCommandPool(device, &cmdPoolInfo, ALLOC_CBS, &cmdpool));
+
+        const VkCommandBufferAllocateInfo cmdBufAllocInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr, cmdpool,
+            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            1 // commandBufferCount
+        };
+        VERIFY_VK(vkAllocateCommandBuffers(device, &cmdBufAllocInfo, &cmdbuf));
+    }
+
+    VkuBufferAndMemory buffers[2];
+    for (VkuBufferAndMemory& r : buffers) {
+        VERIFY_VK(vkuDedicatedBuffer(device, bufferBytes,
+                    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFORM_FEEDBACK_BUFFER_BIT_EXT,
+                &r, vk.memProps, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+    }
+    VkuBufferAndMemory xfbCounter;
+    VERIFY_VK(vkuDedicatedBuffer(device, 16, // counters at 0 and 4, one per buffer
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFORM_FEEDBACK_COUNTER_BUFFER_BIT_EXT,
+        &xfbCounter, vk.memProps, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+    VkuStagingBuffer input, readback;
+    VERIFY_VK(vkuStagingBuffer(device, bufferBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &input, vk.memProps));
+    VERIFY_VK(vkuStagingBuffer(device, bufferBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT, &readback, vk.memProps));
+    {
+        // x and y in [-1, 1), z in [0, 1), the same every run:
+        Vertex *const v = static_cast<Vertex *>(input.pHost);
+        uint32_t seed = 1;
+        auto NextUnorm = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) * (1.0f / 16777216.0f); };
+        for (uint32_t i = 0; i < numVerts; ++i) {
+            v[i].x = NextUnorm() * 2.0f - 1.0f;
+            v[i].y = NextUnorm() * 2.0f - 1.0f;
+            v[i].z = NextUnorm();
+            v[i].w = 1.0f;
+        }
+        vkuFlushStagingBuffer(device, input);
+    }
+
+    bool const bDynamicRendering = g_bDynamicRendering && vk.KHR_dynamic_rendering;
+    const VkExtent2D EmptyFramebufferSize = {
+        vk.props2.properties.limits.maxFramebufferWidth,
+        vk.props2.properties.limits.maxFramebufferHeight
+    };
+    VkRenderPass emptyRenderpass = VK_NULL_HANDLE;
+    VkFramebuffer emptyFramebuffer = VK_NULL_HANDLE;
+    if (!bDynamicRendering) {
+        VkSubpassDescription subpassDesc = { };
+        subpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        VkRenderPassCreateInfo renderpassInfo = {
+            VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO, nullptr, 0x0,
+            0, nullptr, 1, &subpassDesc,
+        };
+        VERIFY_VK(vkCreateRenderPass(device, &renderpassInfo, ALLOC_CBS, &emptyRenderpass));
+
+        VkFramebufferCreateInfo framebufferInfo = {
+            VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO, nullptr, 0x0,
+            emptyRenderpass,
+            0, nullptr,
+            EmptyFramebufferSize.width, EmptyFramebufferSize.height, 1
+        };
+        VERIFY_VK(vkCreateFramebuffer(device, &framebufferInfo, ALLOC_CBS, &emptyFramebuffer));
+    }
+    const VkRenderPassBeginInfo EmptyFramebufferBeginRenderpassInfo = {
+        VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO, nullptr,
+        emptyRenderpass, emptyFramebuffer, { {0,0}, EmptyFramebufferSize }
+    };
+    const VkRenderingInfoKHR EmptyRenderingInfo = {
+        VK_STRUCTURE_TYPE_RENDERING_INFO_KHR, nullptr, 0x0,
+        { {0,0}, EmptyFramebufferSize },
+        1, 0, // layerCount, viewMask
+        0, nullptr, nullptr, nullptr // no attachments
+    };
+
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    {
+        VkPipelineLayoutCreateInfo info = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        VERIFY_VK(vkCreatePipelineLayout(device, &info, ALLOC_CBS, &pipelineLayout));
+    }
+    VkShaderModule vs_xfb;
+#ifdef USE_STATIC_SHADERS
+    VERIFY_VK(ShaderCacheAcquire(VsXfbSpirv, &vs_xfb));
+#else
+    VERIFY_VK(ShaderCacheAcquireFile("shaders/xfb/custom_vs_xfb.spv", &vs_xfb));
+#endif
+    VkPipeline pso_xfb = VK_NULL_HANDLE;
+    CreateGraphicsPipeline(device, vs_xfb, VK_NULL_HANDLE, emptyRenderpass, VK_FORMAT_UNDEFINED, pipelineLayout, &pso_xfb, 0);
+
+    VkQueryPool timestampPool = VK_NULL_HANDLE;
+    {
+        VkQueryPoolCreateInfo info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        info.queryCount = NumConfigs * 2;
+        VERIFY_VK(vkCreateQueryPool(device, &info, ALLOC_CBS, &timestampPool));
+    }
+
+    static const VkDeviceSize WholeSizes[1] = { VK_WHOLE_SIZE };
+    static const VkDeviceSize ZeroOffsets[1] = { 0 };
+    VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, 0, 0 };
+    auto CmdGlobalBarrier = [cmdbuf, &barrier](VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages) {
+        vkCmdPipelineBarrier(cmdbuf, srcStages, dstStages, 0x0, 1, &barrier, 0, nullptr, 0 , nullptr);
+    };
+
+    double const bytesPerIter = double(bufferBytes) * 2; // read + write
+    XfbReferenceVerifyDesc refDesc = { };
+    refDesc.pInput = static_cast<const float *>(input.pHost);
+    refDesc.pGot = static_cast<const float *>(readback.pHost);
+    refDesc.numVerts = numVerts;
+    refDesc.numPasses = numIters;
+    refDesc.maxUlp = XfbReferenceDefaultMaxUlp(numIters);
+
+    printf("%u vertices (%.1f MiB per buffer), %u iterations%s, verified with the %s CPU reference:\n",
+           numVerts, bufferBytes / 1048576.0, numIters, bDynamicRendering ? ", dynamic rendering" : "", XfbReferenceKernelName());
+    printf("  %-38s %8s %10s %12s %10s %10s\n", "barriers", "counter", "GPU ms", "Mverts/s", "GB/s", "verify ms");
+    bool failed = false;
+    // One submit per config, so that each result can be read back whole and checked:
+    for (uint32_t config = 0; config < NumConfigs; ++config) {
+        BarrierStrategy const strategy = BarrierStrategy(config / NumCounterModes);
+        CounterMode const counterMode = CounterMode(config % NumCounterModes);
+        bool const bIndirect = counterMode == CounterIndirect;
+        if (bIndirect && !bIndirectSupported) {
+            printf("  %-38s %8s %10s\n", StrategyNames[strategy], CounterModeNames[counterMode], "n/a");
+            continue;
+        }
+        VkPipelineStageFlags const indirectStage = bIndirect ? VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT : 0;
+        VkAccessFlags const indirectAccess = bIndirect ? VK_ACCESS_INDIRECT_COMMAND_READ_BIT : 0;
+
+        const VkCommandBufferBeginInfo cmdBufbeginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr
+        };
+        VERIFY_VK(vkBeginCommandBuffer(cmdbuf, &cmdBufbeginInfo));
+        vkCmdResetQueryPool(cmdbuf, timestampPool, config * 2, 2);
+        const VkRect2D RenderArea = { { 0, 0 }, { 256, 256 } };
+        VkViewport vp;
+        vkuUpwardsViewportFromRect(RenderArea, 0, 1, &vp);
+        vkCmdSetViewport(cmdbuf, 0, 1, &vp);
+        vkCmdSetScissor(cmdbuf, 0, 1, &RenderArea);
+        vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pso_xfb);
+
+        // Start from the random vertices, the previous submit is done with the buffers:
+        const VkBufferCopy inputRegion = { 0, 0, bufferBytes };
+        vkCmdCopyBuffer(cmdbuf, input.buffer, buffers[0].buffer, 1, &inputRegion);
+        if (bIndirect) {
+            // The first draw reads this, the rest read what the previous iteration wrote:
+            uint32_t const initialBytes = uint32_t(bufferBytes);
+            vkCmdUpdateBuffer(cmdbuf, xfbCounter.buffer, 0, sizeof initialBytes, &initialBytes);
+        }
+        // The begin timestamp waits on the copies too, else the sample includes them:
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | indirectAccess;
+        CmdGlobalBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+        vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, config * 2);
+        for (uint32_t i = 0; i < numIters; ++i) {
+            if (i != 0) {
+                if (strategy != Split) {
+                    barrier.srcAccessMask = VK_ACCESS_TRANSFORM_FEEDBACK_WRITE_BIT_EXT | VK_ACCESS_TRANSFORM_FEEDBACK_COUNTER_WRITE_BIT_EXT;
+                    barrier.dstAccessMask = VK_ACCESS_TRANSFORM_FEEDBACK_WRITE_BIT_EXT | VK_ACCESS_TRANSFORM_FEEDBACK_COUNTER_WRITE_BIT_EXT |
+                                            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | indirectAccess;
+                    CmdGlobalBarrier(VK_PIPELINE_STAGE_TRANSFORM_FEEDBACK_BIT_EXT |
+                                     (strategy == SingleMinimal ? 0 : VK_PIPELINE_STAGE_VERTEX_INPUT_BIT),
+                                     VK_PIPELINE_STAGE_TRANSFORM_FEEDBACK_BIT_EXT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | indirectStage);
+                } else {
+                    barrier.srcAccessMask = VK_ACCESS_TRANSFORM_FEEDBACK_WRITE_BIT_EXT | (bIndirect ? VK_ACCESS_TRANSFORM_FEEDBACK_COUNTER_WRITE_BIT_EXT : 0);
+                    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | indirectAccess;
+                    CmdGlobalBarrier(VK_PIPELINE_STAGE_TRANSFORM_FEEDBACK_BIT_EXT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | indirectStage);
+                    barrier.srcAccessMask = 0;
+                    barrier.dstAccessMask = 0;
+                    CmdGlobalBarrier(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFORM_FEEDBACK_BIT_EXT);
+                    barrier.srcAccessMask = VK_ACCESS_TRANSFORM_FEEDBACK_COUNTER_WRITE_BIT_EXT;
+                    barrier.dstAccessMask = VK_ACCESS_TRANSFORM_FEEDBACK_COUNTER_WRITE_BIT_EXT;
+                    CmdGlobalBarrier(VK_PIPELINE_STAGE_TRANSFORM_FEEDBACK_BIT_EXT, VK_PIPELINE_STAGE_TRANSFORM_FEEDBACK_BIT_EXT);
+                }
+            }
+            if (bDynamicRendering) {
+                vkCmdBeginRenderingKHR(cmdbuf, &EmptyRenderingInfo);
+            } else {
+                vkCmdBeginRenderPass(cmdbuf, &EmptyFramebufferBeginRenderpassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            }
+            vkCmdBindVertexBuffers(cmdbuf, 0, 1, &buffers[i & 1].buffer, ZeroOffsets);
+            vkCmdBindTransformFeedbackBuffersEXT(cmdbuf, 0, 1, &buffers[(i & 1) ^ 1].buffer, ZeroOffsets, WholeSizes);
+            vkCmdBeginTransformFeedbackEXT(cmdbuf, 0, 1, nullptr, nullptr);
+            if (bIndirect) {
+                vkCmdDrawIndirectByteCountEXT(cmdbuf, 1, 0, xfbCounter.buffer, 4 * (i & 1), 0, sizeof(Vertex));
+                const VkDeviceSize counterOffset = 4 * ((i & 1) ^ 1);
+                vkCmdEndTransformFeedbackEXT(cmdbuf, 0, 1, &xfbCounter.buffer, &counterOffset);
+            } else {
+                vkCmdDraw(cmdbuf, numVerts, 1, 0, 0);
+                vkCmdEndTransformFeedbackEXT(cmdbuf, 0, counterMode != NoCounter ? 1 : 0,
+                                             counterMode != NoCounter ? &xfbCounter.buffer : nullptr, ZeroOffsets);
+            }
+            if (bDynamicRendering) {
+                vkCmdEndRenderingKHR(cmdbuf);
+            } else {
+                vkCmdEndRenderPass(cmdbuf);
+            }
+        }
+        vkCmdWriteTimestamp(cmdbuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, config * 2 + 1);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFORM_FEEDBACK_WRITE_BIT_EXT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        CmdGlobalBarrier(VK_PIPELINE_STAGE_TRANSFORM_FEEDBACK_BIT_EXT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        const VkBufferCopy outputRegion = { 0, 0, bufferBytes };
+        vkCmdCopyBuffer(cmdbuf, buffers[numIters & 1].buffer, readback.buffer, 1, &outputRegion);
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        CmdGlobalBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+        VERIFY_VK(vkEndCommandBuffer(cmdbuf));
+
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmdbuf;
+        VERIFY_VK(vkQueueSubmit(vk.universalQueue, 1, &submitInfo, VK_NULL_HANDLE));
+        VERIFY_VK(vkQueueWaitIdle(vk.universalQueue));
+        VERIFY_VK(vkResetCommandPool(device, cmdpool, 0x0));
+        vkuInvalidateStagingBuffer(device, readback);
+
+        uint64_t ticks[2];
+        VERIFY_VK(vkGetQueryPoolResults(device, timestampPool, config * 2, 2, sizeof ticks, ticks, sizeof(uint64_t),
+                                        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        uint64_t const verifyStartNs = BenchNowNs();
+        XfbReferenceResult refResult;
+        XfbReferenceVerify(refDesc, &refResult);
+        uint64_t const verifyNs = BenchNowNs() - verifyStartNs;
+
+        double const seconds = double(ticks[1] - ticks[0]) * nsPerTick * 1e-9;
+        double const perSecond = seconds > 0.0 ? 1.0 / seconds : 0.0;
+        printf("  %-38s %8s %10.3f %12.1f %10.2f %10.2f\n", StrategyNames[strategy], CounterModeNames[counterMode], seconds * 1e3,
+               double(numVerts) * numIters * perSecond * 1e-6, bytesPerIter * numIters * perSecond * 1e-9, verifyNs * 1e-6);
+        if (refResult.numMismatches) {
+            PrintXfbReferenceResult("BAD OUTPUT", refDesc, refResult);
+            failed = true;
+        }
+    }
+
+    vkDestroyQueryPool(device, timestampPool, ALLOC_CBS);
+    vkDestroyPipeline(device, pso_xfb, ALLOC_CBS);
+    ShaderCacheRelease(vs_xfb);
+    vkDestroyPipelineLayout(device, pipelineLayout, ALLOC_CBS);
+    vkDestroyFramebuffer(device, emptyFramebuffer, ALLOC_CBS);
+    vkDestroyRenderPass(device, emptyRenderpass, ALLOC_CBS);
+    vkuDestroyStagingBuffer(device, readback);
+    vkuDestroyStagingBuffer(device, input);
+    vkuDestroyBufferAndFreeMemory(device, xfbCounter);
+    for (auto& r : buffers) vkuDestroyBufferAndFreeMemory(device, r);
+    vkFreeCommandBuffers(device, cmdpool, 1, &cmdbuf);
+    vkDestroyCommandPool(device, cmdpool, ALLOC_CBS);
+    return !failed;
+}
+
 /*
 Passes:
 $ vulkaninfo | grep -A 5 VkPhysicalDeviceDriverProperties
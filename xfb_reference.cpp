@@ -0,0 +1,281 @@
+#include "xfb_reference.h"
+#include "image_compare.h"
+#include "thread_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define XFB_REFERENCE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define XFB_REFERENCE_NEON 1
+#include <arm_neon.h>
+#endif
+
+// The shader's constants, bit for bit: cos(pi/16), sin(pi/16) and the z step of 1/32.
+static const uint32_t CosThetaBits = 0x3F7B14BEu;
+static const uint32_t SinThetaBits = 0x3E47C5C2u;
+static const uint32_t ZStepBits = 0x3D000000u;
+
+static inline float
+FloatFromBits(uint32_t u)
+{
+    float f;
+    memcpy(&f, &u, sizeof f);
+    return f;
+}
+
+static inline uint32_t
+BitsFromFloat(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof u);
+    return u;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Scalar, also used for the tails of the SIMD kernels:
+
+static void
+Transform_Scalar(const float *pIn, float *pOut, size_t n, uint32_t numPasses)
+{
+    float const c = FloatFromBits(CosThetaBits);
+    float const s = FloatFromBits(SinThetaBits);
+    float const dz = FloatFromBits(ZStepBits);
+    for (size_t i = 0; i < n; ++i) {
+        float x = pIn[4*i + 0], y = pIn[4*i + 1], z = pIn[4*i + 2];
+        float const w = pIn[4*i + 3];
+        for (uint32_t p = 0; p < numPasses; ++p) {
+            // Same order as the shader, vec2(c, s) * x + vec2(-s, c) * y:
+            float const nx = c * x + -s * y;
+            float const ny = s * x + c * y;
+            x = nx;
+            y = ny;
+            z += dz;
+        }
+        pOut[4*i + 0] = x;
+        pOut[4*i + 1] = y;
+        pOut[4*i + 2] = z;
+        pOut[4*i + 3] = w;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+#if XFB_REFERENCE_SSE2
+
+// 4 vertices at a time, transposed to x, y, z and w registers for the passes:
+static void
+Transform_SSE2(const float *pIn, float *pOut, size_t n, uint32_t numPasses)
+{
+    __m128 const c = _mm_set1_ps(FloatFromBits(CosThetaBits));
+    __m128 const s = _mm_set1_ps(FloatFromBits(SinThetaBits));
+    __m128 const ns = _mm_set1_ps(-FloatFromBits(SinThetaBits));
+    __m128 const dz = _mm_set1_ps(FloatFromBits(ZStepBits));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(pIn + 4*i + 0);
+        __m128 y = _mm_loadu_ps(pIn + 4*i + 4);
+        __m128 z = _mm_loadu_ps(pIn + 4*i + 8);
+        __m128 w = _mm_loadu_ps(pIn + 4*i + 12);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        for (uint32_t p = 0; p < numPasses; ++p) {
+            __m128 const nx = _mm_add_ps(_mm_mul_ps(c, x), _mm_mul_ps(ns, y));
+            __m128 const ny = _mm_add_ps(_mm_mul_ps(s, x), _mm_mul_ps(c, y));
+            x = nx;
+            y = ny;
+            z = _mm_add_ps(z, dz);
+        }
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(pOut + 4*i + 0, x);
+        _mm_storeu_ps(pOut + 4*i + 4, y);
+        _mm_storeu_ps(pOut + 4*i + 8, z);
+        _mm_storeu_ps(pOut + 4*i + 12, w);
+    }
+    Transform_Scalar(pIn + 4*i, pOut + 4*i, n - i, numPasses);
+}
+
+#define TransformKernel Transform_SSE2
+#define TransformKernelName "sse2"
+
+#endif // XFB_REFERENCE_SSE2
+
+// ---------------------------------------------------------------------------------------------------------------------
+#if XFB_REFERENCE_NEON
+
+// vld4q_f32 deinterleaves 4 vertices into x, y, z and w registers directly:
+static void
+Transform_NEON(const float *pIn, float *pOut, size_t n, uint32_t numPasses)
+{
+    float32x4_t const c = vdupq_n_f32(FloatFromBits(CosThetaBits));
+    float32x4_t const s = vdupq_n_f32(FloatFromBits(SinThetaBits));
+    float32x4_t const ns = vdupq_n_f32(-FloatFromBits(SinThetaBits));
+    float32x4_t const dz = vdupq_n_f32(FloatFromBits(ZStepBits));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4x4_t v = vld4q_f32(pIn + 4*i);
+        for (uint32_t p = 0; p < numPasses; ++p) {
+            float32x4_t const nx = vaddq_f32(vmulq_f32(c, v.val[0]), vmulq_f32(ns, v.val[1]));
+            float32x4_t const ny = vaddq_f32(vmulq_f32(s, v.val[0]), vmulq_f32(c, v.val[1]));
+            v.val[0] = nx;
+            v.val[1] = ny;
+            v.val[2] = vaddq_f32(v.val[2], dz);
+        }
+        vst4q_f32(pOut + 4*i, v);
+    }
+    Transform_Scalar(pIn + 4*i, pOut + 4*i, n - i, numPasses);
+}
+
+#define TransformKernel Transform_NEON
+#define TransformKernelName "neon"
+
+#endif // XFB_REFERENCE_NEON
+
+#ifndef TransformKernel
+#define TransformKernel Transform_Scalar
+#define TransformKernelName "scalar"
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void
+XfbReferenceTransform(const float *pIn, float *pOut, size_t numVerts, uint32_t numPasses)
+{
+    TransformKernel(pIn, pOut, numVerts, numPasses);
+}
+
+const char *
+XfbReferenceKernelName()
+{
+    return TransformKernelName;
+}
+
+enum {
+    VerifyTileVerts = 1024,    // reference vertices computed on the stack between compares
+    VerifyChunkVerts = 1 << 16 // vertices per thread pool job
+};
+
+static inline uint32_t
+UlpDistance(float a, float b)
+{
+    uint32_t const x = BitsFromFloat(a), y = BitsFromFloat(b);
+    if (x == y) return 0;
+    if ((x & 0x7fffffffu) > 0x7f800000u || (y & 0x7fffffffu) > 0x7f800000u) return UINT32_MAX; // NaN
+    uint32_t const kx = (x & 0x80000000u) ? ~x : (x | 0x80000000u);
+    uint32_t const ky = (y & 0x80000000u) ? ~y : (y | 0x80000000u);
+    return kx > ky ? kx - ky : ky - kx;
+}
+
+static bool
+VertexMatches(const float *got, const float *ref, uint32_t maxUlp)
+{
+    float const mag = fmaxf(fabsf(ref[0]), fabsf(ref[1]));
+    float const xyTolerance = float(maxUlp) * (nextafterf(mag, INFINITY) - mag);
+    for (int i = 0; i < 4; ++i) {
+        if (UlpDistance(got[i], ref[i]) <= maxUlp) continue;
+        if (i < 2 && fabsf(got[i] - ref[i]) <= xyTolerance) continue;
+        return false;
+    }
+    return true;
+}
+
+static void
+RecordMismatch(XfbReferenceResult *r, size_t index)
+{
+    if (r->numReported < XfbReferenceMaxReported) {
+        r->first[r->numReported++] = index;
+    }
+    r->numMismatches++;
+}
+
+struct VerifyChunk {
+    const XfbReferenceVerifyDesc *pDesc;
+    size_t begin, end;
+    XfbReferenceResult result;
+};
+
+static void
+VerifyChunkJob(void *pArg)
+{
+    VerifyChunk *const chunk = static_cast<VerifyChunk *>(pArg);
+    const XfbReferenceVerifyDesc& d = *chunk->pDesc;
+    chunk->result = { };
+
+    float tile[VerifyTileVerts * 4];
+    for (size_t t = chunk->begin; t < chunk->end; t += VerifyTileVerts) {
+        size_t const n = chunk->end - t < VerifyTileVerts ? chunk->end - t : size_t(VerifyTileVerts);
+        TransformKernel(d.pInput + 4*t, tile, n, d.numPasses);
+
+        // Nearly every tile matches within maxUlp outright, only the rest get the per vertex compare:
+        const ImageCompareDesc cmp = { d.pGot + 4*t, tile, uint32_t(n), 1, 4 * sizeof(float), 0, 0 };
+        ImageCompareResult cmpResult;
+        CompareImagesUlpF32(cmp, d.maxUlp, &cmpResult);
+        if (cmpResult.numMismatches == 0) continue;
+        for (size_t v = cmpResult.first[0].x; v < n; ++v) {
+            if (!VertexMatches(d.pGot + 4*(t + v), tile + 4*v, d.maxUlp)) RecordMismatch(&chunk->result, t + v);
+        }
+    }
+}
+
+void
+XfbReferenceVerify(const XfbReferenceVerifyDesc& desc, XfbReferenceResult *result)
+{
+    *result = { };
+    size_t const numChunks = (desc.numVerts + VerifyChunkVerts - 1) / VerifyChunkVerts;
+    if (numChunks == 0) {
+        return;
+    }
+    VerifyChunk *const chunks = static_cast<VerifyChunk *>(malloc(numChunks * sizeof(VerifyChunk)));
+    if (!chunks) {
+        // Still verify everything, just as one chunk on this thread:
+        VerifyChunk whole = { &desc, 0, desc.numVerts, { } };
+        VerifyChunkJob(&whole);
+        *result = whole.result;
+        return;
+    }
+    for (size_t i = 0; i < numChunks; ++i) {
+        chunks[i].pDesc = &desc;
+        chunks[i].begin = i * VerifyChunkVerts;
+        chunks[i].end = i + 1 < numChunks ? (i + 1) * VerifyChunkVerts : desc.numVerts;
+    }
+
+    unsigned numThreads = ThreadPoolDefaultThreadCount();
+    if (numThreads > numChunks) numThreads = unsigned(numChunks);
+    if (numThreads <= 1) {
+        for (size_t i = 0; i < numChunks; ++i) VerifyChunkJob(&chunks[i]);
+    } else {
+        ThreadPool *const pool = ThreadPoolCreate(numThreads, unsigned(numChunks));
+        for (size_t i = 0; i < numChunks; ++i) ThreadPoolSubmit(pool, VerifyChunkJob, &chunks[i]);
+        ThreadPoolDestroy(pool);
+    }
+
+    // Chunks are in vertex order, so the first reported stay ascending:
+    for (size_t i = 0; i < numChunks; ++i) {
+        const XfbReferenceResult& r = chunks[i].result;
+        for (uint32_t j = 0; j < r.numReported && result->numReported < XfbReferenceMaxReported; ++j) {
+            result->first[result->numReported++] = r.first[j];
+        }
+        result->numMismatches += r.numMismatches;
+    }
+    free(chunks);
+}
+
+void
+PrintXfbReferenceResult(const char *what, const XfbReferenceVerifyDesc& desc, const XfbReferenceResult& r)
+{
+    if (r.numMismatches == 0) {
+        return;
+    }
+    printf("%s: %llu of %llu vertices are more than %u ULP from the CPU reference after %u passes. First:\n",
+           what, (unsigned long long)r.numMismatches, (unsigned long long)desc.numVerts, desc.maxUlp, desc.numPasses);
+    for (uint32_t i = 0; i < r.numReported; ++i) {
+        size_t const v = r.first[i];
+        float ref[4];
+        XfbReferenceTransform(desc.pInput + 4*v, ref, 1, desc.numPasses);
+        const float *const got = desc.pGot + 4*v;
+        printf("    [%llu] = {%.9g %.9g %.9g %.9g}, expected {%.9g %.9g %.9g %.9g}\n", (unsigned long long)v,
+               got[0], got[1], got[2], got[3], ref[0], ref[1], ref[2], ref[3]);
+    }
+}
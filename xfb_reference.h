@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * CPU model of the xfb_vb_pingpong vertex shader, which rotates xy by pi/16, adds 1/32 to z and
+ * passes w through, for checking the XFB output of any vertex array after any number of passes.
+ * Vertices are 4 floats (xyzw). The passes for a group of vertices are run back to back in
+ * registers (SSE2 or NEON, else scalar), so each vertex is loaded and stored once regardless of
+ * the pass count, and a large verify is split into chunks over a thread pool.
+ */
+
+enum { XfbReferenceMaxReported = 8 };
+
+// Runs numPasses of the shader over each vertex. pIn and pOut may be the same array.
+void
+XfbReferenceTransform(const float *pIn, float *pOut, size_t numVerts, uint32_t numPasses);
+
+struct XfbReferenceVerifyDesc {
+    const float *pInput; // vertices before the first pass
+    const float *pGot;   // vertices after numPasses, as written by the device
+    size_t numVerts;
+    uint32_t numPasses;
+    /*
+     * A component matches if it is at most maxUlp representable values from the reference. Since
+     * rotating can cancel x or y down to near 0, x and y also match if they are within maxUlp ULPs
+     * of the larger of the reference's |x| and |y|.
+     */
+    uint32_t maxUlp;
+};
+
+struct XfbReferenceResult {
+    uint64_t numMismatches; // vertices with at least one mismatching component
+    uint32_t numReported;   // min(numMismatches, XfbReferenceMaxReported)
+    size_t first[XfbReferenceMaxReported]; // vertex indices, ascending
+};
+
+void
+XfbReferenceVerify(const XfbReferenceVerifyDesc& desc, XfbReferenceResult *result);
+
+/*
+ * Tolerance for a device that may fuse the shader's multiply-adds or round differently than the CPU,
+ * each pass can move x and y by about an ULP.
+ */
+inline uint32_t
+XfbReferenceDefaultMaxUlp(uint32_t numPasses)
+{
+    return 2 * numPasses + 2;
+}
+
+// Name of the transform kernel picked at compile time, e.g. "sse2".
+const char *
+XfbReferenceKernelName();
+
+// Prints the mismatch count and the first mismatching vertices with their expected values, if any.
+void
+PrintXfbReferenceResult(const char *what, const XfbReferenceVerifyDesc& desc, const XfbReferenceResult& result);
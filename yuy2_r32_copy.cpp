@@ -1,6 +1,11 @@
 #include "vk_simple_init.h"
 #include "volk/volk.h"
 #include "vk_util.h"
+#include "image_compare.h"
+#include "gpu_verify.h"
+#include "result_archive.h"
+
+#include "artifact_writer.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -18,6 +23,9 @@ VerifyVkResultFaild(VkResult r, const char *expr, int line)
 }
 #define VERIFY_VK(e) do { if (VkResult _r = (e)) VerifyVkResultFaild(_r, #e, __LINE__); } while(0)
 
+extern bool g_bSaveFailingImages;
+extern unsigned g_repeatCount;
+
 
 void TestYuy2Copy(const VulkanObjetcs& vk)
 {
@@ -34,15 +42,20 @@ void TestYuy2Copy(const VulkanObjetcs& vk)
     void *pUploadMap = nullptr;
     vkMapMemory(vk.device, upload.memory, 0, VK_WHOLE_SIZE, 0x0, &pUploadMap);
 
-    vkuDedicatedBuffer(vk.device, BufferByteSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, &readback, vk.memProps,
-                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
-    void *pReadbackMap = nullptr;
-    vkMapMemory(vk.device, readback.memory, 0, VK_WHOLE_SIZE, 0x0, &pReadbackMap);
+    // Verified on the device, only copied to the host if that fails:
+    vkuDedicatedBuffer(vk.device, BufferByteSize,
+                       VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                       &readback, vk.memProps, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
+    // Keep the expected values in ordinary memory, the upload mapping may be write-combined and slow to read back:
+    uint32_t *const pExpected = static_cast<uint32_t *>(malloc(BufferByteSize));
     for (uint32_t i = 0; i < NumBlocksX * NumBlocksY; ++i) {
-        reinterpret_cast<uint32_t *>(pUploadMap)[i] = i;
+        pExpected[i] = i;
     }
-    memset(pReadbackMap, 0xCD, BufferByteSize);
+    memcpy(pUploadMap, pExpected, BufferByteSize);
+
+    GpuVerifier verifier;
+    VERIFY_VK(GpuVerifierInit(vk, &verifier));
 
     VkCommandPool cmdpool = VK_NULL_HANDLE;
     VkCommandBuffer cmdbuf = VK_NULL_HANDLE;
@@ -66,7 +79,7 @@ void TestYuy2Copy(const VulkanObjetcs& vk)
     {
         const VkCommandBufferBeginInfo cmdBufbeginInfo = {
             VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
-            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr
+            0x0, nullptr // submitted g_repeatCount times
         };
         VERIFY_VK(vkBeginCommandBuffer(cmdbuf, &cmdBufbeginInfo));
     }
@@ -117,6 +130,7 @@ void TestYuy2Copy(const VulkanObjetcs& vk)
     imgbar.image = r32ui.image;
     vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0x0,
                          0, nullptr, 0, nullptr, 1, &imgbar);
+    vkCmdFillBuffer(cmdbuf, readback.buffer, 0, VK_WHOLE_SIZE, 0xCDCDCDCDu);
     /* 1: Init R32_UINT image: */
     VkBufferImageCopy bufImgCopy = { };
     bufImgCopy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
@@ -139,52 +153,98 @@ void TestYuy2Copy(const VulkanObjetcs& vk)
     vkCmdCopyImage(cmdbuf, r32ui.image, VK_IMAGE_LAYOUT_GENERAL, yuy2.image, VK_IMAGE_LAYOUT_GENERAL, 1, &imgCopy);
     vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0x0,
                          1, &membar, 0, nullptr, 0, nullptr);
-    /* 3: Copy from YUY2 image to host-cached buffer: */
+    /* 3: Copy from YUY2 image to buffer, then expect readback[i] == i: */
     bufImgCopy.imageExtent.width *= 2;
     bufImgCopy.bufferRowLength *= 2;
     vkCmdCopyImageToBuffer(cmdbuf, yuy2.image, VK_IMAGE_LAYOUT_GENERAL, readback.buffer, 1, &bufImgCopy);
-    membar.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
-    vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0x0,
-                         1, &membar, 0, nullptr, 0, nullptr);
+    GpuVerifierCmdCompareAnalytic(&verifier, cmdbuf, readback.buffer, NumBlocksX * NumBlocksY, 1, 0);
+    VERIFY_VK(vkEndCommandBuffer(cmdbuf));
 
     fflush(stdout);
     fflush(stderr);
-    {
-        VERIFY_VK(vkEndCommandBuffer(cmdbuf));
+    uint32_t nBlocksMismatch = 0;
+    unsigned run = 0;
+    for (; run < g_repeatCount && nBlocksMismatch == 0; ++run) {
         VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &cmdbuf;
         VERIFY_VK(vkQueueSubmit(vk.universalQueue, 1, &submitInfo, VK_NULL_HANDLE));
         VERIFY_VK(vkDeviceWaitIdle(vk.device));
+        const GpuVerifySummary& summary = GpuVerifierReadSummary(verifier);
+        nBlocksMismatch = summary.numMismatches;
+        if (nBlocksMismatch) {
+            printf("Run %u of %u:\n", run + 1, g_repeatCount);
+            PrintGpuVerifySummary("yuy2 readback", summary);
+        }
     }
 
-
-    int nBlocksMismatch = 0;
-    int i = 0;
-    for (int y = 0; y < NumBlocksY; ++y) {
-        for (int xblock = 0; xblock < NumBlocksX; ++xblock) {
-            assert(i == y*NumBlocksX + xblock);
-            uint32_t const val = reinterpret_cast<const uint32_t *>(pReadbackMap)[i];
-            if (val != uint32_t(i)) {
-                nBlocksMismatch++;
-                printf("(%d, %d): got 0x%X, expected 0x%X\n", xblock, y, val, i);
-            }
-            i++;
+    if (nBlocksMismatch && (g_bSaveFailingImages || ResultArchiveIsOpen())) {
+        VkuStagingBuffer stage;
+        VERIFY_VK(vkuStagingBuffer(vk.device, BufferByteSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, &stage, vk.memProps));
+        vkResetCommandPool(vk.device, cmdpool, 0x0);
+        const VkCommandBufferBeginInfo cmdBufbeginInfo = {
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr
+        };
+        VERIFY_VK(vkBeginCommandBuffer(cmdbuf, &cmdBufbeginInfo));
+        const VkBufferCopy region = { 0, 0, BufferByteSize };
+        vkCmdCopyBuffer(cmdbuf, readback.buffer, stage.buffer, 1, &region);
+        membar.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0x0,
+                             1, &membar, 0, nullptr, 0, nullptr);
+        VERIFY_VK(vkEndCommandBuffer(cmdbuf));
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &cmdbuf;
+        VERIFY_VK(vkQueueSubmit(vk.universalQueue, 1, &submitInfo, VK_NULL_HANDLE));
+        VERIFY_VK(vkDeviceWaitIdle(vk.device));
+        vkuInvalidateStagingBuffer(vk.device, stage);
+
+        ImageCompareDesc compareDesc = { };
+        compareDesc.pGot = stage.pHost;
+        compareDesc.pExpected = pExpected;
+        compareDesc.width = NumBlocksX;
+        compareDesc.height = NumBlocksY;
+        compareDesc.bytesPerPixel = sizeof(uint32_t);
+        ImageCompareResult compareResult;
+        CompareImagesExact(compareDesc, &compareResult);
+        for (uint32_t r = 0; r < compareResult.numReported; ++r) {
+            uint32_t const xblock = compareResult.first[r].x, y = compareResult.first[r].y;
+            uint32_t const i = y*NumBlocksX + xblock;
+            uint32_t const val = static_cast<const uint32_t *>(stage.pHost)[i];
+            printf("(%u, %u): got 0x%X, expected 0x%X\n", xblock, y, val, pExpected[i]);
         }
+        PrintImageCompareResult("yuy2 readback", compareResult);
+        const ResultArchiveAddDesc archiveDesc = {
+            "yuy2_r32_copy", "", VK_FORMAT_R32_UINT, NumBlocksX, NumBlocksY, 1,
+            sizeof(uint32_t), stage.pHost, NumBlocksX * sizeof(uint32_t), true
+        };
+        ResultArchiveAdd(archiveDesc);
+        if (ResultArchiveIsOpen()) {
+            puts("Failed result is archived as yuy2_r32_copy");
+        } else {
+            const char *const name = "yuy2_r32_generated.png";
+            printf("Saving failed result as %s\n", name);
+            ArtifactWritePng(name, NumBlocksX, NumBlocksY, 4, stage.pHost, NumBlocksX * sizeof(uint32_t));
+        }
+        vkuDestroyStagingBuffer(vk.device, stage);
+    } else if (nBlocksMismatch) {
+        puts("Not reading back the full result (use --save-failing-images if desired).");
     }
 
-
+    free(pExpected);
     vkuDestroyImageAndFreeMemory(vk.device, r32ui);
     vkuDestroyImageAndFreeMemory(vk.device, yuy2);
     vkuDestroyBufferAndFreeMemory(vk.device, readback);
     vkuDestroyBufferAndFreeMemory(vk.device, upload);
 
+    GpuVerifierDestroy(verifier);
     vkDestroyCommandPool(vk.device, cmdpool, ALLOC_CBS);
 
     if (nBlocksMismatch == 0) {
-        puts("Test passed.");
+        printf("Test passed (%u runs).\n", run);
     } else {
-        printf("Test failed, nBlocksMismatch=%d.\n", nBlocksMismatch);
+        printf("Test failed, nBlocksMismatch=%u.\n", nBlocksMismatch);
     }
 }
 